@@ -2,6 +2,47 @@
 
 #pragma once
 
+/*
+    Turns on the phase timing report (see db/db_timings.h): how long
+    each table took to load, index and save, with rows/sec and
+    bytes/sec. With log_path NULL the report goes to stdout; otherwise
+    it is appended to log_path with a timestamp, so restarts can be
+    compared over time. Call before app_init.
+*/
+void app_enable_timings(const char *log_path);
+
+/*
+    Records trace spans (lib/trace) for the whole run and writes them
+    to path in Chrome trace-event JSON when app_shutdown finishes.
+    Call before app_init. Returns 0 on success, -1 otherwise.
+*/
+int app_enable_tracing(const char *path);
+
+/*
+    Records every DB operation of the run to a workload trace at path
+    (see db/db_record.h), from the moment the data is loaded until
+    app_shutdown, before the final save. Replay it with build/replay.
+    Call before app_init.
+*/
+void app_enable_recording(const char *path);
+
 void app_init(void);
 void app_run(void);
 void app_shutdown(void);
+
+/*
+    Serves the loaded DB over a Unix socket until SIGINT/SIGTERM.
+    Call between app_init and app_shutdown instead of app_run.
+    Returns 0 on a clean stop, -1 if the server could not start.
+*/
+int app_serve(const char *socket_path);
+
+/*
+    Runs every command of a batch file ("-" = stdin) against the DB,
+    with the replies buffered on stdout. Blank lines and lines starting
+    with '#' are ignored; "quit" stops early. Nothing is saved here:
+    app_shutdown saves once at the end, as in the interactive mode.
+    Returns the number of failed commands, or -1 if the file could not
+    be opened.
+*/
+int app_batch(const char *path);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "db/db.h"
+
+/*
+    Line-oriented command interpreter.
+
+    Used by the non-interactive front-ends (socket server, batch mode) so that
+    every one of them speaks the same little language and goes through
+    the same DB calls as the menus.
+
+    One command per line, words separated by spaces; record fields are
+    separated by ';' exactly like in the data files:
+
+        lookup <book_id>
+        search title <term>
+        search author <term>
+        add-book <title>;<author>;<year>;<available>
+        edit-book <book_id> [title];[author];[year];[available]
+        remove-book <book_id>
+        remove-user <user_id>
+        remove-loan <loan_id>
+        remove-suggestion <suggestion_id>
+        add-loan <user_id> <book_id> [YYYYMMDD]
+        return-loan <loan_id> [YYYYMMDD]
+        due|overdue [YYYYMMDD]
+        reserve <user_id> <book_id> [tier [YYYYMMDD]]
+        cancel-reservation <user_id> <book_id>
+        reservations <book_id>
+        totals|check-totals
+        book-loans <book_id>
+        top-books <k> [YYYYMMDD [YYYYMMDD]]
+        top-users <k> [YYYYMMDD [YYYYMMDD]]
+        build-recommendations
+        recommend <book_id> [n]
+        similar-books <min%> <title>
+        similar-suggestions <min%> <title>
+        autocomplete title|author|user <limit> [prefix]
+        help
+        quit
+
+    Dates must be real days (20240231 is refused, not rounded), and a
+    book's available count must be 0..INT_MAX.
+    In edit-book an empty field keeps the current value. The older
+    short names add, remove, checkout and return still work. A return
+    that hands the copy to the next reservation replies
+    "OK handoff <new_loan_id>". totals prints one "totals key=value ..."
+    line; check-totals fails if a maintained counter disagrees with a
+    full rebuild. top-books and top-users print one "top <id>;<loans>"
+    line per entry, most loans first, counting the loans borrowed
+    between the two dates (none: all time; the first may not be after
+    the second). recommend prints one
+    "recommend <id>;<shared borrowers>" line per book, from the last
+    build-recommendations run (the first recommend builds them if none
+    ran yet). similar-books
+    and similar-suggestions print one "similar <id>;<similarity>;<edits>"
+    line per title at least min% (50-100) similar, most similar first.
+    autocomplete prints one "complete <id>;<field>" line per book (title
+    or author) or user (name) starting with prefix, case ignored, in
+    lexical order (at most 50).
+
+    Every reply ends with exactly one status line:
+        "OK" or "OK <details>"  on success,
+        "ERR <message>"         on failure.
+    Commands that return records print one line per record before the
+    status line ("book <csv>", "loan <csv>").
+*/
+
+/* Growable text buffer that collects the reply of a command. */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} CommandOutput;
+
+void command_output_init(CommandOutput *out);
+void command_output_clear(CommandOutput *out);
+void command_output_free(CommandOutput *out);
+
+/* printf-style append. On allocation failure the text is dropped. */
+void command_printf(CommandOutput *out, const char *fmt, ...);
+
+typedef enum {
+    COMMAND_OK = 0,
+    COMMAND_ERROR = -1,
+    COMMAND_QUIT = 1   /* the client asked to close the session */
+} CommandResult;
+
+/*
+    Parses and runs one command line (without the trailing newline)
+    against db, appending the reply to out.
+    Safe to call from several threads when the DB is in concurrent mode.
+*/
+CommandResult command_execute(DB *db, const char *line, CommandOutput *out);
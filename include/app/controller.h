@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+/* Utilitarios partilhados pelos controllers. */
+
+/* Registos mostrados por pagina nas listagens. */
+#define CONTROLLER_PAGE_SIZE 20
+
+/*
+    Pergunta se deve mostrar a pagina seguinte.
+    Enter continua; '0', 'q' ou fim do input param.
+*/
+bool controller_next_page(void);
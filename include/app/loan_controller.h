@@ -5,3 +5,21 @@
 /* Operacoes de negocio simples relacionadas com emprestimos. */
 
 void loan_list_all(const DB *db);
+
+/* Pede uma data e mostra quantos emprestimos estao por devolver desde antes dela. */
+void loan_circulation_report(const DB *db);
+
+/* Pede uma data e lista os emprestimos por devolver com o prazo ja ultrapassado. */
+void loan_list_overdue(DB *db);
+
+/* Pedem os dados e registam um emprestimo / uma devolucao (db_checkout / db_return). */
+void loan_checkout(DB *db);
+void loan_return(DB *db);
+
+/* Reservas: registar, ver a fila de um livro e cancelar (db_reserve / db_book_reservations / db_cancel_reservation). */
+void loan_reserve(DB *db);
+void loan_list_reservations(const DB *db);
+void loan_cancel_reservation(DB *db);
+
+/* Pede k e um intervalo de datas e mostra os livros mais emprestados e os utilizadores mais ativos (db_top_books / db_top_users). */
+void loan_top_report(const DB *db);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "db/db.h"
+
+/*
+    Local socket server.
+
+    Listens on a Unix domain socket, accepts any number of clients and
+    runs the commands they send (see app/command.h) on a fixed pool of
+    worker threads that share one DB.
+
+    Threading model:
+        - the calling thread runs an epoll event loop that accepts
+          connections, reads request lines and writes replies;
+        - complete lines are handed to the workers, which execute them
+          against the DB (switched to concurrent mode while serving);
+        - each connection has at most one command in flight, so replies
+          always come back in the order the requests were sent.
+
+    Only available on Linux (epoll); elsewhere it returns -1 at once.
+*/
+
+/* Default number of worker threads when 0 is passed to server_run. */
+#define SERVER_DEFAULT_WORKERS 4
+
+/*
+    Serves until SIGINT/SIGTERM is received.
+    A socket file left at socket_path by an earlier run is replaced;
+    anything else there, or a socket another server still listens on,
+    makes it fail instead.
+    Returns 0 after a clean shutdown, -1 if the server could not start.
+*/
+int server_run(DB *db, const char *socket_path, unsigned workers);
@@ -1,7 +1,21 @@
 #ifndef DB_H
 #define DB_H
 
+#include <stdbool.h>
+#include <pthread.h>
+
 #include "lib/dlist/dlist.h"
+#include "lib/epoch/epoch.h"
+#include "lib/bptree/bptree.h"
+#include "db/id_index.h"
+#include "db/loan_columns.h"
+#include "db/due_wheel.h"
+#include "db/id_counts.h"
+#include "db/reservations.h"
+#include "db/recommendations.h"
+#include "db/title_index.h"
+#include "db/prefix_index.h"
+#include "db/db_timings.h"
 #include "model/books.h"
 #include "model/user.h"
 #include "model/loans.h"
@@ -18,12 +32,91 @@
 	- Loads all data from the filesystem layer on startup.
 	- Provides a single place for the app layer to query/update data.
 	- Saves everything back to disk on shutdown.
+
+	Concurrency:
+	By default the DB assumes a single thread, exactly like before.
+	Calling db_set_concurrent(db, true) turns on an opt-in mode where
+	every table is guarded by its own reader-writer lock:
+	- lookups, copies and iterations take the table's read lock;
+	- add/update/remove take the table's write lock.
+	In that mode code should iterate with db_foreach_* and read records
+	with db_copy_*_by_id instead of keeping raw pointers around.
+
+	Lookups by id never take a lock: every table has an id index that
+	readers probe inside an epoch read section (lib/epoch). Removed or
+	replaced records are handed to the epoch domain and only freed once
+	no reader can still be looking at them.
 */
 typedef struct DB {
 	DList *books;
 	DList *users;
 	DList *loans;
 	DList *suggestions;
+
+	/* Opt-in concurrent mode (see db_set_concurrent). */
+	bool concurrent;
+	bool locks_ready;
+	pthread_rwlock_t books_lock;
+	pthread_rwlock_t users_lock;
+	pthread_rwlock_t loans_lock;
+	pthread_rwlock_t suggestions_lock;
+
+	/* id -> record indexes, readable without locks. */
+	EpochDomain *epoch;
+	IdIndex *book_index;
+	IdIndex *user_index;
+	IdIndex *loan_index;
+	IdIndex *suggestion_index;
+
+	/*
+		Ordered indexes (lib/bptree) for range queries, keyed by
+		(field, id); loan dates are keyed by day number (model/date.h).
+		Guarded by the table locks like the lists.
+	*/
+	BPTree *books_by_year;
+	BPTree *loans_by_borrow;
+	BPTree *loans_by_return;
+
+	/* Ids in list order (highest first), for keyset pagination. */
+	BPTree *books_by_id;
+	BPTree *users_by_id;
+	BPTree *loans_by_id;
+	BPTree *suggestions_by_id;
+
+	/* Column copy of the loans for bulk filters, under loans_lock. */
+	LoanColumns *loan_columns;
+
+	/* Active loans by due day, under loans_lock. */
+	DueWheel *due_wheel;
+
+	/* Active (not returned) loans per user id, under loans_lock. */
+	IdCounts *active_loans;
+
+	/*
+		Aggregates kept up to date by every write (see db_totals):
+		loans per book id, loans per user id and loans not returned
+		yet under loans_lock, the sum of Book.available under
+		books_lock.
+	*/
+	IdCounts *book_loans;
+	IdCounts *user_loans;
+	size_t loans_active;
+	long long copies_available;
+
+	/* Holds waiting for a copy, one queue per book, under books_lock. */
+	ReservationQueues *reservations;
+
+	/* Last co-borrowing build (NULL until the first), under loans_lock. */
+	Recommendations *recommendations;
+
+	/* Trigram indexes of the titles, under books_lock and suggestions_lock. */
+	TitleIndex *book_titles;
+	TitleIndex *suggestion_titles;
+
+	/* Autocomplete tries, under books_lock (titles, authors) and users_lock (names). */
+	PrefixIndex *book_title_keys;
+	PrefixIndex *book_author_keys;
+	PrefixIndex *user_name_keys;
 } DB;
 
 /*
@@ -43,7 +136,9 @@ int db_init(DB *db,
 			const char *suggestions_path);
 
 /*
-	Saves the current contents of the DB back to disk.
+	Saves the current contents of the DB back to disk. Tables that
+	never loaded (db_init failed) are not written, so their files keep
+	their old contents.
 
 	Returns:
 		0 on success (all saves succeeded)
@@ -55,6 +150,28 @@ int db_save(const DB *db,
 			const char *loans_path,
 			const char *suggestions_path);
 
+/*
+	Same as db_init / db_save, but also fill *timings with the time,
+	row count and file size of every load, index and save phase (see
+	db/db_timings.h). db_init_timed fills the load/index phases and
+	init_ns, db_save_timed the save phases and save_ns; the other
+	fields are left alone, so one DBTimings can cover a whole run.
+	timings may be NULL.
+*/
+int db_init_timed(DB *db,
+				  const char *books_path,
+				  const char *users_path,
+				  const char *loans_path,
+				  const char *suggestions_path,
+				  DBTimings *timings);
+
+int db_save_timed(const DB *db,
+				  const char *books_path,
+				  const char *users_path,
+				  const char *loans_path,
+				  const char *suggestions_path,
+				  DBTimings *timings);
+
 /*
 	Frees all memory owned by the DB.
 	Destroys the three lists and all Book/User/Loan elements.
@@ -62,15 +179,192 @@ int db_save(const DB *db,
 void db_destroy(DB *db);
 
 /*
-	Example query helpers.
-	Simple linear searches for now; can be optimized or expanded later.
+	Turns the per-table reader-writer locks on or off.
+
+	Must be called while only one thread uses the DB (typically right
+	after db_init and before any worker thread is started). db_init,
+	db_destroy and db_set_concurrent itself are never thread-safe.
+*/
+void db_set_concurrent(DB *db, bool enabled);
+
+/*
+	Lock-free read sections.
+
+	Pointers returned by db_find_*_by_id stay valid until the matching
+	db_read_end, even if another thread removes or updates the record
+	in the meantime. Sections nest and are cheap (two atomic stores).
+	Do not add/update/remove from inside a section on the same thread
+	for long-running work: reclamation waits for every open section.
+*/
+void db_read_begin(const DB *db);
+void db_read_end(const DB *db);
+
+/*
+	O(1) lookups through the id index.
+
+	In concurrent mode the returned pointer is only safe to use inside
+	a db_read_begin/db_read_end section; otherwise use db_copy_*_by_id.
 */
 Book *db_find_book_by_id(const DB *db, unsigned id);
 User *db_find_user_by_id(const DB *db, unsigned id);
 Loan *db_find_loan_by_id(const DB *db, unsigned id);
 Suggestion *db_find_suggestion_by_id(const DB *db, unsigned id);
 
-/* Give read-only access to the internal lists (for iteration). */
+/*
+	Thread-safe lookups: copy the record with the given id into *out.
+	Lock-free; the copy is taken inside an epoch read section.
+
+	Return:
+		0 if the record was found and copied
+	   -1 if it does not exist or the arguments are invalid.
+*/
+int db_copy_book_by_id(const DB *db, unsigned id, Book *out);
+int db_copy_user_by_id(const DB *db, unsigned id, User *out);
+int db_copy_loan_by_id(const DB *db, unsigned id, Loan *out);
+int db_copy_suggestion_by_id(const DB *db, unsigned id, Suggestion *out);
+
+/*
+	Callback-based iteration.
+
+	The visitor is called once per record, in list order (highest id
+	first), while the table's read lock is held. Returning a non-zero
+	value from the visitor stops the iteration early.
+
+	The visitor must not call back into the DB: copy what it needs into
+	ctx and resolve relations (e.g. a loan's user) after the iteration.
+
+	Return:
+		0 if every record was visited,
+		the visitor's non-zero value if it stopped the iteration,
+	   -1 if the DB or visitor is invalid.
+*/
+typedef int (*DBBookVisitor)(const Book *book, void *ctx);
+typedef int (*DBUserVisitor)(const User *user, void *ctx);
+typedef int (*DBLoanVisitor)(const Loan *loan, void *ctx);
+typedef int (*DBSuggestionVisitor)(const Suggestion *suggestion, void *ctx);
+
+int db_foreach_book(const DB *db, DBBookVisitor fn, void *ctx);
+int db_foreach_user(const DB *db, DBUserVisitor fn, void *ctx);
+int db_foreach_loan(const DB *db, DBLoanVisitor fn, void *ctx);
+int db_foreach_suggestion(const DB *db, DBSuggestionVisitor fn, void *ctx);
+
+/*
+	Case-insensitive substring search over book titles or authors.
+	Matching books are passed to the visitor with the same rules and
+	return values as db_foreach_book.
+*/
+typedef enum {
+	DB_BOOK_TITLE,
+	DB_BOOK_AUTHOR
+} DBBookField;
+
+int db_search_books(const DB *db, DBBookField field, const char *term,
+					DBBookVisitor fn, void *ctx);
+
+/*
+	Range queries over the ordered indexes, bounds inclusive.
+
+	Records are visited in key order (ties broken by ascending id), with
+	the same rules and return values as db_foreach_*. The cost is one
+	O(log n) descent plus the matching records, never a table scan.
+
+	db_loans_by_return_date only sees returned loans unless from is 0
+	(loans not returned yet have date_return 0).
+	Loan date bounds are YYYYMMDD; one that is not a real date (e.g.
+	20240100) is rounded inwards to the nearest real date.
+*/
+int db_books_by_year_range(const DB *db, int from, int to,
+						   DBBookVisitor fn, void *ctx);
+int db_loans_by_borrow_date(const DB *db, unsigned from, unsigned to,
+							DBLoanVisitor fn, void *ctx);
+int db_loans_by_return_date(const DB *db, unsigned from, unsigned to,
+							DBLoanVisitor fn, void *ctx);
+
+/*
+	Keyset pagination, in list order (highest id first).
+
+	Visits at most limit records with an id lower than after_id, or
+	from the top of the table when after_id is 0. The page starts with
+	an O(log n) seek in the table's id tree, so page k costs the same
+	as page 1, and a record added or removed between two calls never
+	shifts the next page (no row is skipped or shown twice).
+
+	*next_after receives the id to pass back for the following page,
+	or 0 when this page reached the end of the table. The visitor
+	follows the db_foreach_* rules; if it stops early, *next_after is
+	the id of the last record it was given.
+
+	Return:
+		number of records visited,
+	   -1 if the DB, visitor or next_after is invalid or limit is 0.
+*/
+int db_books_page(const DB *db, unsigned after_id, size_t limit,
+				  DBBookVisitor fn, void *ctx, unsigned *next_after);
+int db_users_page(const DB *db, unsigned after_id, size_t limit,
+				  DBUserVisitor fn, void *ctx, unsigned *next_after);
+int db_loans_page(const DB *db, unsigned after_id, size_t limit,
+				  DBLoanVisitor fn, void *ctx, unsigned *next_after);
+int db_suggestions_page(const DB *db, unsigned after_id, size_t limit,
+						DBSuggestionVisitor fn, void *ctx, unsigned *next_after);
+
+/*
+	Bulk loan filters, answered by a vectorized scan of the loans'
+	column store (db/loan_columns.h) instead of walking the list.
+	See LoanFilter for the conditions; a zeroed filter matches every
+	loan. E.g. the loans still out that were borrowed before a cutoff:
+
+		LoanFilter f = { .borrow_to = cutoff - 1, .active_only = true };
+
+	db_loans_count stores the number of matches in *count.
+	db_loans_select writes the ids of up to cap matches to ids, in no
+	particular order, and stores the total number of matches in
+	*count, so a caller whose buffer was too small can retry with a
+	bigger one. ids may be NULL when cap is 0.
+	db_loans_days_out stores the number of returned loans matching the
+	filter in *returned and the sum of their lengths in days in *days
+	(average = days / returned); active_only matches none.
+
+	Return:
+		0 on success
+	   -1 if the DB, filter or an output pointer is invalid.
+*/
+int db_loans_count(const DB *db, const LoanFilter *filter, size_t *count);
+int db_loans_select(const DB *db, const LoanFilter *filter,
+					unsigned *ids, size_t cap, size_t *count);
+int db_loans_days_out(const DB *db, const LoanFilter *filter, size_t *returned, uint64_t *days);
+
+/*
+	Due dates (see LOAN_PERIOD_DAYS in model/loans.h).
+
+	Loans not returned yet are kept in a timing wheel by due day, so
+	these queries only touch the loans they return, never the whole
+	table, and a return unschedules its loan in O(1).
+
+	db_loans_due_on visits the active loans due on date (YYYYMMDD); the
+	loans that become overdue today are the ones due yesterday.
+	db_loans_overdue visits the active loans due before today, in no
+	particular order. It moves the wheel's current day forward to
+	today (hence the non-const DB), which is cheap when called daily.
+	The wheel starts at the system date when the DB is loaded.
+
+	The visitor follows the db_foreach_* rules.
+*/
+int db_loans_due_on(const DB *db, unsigned date, DBLoanVisitor fn, void *ctx);
+int db_loans_overdue(DB *db, unsigned today, DBLoanVisitor fn, void *ctx);
+
+/*
+	Releases the calling thread's slot in the DB's epoch domain.
+	Worker threads that used the DB in concurrent mode should call it
+	right before they exit.
+*/
+void db_thread_exit(const DB *db);
+
+/*
+	Give read-only access to the internal lists (for iteration).
+
+	Deprecated: only safe when the DB is used by a single thread.
+	Prefer db_foreach_* in new code.
+*/
 DList *db_get_books(const DB *db);
 DList *db_get_users(const DB *db);
 DList *db_get_loans(const DB *db);
@@ -89,20 +383,56 @@ DList *db_get_suggestions(const DB *db);
 
 	Return:
 		0 on success
-	   -1 on allocation failure or invalid DB pointer.
+	   -1 on allocation failure, invalid DB pointer or if an element
+	      with the same id already exists.
 */
 int db_add_book(DB *db, const Book *src);
 int db_add_user(DB *db, const User *src);
 int db_add_loan(DB *db, const Loan *src);
 int db_add_suggestion(DB *db, const Suggestion *src);
 
+/*
+	Same as db_add_*, but the DB picks the id: src->id is ignored and
+	set to one past the highest id currently stored (1 for an empty
+	table). Choosing the id under the table's write lock means two
+	threads adding at the same time can never get the same id.
+
+	Return:
+		0 on success (src->id holds the new id)
+	   -1 on allocation failure or invalid DB pointer.
+*/
+int db_add_book_auto(DB *db, Book *src);
+int db_add_user_auto(DB *db, User *src);
+int db_add_loan_auto(DB *db, Loan *src);
+int db_add_suggestion_auto(DB *db, Suggestion *src);
+
+/*
+	Replace the stored record that has the same id as src.
+
+	This is how controllers edit a record: copy it out, change the
+	copy, write it back. The id itself cannot be changed this way.
+	In concurrent mode the record is replaced copy-on-write, so
+	lock-free readers see either the old or the new version.
+
+	Return:
+		0 on success
+	   -1 if no element with that id exists or DB is invalid.
+*/
+int db_update_book(DB *db, const Book *src);
+int db_update_user(DB *db, const User *src);
+int db_update_loan(DB *db, const Loan *src);
+int db_update_suggestion(DB *db, const Suggestion *src);
+
 /*
 	Remove an element by id.
 
 	These functions:
-		- search the corresponding list,
-		- free the matching element,
-		- unlink its node from the list.
+		- find the element through the id index,
+		- unlink its node from the list,
+		- free the element (deferred through the epoch domain in
+		  concurrent mode),
+		- for a book or a user, cancel its reservation holds.
+	Removing a loan does not put its copy back (see db_return).
 
 	Return:
 		0 if an element was removed
@@ -113,5 +443,212 @@ int db_remove_user(DB *db, unsigned id);
 int db_remove_loan(DB *db, unsigned id);
 int db_remove_suggestion(DB *db, unsigned id);
 
-#endif /* DB_H */
+/*
+	Circulation: lending a copy of a book and taking it back.
+
+	db_checkout creates a loan of book_id to user_id on date (YYYYMMDD)
+	and takes one copy off Book.available (and cancels the user's hold
+	on the book, if any). The new loan's id goes to *loan_id (may be
+	NULL).
+
+	db_return sets the loan's return date and hands the copy to the
+	next hold on the book (see db_reserve): the copy is lent straight
+	to that user, on the same date, and the new loan's id goes to
+	*handoff_loan_id. Holds of users removed meanwhile are dropped on
+	the way. With nobody waiting the copy goes back to Book.available
+	and *handoff_loan_id is 0 (it may be NULL). The loan still closes
+	if the book was removed meanwhile. A return dated before the loan
+	was borrowed is refused.
+
+	Each call holds the write locks of the tables it changes for its
+	whole duration, so no other DB call sees a loan without its copy
+	taken or the other way round, and two checkouts can never lend the
+	same last copy. Everything is found through the id indexes, so
+	both are O(1) apart from the O(log n) B+tree updates. On failure
+	nothing changes.
+
+	Only these two keep Book.available in step with the loans. The
+	plain loan writes (db_add_loan, db_update_loan, db_remove_loan)
+	store the record as given and never touch the book: giving an
+	active loan a return date, moving it to another book or removing
+	it that way leaves its copy counted as lent. They are for loading,
+	replaying and correcting records; lending and returning go through
+	db_checkout/db_return.
+
+	db_user_active_loans is the number of loans of user_id not returned
+	yet. It is kept up to date by every loan write, not only these two.
+*/
+typedef enum {
+	DB_CIRC_OK = 0,
+	DB_CIRC_ERROR = -1,       /* invalid DB or date (not a real day), or out of memory */
+	DB_CIRC_NO_USER = -2,
+	DB_CIRC_NO_BOOK = -3,
+	DB_CIRC_UNAVAILABLE = -4, /* Book.available is 0 */
+	DB_CIRC_NO_LOAN = -5,
+	DB_CIRC_RETURNED = -6,    /* the loan was already returned */
+	DB_CIRC_AVAILABLE = -7,   /* a copy is available, no need to reserve */
+	DB_CIRC_RESERVED = -8,    /* the user already holds the book */
+	DB_CIRC_NO_RESERVATION = -9,
+	DB_CIRC_BEFORE_BORROW = -10 /* the return date is before the loan's borrow date */
+} DBCirculationResult;
+
+DBCirculationResult db_checkout(DB *db, unsigned user_id, unsigned book_id,
+								unsigned date, unsigned *loan_id);
+DBCirculationResult db_return(DB *db, unsigned loan_id, unsigned date,
+							  unsigned *handoff_loan_id);
+unsigned db_user_active_loans(const DB *db, unsigned user_id);
+
+/*
+	Circulation aggregates, for dashboards that poll them.
+
+	Every add, update and remove of a book or loan (checkout and return
+	included) adjusts these counters as part of the write, so reading
+	them is O(1) instead of a scan of the tables.
+
+	db_totals fills *out with the table sizes and the catalog-wide
+	counters; each table is read under its own lock, so in concurrent
+	mode the numbers of different tables may be from slightly
+	different moments. db_book_loans is the number of loans of book_id
+	(returned or not); the active loans of a user are
+	db_user_active_loans.
 
+	db_check_totals recomputes every aggregate from scratch with a scan
+	of the books and loans and compares it with the maintained value.
+	It returns the number of counters that disagree (0: consistent), or
+	-1 on invalid arguments or allocation failure. It is O(n): meant
+	for tests and for an occasional audit, not for polling.
+*/
+typedef struct {
+	size_t books;
+	size_t users;
+	size_t loans;
+	size_t suggestions;
+	size_t reservations;        /* holds waiting for a copy */
+	size_t loans_active;        /* loans not returned yet */
+	long long copies_available; /* sum of Book.available */
+} DBTotals;
+
+int db_totals(const DB *db, DBTotals *out);
+unsigned db_book_loans(const DB *db, unsigned book_id);
+int db_check_totals(const DB *db);
+
+/*
+	Most borrowed books and most active users.
+
+	db_top_books writes to out[0..k) the k books with the most loans
+	borrowed between date_from and date_to (YYYYMMDD, inclusive;
+	date_to 0 = no upper bound), most loans first, ties by lower id;
+	IdCount.count is the number of loans. db_top_users does the same
+	per user. *n receives the number of entries written (fewer than k
+	when fewer ids have loans in the window).
+
+	Without a window (both dates 0) the maintained per-book and
+	per-user loan counters are read directly: O(ids log k), no scan of
+	the loans. With a window the loan column store is tallied first
+	(one pass over the loans), then ranked the same way. Either way
+	only k entries are ever ordered, through a bounded min-heap.
+
+	Returns 0, or -1 on invalid arguments or allocation failure.
+*/
+int db_top_books(const DB *db, size_t k, unsigned date_from, unsigned date_to,
+				 IdCount *out, size_t *n);
+int db_top_users(const DB *db, size_t k, unsigned date_from, unsigned date_to,
+				 IdCount *out, size_t *n);
+
+/*
+	"Patrons who borrowed this also borrowed".
+
+	db_build_recommendations is the offline/periodic job: it copies
+	(user, book, date) out of the loans under the read lock, builds
+	the co-borrowing neighbors of every book from that snapshot with no
+	lock held (db/recommendations.h; pool may be NULL, cfg NULL for the
+	defaults), then swaps the result in under the write lock. Loans
+	written meanwhile only show up in the next build. Returns 0, or -1
+	on allocation failure (the previous build is kept).
+
+	db_has_recommendations tells whether any build has run, so callers
+	can build on first use instead of at load (two threads doing so at
+	once both build; the last one is kept).
+
+	db_recommend_for_book writes up to n neighbors of book_id to out,
+	best first, with the number of users who borrowed both books in
+	IdCount.count, and stores how many in *got: O(n). Before the first
+	build every book has none. Neighbors may include books removed
+	since the build. Returns 0, or -1 on invalid arguments.
+*/
+int db_build_recommendations(DB *db, const RecommendConfig *cfg, ThreadPool *pool);
+bool db_has_recommendations(const DB *db);
+int db_recommend_for_book(const DB *db, unsigned book_id, size_t n, IdCount *out, size_t *got);
+
+/*
+	Near-duplicate titles.
+
+	db_similar_books writes to out[0..cap) the books whose title is at
+	least min_similarity percent similar to title (50-100, on the
+	normalized titles: case, punctuation and spacing are ignored), most
+	similar first, and stores how many in *n. db_similar_suggestions
+	does the same over the suggestions.
+
+	Both go through a trigram index kept up to date by every write
+	(db/title_index.h), so only the titles that share enough trigrams
+	and have a compatible length are compared, with a bit-parallel
+	edit distance; the catalog is never scanned title by title.
+
+	Returns 0, or -1 on invalid arguments or allocation failure.
+*/
+int db_similar_books(const DB *db, const char *title, unsigned min_similarity,
+					 TitleMatch *out, size_t cap, size_t *n);
+int db_similar_suggestions(const DB *db, const char *title, unsigned min_similarity,
+						   TitleMatch *out, size_t cap, size_t *n);
+
+/*
+	Type-ahead over book titles, book authors and user names.
+
+	db_autocomplete writes to ids[0..limit) the ids whose field starts
+	with prefix, ignoring the case of ASCII letters, in lexical order of
+	the field (equal values by ascending id), and stores how many in
+	*n. Each field has a radix trie kept up to date by every write
+	(db/prefix_index.h), so a call costs O(|prefix| + limit) however
+	large the table; an empty prefix lists the table in that order.
+
+	Returns 0, or -1 on invalid arguments.
+*/
+typedef enum {
+	DB_COMPLETE_TITLE,
+	DB_COMPLETE_AUTHOR,
+	DB_COMPLETE_USER_NAME
+} DBCompleteField;
+
+int db_autocomplete(const DB *db, DBCompleteField field, const char *prefix, size_t limit,
+					unsigned *ids, size_t *n);
+
+/*
+	Reservations (holds) on books with no copy available.
+
+	db_reserve places user_id in the queue of book_id on date
+	(YYYYMMDD). Holds are served by membership tier (higher first,
+	0..RESERVATION_TIER_MAX), then by date, then by arrival, whenever
+	a copy comes back through db_return. Placing, serving and
+	cancelling a hold are O(log k) for a book with k holds
+	(db/reservations.h).
+
+	db_book_reservations visits the holds on book_id in the order they
+	will be served (O(k log k)), with the db_foreach_* rules.
+
+	db_load_reservations adds the holds saved in path (CSV, see
+	fs/reservations_file.h) to the DB, skipping those whose book or
+	user no longer exists; a missing file is no holds.
+	db_save_reservations writes every hold to path. The app keeps them
+	in data/reservations.txt, next to the tables.
+*/
+typedef int (*DBReservationVisitor)(const Reservation *r, void *ctx);
+
+DBCirculationResult db_reserve(DB *db, unsigned user_id, unsigned book_id,
+							   unsigned tier, unsigned date);
+DBCirculationResult db_cancel_reservation(DB *db, unsigned user_id, unsigned book_id);
+int db_book_reservations(const DB *db, unsigned book_id,
+						 DBReservationVisitor fn, void *ctx);
+int db_load_reservations(DB *db, const char *path);
+int db_save_reservations(const DB *db, const char *path);
+
+#endif /* DB_H */
@@ -0,0 +1,49 @@
+#ifndef DB_MEMORY_H
+#define DB_MEMORY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "db/db.h"
+#include "lib/cutils/aed_alloc.h"
+
+/*
+	Memory usage report of the DB.
+
+	Per table it shows what the table holds right now: records and
+	their bytes, the list nodes, and the id index. Per category it
+	shows the process-wide counters of lib/cutils/aed_alloc, which also
+	cover memory outside the DB (ArrayList buffers, other lists) and
+	keep the peak.
+
+	With a single DB alive, the bytes of the book/user/loan/suggestion
+	categories equal the record bytes of the matching table, except
+	for replaced or removed records that concurrent mode has handed to
+	the epoch and that are not freed yet.
+*/
+
+typedef struct {
+	size_t records;
+	size_t record_bytes; /* records * sizeof(record) */
+	size_t list_bytes;   /* list header + one node per record */
+	size_t index_bytes;  /* id index + ordered indexes (B+tree nodes) + loan columns, due wheel,
+	                        counters; books also count their reservation queues */
+	size_t total_bytes;
+} DBTableMemory;
+
+typedef struct {
+	DBTableMemory tables[DB_TABLE_COUNT];
+	AedMemStats categories[AED_MEM_COUNT];
+} DBMemoryStats;
+
+/*
+	Fills *out. Each table is measured under its read lock, so the
+	numbers are consistent per table even in concurrent mode.
+	Returns 0 on success, -1 on invalid arguments.
+*/
+int db_memory_stats(const DB *db, DBMemoryStats *out);
+
+/* Prints both tables of the report. */
+void db_memory_print(const DBMemoryStats *stats, FILE *out);
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef DB_RECORD_H
+#define DB_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "db/db.h"
+#include "db/db_stats.h"
+
+/*
+	Workload recording.
+
+	While recording is on, every public db_* call except db_init and
+	db_save is appended to a binary trace: which operation, its
+	arguments and when it happened. The replay tool (src/tools/replay.c)
+	re-executes a trace against a fresh DB loaded from the data the
+	recording started from, so engine changes can be compared on real
+	traffic instead of synthetic data.
+
+	File format (all integers are LEB128 varints unless noted):
+
+		header:  8 bytes "AEDWL01\n"
+		entry:   u8   op       DBOp (db_stats.h), bit 7 set for *_auto adds
+		         var  delta_us microseconds since the previous entry
+		         ...  payload, depending on the op:
+		              find/copy/remove:  var id
+		              add/update:        var len, len bytes of the record
+		                                 as CSV (book_to_csv, ...)
+		              search_books:      u8 field, var len, len bytes term
+		              foreach:           nothing
+		              ranges:            var from, var to
+		              pages:             var after_id, var limit
+		              due dates:         var date, var 0
+		              loan filters:      var borrow_from, var borrow_to,
+		                                 u8 active_only, var book_id,
+		                                 var cap (0 for counts)
+		              checkout:          var user_id, var book_id, var date
+		              return:            var loan_id, var 0, var date
+		              reserve:           var len, len bytes of the hold
+		                                 as CSV (reservation_to_csv)
+		              cancel_reservation: var user_id, var book_id, var 0
+		              top_books/top_users: var k, var date_from, var date_to
+		              recommend:         var book_id, var n, var 0
+		              similar_books/similar_suggestions:
+		                                 var min_similarity, var cap,
+		                                 var len, len bytes title
+		              autocomplete:      u8 field (DBCompleteField), var limit,
+		                                 var len, len bytes prefix
+
+	Entries from concurrent threads are serialized under a mutex, in
+	the order their calls started.
+*/
+
+#define DB_RECORD_MAGIC "AEDWL01\n"
+
+/* Longest CSV record or search term stored in a trace. */
+#define DB_RECORD_TEXT_MAX 1024
+
+/*
+	Starts appending to a new trace at path (truncated).
+	Returns 0 on success, -1 if already recording or the file could
+	not be created.
+*/
+int db_record_start(const char *path);
+
+/* Flushes and closes the trace. Returns 0 on success, -1 on write error. */
+int db_record_stop(void);
+
+/* Cheap check used by db.c before building an entry. */
+bool db_recording(void);
+
+/* Entry writers called by db.c. */
+void db_record_id(DBOp op, unsigned id);
+void db_record_none(DBOp op);
+void db_record_search(DBBookField field, const char *term);
+void db_record_range(DBOp op, unsigned from, unsigned to);
+void db_record_filter(DBOp op, const LoanFilter *filter, size_t cap);
+void db_record_circulation(DBOp op, unsigned id, unsigned book_id, unsigned date);
+void db_record_similar(DBOp op, unsigned min_similarity, size_t cap, const char *title);
+void db_record_complete(DBOp op, unsigned field, size_t limit, const char *prefix);
+void db_record_book(DBOp op, bool auto_id, const Book *b);
+void db_record_user(DBOp op, bool auto_id, const User *u);
+void db_record_loan(DBOp op, bool auto_id, const Loan *l);
+void db_record_suggestion(DBOp op, bool auto_id, const Suggestion *s);
+void db_record_reservation(DBOp op, const Reservation *r);
+
+/* One decoded entry, as returned by db_record_read. */
+typedef struct {
+	DBOp op;
+	bool auto_id;
+	uint64_t time_us;  /* since the start of the recording */
+	unsigned id;        /* similar_*: min_similarity; autocomplete: field */
+	DBBookField field;
+	unsigned from, to;  /* range queries; pages use after_id, limit;
+	                       checkout/return/cancel_reservation use
+	                       book_id, date */
+	LoanFilter filter;  /* loan filters */
+	size_t cap;         /* id buffer size of select_loans, similar_*,
+	                       autocomplete */
+	char text[DB_RECORD_TEXT_MAX]; /* CSV record, search term, title or prefix */
+} DBRecordEntry;
+
+/* Checks the header. Returns 0 if f holds a trace, -1 otherwise. */
+int db_record_read_header(FILE *f);
+
+/*
+	Reads the next entry.
+	Returns 1 on success, 0 at the end of the trace, -1 if the entry is
+	truncated or malformed. time_us accumulates across calls through
+	*clock_us, which must start at 0.
+*/
+int db_record_read(FILE *f, uint64_t *clock_us, DBRecordEntry *out);
+
+#endif
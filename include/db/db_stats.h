@@ -0,0 +1,150 @@
+#ifndef DB_STATS_H
+#define DB_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cutils.h"
+
+/*
+	Operation counters and latency histograms for the DB layer.
+
+	Every public db_* entry point records how long it took into a
+	per-operation histogram. The histograms are log-linear (HDR style):
+	each power of two of nanoseconds is split into DB_STATS_SUB_BUCKETS
+	linear buckets, so any recorded value is known to within ~6% no
+	matter whether it took 50 ns or 5 s.
+
+	Recording is compiled in only when DB_STATS_ENABLED is defined
+	(make DB_STATS=1). Without it DB_STATS_START / DB_STATS_STOP expand
+	to nothing, so the normal build pays no cost at all; the functions
+	below still exist and db_stats_dump just says the stats are off.
+
+	The histograms are process wide and updated with relaxed atomics,
+	so they can be recorded from any thread (e.g. the socket server's
+	workers) without locks.
+*/
+
+/* X-macro with every instrumented operation: (enum suffix, label). */
+#define DB_STATS_OPS(X) \
+	X(INIT,               "init") \
+	X(SAVE,               "save") \
+	X(FIND_BOOK,          "find_book") \
+	X(FIND_USER,          "find_user") \
+	X(FIND_LOAN,          "find_loan") \
+	X(FIND_SUGGESTION,    "find_suggestion") \
+	X(COPY_BOOK,          "copy_book") \
+	X(COPY_USER,          "copy_user") \
+	X(COPY_LOAN,          "copy_loan") \
+	X(COPY_SUGGESTION,    "copy_suggestion") \
+	X(FOREACH_BOOK,       "foreach_book") \
+	X(FOREACH_USER,       "foreach_user") \
+	X(FOREACH_LOAN,       "foreach_loan") \
+	X(FOREACH_SUGGESTION, "foreach_suggestion") \
+	X(SEARCH_BOOKS,       "search_books") \
+	X(ADD_BOOK,           "add_book") \
+	X(ADD_USER,           "add_user") \
+	X(ADD_LOAN,           "add_loan") \
+	X(ADD_SUGGESTION,     "add_suggestion") \
+	X(UPDATE_BOOK,        "update_book") \
+	X(UPDATE_USER,        "update_user") \
+	X(UPDATE_LOAN,        "update_loan") \
+	X(UPDATE_SUGGESTION,  "update_suggestion") \
+	X(REMOVE_BOOK,        "remove_book") \
+	X(REMOVE_USER,        "remove_user") \
+	X(REMOVE_LOAN,        "remove_loan") \
+	X(REMOVE_SUGGESTION,  "remove_suggestion") \
+	X(BOOKS_BY_YEAR,      "books_by_year") \
+	X(LOANS_BY_BORROW,    "loans_by_borrow") \
+	X(LOANS_BY_RETURN,    "loans_by_return") \
+	X(PAGE_BOOKS,         "page_books") \
+	X(PAGE_USERS,         "page_users") \
+	X(PAGE_LOANS,         "page_loans") \
+	X(PAGE_SUGGESTIONS,   "page_suggestions") \
+	X(COUNT_LOANS,        "count_loans") \
+	X(SELECT_LOANS,       "select_loans") \
+	X(LOANS_DAYS_OUT,     "loans_days_out") \
+	X(LOANS_DUE_ON,       "loans_due_on") \
+	X(LOANS_OVERDUE,      "loans_overdue") \
+	X(CHECKOUT,           "checkout") \
+	X(RETURN,             "return") \
+	X(ACTIVE_LOANS,       "active_loans") \
+	X(RESERVE,            "reserve") \
+	X(CANCEL_RESERVATION, "cancel_reservation") \
+	X(BOOK_RESERVATIONS,  "book_reservations") \
+	X(LOAD_RESERVATIONS,  "load_reservations") \
+	X(SAVE_RESERVATIONS,  "save_reservations") \
+	X(TOTALS,             "totals") \
+	X(BOOK_LOANS,         "book_loans") \
+	X(CHECK_TOTALS,       "check_totals") \
+	X(TOP_BOOKS,          "top_books") \
+	X(TOP_USERS,          "top_users") \
+	X(BUILD_RECOMMENDATIONS, "build_recommendations") \
+	X(RECOMMEND,          "recommend") \
+	X(SIMILAR_BOOKS,      "similar_books") \
+	X(SIMILAR_SUGGESTIONS, "similar_suggestions") \
+	X(AUTOCOMPLETE,       "autocomplete")
+
+#define DB_STATS_ENUM_ENTRY(name, label) DB_OP_##name,
+
+typedef enum {
+	DB_STATS_OPS(DB_STATS_ENUM_ENTRY)
+	DB_OP_COUNT
+} DBOp;
+
+#undef DB_STATS_ENUM_ENTRY
+
+/* Linear buckets per power of two (16 -> ~6% relative error). */
+#define DB_STATS_SUB_BUCKETS 16
+
+/*
+	Timing helpers used inside db.c:
+
+		DB_STATS_START(t0);
+		int rc = ...;
+		DB_STATS_STOP(t0, DB_OP_ADD_BOOK);
+		return rc;
+*/
+#ifdef DB_STATS_ENABLED
+#define DB_STATS_START(var) uint64_t var = cutils_now_ns()
+#define DB_STATS_STOP(var, op) db_stats_record((op), cutils_now_ns() - (var))
+#else
+#define DB_STATS_START(var) ((void)0)
+#define DB_STATS_STOP(var, op) ((void)0)
+#endif
+
+/* True when the build records stats (DB_STATS_ENABLED). */
+bool db_stats_enabled(void);
+
+/* Adds one sample of ns nanoseconds to the histogram of op. */
+void db_stats_record(DBOp op, uint64_t ns);
+
+/* Clears every counter and histogram. */
+void db_stats_reset(void);
+
+/* Label of op ("find_book", ...), or "?" when out of range. */
+const char *db_stats_op_name(DBOp op);
+
+/* Number of samples recorded for op so far. */
+uint64_t db_stats_count(DBOp op);
+
+/*
+	Approximate latency (ns) at percentile p (0..100) for op, i.e. the
+	upper bound of the bucket that holds it. Returns 0 with no samples.
+*/
+uint64_t db_stats_percentile(DBOp op, double p);
+
+/*
+	Prints a table with count, mean, p50, p90, p99 and max for every
+	operation that was called at least once. In a build without
+	DB_STATS it only prints a note, unless samples were added directly
+	with db_stats_record (the replay tool does that).
+	Returns 0 on success, -1 on invalid stream.
+*/
+int db_stats_dump(FILE *out);
+
+/* Same as db_stats_dump, written to (and overwriting) path. */
+int db_stats_dump_file(const char *path);
+
+#endif
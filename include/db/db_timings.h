@@ -0,0 +1,59 @@
+#ifndef DB_TIMINGS_H
+#define DB_TIMINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+	Phase timings for loading and saving the DB.
+
+	db_init_timed / db_save_timed (db.h) fill a DBTimings with the time
+	spent in each phase of each table, measured with the monotonic
+	clock (cutils_now_ns):
+	- load:  file_load_* (read + parse of the CSV file);
+	- index: building the id index once the list is loaded;
+	- save:  file_save_* (format + write of the CSV file).
+
+	Rows and file sizes are recorded next to the times so the report
+	can show rows/sec and bytes/sec, which is what tells a table that
+	grew apart from a table that got slower.
+*/
+
+typedef enum {
+	DB_TABLE_BOOKS,
+	DB_TABLE_USERS,
+	DB_TABLE_LOANS,
+	DB_TABLE_SUGGESTIONS,
+	DB_TABLE_COUNT
+} DBTable;
+
+typedef struct {
+	uint64_t ns;   /* wall time of the phase */
+	size_t rows;   /* records loaded / indexed / written */
+	long bytes;    /* file size (0 for in-memory phases, -1 if unknown) */
+} DBPhaseTiming;
+
+typedef struct {
+	DBPhaseTiming load[DB_TABLE_COUNT];
+	DBPhaseTiming index[DB_TABLE_COUNT];
+	DBPhaseTiming save[DB_TABLE_COUNT];
+
+	uint64_t init_ns; /* whole db_init_timed, including the phases above */
+	uint64_t save_ns; /* whole db_save_timed */
+} DBTimings;
+
+/* "books", "users", "loans", "suggestions". */
+const char *db_table_name(DBTable table);
+
+/* Size of the file at path in bytes, or -1 if it cannot be opened. */
+long db_timings_file_size(const char *path);
+
+/*
+	Print the load (load + index phases) or save report as a small
+	table with rows/sec and MB/sec per phase and the overall total.
+*/
+void db_timings_print_load(const DBTimings *t, FILE *out);
+void db_timings_print_save(const DBTimings *t, FILE *out);
+
+#endif
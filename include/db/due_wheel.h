@@ -0,0 +1,69 @@
+#ifndef DUE_WHEEL_H
+#define DUE_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+	Hierarchical timing wheel of loan due days.
+
+	Every active loan sits in the bucket of its due day (a Date, see
+	model/date.h), so the loans due on a given day and the
+	loans already overdue are found without looking at any other loan,
+	and a return unlinks its entry in O(1).
+
+	The wheel has a current day ('now'):
+		- level 0: one bucket per day of the current 64-day block;
+		- level 1: one bucket per 64-day block for the next 63 blocks
+		  (~11 years), poured into level 0 when its block starts;
+		- overflow: anything further away, moved to level 1 on the
+		  block step that brings its earliest day within reach;
+		- overdue: entries whose due day is before 'now'.
+	Advancing one day moves the expiring bucket to the overdue list in
+	O(1) (a splice); a jump of more than 4096 days rebuilds the wheel.
+
+	Entries freed by remove are kept on a free list, so re-adding an
+	entry right after removing it never allocates.
+
+	Not thread-safe: the DB maintains it under the loans table lock.
+*/
+typedef struct DueWheel DueWheel;
+
+/* Visitor for due_wheel_visit_*; a non-zero return stops the walk and is returned. */
+typedef int (*DueWheelVisitor)(unsigned id, uint32_t due, void *ctx);
+
+/* Creates an empty wheel whose current day is today. NULL on allocation failure. */
+DueWheel *due_wheel_create(uint32_t today);
+
+/* Frees the wheel and every entry. NULL is ignored. */
+void due_wheel_destroy(DueWheel *w);
+
+/*
+	Schedules id on day due, or moves it there if it is already in the
+	wheel (which never allocates).
+	Returns 0 on success, -1 on allocation failure (wheel unchanged).
+*/
+int due_wheel_put(DueWheel *w, unsigned id, uint32_t due);
+
+/* Unschedules id. Returns 0 if it was in the wheel, -1 otherwise. */
+int due_wheel_remove(DueWheel *w, unsigned id);
+
+/* Moves the current day forward to today (earlier days are ignored). */
+void due_wheel_advance(DueWheel *w, uint32_t today);
+
+/* Current day. */
+uint32_t due_wheel_now(const DueWheel *w);
+
+/* Visits the entries due on day (any day, before or after now). */
+int due_wheel_visit_due(const DueWheel *w, uint32_t day, DueWheelVisitor fn, void *ctx);
+
+/* Visits the entries due before the current day, in no particular order. */
+int due_wheel_visit_overdue(const DueWheel *w, DueWheelVisitor fn, void *ctx);
+
+/* Number of scheduled entries. */
+size_t due_wheel_size(const DueWheel *w);
+
+/* Heap bytes held by the wheel, its id hash and its entries. */
+size_t due_wheel_bytes(const DueWheel *w);
+
+#endif /* DUE_WHEEL_H */
@@ -0,0 +1,59 @@
+#ifndef ID_COUNTS_H
+#define ID_COUNTS_H
+
+#include <stddef.h>
+
+/*
+	Counter per id (e.g. active loans per user), in an open-addressing
+	hash: get and a change of an existing counter are O(1) and never
+	allocate.
+
+	A counter that drops back to 0 keeps its slot, so giving back what
+	was just taken (undoing a change) can never fail. The table only
+	grows with the number of distinct ids ever counted.
+
+	Not thread-safe: the DB maintains it under the loans table lock.
+*/
+typedef struct IdCounts IdCounts;
+
+/* Creates an empty table. NULL on allocation failure. */
+IdCounts *id_counts_create(void);
+
+/* NULL is ignored. */
+void id_counts_destroy(IdCounts *c);
+
+/*
+	Adds delta to the counter of id (missing ids count 0).
+	Returns 0 on success, -1 if the counter would go below 0, id is
+	UINT_MAX or a new slot could not be allocated (counter unchanged).
+*/
+int id_counts_add(IdCounts *c, unsigned id, int delta);
+
+/* Counter of id, 0 if it was never counted. */
+unsigned id_counts_get(const IdCounts *c, unsigned id);
+
+/* Visitor for id_counts_foreach; a non-zero return stops the walk and is returned. */
+typedef int (*IdCountsVisitor)(unsigned id, unsigned count, void *ctx);
+
+/* Visits every non-zero counter, in no particular order. */
+int id_counts_foreach(const IdCounts *c, IdCountsVisitor fn, void *ctx);
+
+/* One counter, as returned by id_counts_top. */
+typedef struct {
+	unsigned id;
+	unsigned count;
+} IdCount;
+
+/*
+	The k largest counters, written to out[0..k) from largest to
+	smallest (ties: lower id first), through a bounded min-heap of
+	k entries: O(n log k) for n counted ids, no sort of the table.
+	Stores the number written (at most k) in *n. Returns 0, or -1 on
+	invalid arguments or allocation failure.
+*/
+int id_counts_top(const IdCounts *c, size_t k, IdCount *out, size_t *n);
+
+/* Heap bytes held by the table. */
+size_t id_counts_bytes(const IdCounts *c);
+
+#endif /* ID_COUNTS_H */
@@ -0,0 +1,58 @@
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+#include <stddef.h>
+
+#include "lib/epoch/epoch.h"
+
+/*
+	Hash index from record id to record pointer, used by the DB to
+	answer db_find_*_by_id / db_copy_*_by_id in O(1).
+
+	Concurrency model:
+	- Writers (put/remove) must be serialized by the caller; the DB
+	  does that with the table's write lock.
+	- Readers (id_index_get) take no lock at all. They only need to be
+	  inside an epoch read section of the domain given at creation,
+	  which keeps both the bucket array and the records alive.
+
+	Every entry also carries an 'aux' pointer that only writers read
+	(the DB stores the record's DList node there).
+*/
+typedef struct IdIndex IdIndex;
+
+/*
+	Creates an empty index. Bucket arrays replaced by a resize are
+	handed to 'epoch' for deferred reclamation.
+	Returns NULL on allocation failure.
+*/
+IdIndex *id_index_create(EpochDomain *epoch);
+
+/* Frees the index (not the records it points to). */
+void id_index_destroy(IdIndex *idx);
+
+/*
+	Inserts or replaces the entry for id.
+	Returns 0 on success, -1 on allocation failure.
+*/
+int id_index_put(IdIndex *idx, unsigned id, void *value, void *aux);
+
+/*
+	Removes the entry for id (if any).
+	Returns 0 if an entry was removed, -1 otherwise.
+*/
+int id_index_remove(IdIndex *idx, unsigned id);
+
+/* Lock-free lookup. Returns the stored value or NULL. */
+void *id_index_get(const IdIndex *idx, unsigned id);
+
+/* Writer-side lookup of the aux pointer. Returns NULL if absent. */
+void *id_index_aux(const IdIndex *idx, unsigned id);
+
+/* Number of live entries. */
+size_t id_index_size(const IdIndex *idx);
+
+/* Heap bytes held by the index (writer side; excludes the records). */
+size_t id_index_bytes(const IdIndex *idx);
+
+#endif /* ID_INDEX_H */
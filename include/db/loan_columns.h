@@ -0,0 +1,112 @@
+#ifndef LOAN_COLUMNS_H
+#define LOAN_COLUMNS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "db/id_counts.h"
+#include "model/loans.h"
+
+/*
+	Column store (struct-of-arrays) copy of the loans table.
+
+	The DB keeps every Loan in its own heap block, linked through a
+	DList; scanning them for a filter is a pointer chase with one cache
+	miss per loan. This store mirrors the five fields into five dense
+	arrays, so a filter over millions of loans streams through a few
+	contiguous columns and can test 4 (SSE2) or 8 (AVX2) loans per
+	instruction.
+
+	Rows are unordered: a removed loan's slot is filled with the last
+	row. An id -> row hash keeps put/remove O(1).
+
+	Not thread-safe: the DB maintains the store and runs the scans
+	under the loans table lock.
+*/
+typedef struct LoanColumns LoanColumns;
+
+/*
+	Which loans a scan matches; every condition must hold.
+	Zero-initialize it to match every loan.
+*/
+typedef struct {
+	unsigned borrow_from; /* date_borrow >= borrow_from */
+	unsigned borrow_to;   /* date_borrow <= borrow_to, 0 = no upper bound */
+	bool active_only;     /* only loans not returned yet (date_return == 0) */
+	unsigned book_id;     /* 0 = any book */
+} LoanFilter;
+
+/* Scan implementations; AUTO picks the widest one the CPU supports. */
+typedef enum {
+	LOAN_KERNEL_AUTO,
+	LOAN_KERNEL_SCALAR,
+	LOAN_KERNEL_SSE2,
+	LOAN_KERNEL_AVX2
+} LoanKernel;
+
+/* Creates an empty store with room for capacity rows. NULL on allocation failure. */
+LoanColumns *loan_columns_create(size_t capacity);
+
+/* NULL is ignored. */
+void loan_columns_destroy(LoanColumns *c);
+
+/*
+	Inserts the loan, or overwrites the row with the same id.
+	Overwriting never allocates, so it cannot fail.
+	Returns 0 on success, -1 on allocation failure (store unchanged).
+*/
+int loan_columns_put(LoanColumns *c, const Loan *l);
+
+/* Removes the row of id. Returns 0 if it was present, -1 otherwise. */
+int loan_columns_remove(LoanColumns *c, unsigned id);
+
+/* Number of rows. */
+size_t loan_columns_size(const LoanColumns *c);
+
+/* Heap bytes held by the columns and the id hash. */
+size_t loan_columns_bytes(const LoanColumns *c);
+
+/* Number of loans matching f. */
+size_t loan_columns_count(const LoanColumns *c, const LoanFilter *f);
+
+/*
+	Writes the ids of the loans matching f to ids[0..cap), in row order.
+	Returns the total number of matches, which may exceed cap (like
+	snprintf); ids may be NULL when cap is 0.
+*/
+size_t loan_columns_select(const LoanColumns *c, const LoanFilter *f,
+						   unsigned *ids, size_t cap);
+
+/*
+	Returned loans matching f (active_only must be false) and the sum of
+	their lengths in days (return - borrow) in *days. Loans returned
+	before they were borrowed (bad data) are skipped.
+*/
+size_t loan_columns_days_out(const LoanColumns *c, const LoanFilter *f, uint64_t *days);
+
+/* Which column loan_columns_tally groups the matches by. */
+typedef enum {
+	LOAN_BY_BOOK,
+	LOAN_BY_USER
+} LoanGroup;
+
+/*
+	Adds 1 to counts[book_id] (or counts[user_id]) for every loan
+	matching f. Returns 0, or -1 if a counter could not be allocated
+	(counts then holds part of the tally).
+*/
+int loan_columns_tally(const LoanColumns *c, const LoanFilter *f, LoanGroup by,
+					   IdCounts *counts);
+
+/*
+	Forces a scan implementation for the whole process (tests and
+	benchmarks). Returns 0, or -1 if the CPU or build lacks it (the
+	current choice is kept).
+*/
+int loan_columns_set_kernel(LoanKernel kernel);
+
+/* "scalar", "sse2" or "avx2": the implementation scans currently use. */
+const char *loan_columns_kernel_name(void);
+
+#endif /* LOAN_COLUMNS_H */
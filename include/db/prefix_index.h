@@ -0,0 +1,69 @@
+#ifndef PREFIX_INDEX_H
+#define PREFIX_INDEX_H
+
+#include <stddef.h>
+
+/*
+	Prefix lookup of ids by a text field, for type-ahead.
+
+	A compact radix trie of the case-folded keys (ASCII letters are
+	lowered, other bytes kept): every edge holds a run of bytes, the
+	children of a node are sorted by their first byte and a node lists
+	the ids whose key ends there, in ascending order. Every node also
+	counts the ids below it, so a query descends |prefix| bytes and then
+	walks the subtree in order, skipping empty branches, until it has
+	limit ids: O(|prefix| + limit) for a compact trie, whatever the
+	number of keys.
+
+	Removing an id leaves its nodes in place (they only lose their
+	count), which is what lets an add undo a remove without allocating.
+	Once the empty nodes outnumber the live ones, the next add prunes
+	them and merges the chains they leave, so the cost is amortized.
+
+	Not thread-safe: the DB maintains one index per field under the
+	lock of the table the field belongs to. Queries only read it.
+*/
+typedef struct PrefixIndex PrefixIndex;
+
+/* Longest key indexed; longer keys are cut (the fields are 128 bytes). */
+#define PREFIX_KEY_MAX 128
+
+/* Creates an empty index. NULL on allocation failure. */
+PrefixIndex *prefix_index_create(void);
+
+/* NULL is ignored. */
+void prefix_index_destroy(PrefixIndex *p);
+
+/*
+	Adds id under key. Returns 0, or -1 on invalid arguments or
+	allocation failure (index unchanged). Adding back a key and id
+	that were removed since the last add never allocates, so it never
+	fails.
+*/
+int prefix_index_add(PrefixIndex *p, const char *key, unsigned id);
+
+/* Removes id from key. Missing pairs are ignored. */
+void prefix_index_remove(PrefixIndex *p, const char *key, unsigned id);
+
+/*
+	Writes to ids[0..limit) the ids whose key starts with prefix, in
+	lexical order of the folded keys (ids of equal keys ascending), and
+	their number to *n. Returns 0, or -1 on invalid arguments.
+*/
+int prefix_index_complete(const PrefixIndex *p, const char *prefix, size_t limit,
+						  unsigned *ids, size_t *n);
+
+/*
+	Compares two keys the way the index orders them (folded, cut at
+	PREFIX_KEY_MAX bytes, unsigned bytes): <0, 0 or >0. Keys that
+	compare equal are the same key to the index.
+*/
+int prefix_index_key_cmp(const char *a, const char *b);
+
+/* Number of ids indexed. */
+size_t prefix_index_size(const PrefixIndex *p);
+
+/* Heap bytes held by the index. */
+size_t prefix_index_bytes(const PrefixIndex *p);
+
+#endif /* PREFIX_INDEX_H */
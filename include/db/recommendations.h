@@ -0,0 +1,71 @@
+#ifndef RECOMMENDATIONS_H
+#define RECOMMENDATIONS_H
+
+#include <stddef.h>
+
+#include "db/id_counts.h"
+#include "lib/cutils/thread_pool.h"
+
+/*
+	"Patrons who borrowed this also borrowed": for every borrowed book,
+	the books that share the most borrowers with it.
+
+	Built offline from a snapshot of the loans, as a sparse book x book
+	co-occurrence matrix that is never stored whole: each user keeps at
+	most history_cap distinct books (the most recently borrowed), and
+	each row of the matrix is accumulated in a dense scratch array,
+	reduced to its top neighbors and thrown away. Rows are independent,
+	so they are spread over a thread pool. The cost is the sum over
+	users of history^2, whatever the number of books.
+
+	The result is immutable and compact: one array of (book, score)
+	pairs with an offset per book, plus a hash from book id to row, so
+	a lookup is O(1) plus the neighbors copied. The score is the number
+	of users who borrowed both books.
+
+	Not thread-safe to build and read at once: the DB swaps a finished
+	build in under the loans table lock.
+*/
+typedef struct Recommendations Recommendations;
+
+/* One loan, as far as recommendations are concerned. */
+typedef struct {
+	unsigned user_id;
+	unsigned book_id;
+	unsigned date; /* YYYYMMDD borrow date: the newest loans of a user are kept */
+} CoBorrow;
+
+#define RECOMMEND_HISTORY_DEFAULT 64
+#define RECOMMEND_NEIGHBORS_DEFAULT 10
+#define RECOMMEND_NEIGHBORS_MAX 64
+
+typedef struct {
+	unsigned history_cap; /* distinct books kept per user; 0 = default */
+	unsigned neighbors;   /* neighbors kept per book; 0 = default, at most RECOMMEND_NEIGHBORS_MAX */
+} RecommendConfig;
+
+/*
+	Builds the neighbors of every book in loans[0..n). loans is sorted
+	in place. cfg may be NULL (defaults); pool may be NULL (runs on the
+	caller). Returns NULL on allocation failure.
+*/
+Recommendations *recommendations_build(CoBorrow *loans, size_t n, const RecommendConfig *cfg,
+									   ThreadPool *pool);
+
+/* NULL is ignored. */
+void recommendations_destroy(Recommendations *r);
+
+/*
+	Writes up to n neighbors of book_id to out, best first (ties: lower
+	id first), with the shared borrowers in IdCount.count. Returns the
+	number written; 0 for a book with no neighbors or not in the build.
+*/
+size_t recommendations_get(const Recommendations *r, unsigned book_id, IdCount *out, size_t n);
+
+/* Number of books in the build (borrowed at least once). */
+size_t recommendations_books(const Recommendations *r);
+
+/* Heap bytes held by the build. */
+size_t recommendations_bytes(const Recommendations *r);
+
+#endif /* RECOMMENDATIONS_H */
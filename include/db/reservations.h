@@ -0,0 +1,79 @@
+#ifndef RESERVATIONS_H
+#define RESERVATIONS_H
+
+#include <stddef.h>
+
+#include "model/reservation.h"
+
+/*
+	Reservation queues: one priority queue (lib/heap) of holds per book.
+
+	Holds are served in reservation_cmp order (tier, then request date,
+	then arrival). Placing, serving and cancelling a hold are O(log k)
+	for a book with k holds: a book's queue is found through a hash by
+	book id, and a (book, user) hash gives the hold's slot in its heap,
+	so cancelling never searches the queue. A user holds a book at
+	most once. A queue is freed when its last hold leaves.
+
+	Not thread-safe: the DB maintains the queues under the books table
+	lock.
+*/
+typedef struct ReservationQueues ReservationQueues;
+
+/* Visitor for the walks below; a non-zero return stops the walk and is returned. */
+typedef int (*ReservationVisitor)(const Reservation *r, void *ctx);
+
+/* Creates an empty set of queues. NULL on allocation failure. */
+ReservationQueues *reservation_queues_create(void);
+
+/* Frees every queue and hold. NULL is ignored. */
+void reservation_queues_destroy(ReservationQueues *q);
+
+/*
+	Adds a copy of *r to the queue of r->book_id. A seq of 0 is
+	replaced by the next arrival number (and written back to r); a
+	loaded hold keeps its own and later ones are numbered after it.
+	Returns 0 on success, -1 on allocation failure, -2 if the user
+	already holds that book (queues unchanged on failure).
+*/
+int reservation_queues_add(ReservationQueues *q, Reservation *r);
+
+/* Cancels user_id's hold on book_id. Returns 0 if there was one, -1 otherwise. */
+int reservation_queues_remove(ReservationQueues *q, unsigned book_id, unsigned user_id);
+
+/* Cancels every hold on book_id (the book is gone). Returns how many there were. */
+size_t reservation_queues_drop_book(ReservationQueues *q, unsigned book_id);
+
+/*
+	Cancels every hold of user_id (the user is gone): one (book, user)
+	lookup per book with holds. Returns how many there were.
+*/
+size_t reservation_queues_drop_user(ReservationQueues *q, unsigned user_id);
+
+/* The hold served next for book_id, or NULL if nobody is waiting. */
+const Reservation *reservation_queues_peek(const ReservationQueues *q, unsigned book_id);
+
+/* Removes the hold served next for book_id. Returns 0, or -1 if nobody is waiting. */
+int reservation_queues_pop(ReservationQueues *q, unsigned book_id);
+
+/* Number of holds on book_id. */
+size_t reservation_queues_length(const ReservationQueues *q, unsigned book_id);
+
+/*
+	Visits the holds on book_id in the order they will be served
+	(sorts a copy of the queue: O(k log k)). Returns 0, the visitor's
+	non-zero value, or -1 on allocation failure.
+*/
+int reservation_queues_visit_book(const ReservationQueues *q, unsigned book_id,
+								  ReservationVisitor fn, void *ctx);
+
+/* Visits every hold, grouped by book, in no particular order. */
+int reservation_queues_foreach(const ReservationQueues *q, ReservationVisitor fn, void *ctx);
+
+/* Number of holds over all books. */
+size_t reservation_queues_size(const ReservationQueues *q);
+
+/* Heap bytes held by the queues, the hashes and the holds. */
+size_t reservation_queues_bytes(const ReservationQueues *q);
+
+#endif /* RESERVATIONS_H */
@@ -0,0 +1,73 @@
+#ifndef TITLE_INDEX_H
+#define TITLE_INDEX_H
+
+#include <stddef.h>
+
+/*
+	Approximate title lookup: which titles are within a given
+	similarity of a query, for near-duplicate detection.
+
+	Titles are kept normalized (lib/fuzzy/fuzzy.h) with an inverted
+	index from each padded trigram to the titles that contain it. A
+	query never compares against the whole catalog:
+	- the similarity bounds the edit distance k, and with it the
+	  lengths a match can have;
+	- an edit touches at most three trigrams, so a match shares at
+	  least (distinct query trigrams - 3k) of them, counted from the
+	  query's posting lists;
+	- only the titles left are compared, with the bit-parallel
+	  Levenshtein distance, which stops at k.
+
+	put is O(trigrams of the title) and skips titles whose normalized
+	form did not change; remove also scans the posting lists of the
+	title's trigrams, so it is linear in how common they are.
+
+	Not thread-safe: the DB maintains one index of book titles under
+	the books table lock and one of suggestion titles under the
+	suggestions table lock. Queries only read the index.
+*/
+typedef struct TitleIndex TitleIndex;
+
+/* One title found by title_index_similar. */
+typedef struct {
+	unsigned id;
+	unsigned distance;   /* edits between the normalized titles */
+	unsigned similarity; /* 0-100, see fuzzy_similarity */
+} TitleMatch;
+
+/* Similarities below this are refused: the filters stop pruning anything. */
+#define TITLE_SIMILARITY_MIN 50
+
+/* Creates an empty index. NULL on allocation failure. */
+TitleIndex *title_index_create(void);
+
+/* NULL is ignored. */
+void title_index_destroy(TitleIndex *t);
+
+/*
+	Indexes title under id, replacing the title id had. Returns 0, or
+	-1 on invalid arguments or allocation failure (index unchanged).
+	Putting back the title id had just before never fails.
+*/
+int title_index_put(TitleIndex *t, unsigned id, const char *title);
+
+/* Forgets id. Unknown ids are ignored. */
+void title_index_remove(TitleIndex *t, unsigned id);
+
+/*
+	Finds the titles at least min_similarity percent similar to title
+	(min_similarity in [TITLE_SIMILARITY_MIN, 100]). The best cap of
+	them are written to out, most similar first (ties: fewer edits,
+	then lower id), and their number to *n. Returns 0, or -1 on
+	invalid arguments or allocation failure.
+*/
+int title_index_similar(const TitleIndex *t, const char *title, unsigned min_similarity,
+						TitleMatch *out, size_t cap, size_t *n);
+
+/* Number of titles indexed. */
+size_t title_index_size(const TitleIndex *t);
+
+/* Heap bytes held by the index. */
+size_t title_index_bytes(const TitleIndex *t);
+
+#endif /* TITLE_INDEX_H */
@@ -0,0 +1,10 @@
+#ifndef RESERVATIONS_FILE_H
+#define RESERVATIONS_FILE_H
+
+#include "lib/dlist/dlist.h"
+#include "model/reservation.h"
+
+DList *file_load_reservations(const char *path);
+int file_save_reservations(const char *path, const DList *reservations);
+
+#endif /* RESERVATIONS_FILE_H */
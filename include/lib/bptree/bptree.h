@@ -0,0 +1,83 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    In-memory B+tree from 64-bit keys to pointers.
+
+    Keys are unique and kept in ascending order; every value lives in
+    a leaf and the leaves are chained left to right, so a range scan
+    is one descent to the first key followed by a walk along the
+    leaves. Nodes hold up to BPTREE_ORDER keys, which keeps the tree
+    shallow (3 levels cover ~30k keys, 5 levels ~25M) and the keys of
+    a node on a few cache lines.
+
+    Callers that need duplicate keys (e.g. many books per year) pack a
+    tie-breaker into the low bits, see bptree_key.
+
+    Not thread-safe: writers and cursors must be serialized by the
+    caller (the DB uses the table's reader-writer lock). A cursor is
+    invalidated by any insert or remove.
+*/
+typedef struct BPTree BPTree;
+
+/* Maximum number of keys per node. */
+#define BPTREE_ORDER 32
+
+/*
+    Position inside the tree, returned by bptree_seek.
+    Opaque: only pass it to bptree_next.
+*/
+typedef struct {
+    const void *leaf;
+    unsigned pos;
+} BPTreeCursor;
+
+/* Creates an empty tree. Returns NULL on allocation failure. */
+BPTree *bptree_create(void);
+
+/* Frees the tree (not the values). NULL is ignored. */
+void bptree_destroy(BPTree *tree);
+
+/*
+    Inserts key, or replaces its value if it is already present.
+    Replacing never allocates, so it cannot fail.
+    Returns 0 on success, -1 on allocation failure (tree unchanged).
+*/
+int bptree_insert(BPTree *tree, uint64_t key, void *value);
+
+/* Removes key. Returns 0 if it was present, -1 otherwise. */
+int bptree_remove(BPTree *tree, uint64_t key);
+
+/* Returns the value stored under key, or NULL. */
+void *bptree_get(const BPTree *tree, uint64_t key);
+
+/* Number of keys. */
+size_t bptree_size(const BPTree *tree);
+
+/* Heap bytes held by the nodes. */
+size_t bptree_bytes(const BPTree *tree);
+
+/* Positions cur on the first key >= key. */
+void bptree_seek(const BPTree *tree, uint64_t key, BPTreeCursor *cur);
+
+/*
+    Returns the entry under cur in *key / *value (either may be NULL)
+    and moves to the next one. Returns false once past the last key.
+*/
+bool bptree_next(BPTreeCursor *cur, uint64_t *key, void **value);
+
+/*
+    Composite key: high orders the entries, low breaks ties (e.g. a
+    record id). Signed fields should be biased first so negative values
+    sort before positive ones: (uint32_t)v ^ 0x80000000u.
+*/
+static inline uint64_t bptree_key(uint32_t high, uint32_t low)
+{
+    return ((uint64_t)high << 32) | low;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+    Accounted heap allocation.
+
+    Every allocation made through aed_malloc/aed_realloc/aed_free is
+    tagged with a category, and the live bytes, live objects, peak
+    bytes and total allocations of each category are kept in process
+    wide counters (relaxed atomics, safe from any thread). This is what
+    lets the DB report how much memory each table, the list nodes, the
+    indexes and the array buffers actually take.
+
+    The free functions take the size of the block back, like a sized
+    delete: the caller always knows it (sizeof of the record, capacity
+    of the buffer), and it means no per-block header is needed, so the
+    accounting itself adds no memory.
+
+    The underlying allocator is pluggable (aed_set_allocator), e.g. to
+    route everything through an arena or to inject failures in tests.
+*/
+
+#ifndef AED_ALLOC_H
+#define AED_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    AED_MEM_OTHER,
+    AED_MEM_LIST,        /* DList headers */
+    AED_MEM_LIST_NODE,   /* DList nodes */
+    AED_MEM_ARRAYLIST,   /* ArrayList buffers */
+    AED_MEM_INDEX,       /* id indexes */
+    AED_MEM_BOOK,        /* records, one category per table */
+    AED_MEM_USER,
+    AED_MEM_LOAN,
+    AED_MEM_SUGGESTION,
+    AED_MEM_RESERVATION, /* reservation queue entries */
+    AED_MEM_COUNT
+} AedMemCategory;
+
+typedef struct {
+    size_t bytes;          /* currently allocated */
+    size_t objects;        /* currently allocated blocks */
+    size_t peak_bytes;     /* highest value 'bytes' has reached */
+    uint64_t allocations;  /* blocks ever allocated */
+} AedMemStats;
+
+/*
+    Allocator hooks. ctx is passed back to every call.
+    The default allocator is malloc/realloc/free.
+*/
+typedef struct {
+    void *(*malloc_fn)(size_t size, void *ctx);
+    void *(*realloc_fn)(void *ptr, size_t size, void *ctx);
+    void (*free_fn)(void *ptr, void *ctx);
+    void *ctx;
+} AedAllocator;
+
+/*
+    Replaces the allocator (NULL restores the default). Only call this
+    while nothing allocated by the previous allocator is still alive,
+    typically first thing in main.
+*/
+void aed_set_allocator(const AedAllocator *allocator);
+
+void *aed_malloc(AedMemCategory category, size_t size);
+void *aed_calloc(AedMemCategory category, size_t count, size_t size);
+
+/* ptr may be NULL (then old_size must be 0); returns NULL on failure, leaving ptr valid. */
+void *aed_realloc(AedMemCategory category, void *ptr, size_t old_size, size_t new_size);
+
+/* size must be the size the block was allocated with. ptr may be NULL. */
+void aed_free(AedMemCategory category, void *ptr, size_t size);
+
+/* Snapshot of the counters of one category (zeros if out of range). */
+void aed_mem_stats(AedMemCategory category, AedMemStats *out);
+
+/* "list_node", "book", ... */
+const char *aed_mem_category_name(AedMemCategory category);
+
+#endif
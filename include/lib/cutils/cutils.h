@@ -3,15 +3,17 @@
 
     Currently it provides a simple ArrayList type: a dynamic array
     of fixed-size elements (void* internally) that can grow as you
-    append new items. It is independent from the rest of the project
-    and can be reused by other modules if needed.
+    append new items, and a monotonic clock for timing code. It is
+    independent from the rest of the project and can be reused by
+    other modules if needed.
 */
 
 #ifndef CUTILS_H
 #define CUTILS_H
 
-#include <stddef.h>  /* size_t */
-#include <stdbool.h> /* bool   */
+#include <stddef.h>  /* size_t   */
+#include <stdbool.h> /* bool     */
+#include <stdint.h>  /* uint64_t */
 
 /*
     Generic array-backed list.
@@ -58,4 +60,10 @@ bool arraylist_append(ArrayList *list, const void *value);
 */
 void *arraylist_get(ArrayList *list, size_t index);
 
+/*
+    Nanoseconds from a monotonic clock (never jumps with wall-clock
+    changes). Only differences between two calls are meaningful.
+*/
+uint64_t cutils_now_ns(void);
+
 #endif
\ No newline at end of file
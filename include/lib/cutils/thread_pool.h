@@ -0,0 +1,74 @@
+/*
+    Work-stealing thread pool.
+
+    Every worker owns a deque of tasks: it pushes and pops at the
+    bottom (LIFO, cache friendly) and idle workers steal from the top
+    of someone else's deque (FIFO, oldest and usually biggest work).
+    Tasks submitted from outside the pool are spread round-robin over
+    the deques; tasks submitted from inside a task go to the deque of
+    the worker running it.
+
+    One pool is meant to be shared by the whole program (parallel
+    load/save, scans, index builds) instead of each feature spawning
+    its own threads.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>  /* size_t */
+#include <stdbool.h> /* bool   */
+
+typedef struct ThreadPool ThreadPool;
+
+/* A unit of work: fn(arg) runs exactly once on some worker. */
+typedef void (*ThreadPoolTask)(void *arg);
+
+/* Body of a parallel-for: handles the indices [begin, end). */
+typedef void (*ThreadPoolRangeFn)(size_t begin, size_t end, void *ctx);
+
+/*
+    Start a pool with n_threads workers (0 = one per online CPU).
+    Returns NULL if no worker could be started.
+*/
+ThreadPool *thread_pool_create(unsigned n_threads);
+
+/*
+    Wait for every submitted task, stop the workers and free the pool.
+    Safe to call with NULL.
+*/
+void thread_pool_destroy(ThreadPool *pool);
+
+/* Number of worker threads. */
+unsigned thread_pool_size(const ThreadPool *pool);
+
+/*
+    Queue fn(arg) for execution.
+    Returns false if the task could not be queued (out of memory);
+    the caller then still owns arg.
+*/
+bool thread_pool_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg);
+
+/*
+    Block until every task queued with thread_pool_submit has finished.
+    The calling thread helps running tasks meanwhile.
+
+    Do not call this from inside a submitted task: that task counts
+    as unfinished, so the wait would never end. Use
+    thread_pool_parallel_for for nested parallelism instead.
+*/
+void thread_pool_wait(ThreadPool *pool);
+
+/*
+    Run fn over [begin, end) split in chunks of at most grain indices
+    (0 = pick a grain that gives every worker a few chunks) and return
+    once all chunks are done. The caller runs chunks too, so this can
+    be nested inside tasks without deadlocking.
+
+    With a NULL pool (or a single chunk) fn runs inline on the caller.
+    Returns 0, or -1 if fn is NULL.
+*/
+int thread_pool_parallel_for(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                             ThreadPoolRangeFn fn, void *ctx);
+
+#endif
@@ -89,8 +89,14 @@ DListNode *dlist_find(DList *list, void *target, int (*cmp_fn)(void*, void*));
     Priority insertion.
     Inserts the element in the correct position (according to 'priority').
     If priority_mode=false, this function should not be used.
+
+    Returns the new node (handy for O(1) removal later), or NULL if
+    the node could not be allocated.
+
+    O(1) when the new priority is above the head or not above the
+    tail (ascending / descending insertion order), O(n) otherwise.
 */
-void dlist_insert_priority(DList *list, void *data, int priority);
+DListNode *dlist_insert_priority(DList *list, void *data, int priority);
 
 // Helper utilities
 
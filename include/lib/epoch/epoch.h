@@ -0,0 +1,77 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stddef.h>
+
+/*
+    Epoch-based memory reclamation (EBR).
+
+    Lets readers walk a shared structure without taking any lock while
+    writers keep removing things from it. The rules are simple:
+
+    - Readers wrap every lock-free access in epoch_enter/epoch_exit.
+      Pointers read inside that section stay valid until epoch_exit.
+    - Writers (serialized among themselves by some other means) unlink
+      an object first and then hand it to epoch_retire instead of
+      freeing it straight away.
+    - A retired object is only freed once every reader that could
+      still see it has left its read section.
+
+    The domain keeps a global epoch counter and one slot per thread.
+    The counter can only move forward when every thread currently
+    inside a read section has observed its current value, so anything
+    retired two epochs ago is guaranteed to be unreachable.
+*/
+typedef struct EpochDomain EpochDomain;
+
+/*
+    Maximum number of threads that can be registered in one domain
+    at the same time. A thread is registered on its first epoch_enter
+    and released with epoch_thread_exit.
+*/
+#define EPOCH_MAX_THREADS 128
+
+/*
+    Creates an empty domain.
+    Returns NULL on allocation failure.
+*/
+EpochDomain *epoch_create(void);
+
+/*
+    Frees the domain and every object still waiting to be reclaimed.
+    Must only be called when no thread is inside a read section.
+*/
+void epoch_destroy(EpochDomain *d);
+
+/*
+    Enter / leave a read section.
+    Sections can be nested; only the outermost pair has any effect.
+    Both are wait-free apart from the very first call on each thread,
+    which claims a slot in the domain.
+*/
+void epoch_enter(EpochDomain *d);
+void epoch_exit(EpochDomain *d);
+
+/*
+    Schedules ptr to be released with free_fn (or free() if NULL)
+    once no reader can reach it anymore.
+    Thread-safe; may run a collection pass every few calls.
+*/
+void epoch_retire(EpochDomain *d, void *ptr, void (*free_fn)(void *));
+
+/*
+    Tries to advance the global epoch and frees everything that has
+    become unreachable. Cheap enough to call after every write batch.
+*/
+void epoch_collect(EpochDomain *d);
+
+/*
+    Releases the calling thread's slot. Call it before a worker thread
+    that used the domain finishes, so the slot can be reused.
+*/
+void epoch_thread_exit(EpochDomain *d);
+
+/* Number of retired objects not yet freed (useful for tests/stats). */
+size_t epoch_pending(EpochDomain *d);
+
+#endif
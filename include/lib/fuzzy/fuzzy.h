@@ -0,0 +1,65 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Approximate string matching for titles.
+
+    fuzzy_distance is the Levenshtein distance computed with Myers'
+    bit-parallel algorithm (Hyyro's multi-word form): the pattern is
+    preprocessed once into one bit mask per character, and each
+    character of the text then updates a whole column of the DP
+    matrix with a handful of word operations, 64 rows per word. That
+    is O(ceil(m/64) * n) instead of O(m * n), and a comparison gives
+    up as soon as the distance can no longer stay under the limit.
+
+    Strings are compared after fuzzy_normalize, so case, punctuation
+    and repeated spaces do not count as edits. Bytes are compared as
+    they are (UTF-8 accents are two bytes).
+*/
+
+/* Longest normalized string a pattern can hold. */
+#define FUZZY_MAX_LEN 128
+
+#define FUZZY_WORDS ((FUZZY_MAX_LEN + 63) / 64)
+
+typedef struct {
+    uint64_t peq[FUZZY_WORDS][256]; /* bit i of peq[w][c]: pattern[64w + i] == c */
+    size_t len;
+    size_t words;
+} FuzzyPattern;
+
+/*
+    Lower-cases ASCII letters, turns every other ASCII character that is
+    not a letter or digit into a space, squeezes runs of spaces and
+    trims both ends. Writes at most out_size - 1 bytes plus the NUL and
+    returns the length written.
+*/
+size_t fuzzy_normalize(const char *s, char *out, size_t out_size);
+
+/* Prepares s[0..len) as a pattern. Returns 0, or -1 if len > FUZZY_MAX_LEN. */
+int fuzzy_pattern_init(FuzzyPattern *p, const char *s, size_t len);
+
+/*
+    Levenshtein distance between the pattern and text[0..len), or
+    max + 1 as soon as it is known to exceed max.
+*/
+unsigned fuzzy_distance(const FuzzyPattern *p, const char *text, size_t len, unsigned max);
+
+/* 100 * (1 - distance / longer length), rounded down; 100 for two empty strings. */
+unsigned fuzzy_similarity(unsigned distance, size_t a_len, size_t b_len);
+
+/*
+    The distinct trigrams of s[0..len) padded with one space on each
+    side (so a string of length n has at most n of them), packed three
+    bytes to a uint32_t and sorted. Writes at most cap of them and
+    returns how many were written.
+
+    An edit changes at most three trigrams, so two strings within
+    distance k share at least (distinct trigrams of one) - 3k of them.
+*/
+size_t fuzzy_trigrams(const char *s, size_t len, uint32_t *out, size_t cap);
+
+#endif
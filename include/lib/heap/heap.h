@@ -0,0 +1,65 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+    Binary heap of pointers: a priority queue whose push, pop and
+    removal are O(log n), unlike dlist_insert_priority, which walks the
+    list to find the insertion point.
+
+    The order comes from a comparison function: cmp(a, b, ctx) < 0
+    means a is served before b. The heap does not break ties itself, so
+    a caller that wants FIFO order among equals compares a sequence
+    number last.
+
+    Elements that must be removed from the middle of the heap (e.g. a
+    cancelled reservation) can track their own slot through the
+    optional 'moved' callback, which is called with the element and its
+    new index every time it is placed; heap_remove_at and heap_update_at
+    take that index.
+
+    Not thread-safe: callers serialize access themselves.
+*/
+typedef struct Heap Heap;
+
+typedef int (*HeapCmp)(const void *a, const void *b, void *ctx);
+typedef void (*HeapMoved)(void *elem, size_t index, void *ctx);
+
+/* Creates an empty heap. moved may be NULL. NULL on allocation failure. */
+Heap *heap_create(HeapCmp cmp, HeapMoved moved, void *ctx);
+
+/* Frees the heap (not the elements). NULL is ignored. */
+void heap_destroy(Heap *h);
+
+/* Adds elem. Returns 0 on success, -1 on allocation failure (heap unchanged). */
+int heap_push(Heap *h, void *elem);
+
+/* The element served first, or NULL if the heap is empty. */
+void *heap_peek(const Heap *h);
+
+/* Removes and returns the element served first, or NULL if the heap is empty. */
+void *heap_pop(Heap *h);
+
+/* Removes and returns the element at index, or NULL if index is out of range. */
+void *heap_remove_at(Heap *h, size_t index);
+
+/* Restores the order after the priority of the element at index changed. */
+void heap_update_at(Heap *h, size_t index);
+
+/* Element at index, in array (not priority) order; NULL if out of range. */
+void *heap_at(const Heap *h, size_t index);
+
+/* Number of elements. */
+size_t heap_size(const Heap *h);
+
+static inline bool heap_empty(const Heap *h)
+{
+    return heap_size(h) == 0;
+}
+
+/* Heap bytes held by the heap itself (not the elements). */
+size_t heap_bytes(const Heap *h);
+
+#endif
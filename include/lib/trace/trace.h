@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Span tracing in the Chrome trace-event format.
+
+    Code marks interesting regions with a begin/end pair:
+
+        TRACE_SPAN_BEGIN(span);
+        ... work ...
+        TRACE_SPAN_END(span, "db", "db_init");
+
+    Each finished span becomes one "complete" event (ph "X") with its
+    start time, duration and thread. Events are appended to a ring
+    buffer owned by the recording thread, so recording takes no lock
+    and never touches the disk; when a buffer is full the oldest events
+    are overwritten. Everything is written as one JSON file by
+    trace_stop, normally at exit, and can be opened in Perfetto
+    (ui.perfetto.dev) or chrome://tracing.
+
+    While tracing is off a span costs one relaxed atomic load.
+
+    Names and categories are stored by pointer: pass string literals or
+    other strings that outlive the trace.
+*/
+
+/* Events kept per thread when trace_start is given 0. */
+#define TRACE_DEFAULT_EVENTS_PER_THREAD 65536
+
+/*
+    Starts recording; the trace is written to path by trace_stop.
+    events_per_thread is the ring size of every thread (0 = default).
+    Returns 0 on success, -1 if already started or out of memory.
+*/
+int trace_start(const char *path, size_t events_per_thread);
+
+/*
+    Stops recording, writes the JSON file and frees every buffer.
+    Must be called once no other thread is still recording (e.g. after
+    worker threads were joined). Returns 0 on success, -1 if the file
+    could not be written or tracing was not started.
+*/
+int trace_stop(void);
+
+bool trace_enabled(void);
+
+/*
+    Names the calling thread in the trace ("main", "server worker").
+    May be called before trace_start; the name is kept per thread.
+*/
+void trace_set_thread_name(const char *name);
+
+/* Low-level API behind the macros: 0 means "not tracing". */
+uint64_t trace_begin(void);
+void trace_end(const char *category, const char *name, uint64_t start);
+
+#define TRACE_SPAN_BEGIN(var) uint64_t var = trace_begin()
+#define TRACE_SPAN_END(var, category, name) trace_end((category), (name), (var))
+
+#endif
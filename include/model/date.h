@@ -0,0 +1,45 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <stdint.h>
+
+/*
+    Day number: days since 0000-12-31, so 0001-01-01 is day 1 and
+    consecutive dates get consecutive numbers. Adding days or taking
+    the days between two dates is plain integer arithmetic, and the
+    order is the same as for the YYYYMMDD values the files use.
+
+    DATE_NONE (0) stands for "no date" (a YYYYMMDD of 0, e.g. a loan
+    not returned yet) and sorts before every real date.
+*/
+typedef uint32_t Date;
+
+#define DATE_NONE 0u
+
+/* Day number of a valid y-m-d (y >= 1, 1 <= m <= 12, 1 <= d <= days in month). */
+Date date_from_ymd(unsigned y, unsigned m, unsigned d);
+
+/*
+    YYYYMMDD -> day number. A value that is not a real date (month 13,
+    day 31 in April, ...) gives the last date before it, so the order
+    of any two values is kept; 0 gives DATE_NONE.
+*/
+Date date_from_yyyymmdd(unsigned yyyymmdd);
+
+/*
+    Like date_from_yyyymmdd, but a value that is not a real date gives
+    the first date after it. Use it for the lower bound of a range and
+    date_from_yyyymmdd for the upper bound.
+*/
+Date date_ceil_yyyymmdd(unsigned yyyymmdd);
+
+/* Day number -> YYYYMMDD; DATE_NONE gives 0. */
+unsigned date_to_yyyymmdd(Date date);
+
+/* Number of days of month m (1..12) of year y. */
+unsigned date_days_in_month(unsigned y, unsigned m);
+
+/* Current local date. */
+Date date_today(void);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "model/date.h"
+
 typedef struct {
     unsigned id;
     unsigned user_id;
@@ -17,6 +19,21 @@ void loan_init(Loan* l, unsigned id,
                unsigned date_borrow,
                unsigned date_return);
 
+/*
+    Due dates: a loan may be kept LOAN_PERIOD_DAYS days, so it is due
+    on date_borrow + LOAN_PERIOD_DAYS and overdue from the next day on
+    while date_return is still 0.
+*/
+#define LOAN_PERIOD_DAYS 21
+
+/* Borrow / return / due dates as day numbers (model/date.h); no return date is DATE_NONE. */
+Date loan_borrow_day(const Loan* l);
+Date loan_return_day(const Loan* l);
+Date loan_due_day(const Loan* l);
+
+/* YYYYMMDD date on which the loan is due. */
+unsigned loan_due_date(const Loan* l);
+
 int  loan_from_csv(Loan* l, const char* line);
 void loan_to_csv(const Loan* l, char* out, size_t out_size);
 
@@ -0,0 +1,36 @@
+#ifndef RESERVATION_H
+#define RESERVATION_H
+
+#include <stddef.h>
+
+/*
+    A hold placed by a user on a book with no copy available.
+
+    Holds on the same book are served by membership tier (higher
+    first), then by request date, then by order of arrival (seq), so
+    two holds placed on the same day keep their order.
+*/
+typedef struct {
+    unsigned book_id;
+    unsigned user_id;
+    unsigned tier;      // 0..RESERVATION_TIER_MAX
+    unsigned date;      // YYYYMMDD the hold was placed
+    unsigned seq;       // arrival order, assigned by the DB
+} Reservation;
+
+/* Highest membership tier (0 is a regular member). */
+#define RESERVATION_TIER_MAX 3
+
+void reservation_init(Reservation* r,
+                      unsigned book_id,
+                      unsigned user_id,
+                      unsigned tier,
+                      unsigned date);
+
+/* < 0 if a is served before b, > 0 if after, 0 for the same position. */
+int reservation_cmp(const Reservation* a, const Reservation* b);
+
+int  reservation_from_csv(Reservation* r, const char* line);
+void reservation_to_csv(const Reservation* r, char* out, size_t out_size);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+    Synthetic dataset generator.
+
+    Produces books, users, loans and suggestions that look like a real
+    catalogue (few very popular authors, titles of a few words, loans
+    spread over a date range, suggestions that repeat books with small
+    typos) so performance work can be measured on large inputs.
+
+    Every record is a pure function of (seed, id): book 123 is the same
+    no matter how many other records are generated or in which order,
+    which is what lets near-duplicate suggestions point back at books
+    without keeping them all in memory.
+
+    Used by the gen_data tool (make gen-data) and by the benchmarks.
+*/
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <stdint.h>
+
+#include "model/books.h"
+#include "model/user.h"
+#include "model/loans.h"
+#include "model/suggestion.h"
+
+typedef struct {
+    unsigned books;
+    unsigned users;
+    unsigned loans;
+    unsigned suggestions;
+
+    unsigned authors;         /* distinct authors */
+    double author_skew;       /* Zipf exponent for books per author (0 = uniform) */
+    double book_skew;         /* Zipf exponent for loans per book (0 = uniform) */
+
+    unsigned title_words_min; /* title length in words */
+    unsigned title_words_max;
+
+    unsigned date_from;       /* loans are borrowed in [date_from, date_to], YYYYMMDD */
+    unsigned date_to;
+    double returned_ratio;    /* fraction of loans already returned */
+
+    double duplicate_ratio;   /* fraction of suggestions that near-duplicate a book */
+
+    uint64_t seed;
+} DataGenConfig;
+
+typedef struct DataGen DataGen;
+
+/* Fills cfg with a small but realistic default dataset. */
+void datagen_default_config(DataGenConfig *cfg);
+
+/*
+    Prepares the samplers for cfg (the config is copied).
+    Returns NULL on invalid config or allocation failure.
+*/
+DataGen *datagen_create(const DataGenConfig *cfg);
+void datagen_destroy(DataGen *g);
+
+/* Record generators; ids start at 1. */
+void datagen_book(const DataGen *g, unsigned id, Book *out);
+void datagen_user(const DataGen *g, unsigned id, User *out);
+void datagen_loan(const DataGen *g, unsigned id, Loan *out);
+void datagen_suggestion(const DataGen *g, unsigned id, Suggestion *out);
+
+/*
+    Writes the four CSV files (with headers) in the format read by
+    file_load_books / users / loans / suggestions.
+    Returns 0 on success, -1 if any file could not be written.
+*/
+int datagen_write_files(const DataGen *g,
+                        const char *books_path,
+                        const char *users_path,
+                        const char *loans_path,
+                        const char *suggestions_path);
+
+#endif
@@ -1,5 +1,8 @@
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <direct.h>
@@ -9,8 +12,14 @@
 #endif
 
 #include "app/app.h"
+#include "app/command.h"
 #include "app/menu.h"
+#include "app/server.h"
 #include "db/db.h"
+#include "db/db_memory.h"
+#include "db/db_stats.h"
+#include "db/db_record.h"
+#include "lib/trace/trace.h"
 
 /*
 	Application layer implementation.
@@ -18,10 +27,18 @@
 	This module owns the global DB instance and glues together
 	the menus (UI) with the persistence and data logic.
 
-	main.c only calls app_init/app_run/app_shutdown.
+	main.c only calls app_init/app_run (or app_serve/app_batch)/app_shutdown.
 */
 static DB db; /* shared in-memory database for the whole app */
 
+/* Phase timing report (app_enable_timings). */
+static bool timings_enabled = false;
+static const char *timings_log = NULL;
+static DBTimings timings;
+
+/* Workload trace (app_enable_recording), NULL when not recording. */
+static const char *record_path = NULL;
+
 /* Pequeno helper cross-platform para criar 'data/' se ainda nao existir. */
 static int ensure_data_directory(void)
 {
@@ -41,6 +58,59 @@ static int ensure_data_directory(void)
 	return -1;
 }
 
+void app_enable_timings(const char *log_path)
+{
+	timings_enabled = true;
+	timings_log = log_path;
+}
+
+/*
+	Prints one of the timing reports to stdout, or appends it to the
+	log file with the current date so nightly restarts can be compared.
+*/
+static void report_timings(void (*print)(const DBTimings *, FILE *))
+{
+	if (!timings_enabled)
+		return;
+
+	if (!timings_log)
+	{
+		print(&timings, stdout);
+		return;
+	}
+
+	FILE *log = fopen(timings_log, "a");
+	if (!log)
+	{
+		printf("Aviso: nao foi possivel abrir %s.\n", timings_log);
+		return;
+	}
+
+	char stamp[32] = "?";
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+	if (tm)
+		strftime(stamp, sizeof stamp, "%Y-%m-%d %H:%M:%S", tm);
+
+	fprintf(log, "# %s\n", stamp);
+	print(&timings, log);
+	fclose(log);
+}
+
+void app_enable_recording(const char *path)
+{
+	record_path = path;
+}
+
+int app_enable_tracing(const char *path)
+{
+	if (trace_start(path, 0) != 0)
+		return -1;
+
+	trace_set_thread_name("main");
+	return 0;
+}
+
 void app_init(void)
 {
 	printf("App iniciada.\n");
@@ -48,11 +118,12 @@ void app_init(void)
 	if (ensure_data_directory() != 0)
 		printf("Aviso: nao foi possivel criar o diretorio 'data/'.\n");
 
-	if (db_init(&db,
+	if (db_init_timed(&db,
 		   "data/books.txt",
 		   "data/users.txt",
 		   "data/loans.txt",
-		   "data/suggestions.txt") != 0)
+		   "data/suggestions.txt",
+		   timings_enabled ? &timings : NULL) != 0)
 	{
 		printf("Erro ao carregar dados da base de dados.\n");
 		/*
@@ -60,6 +131,20 @@ void app_init(void)
 			just continue with empty lists if loading failed.
 		*/
 	}
+	report_timings(db_timings_print_load);
+
+	if (db_load_reservations(&db, "data/reservations.txt") != 0)
+		printf("Aviso: erro ao carregar data/reservations.txt.\n");
+
+	if (record_path && db_record_start(record_path) != 0)
+		printf("Aviso: nao foi possivel gravar o workload em %s.\n", record_path);
+}
+
+static void print_memory_report(void)
+{
+	DBMemoryStats stats;
+	if (db_memory_stats(&db, &stats) == 0)
+		db_memory_print(&stats, stdout);
 }
 
 void app_run(void)
@@ -90,6 +175,8 @@ void app_run(void)
 			case 2: menuLivros(&db);      break;
 			case 3: menuEmprestimos(&db); break;
 			case 4: menuSugestoes(&db);   break;
+			case 98: print_memory_report(); break; /* opcao escondida */
+			case 99: db_stats_dump(stdout); break; /* opcao escondida */
 			case 0:
 				printf("A encerrar a aplicação...\n");
 				return;
@@ -99,17 +186,119 @@ void app_run(void)
 	}
 }
 
+int app_serve(const char *socket_path)
+{
+	/* Workers share the DB, so switch it to locked/copy-on-write mode. */
+	db_set_concurrent(&db, true);
+	int rc = server_run(&db, socket_path, 0);
+	db_set_concurrent(&db, false);
+	return rc;
+}
+
+/* Flush the batch replies once this much text is pending. */
+#define BATCH_FLUSH_BYTES (64 * 1024)
+
+/* Long enough for any command the interpreter accepts, plus slack. */
+#define BATCH_LINE_MAX 1024
+
+int app_batch(const char *path)
+{
+	FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (!in)
+	{
+		fprintf(stderr, "[batch] Nao foi possivel abrir %s.\n", path);
+		return -1;
+	}
+
+	CommandOutput out;
+	command_output_init(&out);
+
+	char line[BATCH_LINE_MAX];
+	unsigned line_no = 0;
+	int failed = 0;
+	int done = 0;
+
+	while (!done && fgets(line, sizeof line, in))
+	{
+		++line_no;
+
+		size_t len = strlen(line);
+		if (len == sizeof line - 1 && line[len - 1] != '\n')
+		{
+			/* Too long: skip the rest of it and report the line. */
+			int ch;
+			while ((ch = fgetc(in)) != '\n' && ch != EOF) {}
+			command_printf(&out, "ERR line too long\n");
+			fprintf(stderr, "[batch] Linha %u: demasiado longa.\n", line_no);
+			++failed;
+			continue;
+		}
+
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		size_t before = out.len;
+		CommandResult rc = command_execute(&db, line, &out);
+
+		if (rc == COMMAND_ERROR)
+		{
+			/* Report the failing line on stderr too, so it is easy to find. */
+			++failed;
+			fprintf(stderr, "[batch] Linha %u: %s", line_no, out.data ? out.data + before : "ERR\n");
+		}
+		else if (rc == COMMAND_QUIT)
+		{
+			done = 1;
+		}
+
+		if (out.len >= BATCH_FLUSH_BYTES)
+		{
+			fwrite(out.data, 1, out.len, stdout);
+			command_output_clear(&out);
+		}
+	}
+
+	if (out.len > 0)
+		fwrite(out.data, 1, out.len, stdout);
+	fflush(stdout);
+
+	command_output_free(&out);
+	if (in != stdin)
+		fclose(in);
+
+	fprintf(stderr, "[batch] %u linhas lidas, %d comandos falharam.\n", line_no, failed);
+	return failed;
+}
+
 void app_shutdown(void)
 {
-	if (db_save(&db,
+	if (db_recording() && db_record_stop() != 0)
+		printf("Aviso: erro ao escrever o workload.\n");
+
+	if (db_save_timed(&db,
 		  "data/books.txt",
 		  "data/users.txt",
 		  "data/loans.txt",
-		  "data/suggestions.txt") != 0)
+		  "data/suggestions.txt",
+		  timings_enabled ? &timings : NULL) != 0)
 	{
 		printf("Aviso: erro ao guardar dados.\n");
 	}
+	report_timings(db_timings_print_save);
+
+	if (db_save_reservations(&db, "data/reservations.txt") != 0)
+		printf("Aviso: erro ao guardar data/reservations.txt.\n");
 
 	db_destroy(&db);
+
+	/* Only builds with DB_STATS=1 have anything worth keeping. */
+	if (db_stats_enabled() && db_stats_dump_file("data/db_stats.txt") != 0)
+		printf("Aviso: erro ao guardar data/db_stats.txt.\n");
+
+	/* Every worker thread has been joined by now, so the buffers are quiet. */
+	if (trace_enabled() && trace_stop() != 0)
+		printf("Aviso: erro ao escrever o trace.\n");
+
 	printf("App encerrada com sucesso.\n");
 }
\ No newline at end of file
@@ -1,18 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
 #include "app/book_controller.h"
+#include "app/controller.h"
 #include "db/db.h"
 #include "model/books.h"
-#include "lib/dlist/dlist.h"
+#include "lib/cutils/thread_pool.h"
+#include "lib/trace/trace.h"
 
 static void remove_newline(char *s);
 static void clear_input_buffer(void);
-static unsigned get_next_book_id(const DB *db);
-static int contains_case_insensitive(const char *text, const char *needle);
-static Book *book_find_by_id(const DB *db, unsigned id);
 
 static void remove_newline(char *s)
 {
@@ -35,57 +33,22 @@ static void clear_input_buffer(void)
     }
 }
 
-static unsigned get_next_book_id(const DB *db)
+static void print_book(const Book *b)
 {
-    unsigned max_id = 0;
-    DList *books = db ? db_get_books(db) : NULL;
-
-    if (!books || !books->head)
-        return 1;
-
-    DLIST_FOREACH(books, node)
-    {
-        Book *b = (Book *)node->data;
-        if (b->id > max_id)
-            max_id = b->id;
-    }
-
-    return max_id + 1;
+    printf("  id=%u, titulo=%s, autor=%s, ano=%d, disponivel=%d\n",
+           b->id, b->title, b->author, b->year, b->available);
 }
 
-static int contains_case_insensitive(const char *text, const char *needle)
+static int print_book_visitor(const Book *b, void *ctx)
 {
-    if (!text || !needle)
-        return 0;
-
-    size_t needle_len = strlen(needle);
-    if (needle_len == 0)
-        return 1;
-
-    for (const char *p = text; *p; ++p)
-    {
-        size_t matched = 0;
-        while (p[matched] && needle[matched] &&
-               tolower((unsigned char)p[matched]) == tolower((unsigned char)needle[matched]))
-        {
-            ++matched;
-        }
-
-        if (matched == needle_len)
-            return 1;
-    }
-
+    int *count = ctx;
+    if (*count == 0)
+        printf("[book] Lista de livros:\n");
+    print_book(b);
+    ++*count;
     return 0;
 }
 
-static Book *book_find_by_id(const DB *db, unsigned id)
-{
-    if (!db)
-        return NULL;
-
-    return db_find_book_by_id(db, id);
-}
-
 void book_list_all(const DB *db)
 {
     if (!db)
@@ -94,20 +57,17 @@ void book_list_all(const DB *db)
         return;
     }
 
-    DList *books = db_get_books(db);
-    if (!books || !books->head)
+    int count = 0;
+    unsigned after = 0;
+    do
     {
-        printf("[book] Nao existem livros registados.\n");
-        return;
-    }
+        TRACE_SPAN_BEGIN(span);
+        db_books_page(db, after, CONTROLLER_PAGE_SIZE, print_book_visitor, &count, &after);
+        TRACE_SPAN_END(span, "app", "book_list_page");
+    } while (after != 0 && controller_next_page());
 
-    printf("[book] Lista de livros:\n");
-    DLIST_FOREACH(books, node)
-    {
-        Book *b = (Book *)node->data;
-        printf("  id=%u, titulo=%s, autor=%s, ano=%d, disponivel=%d\n",
-               b->id, b->title, b->author, b->year, b->available);
-    }
+    if (count == 0)
+        printf("[book] Nao existem livros registados.\n");
 }
 
 void book_insert(DB *db)
@@ -125,8 +85,6 @@ void book_insert(DB *db)
 
     printf("\n--- INSERIR NOVO LIVRO ---\n");
 
-    unsigned new_id = get_next_book_id(db);
-
     printf("Titulo: ");
     if (!fgets(title, sizeof title, stdin))
         return;
@@ -156,10 +114,10 @@ void book_insert(DB *db)
     clear_input_buffer();
 
     Book temp_book;
-    book_init(&temp_book, new_id, title, author, year, stock);
+    book_init(&temp_book, 0, title, author, year, stock);
 
-    if (db_add_book(db, &temp_book) == 0)
-        printf("[book] Livro '%s' (ID=%u) inserido com sucesso.\n", temp_book.title, new_id);
+    if (db_add_book_auto(db, &temp_book) == 0)
+        printf("[book] Livro '%s' (ID=%u) inserido com sucesso.\n", temp_book.title, temp_book.id);
     else
         printf("[book] Erro ao adicionar livro.\n");
 }
@@ -183,16 +141,16 @@ void book_edit(DB *db)
     }
     clear_input_buffer();
 
-    Book *book_to_edit = book_find_by_id(db, id);
-    if (!book_to_edit)
+    Book book_to_edit;
+    if (db_copy_book_by_id(db, id, &book_to_edit) != 0)
     {
         printf("[book] Livro com ID %u nao encontrado.\n", id);
         return;
     }
 
     printf("Livro atual: id=%u, titulo=%s, autor=%s, ano=%d, disponivel=%d\n",
-           book_to_edit->id, book_to_edit->title, book_to_edit->author,
-           book_to_edit->year, book_to_edit->available);
+           book_to_edit.id, book_to_edit.title, book_to_edit.author,
+           book_to_edit.year, book_to_edit.available);
 
     char new_title[128];
     char new_author[128];
@@ -205,8 +163,8 @@ void book_edit(DB *db)
         remove_newline(new_title);
         if (strlen(new_title) > 0)
         {
-            strncpy(book_to_edit->title, new_title, sizeof(book_to_edit->title) - 1);
-            book_to_edit->title[sizeof(book_to_edit->title) - 1] = '\0';
+            strncpy(book_to_edit.title, new_title, sizeof(book_to_edit.title) - 1);
+            book_to_edit.title[sizeof(book_to_edit.title) - 1] = '\0';
         }
     }
 
@@ -216,21 +174,27 @@ void book_edit(DB *db)
         remove_newline(new_author);
         if (strlen(new_author) > 0)
         {
-            strncpy(book_to_edit->author, new_author, sizeof(book_to_edit->author) - 1);
-            book_to_edit->author[sizeof(book_to_edit->author) - 1] = '\0';
+            strncpy(book_to_edit.author, new_author, sizeof(book_to_edit.author) - 1);
+            book_to_edit.author[sizeof(book_to_edit.author) - 1] = '\0';
         }
     }
 
-    printf("Novo ano (atual %d): ", book_to_edit->year);
+    printf("Novo ano (atual %d): ", book_to_edit.year);
     if (scanf("%d", &new_year) == 1)
-        book_to_edit->year = new_year;
+        book_to_edit.year = new_year;
     clear_input_buffer();
 
-    printf("Novo stock (atual %d): ", book_to_edit->available);
+    printf("Novo stock (atual %d): ", book_to_edit.available);
     if (scanf("%d", &new_stock) == 1)
-        book_to_edit->available = new_stock;
+        book_to_edit.available = new_stock;
     clear_input_buffer();
 
+    if (db_update_book(db, &book_to_edit) != 0)
+    {
+        printf("[book] Erro ao atualizar livro.\n");
+        return;
+    }
+
     printf("[book] Livro com ID %u atualizado.\n", id);
 }
 
@@ -253,8 +217,8 @@ void book_delete(DB *db)
     }
     clear_input_buffer();
 
-    Book *existing = db_find_book_by_id(db, id);
-    if (!existing)
+    Book existing;
+    if (db_copy_book_by_id(db, id, &existing) != 0)
     {
         printf("[book] Livro com ID %u nao encontrado.\n", id);
         return;
@@ -266,6 +230,51 @@ void book_delete(DB *db)
         printf("[book] Erro ao remover livro.\n");
 }
 
+static int print_match(const Book *b, void *ctx)
+{
+    print_book(b);
+    ++*(int *)ctx;
+    return 0;
+}
+
+#define BOOK_RECOMMEND_SHOWN 5
+
+/*
+    "Quem requisitou este livro tambem requisitou", da ultima geracao de
+    recomendacoes (gerada aqui na primeira vez, se ainda nao houver).
+*/
+static void print_recommendations(DB *db, unsigned book_id)
+{
+    if (!db_has_recommendations(db))
+    {
+        ThreadPool *pool = thread_pool_create(0);
+        int rc = db_build_recommendations(db, NULL, pool);
+        thread_pool_destroy(pool);
+        if (rc != 0)
+            return;
+    }
+
+    IdCount similar[BOOK_RECOMMEND_SHOWN];
+    size_t n = 0;
+    if (db_recommend_for_book(db, book_id, BOOK_RECOMMEND_SHOWN, similar, &n) != 0 || n == 0)
+        return;
+
+    printf("  Quem requisitou este livro tambem requisitou:\n");
+    for (size_t i = 0; i < n; ++i)
+    {
+        Book b;
+        if (db_copy_book_by_id(db, similar[i].id, &b) == 0)
+            printf("    - %s (%s), %u leitor(es) em comum\n", b.title, b.author, similar[i].count);
+    }
+}
+
+static int has_any_book(const Book *b, void *ctx)
+{
+    (void)b;
+    (void)ctx;
+    return 1;
+}
+
 void book_search(DB *db)
 {
     if (!db)
@@ -274,8 +283,7 @@ void book_search(DB *db)
         return;
     }
 
-    DList *books = db_get_books(db);
-    if (!books || !books->head)
+    if (db_foreach_book(db, has_any_book, NULL) == 0)
     {
         printf("[book] Nao existem livros para pesquisar.\n");
         return;
@@ -332,28 +340,22 @@ void book_search(DB *db)
     int count = 0;
     printf("\n[book] Resultados:\n");
 
-    DLIST_FOREACH(books, node)
+    TRACE_SPAN_BEGIN(span);
+    if (opcao == 1)
     {
-        Book *b = (Book *)node->data;
-        int match = 0;
-
-        if (opcao == 1)
-            match = (b->id == id_search);
-        else if (opcao == 2)
-            match = contains_case_insensitive(b->title, term);
-        else if (opcao == 3)
-            match = contains_case_insensitive(b->author, term);
-
-        if (match)
+        Book found;
+        if (db_copy_book_by_id(db, id_search, &found) == 0)
         {
-            printf("  id=%u, titulo=%s, autor=%s, ano=%d, disponivel=%d\n",
-                   b->id, b->title, b->author, b->year, b->available);
-            ++count;
-
-            if (opcao == 1)
-                break;
+            print_match(&found, &count);
+            print_recommendations(db, id_search);
         }
     }
+    else
+    {
+        db_search_books(db, (opcao == 2) ? DB_BOOK_TITLE : DB_BOOK_AUTHOR,
+                        term, print_match, &count);
+    }
+    TRACE_SPAN_END(span, "app", "book_search");
 
     if (count == 0)
         printf("  Nenhum livro encontrado.\n");
@@ -380,25 +382,23 @@ void book_duplicate(DB *db)
     }
     clear_input_buffer();
 
-    Book *original = book_find_by_id(db, id_original);
-    if (!original)
+    Book original;
+    if (db_copy_book_by_id(db, id_original, &original) != 0)
     {
         printf("[book] Livro com ID %u nao encontrado.\n", id_original);
         return;
     }
 
-    unsigned new_id = get_next_book_id(db);
-
     Book duplicate;
     book_init(&duplicate,
-              new_id,
-              original->title,
-              original->author,
-              original->year,
-              original->available);
-
-    if (db_add_book(db, &duplicate) == 0)
-        printf("[book] Livro duplicado com sucesso. Novo ID=%u.\n", new_id);
+              0,
+              original.title,
+              original.author,
+              original.year,
+              original.available);
+
+    if (db_add_book_auto(db, &duplicate) == 0)
+        printf("[book] Livro duplicado com sucesso. Novo ID=%u.\n", duplicate.id);
     else
         printf("[book] Erro ao duplicar livro.\n");
 }
@@ -0,0 +1,940 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "app/command.h"
+#include "db/db.h"
+#include "model/books.h"
+#include "model/date.h"
+#include "model/loans.h"
+#include "model/user.h"
+#include "lib/cutils/thread_pool.h"
+#include "lib/trace/trace.h"
+
+/* Longest command line accepted (including the record fields). */
+#define COMMAND_LINE_MAX 512
+
+void command_output_init(CommandOutput *out)
+{
+    out->data = NULL;
+    out->len = 0;
+    out->cap = 0;
+}
+
+void command_output_clear(CommandOutput *out)
+{
+    out->len = 0;
+    if (out->data)
+        out->data[0] = '\0';
+}
+
+void command_output_free(CommandOutput *out)
+{
+    free(out->data);
+    command_output_init(out);
+}
+
+void command_printf(CommandOutput *out, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (needed < 0)
+        return;
+
+    size_t want = out->len + (size_t)needed + 1;
+    if (want > out->cap)
+    {
+        size_t new_cap = out->cap ? out->cap : 256;
+        while (new_cap < want)
+            new_cap *= 2;
+
+        char *grown = realloc(out->data, new_cap);
+        if (!grown)
+            return;
+
+        out->data = grown;
+        out->cap = new_cap;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(out->data + out->len, out->cap - out->len, fmt, args);
+    va_end(args);
+    out->len += (size_t)needed;
+}
+
+/* Parses a whole decimal number; rejects trailing garbage. */
+static int parse_unsigned(const char *text, unsigned *value)
+{
+    if (!text || !*text)
+        return -1;
+
+    char *end = NULL;
+    unsigned long v = strtoul(text, &end, 10);
+    if (*end != '\0' || v > 0xFFFFFFFFul)
+        return -1;
+
+    *value = (unsigned)v;
+    return 0;
+}
+
+/* Parses a whole signed decimal number within [min, max]; rejects trailing garbage. */
+static int parse_int(const char *text, long min, long max, int *value)
+{
+    if (!text || !*text)
+        return -1;
+
+    char *end = NULL;
+    errno = 0;
+    long v = strtol(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || v < min || v > max)
+        return -1;
+
+    *value = (int)v;
+    return 0;
+}
+
+/* A YYYYMMDD that names a day; 20241399 or 20230229 are rejected, not rounded. */
+static int parse_date(const char *text, unsigned *date)
+{
+    if (parse_unsigned(text, date) != 0 || *date == 0 ||
+        date_to_yyyymmdd(date_from_yyyymmdd(*date)) != *date)
+        return -1;
+    return 0;
+}
+
+/* Optional trailing date argument (see parse_date), defaulting to today. */
+static int parse_date_or_today(const char *text, unsigned *date)
+{
+    if (!text)
+    {
+        *date = date_to_yyyymmdd(date_today());
+        return 0;
+    }
+
+    return parse_date(text, date);
+}
+
+/*
+    Splits text on ';' into exactly n fields, keeping empty ones
+    (strtok_r would merge "a;;b" into two fields).
+    Returns 0 if the count matches, -1 otherwise.
+*/
+static int split_fields(char *text, char **fields, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        fields[i] = text;
+        char *sep = text ? strchr(text, ';') : NULL;
+
+        if (i + 1 < n)
+        {
+            if (!sep)
+                return -1;
+            *sep = '\0';
+            text = sep + 1;
+        }
+        else if (!text || sep)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void copy_text(char *dst, size_t size, const char *src)
+{
+    strncpy(dst, src, size - 1);
+    dst[size - 1] = '\0';
+}
+
+static void print_book_row(CommandOutput *out, const Book *b)
+{
+    char csv[512];
+    book_to_csv(b, csv, sizeof csv);
+    command_printf(out, "book %s\n", csv);
+}
+
+static int print_book_match(const Book *b, void *ctx)
+{
+    CommandOutput *out = ctx;
+    print_book_row(out, b);
+    return 0;
+}
+
+static CommandResult cmd_lookup(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned id;
+    if (parse_unsigned(strtok_r(args, " ", &save), &id) != 0)
+    {
+        command_printf(out, "ERR usage: lookup <book_id>\n");
+        return COMMAND_ERROR;
+    }
+
+    Book b;
+    if (db_copy_book_by_id(db, id, &b) != 0)
+    {
+        command_printf(out, "ERR book %u not found\n", id);
+        return COMMAND_ERROR;
+    }
+
+    print_book_row(out, &b);
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+/* Visitor state: counts matches while printing them. */
+struct search_ctx {
+    CommandOutput *out;
+    unsigned count;
+};
+
+static int search_visitor(const Book *b, void *ctx)
+{
+    struct search_ctx *search = ctx;
+    print_book_match(b, search->out);
+    ++search->count;
+    return 0;
+}
+
+static CommandResult cmd_search(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    char *field = strtok_r(args, " ", &save);
+    char *term = strtok_r(NULL, "", &save);
+
+    DBBookField which;
+    if (field && strcmp(field, "title") == 0)
+        which = DB_BOOK_TITLE;
+    else if (field && strcmp(field, "author") == 0)
+        which = DB_BOOK_AUTHOR;
+    else
+    {
+        command_printf(out, "ERR usage: search title|author <term>\n");
+        return COMMAND_ERROR;
+    }
+
+    struct search_ctx search = { out, 0 };
+    db_search_books(db, which, term ? term : "", search_visitor, &search);
+    command_printf(out, "OK %u\n", search.count);
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_add_book(DB *db, char *args, CommandOutput *out)
+{
+    char *f[4];
+    int y, a;
+    if (split_fields(args, f, 4) != 0 || !*f[0] || !*f[1] ||
+        parse_int(f[2], INT_MIN, INT_MAX, &y) != 0 || parse_int(f[3], 0, INT_MAX, &a) != 0)
+    {
+        command_printf(out, "ERR usage: add-book <title>;<author>;<year>;<available>\n");
+        return COMMAND_ERROR;
+    }
+
+    Book b;
+    book_init(&b, 0, "", "", y, a);
+    copy_text(b.title, sizeof b.title, f[0]);
+    copy_text(b.author, sizeof b.author, f[1]);
+
+    if (db_add_book_auto(db, &b) != 0)
+    {
+        command_printf(out, "ERR could not add book\n");
+        return COMMAND_ERROR;
+    }
+
+    command_printf(out, "OK %u\n", b.id);
+    return COMMAND_OK;
+}
+
+/* Like the "Editar livro" menu: an empty field keeps the current value. */
+static CommandResult cmd_edit_book(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    char *id_arg = strtok_r(args, " ", &save);
+    char *rest = strtok_r(NULL, "", &save);
+
+    char *f[4];
+    unsigned id;
+    int y = 0, a = 0;
+    if (parse_unsigned(id_arg, &id) != 0 || split_fields(rest, f, 4) != 0 ||
+        (*f[2] && parse_int(f[2], INT_MIN, INT_MAX, &y) != 0) ||
+        (*f[3] && parse_int(f[3], 0, INT_MAX, &a) != 0))
+    {
+        command_printf(out, "ERR usage: edit-book <book_id> [title];[author];[year];[available]\n");
+        return COMMAND_ERROR;
+    }
+
+    Book b;
+    if (db_copy_book_by_id(db, id, &b) != 0)
+    {
+        command_printf(out, "ERR book %u not found\n", id);
+        return COMMAND_ERROR;
+    }
+
+    if (*f[0])
+        copy_text(b.title, sizeof b.title, f[0]);
+    if (*f[1])
+        copy_text(b.author, sizeof b.author, f[1]);
+    if (*f[2])
+        b.year = y;
+    if (*f[3])
+        b.available = a;
+
+    if (db_update_book(db, &b) != 0)
+    {
+        command_printf(out, "ERR could not update book %u\n", id);
+        return COMMAND_ERROR;
+    }
+
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+static CommandResult remove_by_id(DB *db, char *args, CommandOutput *out, const char *what,
+                                  int (*remove_fn)(DB *, unsigned))
+{
+    char *save = NULL;
+    unsigned id;
+    if (parse_unsigned(strtok_r(args, " ", &save), &id) != 0)
+    {
+        command_printf(out, "ERR usage: remove-%s <%s_id>\n", what, what);
+        return COMMAND_ERROR;
+    }
+
+    if (remove_fn(db, id) != 0)
+    {
+        command_printf(out, "ERR %s %u not found\n", what, id);
+        return COMMAND_ERROR;
+    }
+
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_remove_book(DB *db, char *args, CommandOutput *out)
+{
+    return remove_by_id(db, args, out, "book", db_remove_book);
+}
+
+static CommandResult cmd_remove_user(DB *db, char *args, CommandOutput *out)
+{
+    return remove_by_id(db, args, out, "user", db_remove_user);
+}
+
+static CommandResult cmd_remove_loan(DB *db, char *args, CommandOutput *out)
+{
+    return remove_by_id(db, args, out, "loan", db_remove_loan);
+}
+
+static CommandResult cmd_remove_suggestion(DB *db, char *args, CommandOutput *out)
+{
+    return remove_by_id(db, args, out, "suggestion", db_remove_suggestion);
+}
+
+static CommandResult cmd_add_loan(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned user_id, book_id, date;
+    char *user_arg = strtok_r(args, " ", &save);
+    char *book_arg = strtok_r(NULL, " ", &save);
+    char *date_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(user_arg, &user_id) != 0 || parse_unsigned(book_arg, &book_id) != 0 ||
+        parse_date_or_today(date_arg, &date) != 0)
+    {
+        command_printf(out, "ERR usage: add-loan <user_id> <book_id> [YYYYMMDD]\n");
+        return COMMAND_ERROR;
+    }
+
+    unsigned loan_id;
+    switch (db_checkout(db, user_id, book_id, date, &loan_id))
+    {
+    case DB_CIRC_OK:
+        command_printf(out, "OK %u\n", loan_id);
+        return COMMAND_OK;
+    case DB_CIRC_NO_USER:
+        command_printf(out, "ERR user %u not found\n", user_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_NO_BOOK:
+        command_printf(out, "ERR book %u not found\n", book_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_UNAVAILABLE:
+        command_printf(out, "ERR book %u has no copies available\n", book_id);
+        return COMMAND_ERROR;
+    default:
+        command_printf(out, "ERR could not create loan\n");
+        return COMMAND_ERROR;
+    }
+}
+
+static CommandResult cmd_return_loan(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned loan_id, date;
+    char *loan_arg = strtok_r(args, " ", &save);
+    char *date_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(loan_arg, &loan_id) != 0 || parse_date_or_today(date_arg, &date) != 0)
+    {
+        command_printf(out, "ERR usage: return-loan <loan_id> [YYYYMMDD]\n");
+        return COMMAND_ERROR;
+    }
+
+    unsigned handoff;
+    switch (db_return(db, loan_id, date, &handoff))
+    {
+    case DB_CIRC_OK:
+        if (handoff)
+            command_printf(out, "OK handoff %u\n", handoff);
+        else
+            command_printf(out, "OK\n");
+        return COMMAND_OK;
+    case DB_CIRC_NO_LOAN:
+        command_printf(out, "ERR loan %u not found\n", loan_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_RETURNED:
+        command_printf(out, "ERR loan %u already returned\n", loan_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_BEFORE_BORROW:
+        command_printf(out, "ERR loan %u was borrowed after %u\n", loan_id, date);
+        return COMMAND_ERROR;
+    default:
+        command_printf(out, "ERR could not return loan\n");
+        return COMMAND_ERROR;
+    }
+}
+
+/* reserve <user_id> <book_id> [tier [YYYYMMDD]]: hold a book with no copy left. */
+static CommandResult cmd_reserve(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned user_id, book_id, tier = 0, date;
+    char *user_arg = strtok_r(args, " ", &save);
+    char *book_arg = strtok_r(NULL, " ", &save);
+    char *tier_arg = strtok_r(NULL, " ", &save);
+    char *date_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(user_arg, &user_id) != 0 || parse_unsigned(book_arg, &book_id) != 0 ||
+        (tier_arg && (parse_unsigned(tier_arg, &tier) != 0 || tier > RESERVATION_TIER_MAX)) ||
+        parse_date_or_today(date_arg, &date) != 0)
+    {
+        command_printf(out, "ERR usage: reserve <user_id> <book_id> [tier 0-%d [YYYYMMDD]]\n",
+                       RESERVATION_TIER_MAX);
+        return COMMAND_ERROR;
+    }
+
+    switch (db_reserve(db, user_id, book_id, tier, date))
+    {
+    case DB_CIRC_OK:
+        command_printf(out, "OK\n");
+        return COMMAND_OK;
+    case DB_CIRC_NO_USER:
+        command_printf(out, "ERR user %u not found\n", user_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_NO_BOOK:
+        command_printf(out, "ERR book %u not found\n", book_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_AVAILABLE:
+        command_printf(out, "ERR book %u has copies available\n", book_id);
+        return COMMAND_ERROR;
+    case DB_CIRC_RESERVED:
+        command_printf(out, "ERR user %u already reserved book %u\n", user_id, book_id);
+        return COMMAND_ERROR;
+    default:
+        command_printf(out, "ERR could not reserve\n");
+        return COMMAND_ERROR;
+    }
+}
+
+static CommandResult cmd_cancel_reservation(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned user_id, book_id;
+    char *user_arg = strtok_r(args, " ", &save);
+    char *book_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(user_arg, &user_id) != 0 || parse_unsigned(book_arg, &book_id) != 0)
+    {
+        command_printf(out, "ERR usage: cancel-reservation <user_id> <book_id>\n");
+        return COMMAND_ERROR;
+    }
+
+    if (db_cancel_reservation(db, user_id, book_id) != DB_CIRC_OK)
+    {
+        command_printf(out, "ERR user %u has no reservation of book %u\n", user_id, book_id);
+        return COMMAND_ERROR;
+    }
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+static int print_reservation(const Reservation *r, void *ctx)
+{
+    struct search_ctx *list = ctx;
+    char csv[256];
+    reservation_to_csv(r, csv, sizeof csv);
+    command_printf(list->out, "reservation %s\n", csv);
+    ++list->count;
+    return 0;
+}
+
+/* reservations <book_id>: the book's holds, in the order they will be served. */
+static CommandResult cmd_reservations(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned book_id;
+    if (parse_unsigned(strtok_r(args, " ", &save), &book_id) != 0)
+    {
+        command_printf(out, "ERR usage: reservations <book_id>\n");
+        return COMMAND_ERROR;
+    }
+
+    struct search_ctx list = { out, 0 };
+    if (db_book_reservations(db, book_id, print_reservation, &list) != 0)
+    {
+        command_printf(out, "ERR could not list reservations\n");
+        return COMMAND_ERROR;
+    }
+    command_printf(out, "OK %u\n", list.count);
+    return COMMAND_OK;
+}
+
+static int print_loan_due(const Loan *l, void *ctx)
+{
+    struct search_ctx *due = ctx;
+    char csv[256];
+    loan_to_csv(l, csv, sizeof csv);
+    command_printf(due->out, "loan %s;%u\n", csv, loan_due_date(l));
+    ++due->count;
+    return 0;
+}
+
+/* overdue [YYYYMMDD]: active loans past their due date on that day. */
+static CommandResult cmd_overdue(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned date;
+    if (parse_date_or_today(strtok_r(args, " ", &save), &date) != 0)
+    {
+        command_printf(out, "ERR usage: overdue [YYYYMMDD]\n");
+        return COMMAND_ERROR;
+    }
+
+    struct search_ctx due = { out, 0 };
+    db_loans_overdue(db, date, print_loan_due, &due);
+    command_printf(out, "OK %u\n", due.count);
+    return COMMAND_OK;
+}
+
+/* due [YYYYMMDD]: active loans due on that day. */
+static CommandResult cmd_due(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned date;
+    if (parse_date_or_today(strtok_r(args, " ", &save), &date) != 0)
+    {
+        command_printf(out, "ERR usage: due [YYYYMMDD]\n");
+        return COMMAND_ERROR;
+    }
+
+    struct search_ctx due = { out, 0 };
+    db_loans_due_on(db, date, print_loan_due, &due);
+    command_printf(out, "OK %u\n", due.count);
+    return COMMAND_OK;
+}
+
+/* totals: the circulation aggregates, read without scanning the tables. */
+static CommandResult cmd_totals(DB *db, char *args, CommandOutput *out)
+{
+    (void)args;
+    DBTotals t;
+    if (db_totals(db, &t) != 0)
+    {
+        command_printf(out, "ERR could not read totals\n");
+        return COMMAND_ERROR;
+    }
+    command_printf(out,
+                   "totals books=%zu users=%zu loans=%zu suggestions=%zu "
+                   "reservations=%zu active_loans=%zu copies_available=%lld\n",
+                   t.books, t.users, t.loans, t.suggestions,
+                   t.reservations, t.loans_active, t.copies_available);
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+/* book-loans <book_id>: how many times the book was lent. */
+static CommandResult cmd_book_loans(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned book_id;
+    if (parse_unsigned(strtok_r(args, " ", &save), &book_id) != 0)
+    {
+        command_printf(out, "ERR usage: book-loans <book_id>\n");
+        return COMMAND_ERROR;
+    }
+    command_printf(out, "OK %u\n", db_book_loans(db, book_id));
+    return COMMAND_OK;
+}
+
+/* check-totals: rebuilds the aggregates with a full scan and compares. */
+static CommandResult cmd_check_totals(DB *db, char *args, CommandOutput *out)
+{
+    (void)args;
+    int rc = db_check_totals(db);
+    if (rc < 0)
+    {
+        command_printf(out, "ERR could not check totals\n");
+        return COMMAND_ERROR;
+    }
+    if (rc > 0)
+    {
+        command_printf(out, "ERR %d counter(s) out of sync\n", rc);
+        return COMMAND_ERROR;
+    }
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+#define COMMAND_TOP_MAX 1000
+
+/*
+    top-books|top-users <k> [from [to]]: the k books/users with the most
+    loans borrowed in the window (YYYYMMDD; no dates = all time), one
+    "top <id>;<loans>" line each, most loans first.
+*/
+static CommandResult run_top(DB *db, char *args, CommandOutput *out, const char *name,
+                             int (*top)(const DB *, size_t, unsigned, unsigned, IdCount *, size_t *))
+{
+    char *save = NULL;
+    unsigned k, from = 0, to = 0;
+    char *k_arg = strtok_r(args, " ", &save);
+    char *from_arg = strtok_r(NULL, " ", &save);
+    char *to_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(k_arg, &k) != 0 || k == 0 || k > COMMAND_TOP_MAX ||
+        (from_arg && parse_date(from_arg, &from) != 0) ||
+        (to_arg && (parse_date(to_arg, &to) != 0 || from > to)))
+    {
+        command_printf(out, "ERR usage: %s <k 1-%d> [YYYYMMDD [YYYYMMDD]]\n", name, COMMAND_TOP_MAX);
+        return COMMAND_ERROR;
+    }
+
+    IdCount entries[COMMAND_TOP_MAX];
+    size_t n;
+    if (top(db, k, from, to, entries, &n) != 0)
+    {
+        command_printf(out, "ERR could not rank loans\n");
+        return COMMAND_ERROR;
+    }
+    for (size_t i = 0; i < n; ++i)
+        command_printf(out, "top %u;%u\n", entries[i].id, entries[i].count);
+    command_printf(out, "OK %zu\n", n);
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_top_books(DB *db, char *args, CommandOutput *out)
+{
+    return run_top(db, args, out, "top-books", db_top_books);
+}
+
+static CommandResult cmd_top_users(DB *db, char *args, CommandOutput *out)
+{
+    return run_top(db, args, out, "top-users", db_top_users);
+}
+
+/* Runs the co-borrowing build on a pool that lives for the duration of the build. */
+static int build_recommendations(DB *db)
+{
+    ThreadPool *pool = thread_pool_create(0);
+    int rc = db_build_recommendations(db, NULL, pool);
+    thread_pool_destroy(pool);
+    return rc;
+}
+
+/* build-recommendations: the periodic co-borrowing job. */
+static CommandResult cmd_build_recommendations(DB *db, char *args, CommandOutput *out)
+{
+    (void)args;
+    int rc = build_recommendations(db);
+
+    if (rc != 0)
+    {
+        command_printf(out, "ERR could not build recommendations\n");
+        return COMMAND_ERROR;
+    }
+    command_printf(out, "OK\n");
+    return COMMAND_OK;
+}
+
+/*
+    recommend <book_id> [n]: "who borrowed this also borrowed", one
+    "recommend <id>;<shared>" line each. The first one builds the
+    recommendations if build-recommendations has not run yet.
+*/
+static CommandResult cmd_recommend(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned book_id, n = RECOMMEND_NEIGHBORS_DEFAULT;
+    char *book_arg = strtok_r(args, " ", &save);
+    char *n_arg = strtok_r(NULL, " ", &save);
+
+    if (parse_unsigned(book_arg, &book_id) != 0 ||
+        (n_arg && (parse_unsigned(n_arg, &n) != 0 || n == 0 || n > RECOMMEND_NEIGHBORS_MAX)))
+    {
+        command_printf(out, "ERR usage: recommend <book_id> [n 1-%d]\n", RECOMMEND_NEIGHBORS_MAX);
+        return COMMAND_ERROR;
+    }
+
+    if (!db_has_recommendations(db) && build_recommendations(db) != 0)
+    {
+        command_printf(out, "ERR could not build recommendations\n");
+        return COMMAND_ERROR;
+    }
+
+    IdCount similar[RECOMMEND_NEIGHBORS_MAX];
+    size_t got;
+    db_recommend_for_book(db, book_id, n, similar, &got);
+    for (size_t i = 0; i < got; ++i)
+        command_printf(out, "recommend %u;%u\n", similar[i].id, similar[i].count);
+    command_printf(out, "OK %zu\n", got);
+    return COMMAND_OK;
+}
+
+#define COMMAND_SIMILAR_MAX 20
+
+/*
+    similar-books|similar-suggestions <min%> <title>: titles at least
+    min% similar (50-100), one "similar <id>;<similarity>;<edits>" line
+    each, most similar first.
+*/
+static CommandResult run_similar(DB *db, char *args, CommandOutput *out, const char *name,
+                                 int (*similar)(const DB *, const char *, unsigned,
+                                                TitleMatch *, size_t, size_t *))
+{
+    char *save = NULL;
+    unsigned min;
+    char *min_arg = strtok_r(args, " ", &save);
+    char *title = strtok_r(NULL, "", &save);
+
+    if (parse_unsigned(min_arg, &min) != 0 || min < TITLE_SIMILARITY_MIN || min > 100 ||
+        !title || !*title)
+    {
+        command_printf(out, "ERR usage: %s <%d-100> <title>\n", name, TITLE_SIMILARITY_MIN);
+        return COMMAND_ERROR;
+    }
+
+    TitleMatch matches[COMMAND_SIMILAR_MAX];
+    size_t n;
+    if (similar(db, title, min, matches, COMMAND_SIMILAR_MAX, &n) != 0)
+    {
+        command_printf(out, "ERR could not compare titles\n");
+        return COMMAND_ERROR;
+    }
+    for (size_t i = 0; i < n; ++i)
+        command_printf(out, "similar %u;%u;%u\n", matches[i].id, matches[i].similarity,
+                       matches[i].distance);
+    command_printf(out, "OK %zu\n", n);
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_similar_books(DB *db, char *args, CommandOutput *out)
+{
+    return run_similar(db, args, out, "similar-books", db_similar_books);
+}
+
+static CommandResult cmd_similar_suggestions(DB *db, char *args, CommandOutput *out)
+{
+    return run_similar(db, args, out, "similar-suggestions", db_similar_suggestions);
+}
+
+#define COMMAND_COMPLETE_MAX 50
+
+/*
+    autocomplete title|author|user <limit> [prefix]: the books (by title
+    or author) or users (by name) whose field starts with prefix, case
+    ignored, one "complete <id>;<field>" line each in lexical order.
+*/
+static CommandResult cmd_autocomplete(DB *db, char *args, CommandOutput *out)
+{
+    char *save = NULL;
+    unsigned limit;
+    char *field_arg = strtok_r(args, " ", &save);
+    char *limit_arg = strtok_r(NULL, " ", &save);
+    char *prefix = strtok_r(NULL, "", &save);
+
+    DBCompleteField field;
+    if (field_arg && strcmp(field_arg, "title") == 0)
+        field = DB_COMPLETE_TITLE;
+    else if (field_arg && strcmp(field_arg, "author") == 0)
+        field = DB_COMPLETE_AUTHOR;
+    else if (field_arg && strcmp(field_arg, "user") == 0)
+        field = DB_COMPLETE_USER_NAME;
+    else
+        field_arg = NULL;
+
+    if (!field_arg || parse_unsigned(limit_arg, &limit) != 0 || limit == 0 ||
+        limit > COMMAND_COMPLETE_MAX)
+    {
+        command_printf(out, "ERR usage: autocomplete title|author|user <1-%d> [prefix]\n",
+                       COMMAND_COMPLETE_MAX);
+        return COMMAND_ERROR;
+    }
+
+    unsigned ids[COMMAND_COMPLETE_MAX];
+    size_t n;
+    if (db_autocomplete(db, field, prefix ? prefix : "", limit, ids, &n) != 0)
+    {
+        command_printf(out, "ERR could not complete\n");
+        return COMMAND_ERROR;
+    }
+
+    /* A record removed since the lookup is left out. */
+    size_t shown = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        Book b;
+        User u;
+        if (field == DB_COMPLETE_USER_NAME)
+        {
+            if (db_copy_user_by_id(db, ids[i], &u) != 0)
+                continue;
+            command_printf(out, "complete %u;%s\n", ids[i], u.name);
+        }
+        else
+        {
+            if (db_copy_book_by_id(db, ids[i], &b) != 0)
+                continue;
+            command_printf(out, "complete %u;%s\n", ids[i],
+                           field == DB_COMPLETE_TITLE ? b.title : b.author);
+        }
+        ++shown;
+    }
+    command_printf(out, "OK %zu\n", shown);
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_help(DB *db, char *args, CommandOutput *out)
+{
+    (void)db;
+    (void)args;
+    command_printf(out,
+                   "lookup <book_id>\n"
+                   "search title|author <term>\n"
+                   "add-book <title>;<author>;<year>;<available>\n"
+                   "edit-book <book_id> [title];[author];[year];[available]\n"
+                   "remove-book|remove-user|remove-loan|remove-suggestion <id>\n"
+                   "add-loan <user_id> <book_id> [YYYYMMDD]\n"
+                   "return-loan <loan_id> [YYYYMMDD]\n"
+                   "due|overdue [YYYYMMDD]\n"
+                   "reserve <user_id> <book_id> [tier [YYYYMMDD]]\n"
+                   "cancel-reservation <user_id> <book_id>\n"
+                   "reservations <book_id>\n"
+                   "totals|check-totals\n"
+                   "book-loans <book_id>\n"
+                   "top-books|top-users <k> [YYYYMMDD [YYYYMMDD]]\n"
+                   "build-recommendations\n"
+                   "recommend <book_id> [n]\n"
+                   "similar-books|similar-suggestions <min%> <title>\n"
+                   "autocomplete title|author|user <limit> [prefix]\n"
+                   "quit\n"
+                   "OK\n");
+    return COMMAND_OK;
+}
+
+static CommandResult cmd_quit(DB *db, char *args, CommandOutput *out)
+{
+    (void)db;
+    (void)args;
+    command_printf(out, "OK bye\n");
+    return COMMAND_QUIT;
+}
+
+typedef struct {
+    const char *name;
+    CommandResult (*run)(DB *db, char *args, CommandOutput *out);
+} CommandEntry;
+
+/* The short names (add, remove, checkout, return) are kept as aliases. */
+static const CommandEntry commands[] = {
+    { "lookup",            cmd_lookup },
+    { "search",            cmd_search },
+    { "add-book",          cmd_add_book },
+    { "add",               cmd_add_book },
+    { "edit-book",         cmd_edit_book },
+    { "remove-book",       cmd_remove_book },
+    { "remove",            cmd_remove_book },
+    { "remove-user",       cmd_remove_user },
+    { "remove-loan",       cmd_remove_loan },
+    { "remove-suggestion", cmd_remove_suggestion },
+    { "add-loan",          cmd_add_loan },
+    { "checkout",          cmd_add_loan },
+    { "return-loan",       cmd_return_loan },
+    { "return",            cmd_return_loan },
+    { "due",               cmd_due },
+    { "overdue",           cmd_overdue },
+    { "reserve",           cmd_reserve },
+    { "cancel-reservation", cmd_cancel_reservation },
+    { "reservations",      cmd_reservations },
+    { "totals",            cmd_totals },
+    { "book-loans",        cmd_book_loans },
+    { "check-totals",      cmd_check_totals },
+    { "top-books",         cmd_top_books },
+    { "top-users",         cmd_top_users },
+    { "build-recommendations", cmd_build_recommendations },
+    { "recommend",         cmd_recommend },
+    { "similar-books",     cmd_similar_books },
+    { "similar-suggestions", cmd_similar_suggestions },
+    { "autocomplete",      cmd_autocomplete },
+    { "help",              cmd_help },
+    { "quit",              cmd_quit },
+};
+
+CommandResult command_execute(DB *db, const char *line, CommandOutput *out)
+{
+    if (!db || !line || !out)
+        return COMMAND_ERROR;
+
+    if (strlen(line) >= COMMAND_LINE_MAX)
+    {
+        command_printf(out, "ERR line too long\n");
+        return COMMAND_ERROR;
+    }
+
+    /* strtok_r needs a writable copy of the line. */
+    char buffer[COMMAND_LINE_MAX];
+    strcpy(buffer, line);
+
+    char *save = NULL;
+    char *name = strtok_r(buffer, " ", &save);
+    char *args = strtok_r(NULL, "", &save);
+    char empty[1] = "";
+    if (!args)
+        args = empty;
+
+    if (!name)
+    {
+        command_printf(out, "ERR empty command\n");
+        return COMMAND_ERROR;
+    }
+
+    for (size_t i = 0; i < sizeof commands / sizeof commands[0]; ++i)
+    {
+        if (strcmp(name, commands[i].name) == 0)
+        {
+            TRACE_SPAN_BEGIN(span);
+            CommandResult rc = commands[i].run(db, args, out);
+            TRACE_SPAN_END(span, "command", commands[i].name);
+            return rc;
+        }
+    }
+
+    command_printf(out, "ERR unknown command '%s'\n", name);
+    return COMMAND_ERROR;
+}
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "app/controller.h"
+
+bool controller_next_page(void)
+{
+    printf("-- Enter para mais, 0 para parar: ");
+    fflush(stdout);
+
+    char line[32];
+    if (!fgets(line, sizeof line, stdin))
+    {
+        printf("\n");
+        return false;
+    }
+
+    /* Descarta o resto de uma linha demasiado longa. */
+    if (!strchr(line, '\n'))
+    {
+        int ch;
+        while ((ch = getchar()) != '\n' && ch != EOF)
+        {
+        }
+    }
+
+    return line[0] != '0' && line[0] != 'q' && line[0] != 'Q';
+}
@@ -1,11 +1,42 @@
 #include <stdio.h>
 
+#include "app/controller.h"
 #include "app/loan_controller.h"
 #include "db/db.h"
 #include "model/loans.h"
 #include "model/user.h"
 #include "model/books.h"
-#include "lib/dlist/dlist.h"
+#include "lib/cutils/cutils.h"
+#include "lib/trace/trace.h"
+
+/*
+    Copia cada emprestimo para um ArrayList. As relacoes (user/livro)
+    so sao resolvidas depois da iteracao, porque um visitor nao pode
+    voltar a chamar a DB enquanto a tabela esta bloqueada.
+*/
+static int collect_loan(const Loan *l, void *ctx)
+{
+    return arraylist_append((ArrayList *)ctx, l) ? 0 : -1;
+}
+
+/* Imprime uma pagina ja copiada, resolvendo user e livro de cada emprestimo. */
+static void print_loans_with_relations(const DB *db, ArrayList *loans)
+{
+    TRACE_SPAN_BEGIN(span);
+    for (size_t i = 0; i < loans->count; ++i) {
+        const Loan *l = arraylist_get(loans, i);
+        User u;
+        Book b;
+        int has_user = db_copy_user_by_id(db, l->user_id, &u) == 0;
+        int has_book = db_copy_book_by_id(db, l->book_id, &b) == 0;
+
+        printf("  id=%u, user_id=%u, book_id=%u, borrow=%u, return=%u\n",
+               l->id, l->user_id, l->book_id, l->date_borrow, l->date_return);
+        printf("    -> user: %s\n", has_user ? u.name : "(nao encontrado)");
+        printf("    -> book: %s\n", has_book ? b.title : "(nao encontrado)");
+    }
+    TRACE_SPAN_END(span, "app", "loan_list_relations");
+}
 
 void loan_list_all(const DB *db)
 {
@@ -14,21 +45,367 @@ void loan_list_all(const DB *db)
         return;
     }
 
-    DList *loans = db_get_loans(db);
-    if (!loans || !loans->head) {
+    ArrayList loans;
+    arraylist_init(&loans, sizeof(Loan));
+
+    /* Reutiliza o mesmo ArrayList em todas as paginas. */
+    size_t total = 0;
+    unsigned after = 0;
+    do {
+        loans.count = 0;
+        int visited = db_loans_page(db, after, CONTROLLER_PAGE_SIZE, collect_loan, &loans, &after);
+        if (visited < 0 || (size_t)visited != loans.count) {
+            printf("[loan] Erro ao ler emprestimos.\n");
+            arraylist_free(&loans);
+            return;
+        }
+
+        if (total == 0 && loans.count > 0)
+            printf("[loan] Lista de emprestimos (com relacoes):\n");
+        print_loans_with_relations(db, &loans);
+        total += loans.count;
+    } while (after != 0 && controller_next_page());
+
+    if (total == 0)
         printf("[loan] Nao existem emprestimos registados.\n");
+
+    arraylist_free(&loans);
+}
+
+static void clear_input_buffer(void)
+{
+    int ch;
+    while ((ch = getchar()) != '\n' && ch != EOF)
+    {
+        /* discard */
+    }
+}
+
+/*
+    Contagens feitas pelo column store da DB (db_loans_count), sem
+    percorrer a lista de emprestimos.
+*/
+void loan_circulation_report(const DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
         return;
     }
 
-    printf("[loan] Lista de emprestimos (com relacoes):\n");
-    DLIST_FOREACH(loans, node) {
-        Loan *l = (Loan *)node->data;
-        User *u = db_find_user_by_id(db, l->user_id);
-        Book *b = db_find_book_by_id(db, l->book_id);
+    unsigned cutoff;
+    printf("\n--- RELATORIO DE CIRCULACAO ---\n");
+    printf("Data de referencia (AAAAMMDD): ");
+    if (scanf("%u", &cutoff) != 1 || cutoff == 0) {
+        printf("Data invalida.\n");
+        clear_input_buffer();
+        return;
+    }
+    clear_input_buffer();
 
-        printf("  id=%u, user_id=%u, book_id=%u, borrow=%u, return=%u\n",
-               l->id, l->user_id, l->book_id, l->date_borrow, l->date_return);
-        printf("    -> user: %s\n", u ? u->name : "(nao encontrado)");
-        printf("    -> book: %s\n", b ? b->title : "(nao encontrado)");
+    LoanFilter all = { 0 };
+    LoanFilter active = { .active_only = true };
+    LoanFilter before = { .borrow_to = cutoff - 1, .active_only = true };
+    size_t total, out, old, returned;
+    uint64_t days;
+
+    TRACE_SPAN_BEGIN(span);
+    int rc = 0;
+    if (db_loans_count(db, &all, &total) != 0 || db_loans_count(db, &active, &out) != 0 ||
+        db_loans_count(db, &before, &old) != 0 || db_loans_days_out(db, &all, &returned, &days) != 0)
+        rc = -1;
+    TRACE_SPAN_END(span, "app", "loan_circulation_report");
+
+    if (rc != 0) {
+        printf("[loan] Erro ao contar emprestimos.\n");
+        return;
+    }
+
+    printf("  Emprestimos registados: %zu\n", total);
+    printf("  Por devolver: %zu\n", out);
+    printf("  Por devolver, emprestados antes de %u: %zu\n", cutoff, old);
+    if (returned > 0)
+        printf("  Duracao media dos devolvidos: %.1f dias\n", (double)days / (double)returned);
+}
+
+/*
+    Emprestimos por devolver cujo prazo (LOAN_PERIOD_DAYS dias) ja
+    passou na data indicada, lidos da roda de prazos da DB.
+*/
+void loan_list_overdue(DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned today;
+    printf("\n--- EMPRESTIMOS EM ATRASO ---\n");
+    printf("Data de referencia (AAAAMMDD): ");
+    if (scanf("%u", &today) != 1 || today == 0) {
+        printf("Data invalida.\n");
+        clear_input_buffer();
+        return;
+    }
+    clear_input_buffer();
+
+    ArrayList loans;
+    arraylist_init(&loans, sizeof(Loan));
+
+    if (db_loans_overdue(db, today, collect_loan, &loans) != 0) {
+        printf("[loan] Erro ao ler emprestimos.\n");
+        arraylist_free(&loans);
+        return;
+    }
+
+    if (loans.count == 0)
+        printf("[loan] Nao existem emprestimos em atraso.\n");
+    else {
+        print_loans_with_relations(db, &loans);
+        printf("[loan] %zu emprestimo(s) em atraso.\n", loans.count);
+    }
+
+    arraylist_free(&loans);
+}
+
+/* Le um numero depois de mostrar o prompt; devolve 0 se for valido. */
+static int read_unsigned(const char *prompt, unsigned *value)
+{
+    printf("%s", prompt);
+    int ok = scanf("%u", value) == 1;
+    clear_input_buffer();
+    return ok ? 0 : -1;
+}
+
+/* Data pedida ao utilizador; 0 significa hoje. Recusa dias que nao existem (20240231). */
+static int read_date(unsigned *date)
+{
+    if (read_unsigned("Data (AAAAMMDD, 0 = hoje): ", date) != 0)
+        return -1;
+    if (*date == 0)
+        *date = date_to_yyyymmdd(date_today());
+    return date_to_yyyymmdd(date_from_yyyymmdd(*date)) == *date ? 0 : -1;
+}
+
+/* Empresta um exemplar: cria o emprestimo e atualiza o stock numa so operacao da DB. */
+void loan_checkout(DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned user_id, book_id, date, loan_id;
+    printf("\n--- REGISTAR EMPRESTIMO ---\n");
+    if (read_unsigned("ID do utilizador: ", &user_id) != 0 ||
+        read_unsigned("ID do livro: ", &book_id) != 0 || read_date(&date) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    switch (db_checkout(db, user_id, book_id, date, &loan_id)) {
+    case DB_CIRC_OK:
+        printf("[loan] Emprestimo %u registado (devolver ate %u).\n", loan_id,
+               date_to_yyyymmdd(date_from_yyyymmdd(date) + LOAN_PERIOD_DAYS));
+        break;
+    case DB_CIRC_NO_USER:
+        printf("[loan] Utilizador %u nao encontrado.\n", user_id);
+        break;
+    case DB_CIRC_NO_BOOK:
+        printf("[loan] Livro %u nao encontrado.\n", book_id);
+        break;
+    case DB_CIRC_UNAVAILABLE:
+        printf("[loan] Nao ha exemplares disponiveis do livro %u.\n", book_id);
+        break;
+    default:
+        printf("[loan] Erro ao registar o emprestimo.\n");
+        break;
+    }
+}
+
+/* Regista a devolucao de um emprestimo e repoe o exemplar no stock. */
+void loan_return(DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned loan_id, date;
+    printf("\n--- REGISTAR DEVOLUCAO ---\n");
+    if (read_unsigned("ID do emprestimo: ", &loan_id) != 0 || read_date(&date) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    unsigned handoff;
+    switch (db_return(db, loan_id, date, &handoff)) {
+    case DB_CIRC_OK:
+        printf("[loan] Emprestimo %u devolvido.\n", loan_id);
+        if (handoff)
+            printf("[loan] O exemplar foi emprestado a proxima reserva (emprestimo %u).\n",
+                   handoff);
+        break;
+    case DB_CIRC_NO_LOAN:
+        printf("[loan] Emprestimo %u nao encontrado.\n", loan_id);
+        break;
+    case DB_CIRC_RETURNED:
+        printf("[loan] O emprestimo %u ja foi devolvido.\n", loan_id);
+        break;
+    case DB_CIRC_BEFORE_BORROW:
+        printf("[loan] A data de devolucao e anterior a do emprestimo %u.\n", loan_id);
+        break;
+    default:
+        printf("[loan] Erro ao registar a devolucao.\n");
+        break;
+    }
+}
+
+/* Reserva um livro sem exemplares disponiveis; a fila e servida por nivel de socio e data. */
+void loan_reserve(DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned user_id, book_id, tier, date;
+    printf("\n--- RESERVAR LIVRO ---\n");
+    if (read_unsigned("ID do utilizador: ", &user_id) != 0 ||
+        read_unsigned("ID do livro: ", &book_id) != 0 ||
+        read_unsigned("Nivel de socio (0 = normal, ate 3): ", &tier) != 0 ||
+        tier > RESERVATION_TIER_MAX || read_date(&date) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    switch (db_reserve(db, user_id, book_id, tier, date)) {
+    case DB_CIRC_OK:
+        printf("[loan] Reserva registada.\n");
+        break;
+    case DB_CIRC_NO_USER:
+        printf("[loan] Utilizador %u nao encontrado.\n", user_id);
+        break;
+    case DB_CIRC_NO_BOOK:
+        printf("[loan] Livro %u nao encontrado.\n", book_id);
+        break;
+    case DB_CIRC_AVAILABLE:
+        printf("[loan] O livro %u tem exemplares disponiveis; registe o emprestimo.\n", book_id);
+        break;
+    case DB_CIRC_RESERVED:
+        printf("[loan] O utilizador %u ja reservou o livro %u.\n", user_id, book_id);
+        break;
+    default:
+        printf("[loan] Erro ao registar a reserva.\n");
+        break;
+    }
+}
+
+static int print_reservation(const Reservation *r, void *ctx)
+{
+    unsigned *position = ctx;
+    printf("%3u. Utilizador %-8u nivel %u  pedido em %u\n",
+           ++*position, r->user_id, r->tier, r->date);
+    return 0;
+}
+
+/* Mostra a fila de reservas de um livro pela ordem em que vai ser servida. */
+void loan_list_reservations(const DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned book_id, position = 0;
+    if (read_unsigned("ID do livro: ", &book_id) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    if (db_book_reservations(db, book_id, print_reservation, &position) != 0)
+        printf("[loan] Erro ao ler as reservas.\n");
+    else if (position == 0)
+        printf("[loan] O livro %u nao tem reservas.\n", book_id);
+    else
+        printf("[loan] %u reserva(s) em fila.\n", position);
+}
+
+void loan_cancel_reservation(DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned user_id, book_id;
+    printf("\n--- CANCELAR RESERVA ---\n");
+    if (read_unsigned("ID do utilizador: ", &user_id) != 0 ||
+        read_unsigned("ID do livro: ", &book_id) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    if (db_cancel_reservation(db, user_id, book_id) == DB_CIRC_OK)
+        printf("[loan] Reserva cancelada.\n");
+    else
+        printf("[loan] O utilizador %u nao tem reserva do livro %u.\n", user_id, book_id);
+}
+
+#define LOAN_TOP_MAX 100
+
+/*
+    Rankings feitos pela DB com um heap limitado a k entradas; titulos
+    e nomes so sao resolvidos para as k linhas mostradas.
+*/
+void loan_top_report(const DB *db)
+{
+    if (!db) {
+        printf("[loan] DB invalida.\n");
+        return;
+    }
+
+    unsigned k, from, to;
+    printf("\n--- MAIS EMPRESTADOS ---\n");
+    if (read_unsigned("Quantos (1-100): ", &k) != 0 || k == 0 || k > LOAN_TOP_MAX ||
+        read_unsigned("Desde (AAAAMMDD, 0 = sempre): ", &from) != 0 ||
+        read_unsigned("Ate (AAAAMMDD, 0 = sem limite): ", &to) != 0) {
+        printf("Valor invalido.\n");
+        return;
+    }
+
+    IdCount top[LOAN_TOP_MAX];
+    size_t n;
+
+    TRACE_SPAN_BEGIN(span);
+    int rc = db_top_books(db, k, from, to, top, &n);
+    TRACE_SPAN_END(span, "app", "loan_top_books");
+    if (rc != 0) {
+        printf("[loan] Erro ao calcular o ranking.\n");
+        return;
+    }
+
+    printf("Livros mais emprestados:\n");
+    if (n == 0)
+        printf("  (nenhum emprestimo no periodo)\n");
+    for (size_t i = 0; i < n; ++i) {
+        Book b;
+        int has_book = db_copy_book_by_id(db, top[i].id, &b) == 0;
+        printf("%3zu. %-6u %-40s %u emprestimo(s)\n", i + 1, top[i].id,
+               has_book ? b.title : "(nao encontrado)", top[i].count);
+    }
+
+    if (db_top_users(db, k, from, to, top, &n) != 0) {
+        printf("[loan] Erro ao calcular o ranking.\n");
+        return;
+    }
+
+    printf("Utilizadores mais ativos:\n");
+    if (n == 0)
+        printf("  (nenhum emprestimo no periodo)\n");
+    for (size_t i = 0; i < n; ++i) {
+        User u;
+        int has_user = db_copy_user_by_id(db, top[i].id, &u) == 0;
+        printf("%3zu. %-6u %-40s %u emprestimo(s)\n", i + 1, top[i].id,
+               has_user ? u.name : "(nao encontrado)", top[i].count);
     }
 }
@@ -1,10 +1,55 @@
 #include <stdio.h>
+#include <string.h>
 #include "app/app.h"
 
-int main(void) {
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [--serve <socket> | --batch <ficheiro|->]"
+                    " [--timings | --timings-log <ficheiro>] [--trace <ficheiro.json>]"
+                    " [--record <ficheiro>]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = NULL;
+    const char *batch_path = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--timings") == 0) {
+            app_enable_timings(NULL);
+        } else if (strcmp(argv[i], "--timings-log") == 0 && i + 1 < argc) {
+            app_enable_timings(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (app_enable_tracing(argv[++i]) != 0) {
+                fprintf(stderr, "Nao foi possivel iniciar o trace.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            app_enable_recording(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (socket_path && batch_path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
     printf("A iniciar o sistema...\n");
     app_init();
-    app_run();
+
+    int rc = 0;
+    if (socket_path)
+        rc = app_serve(socket_path) == 0 ? 0 : 1;
+    else if (batch_path)
+        rc = app_batch(batch_path) == 0 ? 0 : 1;
+    else
+        app_run();
+
     app_shutdown();
-    return 0;
+    return rc;
 }
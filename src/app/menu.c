@@ -76,8 +76,68 @@ void menuLivros(DB *db)
 
 void menuEmprestimos(DB *db)
 {
-	printf("\n=== MENU EMPRESTIMOS ===\n");
-	loan_list_all(db);
+	int opcao;
+
+	do
+	{
+		printf("\n=== MENU EMPRESTIMOS ===\n");
+		printf("1. Listar emprestimos\n");
+		printf("2. Relatorio de circulacao\n");
+		printf("3. Emprestimos em atraso\n");
+		printf("4. Registar emprestimo\n");
+		printf("5. Registar devolucao\n");
+		printf("6. Reservar livro\n");
+		printf("7. Fila de reservas de um livro\n");
+		printf("8. Cancelar reserva\n");
+		printf("9. Mais emprestados e utilizadores mais ativos\n");
+		printf("0. Voltar ao menu principal\n");
+		printf("Escolha uma opcao: ");
+
+		if (scanf("%d", &opcao) != 1)
+		{
+			printf("Opcao invalida.\n");
+			opcao = -1;
+		}
+		while (getchar() != '\n')
+			;
+
+		switch (opcao)
+		{
+		case 1:
+			loan_list_all(db);
+			break;
+		case 2:
+			loan_circulation_report(db);
+			break;
+		case 3:
+			loan_list_overdue(db);
+			break;
+		case 4:
+			loan_checkout(db);
+			break;
+		case 5:
+			loan_return(db);
+			break;
+		case 6:
+			loan_reserve(db);
+			break;
+		case 7:
+			loan_list_reservations(db);
+			break;
+		case 8:
+			loan_cancel_reservation(db);
+			break;
+		case 9:
+			loan_top_report(db);
+			break;
+		case 0:
+			printf("A sair do menu de emprestimos.\n");
+			break;
+		default:
+			printf("Opcao invalida. Tente novamente.\n");
+			break;
+		}
+	} while (opcao != 0);
 }
 
 void menuSugestoes(DB *db)
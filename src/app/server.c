@@ -0,0 +1,660 @@
+/* accept4, eventfd and signalfd are Linux extensions. */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+
+#include "app/server.h"
+
+#ifdef __linux__
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "app/command.h"
+#include "lib/dlist/dlist.h"
+#include "lib/trace/trace.h"
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_BACKLOG 64
+
+/* Longest request line a client may send. */
+#define CONN_INPUT_MAX 4096
+
+/*
+    One connected client.
+    Connections live in an intrusive list so shutdown can close them all.
+    A closed connection moves to a second list and is only freed once
+    the current batch of epoll events has been handled, since a later
+    event of the batch may still point at it.
+*/
+typedef struct Conn {
+    int fd;
+    char in[CONN_INPUT_MAX];
+    size_t in_len;
+
+    CommandOutput out;  /* reply bytes not yet written */
+    size_t out_off;
+    uint32_t watched;   /* epoll events currently registered */
+
+    bool busy;          /* a job for this connection is in the pool */
+    bool eof;           /* peer closed its side or sent "quit" */
+    bool dead;          /* socket error: drop everything */
+    bool detached;      /* removed from epoll while a job is in flight */
+    bool closed;        /* socket closed, waiting to be freed */
+
+    struct Conn *prev;
+    struct Conn *next;
+} Conn;
+
+/* A request line travelling from the event loop to a worker and back. */
+typedef struct {
+    Conn *conn;
+    char line[CONN_INPUT_MAX];
+    CommandOutput reply;
+    CommandResult result;
+} Job;
+
+typedef struct {
+    DB *db;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;    /* eventfd: workers -> event loop */
+    int signal_fd;  /* SIGINT / SIGTERM */
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    DList *pending; /* Job* waiting for a worker (FIFO) */
+    DList *done;    /* Job* waiting to be written back (FIFO) */
+    bool stopping;
+
+    pthread_t *workers;
+    unsigned n_workers;
+
+    Conn *conns;
+    Conn *closed;   /* closed during the current batch */
+} Server;
+
+/* ---------------------------------------------------------------
+   Worker pool
+   --------------------------------------------------------------- */
+
+static void *worker_main(void *arg)
+{
+    Server *s = arg;
+    trace_set_thread_name("server worker");
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        while (!s->stopping && dlist_is_empty(s->pending))
+            pthread_cond_wait(&s->work_ready, &s->lock);
+
+        Job *job = dlist_pop_front(s->pending);
+        pthread_mutex_unlock(&s->lock);
+
+        /* Stopping and nothing left to do. */
+        if (!job)
+            break;
+
+        job->result = command_execute(s->db, job->line, &job->reply);
+
+        pthread_mutex_lock(&s->lock);
+        dlist_push_back(s->done, job);
+        pthread_mutex_unlock(&s->lock);
+
+        uint64_t one = 1;
+        ssize_t ignored = write(s->wake_fd, &one, sizeof one);
+        (void)ignored;
+    }
+
+    db_thread_exit(s->db);
+    return NULL;
+}
+
+static int start_workers(Server *s, unsigned n)
+{
+    s->workers = calloc(n, sizeof *s->workers);
+    if (!s->workers)
+        return -1;
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        if (pthread_create(&s->workers[i], NULL, worker_main, s) != 0)
+            break;
+        s->n_workers++;
+    }
+
+    return s->n_workers > 0 ? 0 : -1;
+}
+
+static void stop_workers(Server *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->stopping = true;
+    pthread_cond_broadcast(&s->work_ready);
+    pthread_mutex_unlock(&s->lock);
+
+    for (unsigned i = 0; i < s->n_workers; ++i)
+        pthread_join(s->workers[i], NULL);
+
+    free(s->workers);
+    s->workers = NULL;
+    s->n_workers = 0;
+}
+
+/* ---------------------------------------------------------------
+   Connections
+   --------------------------------------------------------------- */
+
+static void conn_close(Server *s, Conn *c)
+{
+    if (!c->detached)
+        epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        s->conns = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+
+    command_output_free(&c->out);
+    c->closed = true;
+    c->prev = NULL;
+    c->next = s->closed;
+    s->closed = c;
+}
+
+static void free_closed(Server *s)
+{
+    while (s->closed)
+    {
+        Conn *c = s->closed;
+        s->closed = c->next;
+        free(c);
+    }
+}
+
+/*
+    Recomputes the epoll interest set from the connection state.
+    Everything is level-triggered, so we must stop asking for EPOLLIN
+    once the peer is gone or the input buffer is full, otherwise the
+    loop would spin while a job is still running. EPOLLHUP/EPOLLERR are
+    reported whatever the interest set, so a dead socket leaves epoll.
+*/
+static void conn_watch(Server *s, Conn *c)
+{
+    if (c->dead)
+    {
+        if (!c->detached)
+            epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->detached = true;
+        return;
+    }
+
+    uint32_t events = 0;
+    if (!c->eof && c->in_len < sizeof c->in)
+        events |= EPOLLIN | EPOLLRDHUP;
+    if (c->out_off < c->out.len)
+        events |= EPOLLOUT;
+
+    if (events == c->watched)
+        return;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->watched = events;
+}
+
+/* Writes as much pending output as the socket accepts. */
+static void conn_flush(Conn *c)
+{
+    while (!c->dead && c->out_off < c->out.len)
+    {
+        ssize_t n = send(c->fd, c->out.data + c->out_off, c->out.len - c->out_off, MSG_NOSIGNAL);
+        if (n > 0)
+            c->out_off += (size_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else
+            c->dead = true;
+    }
+
+    if (c->out_off >= c->out.len)
+    {
+        command_output_clear(&c->out);
+        c->out_off = 0;
+    }
+}
+
+/* Hands the next complete request line of c to the worker pool. */
+static void conn_dispatch(Server *s, Conn *c)
+{
+    while (!c->busy && !c->dead)
+    {
+        char *nl = memchr(c->in, '\n', c->in_len);
+        if (!nl)
+        {
+            if (c->in_len == sizeof c->in)
+            {
+                command_printf(&c->out, "ERR line too long\n");
+                c->in_len = 0;
+                c->eof = true;
+            }
+            return;
+        }
+
+        size_t line_len = (size_t)(nl - c->in);
+        size_t consumed = line_len + 1;
+        if (line_len > 0 && c->in[line_len - 1] == '\r')
+            --line_len;
+
+        /* Blank lines are just skipped. */
+        if (line_len == 0)
+        {
+            memmove(c->in, c->in + consumed, c->in_len - consumed);
+            c->in_len -= consumed;
+            continue;
+        }
+
+        Job *job = malloc(sizeof *job);
+        if (!job)
+        {
+            command_printf(&c->out, "ERR server out of memory\n");
+            c->eof = true;
+            return;
+        }
+
+        job->conn = c;
+        memcpy(job->line, c->in, line_len);
+        job->line[line_len] = '\0';
+        command_output_init(&job->reply);
+
+        memmove(c->in, c->in + consumed, c->in_len - consumed);
+        c->in_len -= consumed;
+        c->busy = true;
+
+        pthread_mutex_lock(&s->lock);
+        dlist_push_back(s->pending, job);
+        pthread_cond_signal(&s->work_ready);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+/*
+    Closes c once nothing is left to do for it: no job in flight and,
+    unless the socket is broken, every reply written. A busy connection
+    is still re-watched, so a peer that hangs up or half-closes while
+    its job runs does not keep waking the loop.
+*/
+static void conn_maybe_close(Server *s, Conn *c)
+{
+    if (c->busy)
+    {
+        conn_watch(s, c);
+        return;
+    }
+
+    if (c->dead || (c->eof && c->out_off >= c->out.len && !memchr(c->in, '\n', c->in_len)))
+        conn_close(s, c);
+    else
+        conn_watch(s, c);
+}
+
+static void conn_read(Conn *c)
+{
+    while (!c->dead && !c->eof && c->in_len < sizeof c->in)
+    {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof c->in - c->in_len, 0);
+        if (n > 0)
+            c->in_len += (size_t)n;
+        else if (n == 0)
+            c->eof = true;
+        else if (errno == EINTR)
+            continue;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else
+            c->dead = true;
+    }
+}
+
+static void accept_clients(Server *s)
+{
+    for (;;)
+    {
+        int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return; /* EAGAIN: no more pending connections */
+
+        Conn *c = calloc(1, sizeof *c);
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->watched = EPOLLIN | EPOLLRDHUP;
+        command_output_init(&c->out);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = c;
+        if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            free(c);
+            continue;
+        }
+
+        c->next = s->conns;
+        if (s->conns)
+            s->conns->prev = c;
+        s->conns = c;
+    }
+}
+
+/* Moves finished jobs back onto their connections. */
+static void collect_replies(Server *s)
+{
+    uint64_t count;
+    ssize_t ignored = read(s->wake_fd, &count, sizeof count);
+    (void)ignored;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        Job *job = dlist_pop_front(s->done);
+        pthread_mutex_unlock(&s->lock);
+
+        if (!job)
+            break;
+
+        Conn *c = job->conn;
+        c->busy = false;
+
+        if (job->reply.len > 0)
+            command_printf(&c->out, "%s", job->reply.data);
+        if (job->result == COMMAND_QUIT)
+        {
+            /* Lines sent after "quit" are discarded. */
+            c->eof = true;
+            c->in_len = 0;
+        }
+
+        command_output_free(&job->reply);
+        free(job);
+
+        /* A half-closed peer still gets replies to the lines it sent. */
+        conn_dispatch(s, c);
+        conn_flush(c);
+        conn_maybe_close(s, c);
+    }
+}
+
+/* ---------------------------------------------------------------
+   Setup / teardown
+   --------------------------------------------------------------- */
+
+/*
+    Makes way for bind. A socket file left by a previous run is
+    removed, but only once a connect shows nobody is listening on it:
+    anything else at path (a data file, a live server's socket) is
+    left alone and reported. Returns 0 when path is free.
+*/
+static int clear_stale_socket(const char *path, const struct sockaddr_un *addr)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0)
+        return errno == ENOENT ? 0 : -1;
+
+    if (!S_ISSOCK(st.st_mode))
+    {
+        fprintf(stderr, "[server] %s ja existe e nao e um socket.\n", path);
+        return -1;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+        return -1;
+    /* A full backlog (EAGAIN) also means someone is listening. */
+    bool live = connect(probe, (const struct sockaddr *)addr, sizeof *addr) == 0 ||
+                errno == EAGAIN;
+    close(probe);
+
+    if (live)
+    {
+        fprintf(stderr, "[server] Ja ha um servidor a escutar em %s.\n", path);
+        return -1;
+    }
+    return unlink(path);
+}
+
+static int open_listener(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof addr.sun_path)
+    {
+        fprintf(stderr, "[server] Caminho do socket demasiado longo: %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (clear_stale_socket(path, &addr) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(fd, SERVER_BACKLOG) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int watch_fd(int epoll_fd, int fd, void *tag)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void server_cleanup(Server *s, const char *socket_path)
+{
+    while (s->conns)
+        conn_close(s, s->conns);
+    free_closed(s);
+
+    if (s->pending)
+    {
+        Job *job;
+        while ((job = dlist_pop_front(s->pending)) != NULL)
+        {
+            command_output_free(&job->reply);
+            free(job);
+        }
+        dlist_destroy(s->pending, NULL);
+    }
+    if (s->done)
+    {
+        Job *job;
+        while ((job = dlist_pop_front(s->done)) != NULL)
+        {
+            command_output_free(&job->reply);
+            free(job);
+        }
+        dlist_destroy(s->done, NULL);
+    }
+
+    if (s->listen_fd >= 0)
+    {
+        close(s->listen_fd);
+        unlink(socket_path);
+    }
+    if (s->epoll_fd >= 0)
+        close(s->epoll_fd);
+    if (s->wake_fd >= 0)
+        close(s->wake_fd);
+    if (s->signal_fd >= 0)
+        close(s->signal_fd);
+
+    pthread_cond_destroy(&s->work_ready);
+    pthread_mutex_destroy(&s->lock);
+}
+
+int server_run(DB *db, const char *socket_path, unsigned workers)
+{
+    if (!db || !socket_path)
+        return -1;
+
+    if (workers == 0)
+        workers = SERVER_DEFAULT_WORKERS;
+
+    Server s;
+    memset(&s, 0, sizeof s);
+    s.db = db;
+    s.listen_fd = s.epoll_fd = s.wake_fd = s.signal_fd = -1;
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.work_ready, NULL);
+
+    /*
+        SIGINT/SIGTERM are blocked in every thread (workers inherit the
+        mask) and delivered through a signalfd watched by the loop.
+    */
+    sigset_t stop_signals, old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+
+    s.pending = dlist_create(false, NULL);
+    s.done = dlist_create(false, NULL);
+    s.listen_fd = open_listener(socket_path);
+    s.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    s.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    s.signal_fd = signalfd(-1, &stop_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if (!s.pending || !s.done || s.listen_fd < 0 || s.epoll_fd < 0 || s.wake_fd < 0 ||
+        s.signal_fd < 0 ||
+        watch_fd(s.epoll_fd, s.listen_fd, &s.listen_fd) != 0 ||
+        watch_fd(s.epoll_fd, s.wake_fd, &s.wake_fd) != 0 ||
+        watch_fd(s.epoll_fd, s.signal_fd, &s.signal_fd) != 0 ||
+        start_workers(&s, workers) != 0)
+    {
+        fprintf(stderr, "[server] Nao foi possivel iniciar o servidor em %s.\n", socket_path);
+        stop_workers(&s);
+        server_cleanup(&s, socket_path);
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+        return -1;
+    }
+
+    printf("[server] A escutar em %s com %u workers (Ctrl+C para terminar).\n",
+           socket_path, s.n_workers);
+
+    bool running = true;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+
+    while (running)
+    {
+        int n = epoll_wait(s.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            void *tag = events[i].data.ptr;
+
+            if (tag == &s.listen_fd)
+            {
+                accept_clients(&s);
+            }
+            else if (tag == &s.wake_fd)
+            {
+                collect_replies(&s);
+            }
+            else if (tag == &s.signal_fd)
+            {
+                /* Consume it, or it kills us once the old mask is restored. */
+                struct signalfd_siginfo info;
+                while (read(s.signal_fd, &info, sizeof info) == (ssize_t)sizeof info) {}
+                running = false;
+            }
+            else
+            {
+                Conn *c = tag;
+                uint32_t ev = events[i].events;
+                if (c->closed)
+                    continue;
+
+                if (ev & (EPOLLERR | EPOLLHUP))
+                    c->dead = true;
+                if (ev & (EPOLLIN | EPOLLRDHUP))
+                    conn_read(c);
+                if (ev & EPOLLOUT)
+                    conn_flush(c);
+
+                conn_dispatch(&s, c);
+                conn_flush(c);
+                conn_maybe_close(&s, c);
+            }
+        }
+
+        free_closed(&s);
+    }
+
+    printf("[server] A terminar...\n");
+
+    /* Workers finish the jobs already queued; the replies are dropped. */
+    stop_workers(&s);
+    server_cleanup(&s, socket_path);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    return 0;
+}
+
+#else /* !__linux__ */
+
+int server_run(DB *db, const char *socket_path, unsigned workers)
+{
+    (void)db;
+    (void)socket_path;
+    (void)workers;
+    fprintf(stderr, "[server] Modo servidor so esta disponivel em Linux.\n");
+    return -1;
+}
+
+#endif
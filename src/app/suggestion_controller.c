@@ -2,10 +2,11 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "app/controller.h"
 #include "app/suggestion_controller.h"
 #include "model/suggestion.h"
 #include "model/books.h"
-#include "lib/dlist/dlist.h"
+#include "lib/trace/trace.h"
 
 static void read_line(char *buffer, size_t size)
 {
@@ -22,23 +23,6 @@ static void read_line(char *buffer, size_t size)
     }
 }
 
-static unsigned next_suggestion_id(const DB *db)
-{
-    unsigned max_id = 0;
-    DList *suggestions = db_get_suggestions(db);
-    if (!suggestions)
-        return 1;
-
-    DLIST_FOREACH(suggestions, node)
-    {
-        Suggestion *s = (Suggestion *)node->data;
-        if (s->id > max_id)
-            max_id = s->id;
-    }
-
-    return max_id + 1;
-}
-
 static int strings_equal_ci(const char *a, const char *b)
 {
     size_t i = 0;
@@ -53,6 +37,71 @@ static int strings_equal_ci(const char *a, const char *b)
     return a[i] == b[i];
 }
 
+/* Campos da sugestao nova, comparados com livros e sugestoes existentes. */
+struct suggestion_match {
+    const char *title;
+    const char *author;
+    const char *isbn;
+};
+
+static int book_matches(const Book *b, void *ctx)
+{
+    const struct suggestion_match *m = ctx;
+    return strings_equal_ci(b->title, m->title) && strings_equal_ci(b->author, m->author);
+}
+
+static int suggestion_matches(const Suggestion *s, void *ctx)
+{
+    const struct suggestion_match *m = ctx;
+    return strings_equal_ci(s->title, m->title) && strings_equal_ci(s->author, m->author) &&
+           strings_equal_ci(s->isbn, m->isbn);
+}
+
+/* Titulos parecidos a partir desta semelhanca (%) sao mostrados antes de registar. */
+#define SUGGESTION_SIMILARITY_MIN 80
+#define SUGGESTION_SIMILAR_SHOWN 5
+
+/*
+    Lista os livros e sugestoes com titulo parecido (erros de escrita,
+    pontuacao, maiusculas). Devolve quantos foram mostrados.
+*/
+static size_t print_similar_titles(const DB *db, const char *title)
+{
+    TitleMatch matches[SUGGESTION_SIMILAR_SHOWN];
+    size_t n = 0, shown = 0;
+
+    if (db_similar_books(db, title, SUGGESTION_SIMILARITY_MIN, matches,
+                         SUGGESTION_SIMILAR_SHOWN, &n) == 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            Book b;
+            if (db_copy_book_by_id(db, matches[i].id, &b) != 0)
+                continue;
+            if (shown++ == 0)
+                printf("[sugestoes] Titulos parecidos:\n");
+            printf("  livro id=%u, titulo=%s, autor=%s (%u%% semelhante)\n",
+                   b.id, b.title, b.author, matches[i].similarity);
+        }
+    }
+
+    if (db_similar_suggestions(db, title, SUGGESTION_SIMILARITY_MIN, matches,
+                               SUGGESTION_SIMILAR_SHOWN, &n) == 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            Suggestion s;
+            if (db_copy_suggestion_by_id(db, matches[i].id, &s) != 0)
+                continue;
+            if (shown++ == 0)
+                printf("[sugestoes] Titulos parecidos:\n");
+            printf("  sugestao id=%u, titulo=%s, autor=%s (%u%% semelhante)\n",
+                   s.id, s.title, s.author, matches[i].similarity);
+        }
+    }
+    return shown;
+}
+
 void suggestion_register(DB *db)
 {
     if (!db)
@@ -86,43 +135,52 @@ void suggestion_register(DB *db)
     printf("ISBN (opcional, pressione Enter para saltar): ");
     read_line(isbn, sizeof isbn);
 
-    DList *books = db_get_books(db);
-    if (books)
+    struct suggestion_match match = { title, author, isbn };
+
+    if (db_foreach_book(db, book_matches, &match) > 0)
     {
-        DLIST_FOREACH(books, node)
-        {
-            Book *b = (Book *)node->data;
-            if (strings_equal_ci(b->title, title) && strings_equal_ci(b->author, author))
-            {
-                printf("[sugestoes] Este livro ja existe na biblioteca.\n");
-                return;
-            }
-        }
+        printf("[sugestoes] Este livro ja existe na biblioteca.\n");
+        return;
+    }
+
+    if (db_foreach_suggestion(db, suggestion_matches, &match) > 0)
+    {
+        printf("[sugestoes] Ja existe uma sugestao identica registada.\n");
+        return;
     }
 
-    DList *suggestions = db_get_suggestions(db);
-    if (suggestions)
+    if (print_similar_titles(db, title) > 0)
     {
-        DLIST_FOREACH(suggestions, node)
+        char answer[8];
+        printf("Registar mesmo assim? (s/n): ");
+        read_line(answer, sizeof answer);
+        if (tolower((unsigned char)answer[0]) != 's')
         {
-            Suggestion *s = (Suggestion *)node->data;
-            if (strings_equal_ci(s->title, title) && strings_equal_ci(s->author, author) && strings_equal_ci(s->isbn, isbn))
-            {
-                printf("[sugestoes] Ja existe uma sugestao identica registada.\n");
-                return;
-            }
+            printf("[sugestoes] Sugestao nao registada.\n");
+            return;
         }
     }
 
     Suggestion new_suggestion;
-    suggestion_init(&new_suggestion, next_suggestion_id(db), title, author, isbn);
+    suggestion_init(&new_suggestion, 0, title, author, isbn);
 
-    if (db_add_suggestion(db, &new_suggestion) == 0)
+    if (db_add_suggestion_auto(db, &new_suggestion) == 0)
         printf("[sugestoes] Sugestao registada com sucesso (id=%u).\n", new_suggestion.id);
     else
         printf("[sugestoes] Erro ao guardar sugestao.\n");
 }
 
+static int print_suggestion_visitor(const Suggestion *s, void *ctx)
+{
+    int *count = ctx;
+    if (*count == 0)
+        printf("[sugestoes] Lista de sugestoes:\n");
+    printf("  id=%u, titulo=%s, autor=%s, isbn=%s\n",
+           s->id, s->title, s->author, s->isbn[0] ? s->isbn : "(n/d)");
+    ++*count;
+    return 0;
+}
+
 void suggestion_list_all(const DB *db)
 {
     if (!db)
@@ -131,18 +189,16 @@ void suggestion_list_all(const DB *db)
         return;
     }
 
-    DList *suggestions = db_get_suggestions(db);
-    if (!suggestions || !suggestions->head)
+    int count = 0;
+    unsigned after = 0;
+    do
     {
-        printf("[sugestoes] Nao existem sugestoes registadas.\n");
-        return;
-    }
+        TRACE_SPAN_BEGIN(span);
+        db_suggestions_page(db, after, CONTROLLER_PAGE_SIZE, print_suggestion_visitor,
+                            &count, &after);
+        TRACE_SPAN_END(span, "app", "suggestion_list_page");
+    } while (after != 0 && controller_next_page());
 
-    printf("[sugestoes] Lista de sugestoes:\n");
-    DLIST_FOREACH(suggestions, node)
-    {
-        Suggestion *s = (Suggestion *)node->data;
-        printf("  id=%u, titulo=%s, autor=%s, isbn=%s\n",
-               s->id, s->title, s->author, s->isbn[0] ? s->isbn : "(n/d)");
-    }
+    if (count == 0)
+        printf("[sugestoes] Nao existem sugestoes registadas.\n");
 }
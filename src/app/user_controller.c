@@ -1,9 +1,20 @@
 #include <stdio.h>
 
+#include "app/controller.h"
 #include "app/user_controller.h"
 #include "db/db.h"
 #include "model/user.h"
-#include "lib/dlist/dlist.h"
+#include "lib/trace/trace.h"
+
+static int print_user_visitor(const User *u, void *ctx)
+{
+    int *count = ctx;
+    if (*count == 0)
+        printf("[user] Lista de utilizadores:\n");
+    printf("  id=%u, nome=%s, email=%s\n", u->id, u->name, u->email);
+    ++*count;
+    return 0;
+}
 
 void user_list_all(const DB *db)
 {
@@ -12,15 +23,14 @@ void user_list_all(const DB *db)
         return;
     }
 
-    DList *users = db_get_users(db);
-    if (!users || !users->head) {
-        printf("[user] Nao existem utilizadores registados.\n");
-        return;
-    }
+    int count = 0;
+    unsigned after = 0;
+    do {
+        TRACE_SPAN_BEGIN(span);
+        db_users_page(db, after, CONTROLLER_PAGE_SIZE, print_user_visitor, &count, &after);
+        TRACE_SPAN_END(span, "app", "user_list_page");
+    } while (after != 0 && controller_next_page());
 
-    printf("[user] Lista de utilizadores:\n");
-    DLIST_FOREACH(users, node) {
-        User *u = (User *)node->data;
-        printf("  id=%u, nome=%s, email=%s\n", u->id, u->name, u->email);
-    }
+    if (count == 0)
+        printf("[user] Nao existem utilizadores registados.\n");
 }
@@ -0,0 +1,1012 @@
+/*
+    Benchmarks for the fs and DB layers (make bench).
+
+    For every dataset size the benchmark:
+      1. writes a synthetic dataset with tools/datagen;
+      2. times the fs loaders/savers and db_init/db_save on it;
+      3. times lookups, add/remove, title search, a full loan
+         listing (the same work the loans menu does) and the
+         circulation report filter, list walk vs column scan;
+      4. runs 1, 2, 4 and 8 lock-free readers against one writer
+         that keeps replacing books, to see how reads scale.
+
+    Each operation is timed individually, so besides ops/sec we get
+    latency percentiles. Peak RSS is the process high-water mark
+    after each size (it only grows, sizes run smallest first).
+
+    Uso:
+      bench [--sizes 1000,10000,...] [--json <ficheiro>] [--dir <dir>]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "cutils.h"
+#include "db/db.h"
+#include "fs/books_file.h"
+#include "fs/loans_file.h"
+#include "lib/cutils/thread_pool.h"
+#include "tools/datagen.h"
+
+#define MAX_SIZES 16
+
+/* Upper bounds on how many timed operations one benchmark runs. */
+#define POINT_OPS 200000
+#define MUTATION_OPS 20000
+
+/* Lookups each reader thread does in the scaling run. */
+#define READER_OPS 50000
+#define MAX_READERS 8
+
+typedef struct {
+    char name[48];
+    size_t ops;          /* timed operations */
+    size_t items;        /* rows processed in total (ops for point operations) */
+    uint64_t total_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} BenchResult;
+
+typedef struct {
+    unsigned rows;       /* number of books; other tables scale from it */
+    long peak_rss_kb;
+    ArrayList results;   /* BenchResult */
+} BenchSize;
+
+/* Per-operation latencies of the benchmark being run. */
+typedef struct {
+    uint64_t *ns;
+    size_t count;
+} Samples;
+
+/* ---------------------------------------------------------------
+   Helpers
+   --------------------------------------------------------------- */
+
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+static unsigned rand_below(unsigned n)
+{
+    /* xorshift64: cheap enough not to disturb the timings */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned)(rng_state % n);
+}
+
+static long peak_rss_kb(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; /* bytes on macOS */
+#else
+    return usage.ru_maxrss;        /* kilobytes on Linux */
+#endif
+#endif
+}
+
+static int ensure_directory(const char *path)
+{
+#ifdef _WIN32
+    if (_mkdir(path) == 0)
+        return 0;
+#else
+    if (mkdir(path, 0777) == 0)
+        return 0;
+#endif
+    return errno == EEXIST ? 0 : -1;
+}
+
+static int samples_init(Samples *s, size_t capacity)
+{
+    s->ns = malloc((capacity ? capacity : 1) * sizeof *s->ns);
+    s->count = 0;
+    return s->ns ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    size_t at = (size_t)(p * (double)(n - 1) + 0.5);
+    return sorted[at];
+}
+
+/*
+    Turns the samples into a result row and frees them. Throughput is
+    taken over total_ns, which is the sum of the samples unless the
+    operations overlapped in time (threads: pass the wall time).
+*/
+static void record_total(BenchSize *size, const char *name, Samples *s, size_t items, uint64_t total_ns)
+{
+    BenchResult r;
+    memset(&r, 0, sizeof r);
+    snprintf(r.name, sizeof r.name, "%s", name);
+    r.ops = s->count;
+    r.items = items;
+    r.total_ns = total_ns;
+
+    qsort(s->ns, s->count, sizeof *s->ns, cmp_u64);
+    r.p50_ns = percentile(s->ns, s->count, 0.50);
+    r.p90_ns = percentile(s->ns, s->count, 0.90);
+    r.p99_ns = percentile(s->ns, s->count, 0.99);
+    r.max_ns = s->count ? s->ns[s->count - 1] : 0;
+
+    free(s->ns);
+    s->ns = NULL;
+    s->count = 0;
+
+    arraylist_append(&size->results, &r);
+
+    double secs = (double)r.total_ns / 1e9;
+    printf("  %-26s %9zu ops %12.0f ops/s %12.0f items/s  p50 %9.0f ns  p99 %10.0f ns\n",
+           r.name, r.ops,
+           secs > 0 ? (double)r.ops / secs : 0.0,
+           secs > 0 ? (double)r.items / secs : 0.0,
+           (double)r.p50_ns, (double)r.p99_ns);
+}
+
+static void record(BenchSize *size, const char *name, Samples *s, size_t items)
+{
+    uint64_t total_ns = 0;
+    for (size_t i = 0; i < s->count; ++i)
+        total_ns += s->ns[i];
+    record_total(size, name, s, items, total_ns);
+}
+
+/* Times one call of a statement into the sample buffer. */
+#define TIMED(samples, stmt)                                      \
+    do {                                                          \
+        uint64_t t0_ = cutils_now_ns();                           \
+        stmt;                                                     \
+        (samples)->ns[(samples)->count++] = cutils_now_ns() - t0_; \
+    } while (0)
+
+static size_t clamp_ops(size_t wanted, size_t lo, size_t hi)
+{
+    return wanted < lo ? lo : (wanted > hi ? hi : wanted);
+}
+
+/* ---------------------------------------------------------------
+   Benchmarks
+   --------------------------------------------------------------- */
+
+struct data_paths {
+    char books[512];
+    char users[512];
+    char loans[512];
+    char suggestions[512];
+};
+
+static void make_paths(struct data_paths *p, const char *dir, const char *suffix)
+{
+    snprintf(p->books, sizeof p->books, "%s/books%s.txt", dir, suffix);
+    snprintf(p->users, sizeof p->users, "%s/users%s.txt", dir, suffix);
+    snprintf(p->loans, sizeof p->loans, "%s/loans%s.txt", dir, suffix);
+    snprintf(p->suggestions, sizeof p->suggestions, "%s/suggestions%s.txt", dir, suffix);
+}
+
+static void bench_fs(BenchSize *size, const struct data_paths *in, const struct data_paths *out)
+{
+    Samples s;
+    DList *books = NULL;
+    DList *loans = NULL;
+
+    samples_init(&s, 1);
+    TIMED(&s, books = file_load_books(in->books));
+    record(size, "fs_load_books", &s, books ? dlist_size(books) : 0);
+
+    samples_init(&s, 1);
+    TIMED(&s, file_save_books(out->books, books));
+    record(size, "fs_save_books", &s, books ? dlist_size(books) : 0);
+
+    samples_init(&s, 1);
+    TIMED(&s, loans = file_load_loans(in->loans));
+    record(size, "fs_load_loans", &s, loans ? dlist_size(loans) : 0);
+
+    samples_init(&s, 1);
+    TIMED(&s, file_save_loans(out->loans, loans));
+    record(size, "fs_save_loans", &s, loans ? dlist_size(loans) : 0);
+
+    dlist_destroy(books, free);
+    dlist_destroy(loans, free);
+}
+
+static size_t total_rows(const DB *db)
+{
+    return dlist_size(db->books) + dlist_size(db->users) +
+           dlist_size(db->loans) + dlist_size(db->suggestions);
+}
+
+static void bench_lookups(BenchSize *size, const DB *db, unsigned books, unsigned loans)
+{
+    Samples s;
+    volatile const void *sink = NULL;
+
+    samples_init(&s, POINT_OPS);
+    for (size_t i = 0; i < POINT_OPS; ++i)
+    {
+        unsigned id = rand_below(books) + 1;
+        TIMED(&s, sink = db_find_book_by_id(db, id));
+    }
+    record(size, "db_find_book_by_id", &s, POINT_OPS);
+
+    samples_init(&s, POINT_OPS);
+    for (size_t i = 0; i < POINT_OPS; ++i)
+    {
+        unsigned id = rand_below(loans) + 1;
+        TIMED(&s, sink = db_find_loan_by_id(db, id));
+    }
+    record(size, "db_find_loan_by_id", &s, POINT_OPS);
+
+    /* Misses walk the probe sequence to its end. */
+    samples_init(&s, POINT_OPS);
+    for (size_t i = 0; i < POINT_OPS; ++i)
+    {
+        unsigned id = books + 1 + rand_below(books);
+        TIMED(&s, sink = db_find_book_by_id(db, id));
+    }
+    record(size, "db_find_book_by_id_miss", &s, POINT_OPS);
+
+    (void)sink;
+}
+
+struct reader_args {
+    const DB *db;
+    unsigned books;
+    uint64_t seed;
+    Samples samples;
+};
+
+static void *scaling_reader(void *p)
+{
+    struct reader_args *a = p;
+    uint64_t x = a->seed;
+    Book copy;
+
+    for (size_t i = 0; i < READER_OPS; ++i)
+    {
+        /* Own xorshift: rand_below's state is not thread-safe. */
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        unsigned id = (unsigned)(x % a->books) + 1;
+        TIMED(&a->samples, db_copy_book_by_id(a->db, id, &copy));
+    }
+    return NULL;
+}
+
+struct churn_args {
+    DB *db;
+    unsigned books;
+    atomic_bool stop;
+    unsigned long updates;
+};
+
+/* Keeps replacing books, so readers race with records being retired. */
+static void *churn_writer(void *p)
+{
+    struct churn_args *a = p;
+    Book b;
+
+    for (unsigned id = 1; !atomic_load(&a->stop); id = id % a->books + 1)
+        if (db_copy_book_by_id(a->db, id, &b) == 0 && db_update_book(a->db, &b) == 0)
+            ++a->updates;
+    return NULL;
+}
+
+/*
+    Lock-free lookups by 1, 2, 4 and 8 reader threads at once while a
+    writer replaces books. Every reader does the same amount of work,
+    so with linear scaling the wall time stays flat and ops/sec grows
+    with the thread count (up to the number of cores).
+*/
+static void bench_reader_scaling(BenchSize *size, DB *db, unsigned books)
+{
+    struct reader_args readers[MAX_READERS];
+    pthread_t threads[MAX_READERS];
+    double one_reader = 0.0;
+
+    db_set_concurrent(db, true);
+
+    for (unsigned n = 1; n <= MAX_READERS; n *= 2)
+    {
+        struct churn_args churn = { .db = db, .books = books, .updates = 0 };
+        pthread_t writer;
+        unsigned started = 0;
+        Samples all;
+
+        atomic_init(&churn.stop, false);
+        if (pthread_create(&writer, NULL, churn_writer, &churn) != 0)
+            break;
+
+        uint64_t t0 = cutils_now_ns();
+        for (unsigned t = 0; t < n; ++t)
+        {
+            readers[t].db = db;
+            readers[t].books = books;
+            readers[t].seed = 0x9E3779B97F4A7C15ull * (t + 1);
+            if (samples_init(&readers[t].samples, READER_OPS) != 0)
+                break;
+            if (pthread_create(&threads[t], NULL, scaling_reader, &readers[t]) != 0)
+            {
+                free(readers[t].samples.ns);
+                break;
+            }
+            ++started;
+        }
+        for (unsigned t = 0; t < started; ++t)
+            pthread_join(threads[t], NULL);
+        uint64_t wall_ns = cutils_now_ns() - t0;
+
+        atomic_store(&churn.stop, true);
+        pthread_join(writer, NULL);
+
+        if (samples_init(&all, (size_t)started * READER_OPS) == 0)
+            for (unsigned t = 0; t < started; ++t)
+            {
+                memcpy(all.ns + all.count, readers[t].samples.ns, READER_OPS * sizeof *all.ns);
+                all.count += READER_OPS;
+            }
+        for (unsigned t = 0; t < started; ++t)
+            free(readers[t].samples.ns);
+        if (started < n || !all.ns)
+        {
+            free(all.ns);
+            break;
+        }
+
+        char name[48];
+        snprintf(name, sizeof name, "copy_book_%u_readers", n);
+        record_total(size, name, &all, (size_t)n * READER_OPS, wall_ns);
+
+        double rate = (double)n * READER_OPS / ((double)wall_ns / 1e9);
+        if (n == 1)
+            one_reader = rate;
+        printf("    %u reader(s): %.2fx one reader, %lu book updates meanwhile\n",
+               n, one_reader > 0 ? rate / one_reader : 0.0, churn.updates);
+    }
+
+    db_set_concurrent(db, false);
+}
+
+static void bench_mutations(BenchSize *size, DB *db, const DataGen *g, unsigned books, unsigned loans)
+{
+    size_t n = clamp_ops(books, 100, MUTATION_OPS);
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Book b;
+        datagen_book(g, (unsigned)(books + 1 + i), &b);
+        TIMED(&s, db_add_book(db, &b));
+    }
+    record(size, "db_add_book", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned id = (unsigned)(books + 1 + i);
+        TIMED(&s, db_remove_book(db, id));
+    }
+    record(size, "db_remove_book", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Loan l;
+        datagen_loan(g, (unsigned)(loans + 1 + i), &l);
+        TIMED(&s, db_add_loan(db, &l));
+    }
+    record(size, "db_add_loan", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned id = (unsigned)(loans + 1 + i);
+        TIMED(&s, db_remove_loan(db, id));
+    }
+    record(size, "db_remove_loan", &s, n);
+}
+
+/*
+    Checkout then return of the same loans. Books are picked with a
+    stride so consecutive checkouts rarely hit the same title; books
+    without copies just fail fast, which is timed as well.
+*/
+static void bench_circulation(BenchSize *size, DB *db, unsigned books, unsigned users)
+{
+    size_t n = clamp_ops(books, 100, MUTATION_OPS);
+    unsigned *ids = calloc(n, sizeof *ids);
+    Samples s;
+    if (!ids)
+        return;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned book_id = (unsigned)((i * 7919) % books) + 1;
+        unsigned user_id = (unsigned)(i % users) + 1;
+        TIMED(&s, db_checkout(db, user_id, book_id, 20240601, &ids[i]));
+    }
+    record(size, "db_checkout", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_return(db, ids[i], 20240615, NULL));
+    record(size, "db_return", &s, n);
+
+    for (size_t i = 0; i < n; ++i)
+        if (ids[i])
+            db_remove_loan(db, ids[i]);
+    free(ids);
+}
+
+/*
+    One popular title with a long waitlist: n users reserve it (tiers
+    mixed), then each return hands the copy on to the next hold, and a
+    second waitlist is cancelled hold by hold.
+*/
+static void bench_reservations(BenchSize *size, DB *db, unsigned users)
+{
+    size_t n = clamp_ops(users, 100, MUTATION_OPS);
+    unsigned *loans = calloc(n + 1, sizeof *loans);
+    Book saved, b;
+    Loan l;
+    Samples s;
+    if (!loans || db_copy_book_by_id(db, 1, &saved) != 0)
+    {
+        free(loans);
+        return;
+    }
+
+    b = saved;
+    b.available = 0;
+    db_update_book(db, &b);
+    loan_init(&l, 0, 1, 1, 20240601, 0);
+    if (db_add_loan_auto(db, &l) == 0)
+        loans[0] = l.id;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_reserve(db, (unsigned)(i % users) + 1, 1,
+                             (unsigned)(i % (RESERVATION_TIER_MAX + 1)), 20240602));
+    record(size, "db_reserve", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_return(db, loans[i], 20240610, &loans[i + 1]));
+    record(size, "db_return_handoff", &s, n);
+
+    for (size_t i = 0; i < n; ++i)
+        db_reserve(db, (unsigned)(i % users) + 1, 1, (unsigned)(i % (RESERVATION_TIER_MAX + 1)), 20240611);
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_cancel_reservation(db, (unsigned)((i * 7919) % n % users) + 1, 1));
+    record(size, "db_cancel_reservation", &s, n);
+
+    for (size_t i = 0; i <= n; ++i)
+        if (loans[i])
+            db_remove_loan(db, loans[i]);
+    db_update_book(db, &saved);
+    free(loans);
+}
+
+/*
+    What a dashboard poll costs: the maintained counters against the
+    full rebuild that db_check_totals does (the price of answering the
+    same questions with a scan).
+*/
+static void bench_totals(BenchSize *size, DB *db, unsigned books, unsigned loans)
+{
+    size_t n = MUTATION_OPS;
+    DBTotals t;
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_totals(db, &t));
+    record(size, "db_totals", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_book_loans(db, (unsigned)((i * 7919) % books) + 1));
+    record(size, "db_book_loans", &s, n);
+
+    n = clamp_ops(2000000 / (books + loans), 3, 50);
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_check_totals(db));
+    record(size, "db_check_totals", &s, n * (books + loans));
+}
+
+/*
+    Top 50 books and users: all time (the maintained counters) and over
+    one year of loans (a column tally first).
+*/
+static void bench_top(BenchSize *size, DB *db, unsigned loans)
+{
+    enum { TOP_K = 50 };
+    IdCount top[TOP_K];
+    size_t n = clamp_ops(2000000 / loans, 5, 200), got;
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_top_books(db, TOP_K, 0, 0, top, &got));
+    record(size, "db_top_books_all_time", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_top_users(db, TOP_K, 0, 0, top, &got));
+    record(size, "db_top_users_all_time", &s, n);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_top_books(db, TOP_K, 20230101, 20231231, top, &got));
+    record(size, "db_top_books_window", &s, n * loans);
+}
+
+/* The periodic co-borrowing build over every loan, then book-detail lookups. */
+static void bench_recommendations(BenchSize *size, DB *db, unsigned books, unsigned loans)
+{
+    IdCount similar[RECOMMEND_NEIGHBORS_DEFAULT];
+    size_t n = MUTATION_OPS, got;
+    Samples s;
+
+    ThreadPool *pool = thread_pool_create(0);
+    samples_init(&s, 1);
+    TIMED(&s, db_build_recommendations(db, NULL, pool));
+    record(size, "db_build_recommendations", &s, loans);
+    thread_pool_destroy(pool);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_recommend_for_book(db, (unsigned)((i * 7919) % books) + 1,
+                                        RECOMMEND_NEIGHBORS_DEFAULT, similar, &got));
+    record(size, "db_recommend_for_book", &s, n);
+}
+
+static int count_match(const Book *b, void *ctx)
+{
+    (void)b;
+    ++*(size_t *)ctx;
+    return 0;
+}
+
+static void bench_search(BenchSize *size, const DB *db, unsigned books)
+{
+    static const char *const terms[] = { "rio", "mapa", "segredo", "farol", "zzz-no-match" };
+    size_t n = clamp_ops(2000000 / books, 5, 200);
+    size_t matches = 0;
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const char *term = terms[i % (sizeof terms / sizeof terms[0])];
+        TIMED(&s, db_search_books(db, DB_BOOK_TITLE, term, count_match, &matches));
+    }
+    record(size, "db_search_books_title", &s, n * dlist_size(db->books));
+}
+
+static int index_title(const Book *b, void *ctx)
+{
+    return title_index_put(ctx, b->id, b->title);
+}
+
+/*
+    Near-duplicate lookups: the title index built from scratch (what the
+    load does), then existing titles with one character changed, the
+    typo a suggestion would have.
+*/
+static void bench_similar(BenchSize *size, const DB *db, unsigned books)
+{
+    size_t n = MUTATION_OPS, found;
+    TitleMatch matches[10];
+    Samples s;
+
+    TitleIndex *t = title_index_create();
+    samples_init(&s, 1);
+    TIMED(&s, db_foreach_book(db, index_title, t));
+    record(size, "title_index_build", &s, dlist_size(db->books));
+    title_index_destroy(t);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Book b;
+        if (db_copy_book_by_id(db, (unsigned)((i * 7919) % books) + 1, &b) != 0)
+            continue;
+        size_t len = strlen(b.title);
+        if (len > 0)
+            b.title[(i * 31) % len] = 'x';
+        TIMED(&s, db_similar_books(db, b.title, 80, matches, 10, &found));
+    }
+    record(size, "db_similar_books", &s, n);
+}
+
+static int index_title_key(const Book *b, void *ctx)
+{
+    return prefix_index_add(ctx, b->title, b->id);
+}
+
+/*
+    Type-ahead: the title trie built from scratch (what the load does),
+    then every prefix of existing titles, as they are typed, for the
+    first screen of completions.
+*/
+static void bench_autocomplete(BenchSize *size, const DB *db, unsigned books)
+{
+    size_t n = MUTATION_OPS, found;
+    unsigned ids[10];
+    Samples s;
+
+    PrefixIndex *p = prefix_index_create();
+    samples_init(&s, 1);
+    TIMED(&s, db_foreach_book(db, index_title_key, p));
+    record(size, "prefix_index_build", &s, dlist_size(db->books));
+    prefix_index_destroy(p);
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Book b;
+        if (db_copy_book_by_id(db, (unsigned)((i / 8 * 7919) % books) + 1, &b) != 0)
+            continue;
+        b.title[i % 8 + 1] = '\0';
+        TIMED(&s, db_autocomplete(db, DB_COMPLETE_TITLE, b.title, 10, ids, &found));
+    }
+    record(size, "db_autocomplete", &s, n);
+}
+
+/* What the loans menu does: walk every loan and resolve its user and book. */
+struct listing_ctx {
+    const DB *db;
+    size_t resolved;
+};
+
+static int list_loan(const Loan *l, void *ctx)
+{
+    struct listing_ctx *listing = ctx;
+    User u;
+    Book b;
+    if (db_copy_user_by_id(listing->db, l->user_id, &u) == 0 &&
+        db_copy_book_by_id(listing->db, l->book_id, &b) == 0)
+        listing->resolved++;
+    return 0;
+}
+
+static void bench_loan_listing(BenchSize *size, const DB *db, unsigned loans)
+{
+    size_t n = clamp_ops(1000000 / loans, 3, 100);
+    struct listing_ctx listing = { db, 0 };
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_foreach_loan(db, list_loan, &listing));
+    record(size, "loan_listing", &s, n * dlist_size(db->loans));
+}
+
+/*
+    The circulation report question ("loans still out, borrowed before
+    a cutoff"), answered by walking the list and by each scan kernel
+    of the loans' column store.
+*/
+struct filter_count {
+    const LoanFilter *f;
+    size_t n;
+};
+
+static int count_old_active(const Loan *l, void *ctx)
+{
+    struct filter_count *c = ctx;
+    if (l->date_return == 0 && l->date_borrow <= c->f->borrow_to)
+        c->n++;
+    return 0;
+}
+
+static void bench_loan_filter(BenchSize *size, const DB *db, unsigned loans)
+{
+    static const struct { LoanKernel kernel; const char *name; } kernels[] = {
+        { LOAN_KERNEL_SCALAR, "loan_filter_columns_scalar" },
+        { LOAN_KERNEL_SSE2,   "loan_filter_columns_sse2" },
+        { LOAN_KERNEL_AVX2,   "loan_filter_columns_avx2" }
+    };
+    LoanFilter f = { .borrow_to = 20230101, .active_only = true };
+    size_t n = clamp_ops(10000000 / loans, 3, 1000);
+    size_t count;
+    Samples s;
+
+    struct filter_count c = { &f, 0 };
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_foreach_loan(db, count_old_active, &c));
+    record(size, "loan_filter_foreach", &s, n * dlist_size(db->loans));
+
+    for (size_t k = 0; k < sizeof kernels / sizeof kernels[0]; ++k)
+    {
+        if (loan_columns_set_kernel(kernels[k].kernel) != 0)
+            continue;
+
+        samples_init(&s, n);
+        for (size_t i = 0; i < n; ++i)
+            TIMED(&s, db_loans_count(db, &f, &count));
+        record(size, kernels[k].name, &s, n * dlist_size(db->loans));
+    }
+    loan_columns_set_kernel(LOAN_KERNEL_AUTO);
+}
+
+/*
+    Average loan length: converting both YYYYMMDD dates of every loan
+    while walking the list, against the column store's day numbers.
+*/
+struct days_out {
+    size_t returned;
+    uint64_t days;
+};
+
+static int add_days_out(const Loan *l, void *ctx)
+{
+    struct days_out *d = ctx;
+    if (l->date_return != 0 && l->date_return >= l->date_borrow)
+    {
+        d->returned++;
+        d->days += date_from_yyyymmdd(l->date_return) - date_from_yyyymmdd(l->date_borrow);
+    }
+    return 0;
+}
+
+static void bench_loan_days_out(BenchSize *size, const DB *db, unsigned loans)
+{
+    LoanFilter all = { 0 };
+    size_t n = clamp_ops(10000000 / loans, 3, 1000);
+    struct days_out d;
+    Samples s;
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        d.returned = 0;
+        d.days = 0;
+        TIMED(&s, db_foreach_loan(db, add_days_out, &d));
+    }
+    record(size, "loan_days_out_foreach", &s, n * dlist_size(db->loans));
+
+    samples_init(&s, n);
+    for (size_t i = 0; i < n; ++i)
+        TIMED(&s, db_loans_days_out(db, &all, &d.returned, &d.days));
+    record(size, "loan_days_out_columns", &s, n * dlist_size(db->loans));
+}
+
+static int bench_size(BenchSize *size, const char *dir)
+{
+    unsigned rows = size->rows;
+
+    DataGenConfig cfg;
+    datagen_default_config(&cfg);
+    cfg.books = rows;
+    cfg.users = rows / 10 ? rows / 10 : 1;
+    cfg.loans = rows * 2;
+    cfg.suggestions = rows / 20 ? rows / 20 : 1;
+    cfg.authors = rows / 7 ? rows / 7 : 1;
+
+    DataGen *g = datagen_create(&cfg);
+    if (!g)
+        return -1;
+
+    char size_dir[512];
+    snprintf(size_dir, sizeof size_dir, "%s/%u", dir, rows);
+    if (ensure_directory(size_dir) != 0)
+    {
+        datagen_destroy(g);
+        return -1;
+    }
+
+    struct data_paths in, out;
+    make_paths(&in, size_dir, "");
+    make_paths(&out, size_dir, "_out");
+
+    printf("\n== %u books, %u users, %u loans, %u suggestions ==\n",
+           cfg.books, cfg.users, cfg.loans, cfg.suggestions);
+
+    if (datagen_write_files(g, in.books, in.users, in.loans, in.suggestions) != 0)
+    {
+        datagen_destroy(g);
+        return -1;
+    }
+
+    bench_fs(size, &in, &out);
+
+    DB db;
+    Samples s;
+    int init_rc = 0;
+
+    samples_init(&s, 1);
+    TIMED(&s, init_rc = db_init(&db, in.books, in.users, in.loans, in.suggestions));
+    if (init_rc != 0)
+    {
+        free(s.ns);
+        datagen_destroy(g);
+        return -1;
+    }
+    record(size, "db_init", &s, total_rows(&db));
+
+    samples_init(&s, 1);
+    TIMED(&s, db_save(&db, out.books, out.users, out.loans, out.suggestions));
+    record(size, "db_save", &s, total_rows(&db));
+
+    bench_lookups(size, &db, cfg.books, cfg.loans);
+    bench_mutations(size, &db, g, cfg.books, cfg.loans);
+    bench_circulation(size, &db, cfg.books, cfg.users);
+    bench_reservations(size, &db, cfg.users);
+    bench_totals(size, &db, cfg.books, cfg.loans);
+    bench_top(size, &db, cfg.loans);
+    bench_recommendations(size, &db, cfg.books, cfg.loans);
+    bench_search(size, &db, cfg.books);
+    bench_similar(size, &db, cfg.books);
+    bench_autocomplete(size, &db, cfg.books);
+    bench_loan_listing(size, &db, cfg.loans);
+    bench_loan_filter(size, &db, cfg.loans);
+    bench_loan_days_out(size, &db, cfg.loans);
+    bench_reader_scaling(size, &db, cfg.books);
+
+    db_destroy(&db);
+    datagen_destroy(g);
+
+    size->peak_rss_kb = peak_rss_kb();
+    printf("  peak RSS: %ld KB\n", size->peak_rss_kb);
+    return 0;
+}
+
+/* ---------------------------------------------------------------
+   Output
+   --------------------------------------------------------------- */
+
+static int write_json(const char *path, BenchSize *sizes, size_t n_sizes)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    fprintf(f, "{\n  \"sizes\": [\n");
+    for (size_t i = 0; i < n_sizes; ++i)
+    {
+        BenchSize *size = &sizes[i];
+        fprintf(f, "    {\n      \"rows\": %u,\n      \"peak_rss_kb\": %ld,\n      \"results\": [\n",
+                size->rows, size->peak_rss_kb);
+
+        for (size_t j = 0; j < size->results.count; ++j)
+        {
+            const BenchResult *r = arraylist_get(&size->results, j);
+            double secs = (double)r->total_ns / 1e9;
+            fprintf(f,
+                    "        {\"name\": \"%s\", \"ops\": %zu, \"items\": %zu, \"total_ns\": %llu, "
+                    "\"ops_per_sec\": %.1f, \"items_per_sec\": %.1f, "
+                    "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}%s\n",
+                    r->name, r->ops, r->items, (unsigned long long)r->total_ns,
+                    secs > 0 ? (double)r->ops / secs : 0.0,
+                    secs > 0 ? (double)r->items / secs : 0.0,
+                    (unsigned long long)r->p50_ns, (unsigned long long)r->p90_ns,
+                    (unsigned long long)r->p99_ns, (unsigned long long)r->max_ns,
+                    j + 1 < size->results.count ? "," : "");
+        }
+
+        fprintf(f, "      ]\n    }%s\n", i + 1 < n_sizes ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int parse_sizes(const char *text, unsigned *sizes, size_t *n)
+{
+    char tmp[256];
+    snprintf(tmp, sizeof tmp, "%s", text);
+
+    *n = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        char *end = NULL;
+        unsigned long v = strtoul(tok, &end, 10);
+        if (*end != '\0' || v == 0 || v > 100000000ul || *n == MAX_SIZES)
+            return -1;
+        sizes[(*n)++] = (unsigned)v;
+    }
+    return *n > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned sizes[MAX_SIZES] = { 1000, 10000, 100000, 1000000 };
+    size_t n_sizes = 4;
+    const char *json_path = "build/bench/results.json";
+    const char *dir = "build/bench";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--sizes") == 0 && val && parse_sizes(val, sizes, &n_sizes) == 0)
+            ++i;
+        else if (strcmp(argv[i], "--json") == 0 && val)
+            json_path = argv[++i];
+        else if (strcmp(argv[i], "--dir") == 0 && val)
+            dir = argv[++i];
+        else
+        {
+            fprintf(stderr, "Uso: %s [--sizes 1000,10000,...] [--json <ficheiro>] [--dir <dir>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (ensure_directory(dir) != 0)
+    {
+        fprintf(stderr, "Nao foi possivel criar %s.\n", dir);
+        return 1;
+    }
+
+    BenchSize results[MAX_SIZES];
+    size_t done = 0;
+    int rc = 0;
+
+    for (size_t i = 0; i < n_sizes; ++i)
+    {
+        results[i].rows = sizes[i];
+        results[i].peak_rss_kb = 0;
+        arraylist_init(&results[i].results, sizeof(BenchResult));
+
+        if (bench_size(&results[i], dir) != 0)
+        {
+            fprintf(stderr, "Benchmark falhou para %u linhas.\n", sizes[i]);
+            arraylist_free(&results[i].results);
+            rc = 1;
+            break;
+        }
+        ++done;
+    }
+
+    if (write_json(json_path, results, done) != 0)
+    {
+        fprintf(stderr, "Nao foi possivel escrever %s.\n", json_path);
+        rc = 1;
+    }
+    else
+    {
+        printf("\nResultados em %s\n", json_path);
+    }
+
+    for (size_t i = 0; i < done; ++i)
+        arraylist_free(&results[i].results);
+
+    return rc;
+}
@@ -0,0 +1,378 @@
+/*
+    DList microbenchmarks with scaling checks (make bench-dlist).
+
+    Every operation is timed at list sizes 10^3 .. 10^6 and the cost
+    per operation is fitted to c * n^k (least squares on log-log).
+    The fitted exponent k is compared with the expected complexity:
+
+        O(1)  ->  k should be ~0   (fails above MAX_K_CONSTANT)
+        O(n)  ->  k should be ~1   (fails above MAX_K_LINEAR)
+
+    Cache misses make even O(1) operations slower on big lists (a 10^6
+    node list no longer fits in cache, so iteration and random removal
+    pay DRAM latency), which shows up as an exponent of 0.3-0.5 on
+    typical machines. The O(1) limit is therefore well above that but
+    still clearly below a real O(n) regression.
+
+    An operation that suddenly becomes quadratic would take minutes at
+    10^6, so once a single measurement passes TIME_BUDGET_NS the larger
+    sizes are skipped and the fit uses the sizes measured so far.
+
+    Uso:
+      bench_dlist [--max N]   (maior tamanho, default 1000000)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "dlist.h"
+#include "cutils.h"
+
+#define MAX_K_CONSTANT 0.75
+#define MAX_K_LINEAR 1.5
+
+#define REPEATS 3
+#define TIME_BUDGET_NS 2000000000ull
+#define MAX_SIZES 8
+
+typedef enum { EXPECT_CONSTANT, EXPECT_LINEAR } Expectation;
+
+/*
+    Runs the operation on a list of n elements and returns the cost of
+    one operation in ns. *elapsed_ns receives the wall time of the run.
+*/
+typedef double (*BenchFn)(size_t n, uint64_t *elapsed_ns);
+
+typedef struct {
+    const char *name;
+    Expectation expect;
+    BenchFn run;
+} BenchOp;
+
+/* ---------------------------------------------------------------
+   Helpers
+   --------------------------------------------------------------- */
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static size_t rand_below(size_t n)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (size_t)(rng_state % n);
+}
+
+/* The payload is the integer itself, stored in the pointer. */
+static void *as_data(size_t v)
+{
+    return (void *)(uintptr_t)v;
+}
+
+static int cmp_values(void *a, void *b)
+{
+    return (uintptr_t)a == (uintptr_t)b ? 0 : 1;
+}
+
+/* Priority list with priorities 2(n-1), ..., 2, 0 (built via the O(1) tail path). */
+static DList *build_priority_list(size_t n, DListNode **nodes)
+{
+    DList *list = dlist_create(true, NULL);
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t v = n - 1 - i;
+        DListNode *node = dlist_insert_priority(list, as_data(v), (int)(2 * v));
+        if (nodes)
+            nodes[i] = node;
+    }
+    return list;
+}
+
+static DList *build_plain_list(size_t n)
+{
+    DList *list = dlist_create(false, NULL);
+    for (size_t i = 0; i < n; ++i)
+        dlist_push_back(list, as_data(i));
+    return list;
+}
+
+/* Enough operations to get stable timings without taking forever. */
+static size_t linear_ops(size_t n)
+{
+    size_t k = 20000000 / n;
+    return k < 20 ? 20 : (k > 2000 ? 2000 : k);
+}
+
+/* ---------------------------------------------------------------
+   Operations
+   --------------------------------------------------------------- */
+
+static double run_queue_back_front(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = build_plain_list(n);
+    const size_t ops = 200000;
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        dlist_push_back(list, as_data(i));
+        dlist_pop_front(list);
+    }
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)ops;
+}
+
+static double run_queue_front_back(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = build_plain_list(n);
+    const size_t ops = 200000;
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        dlist_push_front(list, as_data(i));
+        dlist_pop_back(list);
+    }
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)ops;
+}
+
+/* The load path: files are saved highest id first. */
+static double run_insert_descending(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = dlist_create(true, NULL);
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < n; ++i)
+        dlist_insert_priority(list, as_data(i), (int)(n - i));
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)n;
+}
+
+static double run_insert_ascending(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = dlist_create(true, NULL);
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < n; ++i)
+        dlist_insert_priority(list, as_data(i), (int)i);
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)n;
+}
+
+/* Random odd priorities land between the existing even ones. */
+static double run_insert_random(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = build_priority_list(n, NULL);
+    size_t ops = linear_ops(n);
+    DListNode **added = malloc(ops * sizeof *added);
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < ops; ++i)
+        added[i] = dlist_insert_priority(list, as_data(i), (int)(2 * rand_below(n) + 1));
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    for (size_t i = 0; i < ops; ++i)
+        dlist_remove_node(list, added[i], NULL);
+    free(added);
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)ops;
+}
+
+static double run_find(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = build_plain_list(n);
+    size_t ops = linear_ops(n);
+    size_t found = 0;
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < ops; ++i)
+        found += dlist_find(list, as_data(rand_below(n)), cmp_values) != NULL;
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    if (found != ops)
+        fprintf(stderr, "dlist_find missed %zu values\n", ops - found);
+
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)ops;
+}
+
+static double run_remove_node(size_t n, uint64_t *elapsed_ns)
+{
+    DListNode **nodes = malloc(n * sizeof *nodes);
+    DList *list = build_priority_list(n, nodes);
+
+    /* Remove half of the nodes in random order. */
+    size_t ops = n / 2;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        size_t j = i + rand_below(n - i);
+        DListNode *t = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = t;
+    }
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t i = 0; i < ops; ++i)
+        dlist_remove_node(list, nodes[i], NULL);
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    free(nodes);
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)ops;
+}
+
+/* Cost per visited element of a full DLIST_FOREACH. */
+static double run_iterate(size_t n, uint64_t *elapsed_ns)
+{
+    DList *list = build_priority_list(n, NULL);
+    size_t rounds = 10000000 / n ? 10000000 / n : 1;
+    volatile uintptr_t sink = 0;
+
+    uint64_t t0 = cutils_now_ns();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        uintptr_t sum = 0;
+        DLIST_FOREACH(list, node)
+            sum += (uintptr_t)node->data;
+        sink += sum;
+    }
+    *elapsed_ns = cutils_now_ns() - t0;
+
+    (void)sink;
+    dlist_destroy(list, NULL);
+    return (double)*elapsed_ns / (double)(rounds * n);
+}
+
+static const BenchOp ops[] = {
+    { "push_back+pop_front",     EXPECT_CONSTANT, run_queue_back_front },
+    { "push_front+pop_back",     EXPECT_CONSTANT, run_queue_front_back },
+    { "insert_priority desc",    EXPECT_CONSTANT, run_insert_descending },
+    { "insert_priority asc",     EXPECT_CONSTANT, run_insert_ascending },
+    { "insert_priority random",  EXPECT_LINEAR,   run_insert_random },
+    { "find",                    EXPECT_LINEAR,   run_find },
+    { "remove_node",             EXPECT_CONSTANT, run_remove_node },
+    { "iterate (per element)",   EXPECT_CONSTANT, run_iterate },
+};
+
+/* ---------------------------------------------------------------
+   Fitting
+   --------------------------------------------------------------- */
+
+/* Slope of log(cost) over log(n). */
+static double fit_exponent(const size_t *sizes, const double *cost, size_t count)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        double x = log((double)sizes[i]);
+        double y = log(cost[i] > 0 ? cost[i] : 1e-3);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    double denom = (double)count * sxx - sx * sx;
+    return denom != 0 ? ((double)count * sxy - sx * sy) / denom : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_size = 1000000;
+    if (argc == 3 && strcmp(argv[1], "--max") == 0)
+        max_size = strtoul(argv[2], NULL, 10);
+    else if (argc != 1)
+    {
+        fprintf(stderr, "Uso: %s [--max N]\n", argv[0]);
+        return 1;
+    }
+
+    size_t sizes[MAX_SIZES];
+    size_t n_sizes = 0;
+    for (size_t n = 1000; n <= max_size && n_sizes < MAX_SIZES; n *= 10)
+        sizes[n_sizes++] = n;
+
+    if (n_sizes < 2)
+    {
+        fprintf(stderr, "Sao precisos pelo menos dois tamanhos (--max >= 10000).\n");
+        return 1;
+    }
+
+    printf("== DList scaling benchmark (ns per operation) ==\n");
+    printf("%-24s", "operation");
+    for (size_t i = 0; i < n_sizes; ++i)
+        printf(" %10zu", sizes[i]);
+    printf("   exponent  expected\n");
+
+    int failures = 0;
+
+    for (size_t o = 0; o < sizeof ops / sizeof ops[0]; ++o)
+    {
+        const BenchOp *op = &ops[o];
+        double cost[MAX_SIZES];
+        size_t measured = 0;
+
+        printf("%-24s", op->name);
+        fflush(stdout);
+
+        for (size_t i = 0; i < n_sizes; ++i)
+        {
+            double best = 0;
+            uint64_t slowest = 0;
+
+            /* Best of a few runs filters out scheduler noise. */
+            for (int r = 0; r < REPEATS; ++r)
+            {
+                uint64_t elapsed = 0;
+                double c = op->run(sizes[i], &elapsed);
+                if (r == 0 || c < best)
+                    best = c;
+                if (elapsed > slowest)
+                    slowest = elapsed;
+                if (elapsed > TIME_BUDGET_NS)
+                    break;
+            }
+
+            cost[measured++] = best;
+            printf(" %10.1f", best);
+            fflush(stdout);
+
+            if (slowest > TIME_BUDGET_NS)
+                break;
+        }
+
+        for (size_t i = measured; i < n_sizes; ++i)
+            printf(" %10s", "skipped");
+
+        double k = measured >= 2 ? fit_exponent(sizes, cost, measured) : 0.0;
+        double limit = op->expect == EXPECT_CONSTANT ? MAX_K_CONSTANT : MAX_K_LINEAR;
+        bool ok = measured >= 2 && k <= limit;
+
+        printf("   %8.2f  %-8s %s\n", k, op->expect == EXPECT_CONSTANT ? "O(1)" : "O(n)",
+               ok ? "" : "<-- REGRESSION");
+
+        if (!ok)
+            failures++;
+    }
+
+    if (failures)
+    {
+        printf("%d operation(s) scale worse than expected.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
@@ -12,23 +12,369 @@
 		2) CRUD ops:   manipulate the in-memory lists during the program.
 		3) db_save:    write the current state back to disk.
 		4) db_destroy: free all memory.
+
+	Concurrency:
+		Each table has its own pthread reader-writer lock. The locks
+		are always initialized by db_init but only taken when the DB
+		was switched to concurrent mode with db_set_concurrent.
+		Only checkout and return hold more than one table lock, always
+		in table order (books, then users, then loans); everything
+		else holds one at a time, so no two calls can deadlock.
+
+		Lookups by id go through a per-table IdIndex and take no lock
+		at all; they rely on the epoch domain (lib/epoch) to keep
+		records alive while a reader may still be using them.
+
+	Instrumentation:
+		Every public entry point is wrapped in DB_STATS_START/STOP,
+		which only record anything in a DB_STATS=1 build (db_stats.h).
+		The same entry points append to the workload trace while
+		recording is on (db_record.h).
 */
 
 #include "db/db.h"
+#include "db/db_stats.h"
+#include "db/db_record.h"
+#include "lib/trace/trace.h"
+#include "lib/cutils/aed_alloc.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
+#include <ctype.h>
 
 #include "fs/books_file.h"
 #include "fs/users_file.h"
 #include "fs/loans_file.h"
 #include "fs/suggestions_file.h"
+#include "fs/reservations_file.h"
+
+/* Small wrappers so dlist_destroy (and the epoch) can free the stored elements. */
+static void free_book(void *p)  { aed_free(AED_MEM_BOOK, p, sizeof(Book)); }
+static void free_user(void *p)  { aed_free(AED_MEM_USER, p, sizeof(User)); }
+static void free_loan(void *p)  { aed_free(AED_MEM_LOAN, p, sizeof(Loan)); }
+static void free_suggestion(void *p) { aed_free(AED_MEM_SUGGESTION, p, sizeof(Suggestion)); }
+
+/*
+	Ordered index on one field of a table: which tree of the DB it
+	lives in and how a record is turned into its (field, id) key.
+*/
+typedef struct {
+	BPTree *(*tree)(const DB *db);
+	uint64_t (*key)(const void *record);
+} OrderedIndex;
+
+/* Years can be negative; the bias makes them sort as unsigned keys. */
+static uint32_t year_bias(int year) { return (uint32_t)year ^ 0x80000000u; }
+
+static uint64_t book_year_key(const void *r)
+{
+	const Book *b = r;
+	return bptree_key(year_bias(b->year), b->id);
+}
+
+static uint64_t loan_borrow_key(const void *r)
+{
+	const Loan *l = r;
+	return bptree_key(loan_borrow_day(l), l->id);
+}
+
+static uint64_t loan_return_key(const void *r)
+{
+	const Loan *l = r;
+	return bptree_key(loan_return_day(l), l->id);
+}
+
+/* Every record starts with its id; the key is inverted so the highest id comes first. */
+static uint64_t id_desc_key(unsigned id)
+{
+	return (uint64_t)(UINT32_MAX - id);
+}
+
+static uint64_t record_id_key(const void *r)
+{
+	return id_desc_key(*(const unsigned *)r);
+}
+
+static BPTree *books_by_year(const DB *db)     { return db->books_by_year; }
+static BPTree *loans_by_borrow(const DB *db)   { return db->loans_by_borrow; }
+static BPTree *loans_by_return(const DB *db)   { return db->loans_by_return; }
+static BPTree *books_by_id(const DB *db)       { return db->books_by_id; }
+static BPTree *users_by_id(const DB *db)       { return db->users_by_id; }
+static BPTree *loans_by_id(const DB *db)       { return db->loans_by_id; }
+static BPTree *suggestions_by_id(const DB *db) { return db->suggestions_by_id; }
+
+static const OrderedIndex book_ordered[] = {
+	{ books_by_id, record_id_key },
+	{ books_by_year, book_year_key }
+};
+static const OrderedIndex user_ordered[] = {
+	{ users_by_id, record_id_key }
+};
+static const OrderedIndex loan_ordered[] = {
+	{ loans_by_id, record_id_key },
+	{ loans_by_borrow, loan_borrow_key },
+	{ loans_by_return, loan_return_key }
+};
+static const OrderedIndex suggestion_ordered[] = {
+	{ suggestions_by_id, record_id_key }
+};
+
+#define COUNTED(a) (a), sizeof(a) / sizeof((a)[0])
+
+/*
+	Other structures that keep a copy of a table's fields (by id, not
+	by pointer). put inserts or overwrites the record's entry (old is
+	the version being replaced, NULL for a new record) and may only
+	fail when it has to allocate; putting the previous version back
+	right after a put must never fail, which is what lets an update be
+	undone.
+*/
+typedef struct {
+	int (*put)(DB *db, const void *record, const void *old);
+	void (*remove)(DB *db, const void *record);
+} RecordMirror;
+
+/* Column store of the loans (db/loan_columns.h). */
+static int loan_columns_put_record(DB *db, const void *record, const void *old)
+{
+	(void)old;
+	return loan_columns_put(db->loan_columns, record);
+}
+
+static void loan_columns_remove_record(DB *db, const void *record)
+{
+	loan_columns_remove(db->loan_columns, ((const Loan *)record)->id);
+}
+
+/* Due-date wheel (db/due_wheel.h): only loans not returned yet are scheduled. */
+static int due_wheel_put_record(DB *db, const void *record, const void *old)
+{
+	const Loan *l = record;
+	(void)old;
+	if (l->date_return != 0)
+	{
+		due_wheel_remove(db->due_wheel, l->id);
+		return 0;
+	}
+	return due_wheel_put(db->due_wheel, l->id, loan_due_day(l));
+}
+
+static void due_wheel_remove_record(DB *db, const void *record)
+{
+	due_wheel_remove(db->due_wheel, ((const Loan *)record)->id);
+}
+
+/*
+	Active loans per user (db/id_counts.h). The new user is counted
+	before the old one is released, so a failure changes nothing.
+*/
+static int active_loans_put_record(DB *db, const void *record, const void *old)
+{
+	const Loan *l = record, *o = old;
+	bool now = l->date_return == 0, before = o && o->date_return == 0;
+
+	if (now && before && l->user_id == o->user_id)
+		return 0;
+	if (now && id_counts_add(db->active_loans, l->user_id, 1) != 0)
+		return -1;
+	if (before)
+		id_counts_add(db->active_loans, o->user_id, -1);
+	return 0;
+}
+
+static void active_loans_remove_record(DB *db, const void *record)
+{
+	const Loan *l = record;
+	if (l->date_return == 0)
+		id_counts_add(db->active_loans, l->user_id, -1);
+}
+
+/*
+	Moves one loan of the counters from old_id to new_id (old_id
+	unused when moved is false). The new id is counted first, so a
+	failure changes nothing.
+*/
+static int move_count(IdCounts *c, unsigned new_id, unsigned old_id, bool moved)
+{
+	if (moved && new_id == old_id)
+		return 0;
+	if (id_counts_add(c, new_id, 1) != 0)
+		return -1;
+	if (moved)
+		id_counts_add(c, old_id, -1);
+	return 0;
+}
+
+/* Loans per book, loans per user and loans not returned yet (db_totals). */
+static int loan_totals_put_record(DB *db, const void *record, const void *old)
+{
+	const Loan *l = record, *o = old;
+
+	if (move_count(db->book_loans, l->book_id, o ? o->book_id : 0, o != NULL) != 0)
+		return -1;
+	if (move_count(db->user_loans, l->user_id, o ? o->user_id : 0, o != NULL) != 0)
+	{
+		if (o)
+			move_count(db->book_loans, o->book_id, l->book_id, true);
+		else
+			id_counts_add(db->book_loans, l->book_id, -1);
+		return -1;
+	}
+	if (l->date_return == 0)
+		db->loans_active++;
+	if (o && o->date_return == 0)
+		db->loans_active--;
+	return 0;
+}
+
+static void loan_totals_remove_record(DB *db, const void *record)
+{
+	const Loan *l = record;
+	id_counts_add(db->book_loans, l->book_id, -1);
+	id_counts_add(db->user_loans, l->user_id, -1);
+	if (l->date_return == 0)
+		db->loans_active--;
+}
+
+static const RecordMirror loan_mirrors[] = {
+	{ loan_columns_put_record, loan_columns_remove_record },
+	{ due_wheel_put_record, due_wheel_remove_record },
+	{ active_loans_put_record, active_loans_remove_record },
+	{ loan_totals_put_record, loan_totals_remove_record }
+};
+
+/* Copies available over the catalog (db_totals). Never fails. */
+static int book_totals_put_record(DB *db, const void *record, const void *old)
+{
+	const Book *b = record, *o = old;
+	db->copies_available += b->available - (o ? o->available : 0);
+	return 0;
+}
+
+static void book_totals_remove_record(DB *db, const void *record)
+{
+	db->copies_available -= ((const Book *)record)->available;
+}
+
+/* Title trigrams (db/title_index.h); checkouts and returns leave the title alone. */
+static int book_titles_put_record(DB *db, const void *record, const void *old)
+{
+	const Book *b = record, *o = old;
+	if (o && strcmp(b->title, o->title) == 0)
+		return 0;
+	return title_index_put(db->book_titles, b->id, b->title);
+}
+
+static void book_titles_remove_record(DB *db, const void *record)
+{
+	title_index_remove(db->book_titles, ((const Book *)record)->id);
+}
+
+/*
+	Autocomplete keys (db/prefix_index.h). A changed key is added
+	before the old one goes, so a failed add changes nothing and
+	putting the old record back only re-adds what was just removed.
+*/
+static int prefix_put(PrefixIndex *p, unsigned id, const char *key, const char *old_key)
+{
+	if (old_key && prefix_index_key_cmp(key, old_key) == 0)
+		return 0;
+	if (prefix_index_add(p, key, id) != 0)
+		return -1;
+	if (old_key)
+		prefix_index_remove(p, old_key, id);
+	return 0;
+}
+
+static int book_title_keys_put_record(DB *db, const void *record, const void *old)
+{
+	const Book *b = record, *o = old;
+	return prefix_put(db->book_title_keys, b->id, b->title, o ? o->title : NULL);
+}
+
+static void book_title_keys_remove_record(DB *db, const void *record)
+{
+	const Book *b = record;
+	prefix_index_remove(db->book_title_keys, b->title, b->id);
+}
 
-/* Small wrappers so dlist_destroy can free the stored elements. */
-static void free_book(void *p)  { free(p); }
-static void free_user(void *p)  { free(p); }
-static void free_loan(void *p)  { free(p); }
-static void free_suggestion(void *p) { free(p); }
+static int book_author_keys_put_record(DB *db, const void *record, const void *old)
+{
+	const Book *b = record, *o = old;
+	return prefix_put(db->book_author_keys, b->id, b->author, o ? o->author : NULL);
+}
+
+static void book_author_keys_remove_record(DB *db, const void *record)
+{
+	const Book *b = record;
+	prefix_index_remove(db->book_author_keys, b->author, b->id);
+}
+
+static const RecordMirror book_mirrors[] = {
+	{ book_totals_put_record, book_totals_remove_record },
+	{ book_titles_put_record, book_titles_remove_record },
+	{ book_title_keys_put_record, book_title_keys_remove_record },
+	{ book_author_keys_put_record, book_author_keys_remove_record }
+};
+
+static int user_name_keys_put_record(DB *db, const void *record, const void *old)
+{
+	const User *u = record, *o = old;
+	return prefix_put(db->user_name_keys, u->id, u->name, o ? o->name : NULL);
+}
+
+static void user_name_keys_remove_record(DB *db, const void *record)
+{
+	const User *u = record;
+	prefix_index_remove(db->user_name_keys, u->name, u->id);
+}
+
+static const RecordMirror user_mirrors[] = {
+	{ user_name_keys_put_record, user_name_keys_remove_record }
+};
+
+static int suggestion_titles_put_record(DB *db, const void *record, const void *old)
+{
+	const Suggestion *s = record, *o = old;
+	if (o && strcmp(s->title, o->title) == 0)
+		return 0;
+	return title_index_put(db->suggestion_titles, s->id, s->title);
+}
+
+static void suggestion_titles_remove_record(DB *db, const void *record)
+{
+	title_index_remove(db->suggestion_titles, ((const Suggestion *)record)->id);
+}
+
+static const RecordMirror suggestion_mirrors[] = {
+	{ suggestion_titles_put_record, suggestion_titles_remove_record }
+};
+
+/* What the generic table helpers need to know about a record type. */
+typedef struct {
+	size_t size;
+	AedMemCategory category;
+	void (*free_fn)(void *);
+	const OrderedIndex *ordered;
+	size_t n_ordered;
+	const RecordMirror *mirrors;
+	size_t n_mirrors;
+} RecordType;
+
+static const RecordType book_type = {
+	sizeof(Book), AED_MEM_BOOK, free_book, COUNTED(book_ordered), COUNTED(book_mirrors)
+};
+static const RecordType user_type = {
+	sizeof(User), AED_MEM_USER, free_user, COUNTED(user_ordered), COUNTED(user_mirrors)
+};
+static const RecordType loan_type = {
+	sizeof(Loan), AED_MEM_LOAN, free_loan, COUNTED(loan_ordered), COUNTED(loan_mirrors)
+};
+static const RecordType suggestion_type = {
+	sizeof(Suggestion), AED_MEM_SUGGESTION, free_suggestion, COUNTED(suggestion_ordered),
+	COUNTED(suggestion_mirrors)
+};
 
 /* Traduz ids unsigned para prioridades int usadas pela DList. */
 static int id_priority(unsigned id)
@@ -38,335 +384,2406 @@ static int id_priority(unsigned id)
 	return (int)id;
 }
 
-/*
-	Loads all data from the filesystem layer into the DB.
+/*
+	Lock helpers.
+	The read variants accept a const DB because lookups are logically
+	read-only; the lock itself still has to be mutated.
+*/
+static void table_read_lock(const DB *db, const pthread_rwlock_t *lock)
+{
+	if (db->concurrent)
+		pthread_rwlock_rdlock((pthread_rwlock_t *)lock);
+}
+
+static void table_write_lock(const DB *db, const pthread_rwlock_t *lock)
+{
+	if (db->concurrent)
+		pthread_rwlock_wrlock((pthread_rwlock_t *)lock);
+}
+
+static void table_unlock(const DB *db, const pthread_rwlock_t *lock)
+{
+	if (db->concurrent)
+		pthread_rwlock_unlock((pthread_rwlock_t *)lock);
+}
+
+static int db_init_locks(DB *db)
+{
+	if (pthread_rwlock_init(&db->books_lock, NULL) != 0)
+		return -1;
+	if (pthread_rwlock_init(&db->users_lock, NULL) != 0)
+		goto fail_users;
+	if (pthread_rwlock_init(&db->loans_lock, NULL) != 0)
+		goto fail_loans;
+	if (pthread_rwlock_init(&db->suggestions_lock, NULL) != 0)
+		goto fail_suggestions;
+
+	db->locks_ready = true;
+	return 0;
+
+fail_suggestions:
+	pthread_rwlock_destroy(&db->loans_lock);
+fail_loans:
+	pthread_rwlock_destroy(&db->users_lock);
+fail_users:
+	pthread_rwlock_destroy(&db->books_lock);
+	return -1;
+}
+
+/*
+	Builds the id index of a freshly loaded list.
+	If a file contains the same id twice, the first record in list
+	order wins, which is the one a linear search used to return. The
+	later copies could never be found, updated or removed by id, so
+	they are dropped from the list: build_secondary, the totals and
+	the next save then see exactly the records the index does.
+*/
+static IdIndex *build_index(EpochDomain *epoch, const RecordType *type, DList *list)
+{
+	IdIndex *index = id_index_create(epoch);
+	if (!index)
+		return NULL;
+
+	DListNode *node = list->head;
+	while (node)
+	{
+		DListNode *next = node->next;
+		unsigned id = *(const unsigned *)node->data;
+		if (id_index_get(index, id))
+			dlist_remove_node(list, node, type->free_fn);
+		else if (id_index_put(index, id, node->data, node) != 0)
+		{
+			id_index_destroy(index);
+			return NULL;
+		}
+		node = next;
+	}
+
+	return index;
+}
+
+/*
+	Ordered index maintenance. All of it runs under the table's write
+	lock, and either every index of the record changes or none does.
+*/
+static int ordered_add(DB *db, const RecordType *type, void *record)
+{
+	for (size_t i = 0; i < type->n_ordered; ++i)
+	{
+		const OrderedIndex *o = &type->ordered[i];
+		if (bptree_insert(o->tree(db), o->key(record), record) != 0)
+		{
+			while (i-- > 0)
+				bptree_remove(type->ordered[i].tree(db), type->ordered[i].key(record));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void ordered_remove(DB *db, const RecordType *type, const void *record)
+{
+	for (size_t i = 0; i < type->n_ordered; ++i)
+		bptree_remove(type->ordered[i].tree(db), type->ordered[i].key(record));
+}
+
+/*
+	Moves the entries of old to the keys of src, pointing at record
+	(which is old itself when the update is done in place). Inserting
+	an existing key only swaps the value and cannot fail, so the
+	rollback below always succeeds.
+*/
+static int ordered_update(DB *db, const RecordType *type, const void *old,
+						  const void *src, void *record)
+{
+	for (size_t i = 0; i < type->n_ordered; ++i)
+	{
+		const OrderedIndex *o = &type->ordered[i];
+		if (bptree_insert(o->tree(db), o->key(src), record) == 0)
+			continue;
+
+		while (i-- > 0)
+		{
+			o = &type->ordered[i];
+			if (o->key(src) != o->key(old))
+				bptree_remove(o->tree(db), o->key(src));
+			else
+				bptree_insert(o->tree(db), o->key(old), (void *)old);
+		}
+		return -1;
+	}
+
+	for (size_t i = 0; i < type->n_ordered; ++i)
+	{
+		const OrderedIndex *o = &type->ordered[i];
+		if (o->key(src) != o->key(old))
+			bptree_remove(o->tree(db), o->key(old));
+	}
+	return 0;
+}
+
+/*
+	Puts src into every mirror. If one fails, the mirrors already
+	updated get old back (old == NULL: src is removed from them).
+*/
+static int mirrors_put(DB *db, const RecordType *type, const void *src, const void *old)
+{
+	for (size_t i = 0; i < type->n_mirrors; ++i)
+	{
+		if (type->mirrors[i].put(db, src, old) == 0)
+			continue;
+
+		while (i-- > 0)
+		{
+			if (old)
+				type->mirrors[i].put(db, old, src);
+			else
+				type->mirrors[i].remove(db, src);
+		}
+		return -1;
+	}
+	return 0;
+}
+
+/*
+	Secondary structures of a record: the ordered indexes plus the
+	mirrors of its type. Same all-or-nothing rule.
+*/
+static int secondary_add(DB *db, const RecordType *type, void *record)
+{
+	if (ordered_add(db, type, record) != 0)
+		return -1;
+	if (mirrors_put(db, type, record, NULL) != 0)
+	{
+		ordered_remove(db, type, record);
+		return -1;
+	}
+	return 0;
+}
+
+static void secondary_remove(DB *db, const RecordType *type, const void *record)
+{
+	ordered_remove(db, type, record);
+	for (size_t i = 0; i < type->n_mirrors; ++i)
+		type->mirrors[i].remove(db, record);
+}
+
+/*
+	Mirrors go first: unlike the ordered indexes, they can always be
+	put back to old if ordered_update fails afterwards.
+*/
+static int secondary_update(DB *db, const RecordType *type, const void *old,
+							const void *src, void *record)
+{
+	if (mirrors_put(db, type, src, old) != 0)
+		return -1;
+	if (ordered_update(db, type, old, src, record) != 0)
+	{
+		for (size_t i = 0; i < type->n_mirrors; ++i)
+			type->mirrors[i].put(db, old, src);
+		return -1;
+	}
+	return 0;
+}
+
+/* Fills the ordered indexes and mirrors of a freshly loaded list. */
+static int build_secondary(DB *db, const RecordType *type, DList *list)
+{
+	DLIST_FOREACH(list, node)
+	{
+		if (secondary_add(db, type, node->data) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+	Phase timing helpers for db_init_timed/db_save_timed.
+	When p is NULL (plain db_init/db_save) nothing is measured, apart
+	from the trace span, which is free unless tracing was started.
+*/
+static DList *timed_load(DList *(*load)(const char *), const char *path,
+						 const char *span_name, DBPhaseTiming *p)
+{
+	TRACE_SPAN_BEGIN(span);
+	uint64_t t0 = p ? cutils_now_ns() : 0;
+	DList *list = load(path);
+	TRACE_SPAN_END(span, "fs", span_name);
+
+	if (!p)
+		return list;
+
+	p->ns = cutils_now_ns() - t0;
+	p->rows = list ? dlist_size(list) : 0;
+	p->bytes = db_timings_file_size(path);
+
+	return list;
+}
+
+/* Builds the id index, the ordered indexes and the mirrors of one table. */
+static IdIndex *timed_index(DB *db, const RecordType *type, DList *list,
+							const char *span_name, DBPhaseTiming *p)
+{
+	TRACE_SPAN_BEGIN(span);
+	uint64_t t0 = p ? cutils_now_ns() : 0;
+	IdIndex *index = build_index(db->epoch, type, list);
+	if (index && build_secondary(db, type, list) != 0)
+	{
+		id_index_destroy(index);
+		index = NULL;
+	}
+	TRACE_SPAN_END(span, "db", span_name);
+
+	if (!p)
+		return index;
+
+	p->ns = cutils_now_ns() - t0;
+	p->rows = dlist_size(list);
+	p->bytes = 0;
+
+	return index;
+}
+
+/*
+	Writes one table under its read lock. A table that never loaded
+	(db_init failed) is skipped, leaving its file as it was, and
+	counts as a failed save.
+*/
+static int timed_save(const DB *db, const pthread_rwlock_t *lock,
+					  int (*save)(const char *, const DList *),
+					  const char *path, const DList *list,
+					  const char *span_name, DBPhaseTiming *p)
+{
+	if (!list)
+	{
+		if (p)
+			*p = (DBPhaseTiming){ 0, 0, db_timings_file_size(path) };
+		return -1;
+	}
+
+	uint64_t t0 = p ? cutils_now_ns() : 0;
+
+	table_read_lock(db, lock);
+	TRACE_SPAN_BEGIN(span);
+	int rc = save(path, list);
+	TRACE_SPAN_END(span, "fs", span_name);
+	if (p)
+		p->rows = list->size;
+	table_unlock(db, lock);
+
+	if (p)
+	{
+		p->ns = cutils_now_ns() - t0;
+		p->bytes = db_timings_file_size(path);
+	}
+
+	return rc;
+}
+
+/*
+	Loads all data from the filesystem layer into the DB.
+
+	On success, the three lists (books/users/loans) are ready to use.
+	On error (e.g. out of memory), any partially created lists
+	are destroyed and the function returns -1.
+*/
+static int load_tables(DB *db,
+					   const char *books_path,
+					   const char *users_path,
+					   const char *loans_path,
+					   const char *suggestions_path,
+					   DBTimings *t)
+{
+	db->books = NULL;
+	db->users = NULL;
+	db->loans = NULL;
+	db->suggestions = NULL;
+	db->concurrent = false;
+	db->locks_ready = false;
+	db->epoch = NULL;
+	db->book_index = NULL;
+	db->user_index = NULL;
+	db->loan_index = NULL;
+	db->suggestion_index = NULL;
+	db->books_by_year = NULL;
+	db->loans_by_borrow = NULL;
+	db->loans_by_return = NULL;
+	db->books_by_id = NULL;
+	db->users_by_id = NULL;
+	db->loans_by_id = NULL;
+	db->suggestions_by_id = NULL;
+	db->loan_columns = NULL;
+	db->due_wheel = NULL;
+	db->active_loans = NULL;
+	db->book_loans = NULL;
+	db->user_loans = NULL;
+	db->loans_active = 0;
+	db->copies_available = 0;
+	db->reservations = NULL;
+	db->recommendations = NULL;
+	db->book_titles = NULL;
+	db->suggestion_titles = NULL;
+	db->book_title_keys = NULL;
+	db->book_author_keys = NULL;
+	db->user_name_keys = NULL;
+
+	if (db_init_locks(db) != 0)
+		return -1;
+
+	db->books = timed_load(file_load_books, books_path, "file_load_books",
+						   t ? &t->load[DB_TABLE_BOOKS] : NULL);
+	db->users = timed_load(file_load_users, users_path, "file_load_users",
+						   t ? &t->load[DB_TABLE_USERS] : NULL);
+	db->loans = timed_load(file_load_loans, loans_path, "file_load_loans",
+						   t ? &t->load[DB_TABLE_LOANS] : NULL);
+	db->suggestions = timed_load(file_load_suggestions, suggestions_path,
+								 "file_load_suggestions",
+								 t ? &t->load[DB_TABLE_SUGGESTIONS] : NULL);
+
+	if (!db->books || !db->users || !db->loans || !db->suggestions)
+	{
+		/* Clean up anything that was allocated before signaling failure. */
+		db_destroy(db);
+		return -1;
+	}
+
+	db->epoch = epoch_create();
+	db->books_by_year = bptree_create();
+	db->loans_by_borrow = bptree_create();
+	db->loans_by_return = bptree_create();
+	db->books_by_id = bptree_create();
+	db->users_by_id = bptree_create();
+	db->loans_by_id = bptree_create();
+	db->suggestions_by_id = bptree_create();
+	db->loan_columns = loan_columns_create(dlist_size(db->loans));
+	db->due_wheel = due_wheel_create(date_today());
+	db->active_loans = id_counts_create();
+	db->book_loans = id_counts_create();
+	db->user_loans = id_counts_create();
+	db->reservations = reservation_queues_create();
+	db->book_titles = title_index_create();
+	db->suggestion_titles = title_index_create();
+	db->book_title_keys = prefix_index_create();
+	db->book_author_keys = prefix_index_create();
+	db->user_name_keys = prefix_index_create();
+	if (!db->epoch || !db->books_by_year || !db->loans_by_borrow || !db->loans_by_return ||
+		!db->books_by_id || !db->users_by_id || !db->loans_by_id || !db->suggestions_by_id ||
+		!db->loan_columns || !db->due_wheel || !db->active_loans || !db->book_loans ||
+		!db->user_loans || !db->reservations || !db->book_titles || !db->suggestion_titles ||
+		!db->book_title_keys || !db->book_author_keys || !db->user_name_keys)
+	{
+		db_destroy(db);
+		return -1;
+	}
+
+	db->book_index = timed_index(db, &book_type, db->books, "index_books",
+								 t ? &t->index[DB_TABLE_BOOKS] : NULL);
+	db->user_index = timed_index(db, &user_type, db->users, "index_users",
+								 t ? &t->index[DB_TABLE_USERS] : NULL);
+	db->loan_index = timed_index(db, &loan_type, db->loans, "index_loans",
+								 t ? &t->index[DB_TABLE_LOANS] : NULL);
+	db->suggestion_index = timed_index(db, &suggestion_type, db->suggestions,
+									   "index_suggestions",
+									   t ? &t->index[DB_TABLE_SUGGESTIONS] : NULL);
+
+	if (!db->book_index || !db->user_index || !db->loan_index || !db->suggestion_index)
+	{
+		db_destroy(db);
+		return -1;
+	}
+
+	return 0;
+}
+
+int db_init(DB *db,
+			const char *books_path,
+			const char *users_path,
+			const char *loans_path,
+			const char *suggestions_path)
+{
+	return db_init_timed(db, books_path, users_path, loans_path,
+						 suggestions_path, NULL);
+}
+
+int db_init_timed(DB *db,
+				  const char *books_path,
+				  const char *users_path,
+				  const char *loans_path,
+				  const char *suggestions_path,
+				  DBTimings *timings)
+{
+	if (!db)
+		return -1;
+
+	if (timings)
+	{
+		memset(timings->load, 0, sizeof timings->load);
+		memset(timings->index, 0, sizeof timings->index);
+	}
+
+	uint64_t start = timings ? cutils_now_ns() : 0;
+	TRACE_SPAN_BEGIN(span);
+	DB_STATS_START(t0);
+	int rc = load_tables(db, books_path, users_path, loans_path,
+						 suggestions_path, timings);
+	DB_STATS_STOP(t0, DB_OP_INIT);
+	TRACE_SPAN_END(span, "db", "db_init");
+	if (timings)
+		timings->init_ns = cutils_now_ns() - start;
+	return rc;
+}
+
+/*
+	Persists the current in-memory state of the DB to disk.
+	Each list is written using the filesystem helpers, overwriting
+	the corresponding .txt file with a header + all records.
+
+	In concurrent mode each table is read-locked while it is written,
+	so the files are individually consistent snapshots.
+*/
+int db_save(const DB *db,
+			const char *books_path,
+			const char *users_path,
+			const char *loans_path,
+			const char *suggestions_path)
+{
+	return db_save_timed(db, books_path, users_path, loans_path,
+						 suggestions_path, NULL);
+}
+
+int db_save_timed(const DB *db,
+				  const char *books_path,
+				  const char *users_path,
+				  const char *loans_path,
+				  const char *suggestions_path,
+				  DBTimings *timings)
+{
+	if (!db)
+		return -1;
+
+	DBPhaseTiming *p = timings ? timings->save : NULL;
+	uint64_t start = timings ? cutils_now_ns() : 0;
+	TRACE_SPAN_BEGIN(span);
+	DB_STATS_START(t0);
+	int ok = 0;
+
+	if (timed_save(db, &db->books_lock, file_save_books, books_path,
+				   db->books, "file_save_books",
+				   p ? &p[DB_TABLE_BOOKS] : NULL) != 0)
+		ok = -1;
+	if (timed_save(db, &db->users_lock, file_save_users, users_path,
+				   db->users, "file_save_users",
+				   p ? &p[DB_TABLE_USERS] : NULL) != 0)
+		ok = -1;
+	if (timed_save(db, &db->loans_lock, file_save_loans, loans_path,
+				   db->loans, "file_save_loans",
+				   p ? &p[DB_TABLE_LOANS] : NULL) != 0)
+		ok = -1;
+	if (timed_save(db, &db->suggestions_lock, file_save_suggestions,
+				   suggestions_path, db->suggestions, "file_save_suggestions",
+				   p ? &p[DB_TABLE_SUGGESTIONS] : NULL) != 0)
+		ok = -1;
+
+	DB_STATS_STOP(t0, DB_OP_SAVE);
+	TRACE_SPAN_END(span, "db", "db_save");
+	if (timings)
+		timings->save_ns = cutils_now_ns() - start;
+	return ok;
+}
+
+/*
+	Releases all memory owned by the DB.
+	Each list is destroyed and every stored Book/User/Loan is freed.
+*/
+void db_destroy(DB *db)
+{
+	if (!db)
+		return;
+
+	id_index_destroy(db->book_index);
+	id_index_destroy(db->user_index);
+	id_index_destroy(db->loan_index);
+	id_index_destroy(db->suggestion_index);
+	db->book_index = NULL;
+	db->user_index = NULL;
+	db->loan_index = NULL;
+	db->suggestion_index = NULL;
+
+	bptree_destroy(db->books_by_year);
+	bptree_destroy(db->loans_by_borrow);
+	bptree_destroy(db->loans_by_return);
+	bptree_destroy(db->books_by_id);
+	bptree_destroy(db->users_by_id);
+	bptree_destroy(db->loans_by_id);
+	bptree_destroy(db->suggestions_by_id);
+	db->books_by_year = NULL;
+	db->loans_by_borrow = NULL;
+	db->loans_by_return = NULL;
+	db->books_by_id = NULL;
+	db->users_by_id = NULL;
+	db->loans_by_id = NULL;
+	db->suggestions_by_id = NULL;
+
+	loan_columns_destroy(db->loan_columns);
+	due_wheel_destroy(db->due_wheel);
+	id_counts_destroy(db->active_loans);
+	id_counts_destroy(db->book_loans);
+	id_counts_destroy(db->user_loans);
+	reservation_queues_destroy(db->reservations);
+	recommendations_destroy(db->recommendations);
+	title_index_destroy(db->book_titles);
+	title_index_destroy(db->suggestion_titles);
+	prefix_index_destroy(db->book_title_keys);
+	prefix_index_destroy(db->book_author_keys);
+	prefix_index_destroy(db->user_name_keys);
+	db->loan_columns = NULL;
+	db->due_wheel = NULL;
+	db->active_loans = NULL;
+	db->book_loans = NULL;
+	db->user_loans = NULL;
+	db->loans_active = 0;
+	db->copies_available = 0;
+	db->reservations = NULL;
+	db->recommendations = NULL;
+	db->book_titles = NULL;
+	db->suggestion_titles = NULL;
+	db->book_title_keys = NULL;
+	db->book_author_keys = NULL;
+	db->user_name_keys = NULL;
+
+	if (db->books)
+		dlist_destroy(db->books, free_book);
+	if (db->users)
+		dlist_destroy(db->users, free_user);
+	if (db->loans)
+		dlist_destroy(db->loans, free_loan);
+	if (db->suggestions)
+		dlist_destroy(db->suggestions, free_suggestion);
+
+	db->books = NULL;
+	db->users = NULL;
+	db->loans = NULL;
+	db->suggestions = NULL;
+
+	/* Frees every record and bucket array still waiting for reclamation. */
+	epoch_destroy(db->epoch);
+	db->epoch = NULL;
+
+	if (db->locks_ready)
+	{
+		pthread_rwlock_destroy(&db->books_lock);
+		pthread_rwlock_destroy(&db->users_lock);
+		pthread_rwlock_destroy(&db->loans_lock);
+		pthread_rwlock_destroy(&db->suggestions_lock);
+		db->locks_ready = false;
+	}
+	db->concurrent = false;
+}
+
+void db_set_concurrent(DB *db, bool enabled)
+{
+	if (!db || !db->locks_ready)
+		return;
+
+	db->concurrent = enabled;
+}
+
+/*
+	Read sections.
+	Thin wrappers over the epoch domain so callers never need to know
+	how reclamation works.
+*/
+void db_read_begin(const DB *db)
+{
+	if (db && db->epoch)
+		epoch_enter(db->epoch);
+}
+
+void db_read_end(const DB *db)
+{
+	if (db && db->epoch)
+		epoch_exit(db->epoch);
+}
+
+/*
+	Index lookups.
+	The index is probed without any lock; in concurrent mode the caller
+	is expected to be inside a read section (see db.h).
+*/
+
+Book *db_find_book_by_id(const DB *db, unsigned id)
+{
+	if (!db || !db->books)
+		return NULL;
+
+	if (db_recording())
+		db_record_id(DB_OP_FIND_BOOK, id);
+	DB_STATS_START(t0);
+	Book *found = id_index_get(db->book_index, id);
+	DB_STATS_STOP(t0, DB_OP_FIND_BOOK);
+	return found;
+}
+
+User *db_find_user_by_id(const DB *db, unsigned id)
+{
+	if (!db || !db->users)
+		return NULL;
+
+	if (db_recording())
+		db_record_id(DB_OP_FIND_USER, id);
+	DB_STATS_START(t0);
+	User *found = id_index_get(db->user_index, id);
+	DB_STATS_STOP(t0, DB_OP_FIND_USER);
+	return found;
+}
+
+Loan *db_find_loan_by_id(const DB *db, unsigned id)
+{
+	if (!db || !db->loans)
+		return NULL;
+
+	if (db_recording())
+		db_record_id(DB_OP_FIND_LOAN, id);
+	DB_STATS_START(t0);
+	Loan *found = id_index_get(db->loan_index, id);
+	DB_STATS_STOP(t0, DB_OP_FIND_LOAN);
+	return found;
+}
+
+Suggestion *db_find_suggestion_by_id(const DB *db, unsigned id)
+{
+	if (!db || !db->suggestions)
+		return NULL;
+
+	if (db_recording())
+		db_record_id(DB_OP_FIND_SUGGESTION, id);
+	DB_STATS_START(t0);
+	Suggestion *found = id_index_get(db->suggestion_index, id);
+	DB_STATS_STOP(t0, DB_OP_FIND_SUGGESTION);
+	return found;
+}
+
+/*
+	Copying lookups.
+	The record is copied inside a read section, so the caller gets a
+	consistent snapshot even if another thread removes or replaces the
+	record at the same time.
+*/
+static int copy_by_id(const DB *db, const IdIndex *index, unsigned id,
+					  void *out, size_t size)
+{
+	int rc = -1;
+
+	db_read_begin(db);
+	const void *record = id_index_get(index, id);
+	if (record)
+	{
+		memcpy(out, record, size);
+		rc = 0;
+	}
+	db_read_end(db);
+
+	return rc;
+}
+
+int db_copy_book_by_id(const DB *db, unsigned id, Book *out)
+{
+	if (!db || !db->books || !out)
+		return -1;
+
+	if (db_recording())
+		db_record_id(DB_OP_COPY_BOOK, id);
+	DB_STATS_START(t0);
+	int rc = copy_by_id(db, db->book_index, id, out, sizeof *out);
+	DB_STATS_STOP(t0, DB_OP_COPY_BOOK);
+	return rc;
+}
+
+int db_copy_user_by_id(const DB *db, unsigned id, User *out)
+{
+	if (!db || !db->users || !out)
+		return -1;
+
+	if (db_recording())
+		db_record_id(DB_OP_COPY_USER, id);
+	DB_STATS_START(t0);
+	int rc = copy_by_id(db, db->user_index, id, out, sizeof *out);
+	DB_STATS_STOP(t0, DB_OP_COPY_USER);
+	return rc;
+}
+
+int db_copy_loan_by_id(const DB *db, unsigned id, Loan *out)
+{
+	if (!db || !db->loans || !out)
+		return -1;
+
+	if (db_recording())
+		db_record_id(DB_OP_COPY_LOAN, id);
+	DB_STATS_START(t0);
+	int rc = copy_by_id(db, db->loan_index, id, out, sizeof *out);
+	DB_STATS_STOP(t0, DB_OP_COPY_LOAN);
+	return rc;
+}
+
+int db_copy_suggestion_by_id(const DB *db, unsigned id, Suggestion *out)
+{
+	if (!db || !db->suggestions || !out)
+		return -1;
+
+	if (db_recording())
+		db_record_id(DB_OP_COPY_SUGGESTION, id);
+	DB_STATS_START(t0);
+	int rc = copy_by_id(db, db->suggestion_index, id, out, sizeof *out);
+	DB_STATS_STOP(t0, DB_OP_COPY_SUGGESTION);
+	return rc;
+}
+
+/*
+	Callback iteration.
+	The generic walker holds the read lock for the whole traversal and
+	stops at the first non-zero visitor result.
+*/
+static int db_foreach(const DB *db, const DList *list,
+					  const pthread_rwlock_t *lock,
+					  int (*fn)(const void *, void *), void *ctx)
+{
+	int rc = 0;
+
+	table_read_lock(db, lock);
+	DLIST_FOREACH(list, node)
+	{
+		rc = fn(node->data, ctx);
+		if (rc != 0)
+			break;
+	}
+	table_unlock(db, lock);
+
+	return rc;
+}
+
+/*
+	The typed visitors only differ from the generic one in the type
+	of their first parameter, so they are adapted through a tiny
+	trampoline instead of casting function pointers.
+*/
+struct visit_ctx {
+	union {
+		DBBookVisitor book;
+		DBUserVisitor user;
+		DBLoanVisitor loan;
+		DBSuggestionVisitor suggestion;
+	} fn;
+	void *ctx;
+};
+
+static int visit_book(const void *p, void *c)
+{
+	struct visit_ctx *v = c;
+	return v->fn.book((const Book *)p, v->ctx);
+}
+
+static int visit_user(const void *p, void *c)
+{
+	struct visit_ctx *v = c;
+	return v->fn.user((const User *)p, v->ctx);
+}
+
+static int visit_loan(const void *p, void *c)
+{
+	struct visit_ctx *v = c;
+	return v->fn.loan((const Loan *)p, v->ctx);
+}
+
+static int visit_suggestion(const void *p, void *c)
+{
+	struct visit_ctx *v = c;
+	return v->fn.suggestion((const Suggestion *)p, v->ctx);
+}
+
+int db_foreach_book(const DB *db, DBBookVisitor fn, void *ctx)
+{
+	if (!db || !db->books || !fn)
+		return -1;
+
+	struct visit_ctx v = { .fn.book = fn, .ctx = ctx };
+	if (db_recording())
+		db_record_none(DB_OP_FOREACH_BOOK);
+	DB_STATS_START(t0);
+	int rc = db_foreach(db, db->books, &db->books_lock, visit_book, &v);
+	DB_STATS_STOP(t0, DB_OP_FOREACH_BOOK);
+	return rc;
+}
+
+int db_foreach_user(const DB *db, DBUserVisitor fn, void *ctx)
+{
+	if (!db || !db->users || !fn)
+		return -1;
+
+	struct visit_ctx v = { .fn.user = fn, .ctx = ctx };
+	if (db_recording())
+		db_record_none(DB_OP_FOREACH_USER);
+	DB_STATS_START(t0);
+	int rc = db_foreach(db, db->users, &db->users_lock, visit_user, &v);
+	DB_STATS_STOP(t0, DB_OP_FOREACH_USER);
+	return rc;
+}
+
+int db_foreach_loan(const DB *db, DBLoanVisitor fn, void *ctx)
+{
+	if (!db || !db->loans || !fn)
+		return -1;
+
+	struct visit_ctx v = { .fn.loan = fn, .ctx = ctx };
+	if (db_recording())
+		db_record_none(DB_OP_FOREACH_LOAN);
+	DB_STATS_START(t0);
+	int rc = db_foreach(db, db->loans, &db->loans_lock, visit_loan, &v);
+	DB_STATS_STOP(t0, DB_OP_FOREACH_LOAN);
+	return rc;
+}
+
+int db_foreach_suggestion(const DB *db, DBSuggestionVisitor fn, void *ctx)
+{
+	if (!db || !db->suggestions || !fn)
+		return -1;
+
+	struct visit_ctx v = { .fn.suggestion = fn, .ctx = ctx };
+	if (db_recording())
+		db_record_none(DB_OP_FOREACH_SUGGESTION);
+	DB_STATS_START(t0);
+	int rc = db_foreach(db, db->suggestions, &db->suggestions_lock,
+					    visit_suggestion, &v);
+	DB_STATS_STOP(t0, DB_OP_FOREACH_SUGGESTION);
+	return rc;
+}
+
+/*
+	Search.
+	The term is matched as a case-insensitive substring; an empty term
+	matches every book.
+*/
+static int contains_case_insensitive(const char *text, const char *needle)
+{
+	size_t needle_len = strlen(needle);
+	if (needle_len == 0)
+		return 1;
+
+	for (const char *p = text; *p; ++p)
+	{
+		size_t matched = 0;
+		while (p[matched] && needle[matched] &&
+			   tolower((unsigned char)p[matched]) == tolower((unsigned char)needle[matched]))
+		{
+			++matched;
+		}
+
+		if (matched == needle_len)
+			return 1;
+	}
+
+	return 0;
+}
+
+struct search_ctx {
+	DBBookField field;
+	const char *term;
+	DBBookVisitor fn;
+	void *ctx;
+};
+
+static int search_visitor(const Book *b, void *c)
+{
+	struct search_ctx *search = c;
+	const char *text = (search->field == DB_BOOK_TITLE) ? b->title : b->author;
+
+	if (!contains_case_insensitive(text, search->term))
+		return 0;
+
+	return search->fn(b, search->ctx);
+}
+
+int db_search_books(const DB *db, DBBookField field, const char *term,
+					DBBookVisitor fn, void *ctx)
+{
+	if (!db || !db->books || !term || !fn)
+		return -1;
+
+	/* Walks the table directly so the scan is not also counted as a foreach_book. */
+	struct search_ctx search = { field, term, fn, ctx };
+	struct visit_ctx v = { .fn.book = search_visitor, .ctx = &search };
+	if (db_recording())
+		db_record_search(field, term);
+	DB_STATS_START(t0);
+	int rc = db_foreach(db, db->books, &db->books_lock, visit_book, &v);
+	DB_STATS_STOP(t0, DB_OP_SEARCH_BOOKS);
+	return rc;
+}
+
+/*
+	Range queries.
+	The cursor walks the leaves from the first key of the range, under
+	the table's read lock, until it passes the last one.
+*/
+static int ordered_range(const DB *db, const pthread_rwlock_t *lock,
+						 const BPTree *tree, uint64_t lo, uint64_t hi,
+						 int (*fn)(const void *, void *), void *ctx)
+{
+	int rc = 0;
+	BPTreeCursor cur;
+	uint64_t key;
+	void *record;
+
+	table_read_lock(db, lock);
+	bptree_seek(tree, lo, &cur);
+	while (bptree_next(&cur, &key, &record) && key <= hi)
+	{
+		rc = fn(record, ctx);
+		if (rc != 0)
+			break;
+	}
+	table_unlock(db, lock);
+
+	return rc;
+}
+
+int db_books_by_year_range(const DB *db, int from, int to,
+						   DBBookVisitor fn, void *ctx)
+{
+	if (!db || !db->books_by_year || !fn)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_BOOKS_BY_YEAR, (unsigned)from, (unsigned)to);
+	if (from > to)
+		return 0;
+
+	struct visit_ctx v = { .fn.book = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = ordered_range(db, &db->books_lock, db->books_by_year,
+						   bptree_key(year_bias(from), 0),
+						   bptree_key(year_bias(to), UINT32_MAX),
+						   visit_book, &v);
+	DB_STATS_STOP(t0, DB_OP_BOOKS_BY_YEAR);
+	return rc;
+}
+
+int db_loans_by_borrow_date(const DB *db, unsigned from, unsigned to,
+							DBLoanVisitor fn, void *ctx)
+{
+	if (!db || !db->loans_by_borrow || !fn)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_LOANS_BY_BORROW, from, to);
+	if (from > to)
+		return 0;
+
+	struct visit_ctx v = { .fn.loan = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = ordered_range(db, &db->loans_lock, db->loans_by_borrow,
+						   bptree_key(date_ceil_yyyymmdd(from), 0),
+						   bptree_key(date_from_yyyymmdd(to), UINT32_MAX),
+						   visit_loan, &v);
+	DB_STATS_STOP(t0, DB_OP_LOANS_BY_BORROW);
+	return rc;
+}
+
+int db_loans_by_return_date(const DB *db, unsigned from, unsigned to,
+							DBLoanVisitor fn, void *ctx)
+{
+	if (!db || !db->loans_by_return || !fn)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_LOANS_BY_RETURN, from, to);
+	if (from > to)
+		return 0;
+
+	struct visit_ctx v = { .fn.loan = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = ordered_range(db, &db->loans_lock, db->loans_by_return,
+						   bptree_key(date_ceil_yyyymmdd(from), 0),
+						   bptree_key(date_from_yyyymmdd(to), UINT32_MAX),
+						   visit_loan, &v);
+	DB_STATS_STOP(t0, DB_OP_LOANS_BY_RETURN);
+	return rc;
+}
+
+/*
+	Keyset pagination.
+	The id trees hold UINT32_MAX - id, so the ids below after_id start
+	right past its key and come out highest first.
+*/
+static int table_page(const DB *db, const pthread_rwlock_t *lock,
+					  const BPTree *tree, unsigned after_id, size_t limit,
+					  int (*fn)(const void *, void *), void *ctx,
+					  unsigned *next_after)
+{
+	int visited = 0;
+	bool stopped = false;
+	BPTreeCursor cur;
+	void *record;
+
+	*next_after = 0;
+
+	table_read_lock(db, lock);
+	bptree_seek(tree, after_id ? id_desc_key(after_id) + 1 : 0, &cur);
+	while ((size_t)visited < limit && visited < INT_MAX && bptree_next(&cur, NULL, &record))
+	{
+		++visited;
+		*next_after = *(const unsigned *)record;
+		if (fn(record, ctx) != 0)
+		{
+			stopped = true;
+			break;
+		}
+	}
+
+	/* Only hand out a cursor if something follows the page. */
+	if (!stopped && !bptree_next(&cur, NULL, NULL))
+		*next_after = 0;
+	table_unlock(db, lock);
+
+	return visited;
+}
+
+int db_books_page(const DB *db, unsigned after_id, size_t limit,
+				  DBBookVisitor fn, void *ctx, unsigned *next_after)
+{
+	if (!db || !db->books_by_id || !fn || !next_after || limit == 0)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_PAGE_BOOKS, after_id, (unsigned)limit);
+
+	struct visit_ctx v = { .fn.book = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = table_page(db, &db->books_lock, db->books_by_id, after_id, limit,
+						visit_book, &v, next_after);
+	DB_STATS_STOP(t0, DB_OP_PAGE_BOOKS);
+	return rc;
+}
+
+int db_users_page(const DB *db, unsigned after_id, size_t limit,
+				  DBUserVisitor fn, void *ctx, unsigned *next_after)
+{
+	if (!db || !db->users_by_id || !fn || !next_after || limit == 0)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_PAGE_USERS, after_id, (unsigned)limit);
+
+	struct visit_ctx v = { .fn.user = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = table_page(db, &db->users_lock, db->users_by_id, after_id, limit,
+						visit_user, &v, next_after);
+	DB_STATS_STOP(t0, DB_OP_PAGE_USERS);
+	return rc;
+}
+
+int db_loans_page(const DB *db, unsigned after_id, size_t limit,
+				  DBLoanVisitor fn, void *ctx, unsigned *next_after)
+{
+	if (!db || !db->loans_by_id || !fn || !next_after || limit == 0)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_PAGE_LOANS, after_id, (unsigned)limit);
+
+	struct visit_ctx v = { .fn.loan = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = table_page(db, &db->loans_lock, db->loans_by_id, after_id, limit,
+						visit_loan, &v, next_after);
+	DB_STATS_STOP(t0, DB_OP_PAGE_LOANS);
+	return rc;
+}
+
+int db_suggestions_page(const DB *db, unsigned after_id, size_t limit,
+						DBSuggestionVisitor fn, void *ctx, unsigned *next_after)
+{
+	if (!db || !db->suggestions_by_id || !fn || !next_after || limit == 0)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_PAGE_SUGGESTIONS, after_id, (unsigned)limit);
+
+	struct visit_ctx v = { .fn.suggestion = fn, .ctx = ctx };
+	DB_STATS_START(t0);
+	int rc = table_page(db, &db->suggestions_lock, db->suggestions_by_id, after_id,
+						limit, visit_suggestion, &v, next_after);
+	DB_STATS_STOP(t0, DB_OP_PAGE_SUGGESTIONS);
+	return rc;
+}
+
+/*
+	Bulk loan filters.
+	The scan itself lives in loan_columns.c; here it only runs under
+	the loans read lock.
+*/
+int db_loans_count(const DB *db, const LoanFilter *filter, size_t *count)
+{
+	if (!db || !db->loan_columns || !filter || !count)
+		return -1;
+
+	if (db_recording())
+		db_record_filter(DB_OP_COUNT_LOANS, filter, 0);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	*count = loan_columns_count(db->loan_columns, filter);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_COUNT_LOANS);
+	return 0;
+}
+
+int db_loans_select(const DB *db, const LoanFilter *filter,
+					unsigned *ids, size_t cap, size_t *count)
+{
+	if (!db || !db->loan_columns || !filter || !count || (!ids && cap))
+		return -1;
+
+	if (db_recording())
+		db_record_filter(DB_OP_SELECT_LOANS, filter, cap);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	*count = loan_columns_select(db->loan_columns, filter, ids, cap);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_SELECT_LOANS);
+	return 0;
+}
+
+int db_loans_days_out(const DB *db, const LoanFilter *filter, size_t *returned, uint64_t *days)
+{
+	if (!db || !db->loan_columns || !filter || !returned || !days)
+		return -1;
+
+	if (db_recording())
+		db_record_filter(DB_OP_LOANS_DAYS_OUT, filter, 0);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	*returned = loan_columns_days_out(db->loan_columns, filter, days);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_LOANS_DAYS_OUT);
+	return 0;
+}
+
+/*
+	Due dates.
+	The wheel only stores ids; each one is resolved through the id
+	index while the loans lock keeps writers out.
+*/
+struct due_visit {
+	const DB *db;
+	uint32_t before; /* overdue: only entries due before this day */
+	DBLoanVisitor fn;
+	void *ctx;
+};
+
+static int visit_due_loan(unsigned id, uint32_t due, void *c)
+{
+	struct due_visit *v = c;
+	if (due >= v->before)
+		return 0;
+
+	const Loan *l = id_index_get(v->db->loan_index, id);
+	return l ? v->fn(l, v->ctx) : 0;
+}
+
+int db_loans_due_on(const DB *db, unsigned date, DBLoanVisitor fn, void *ctx)
+{
+	if (!db || !db->due_wheel || !fn)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_LOANS_DUE_ON, date, 0);
+	/* Nothing is due on a value that is not a real date. */
+	Date day = date_from_yyyymmdd(date);
+	if (date_to_yyyymmdd(day) != date)
+		return 0;
+
+	struct due_visit v = { db, UINT32_MAX, fn, ctx };
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	int rc = due_wheel_visit_due(db->due_wheel, day, visit_due_loan, &v);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_LOANS_DUE_ON);
+	return rc;
+}
+
+int db_loans_overdue(DB *db, unsigned today, DBLoanVisitor fn, void *ctx)
+{
+	if (!db || !db->due_wheel || !fn)
+		return -1;
+
+	if (db_recording())
+		db_record_range(DB_OP_LOANS_OVERDUE, today, 0);
+	Date day = date_ceil_yyyymmdd(today);
+	struct due_visit v = { db, day, fn, ctx };
+	DB_STATS_START(t0);
+	/* Advancing changes the wheel; a day earlier than its current one just filters. */
+	table_write_lock(db, &db->loans_lock);
+	due_wheel_advance(db->due_wheel, day);
+	int rc = due_wheel_visit_overdue(db->due_wheel, visit_due_loan, &v);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_LOANS_OVERDUE);
+	return rc;
+}
+
+void db_thread_exit(const DB *db)
+{
+	if (db && db->epoch)
+		epoch_thread_exit(db->epoch);
+}
+
+/* Simple accessors so UI code can iterate over lists. */
+
+DList *db_get_books(const DB *db)
+{
+	return db ? db->books : NULL;
+}
+
+DList *db_get_users(const DB *db)
+{
+	return db ? db->users : NULL;
+}
+
+DList *db_get_loans(const DB *db)
+{
+	return db ? db->loans : NULL;
+}
+
+DList *db_get_suggestions(const DB *db)
+{
+	return db ? db->suggestions : NULL;
+}
+
+/*
+	Generic write helpers shared by the four tables.
+	Every record type starts with its 'unsigned id', and the list, lock
+	and index of a table are passed explicitly.
+*/
+
+/*
+	Releases a record that was just unlinked from a table.
+	In concurrent mode a lock-free reader may still be copying it, so
+	it goes through the epoch domain instead of being freed directly.
+*/
+static void release_record(DB *db, const RecordType *type, void *record)
+{
+	if (db->concurrent)
+		epoch_retire(db->epoch, record, type->free_fn);
+	else
+		type->free_fn(record);
+}
+
+/*
+	Links record (a private copy) into a table whose write lock is held.
+	When auto_id is not NULL the id is chosen here (one past the head,
+	which always holds the highest id) and also stored in *auto_id.
+	On failure nothing was linked and the caller still owns record.
+*/
+static int insert_locked(DB *db, DList *list, IdIndex *index,
+						 const RecordType *type, void *record, unsigned *auto_id)
+{
+	unsigned id = *(const unsigned *)record;
+	if (auto_id)
+	{
+		id = list->head ? *(const unsigned *)list->head->data + 1 : 1;
+		*(unsigned *)record = id;
+	}
+
+	if (id_index_get(index, id))
+		return -1;
+
+	/* The id index goes last: lock-free readers may see the record from then on. */
+	DListNode *node = dlist_insert_priority(list, record, id_priority(id));
+	if (!node)
+		return -1;
+	if (secondary_add(db, type, record) == 0)
+	{
+		if (id_index_put(index, id, record, node) == 0)
+		{
+			if (auto_id)
+				*auto_id = id;
+			return 0;
+		}
+		secondary_remove(db, type, record);
+	}
+	dlist_remove_node(list, node, NULL);
+	return -1;
+}
+
+/*
+	Replaces the record with src's id, under the table's write lock.
+	In concurrent mode the new version is a fresh copy; spare, when not
+	NULL, may hold a block allocated beforehand for it (it is consumed
+	and set to NULL), so that the only failure left is in the secondary
+	structures.
+*/
+static int update_locked(DB *db, IdIndex *index, const RecordType *type,
+						 const void *src, void **spare)
+{
+	unsigned id = *(const unsigned *)src;
+	DListNode *node = id_index_aux(index, id);
+	if (!node)
+		return -1;
+
+	if (!db->concurrent)
+	{
+		if (secondary_update(db, type, node->data, src, node->data) != 0)
+			return -1;
+		memcpy(node->data, src, type->size);
+		return 0;
+	}
+
+	/* Copy-on-write so lock-free readers never see a torn record. */
+	void *record = spare && *spare ? *spare : aed_malloc(type->category, type->size);
+	if (spare)
+		*spare = NULL;
+	if (!record)
+		return -1;
+
+	memcpy(record, src, type->size);
+	void *old = node->data;
+	if (secondary_update(db, type, old, record, record) != 0)
+	{
+		type->free_fn(record);
+		return -1;
+	}
+	node->data = record;
+	id_index_put(index, id, record, node);
+	epoch_retire(db->epoch, old, type->free_fn);
+	return 0;
+}
+
+/* Unlinks and releases the record of id, under the table's write lock. */
+static int remove_locked(DB *db, DList *list, IdIndex *index,
+						 const RecordType *type, unsigned id)
+{
+	DListNode *node = id_index_aux(index, id);
+	if (!node)
+		return -1;
+
+	void *record = node->data;
+	secondary_remove(db, type, record);
+	id_index_remove(index, id);
+	dlist_remove_node(list, node, NULL);
+	release_record(db, type, record);
+	return 0;
+}
+
+/* Inserts a copy of src (see insert_locked for auto_id). */
+static int table_add(DB *db, DList *list, const pthread_rwlock_t *lock,
+					 IdIndex *index, const RecordType *type, const void *src,
+					 unsigned *auto_id)
+{
+	void *record = aed_malloc(type->category, type->size);
+	if (!record)
+		return -1;
+
+	memcpy(record, src, type->size);
+
+	table_write_lock(db, lock);
+	int rc = insert_locked(db, list, index, type, record, auto_id);
+	table_unlock(db, lock);
+
+	if (rc != 0)
+		type->free_fn(record);
+	return rc;
+}
+
+static int table_update(DB *db, const pthread_rwlock_t *lock,
+						IdIndex *index, const RecordType *type, const void *src)
+{
+	table_write_lock(db, lock);
+	int rc = update_locked(db, index, type, src, NULL);
+	table_unlock(db, lock);
+
+	return rc;
+}
+
+static int table_remove(DB *db, DList *list, const pthread_rwlock_t *lock,
+						IdIndex *index, const RecordType *type, unsigned id)
+{
+	table_write_lock(db, lock);
+	int rc = remove_locked(db, list, index, type, id);
+	table_unlock(db, lock);
+
+	return rc;
+}
+
+/*
+	CRUD - Create helpers.
+
+	Each "add" function:
+		- validates the DB and source pointer,
+		- allocates a new element on the heap,
+		- copies the contents of the provided struct,
+		- inserts it in the appropriate list and id index.
+
+	The caller is responsible for picking an id (e.g. next free id).
+*/
+
+int db_add_book(DB *db, const Book *src)
+{
+	if (!db || !db->books || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_book(DB_OP_ADD_BOOK, false, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->books, &db->books_lock, db->book_index,
+					   &book_type, src, NULL);
+	DB_STATS_STOP(t0, DB_OP_ADD_BOOK);
+	return rc;
+}
+
+int db_add_user(DB *db, const User *src)
+{
+	if (!db || !db->users || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_user(DB_OP_ADD_USER, false, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->users, &db->users_lock, db->user_index,
+					   &user_type, src, NULL);
+	DB_STATS_STOP(t0, DB_OP_ADD_USER);
+	return rc;
+}
+
+int db_add_loan(DB *db, const Loan *src)
+{
+	if (!db || !db->loans || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_loan(DB_OP_ADD_LOAN, false, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->loans, &db->loans_lock, db->loan_index,
+					   &loan_type, src, NULL);
+	DB_STATS_STOP(t0, DB_OP_ADD_LOAN);
+	return rc;
+}
+
+int db_add_suggestion(DB *db, const Suggestion *src)
+{
+	if (!db || !db->suggestions || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_suggestion(DB_OP_ADD_SUGGESTION, false, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->suggestions, &db->suggestions_lock,
+					   db->suggestion_index, &suggestion_type, src, NULL);
+	DB_STATS_STOP(t0, DB_OP_ADD_SUGGESTION);
+	return rc;
+}
+
+/* Auto-id variants (see table_add). */
+
+int db_add_book_auto(DB *db, Book *src)
+{
+	if (!db || !db->books || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_book(DB_OP_ADD_BOOK, true, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->books, &db->books_lock, db->book_index,
+					   &book_type, src, &src->id);
+	DB_STATS_STOP(t0, DB_OP_ADD_BOOK);
+	return rc;
+}
+
+int db_add_user_auto(DB *db, User *src)
+{
+	if (!db || !db->users || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_user(DB_OP_ADD_USER, true, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->users, &db->users_lock, db->user_index,
+					   &user_type, src, &src->id);
+	DB_STATS_STOP(t0, DB_OP_ADD_USER);
+	return rc;
+}
+
+int db_add_loan_auto(DB *db, Loan *src)
+{
+	if (!db || !db->loans || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_loan(DB_OP_ADD_LOAN, true, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->loans, &db->loans_lock, db->loan_index,
+					   &loan_type, src, &src->id);
+	DB_STATS_STOP(t0, DB_OP_ADD_LOAN);
+	return rc;
+}
+
+int db_add_suggestion_auto(DB *db, Suggestion *src)
+{
+	if (!db || !db->suggestions || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_suggestion(DB_OP_ADD_SUGGESTION, true, src);
+	DB_STATS_START(t0);
+	int rc = table_add(db, db->suggestions, &db->suggestions_lock,
+					   db->suggestion_index, &suggestion_type, src, &src->id);
+	DB_STATS_STOP(t0, DB_OP_ADD_SUGGESTION);
+	return rc;
+}
+
+/* CRUD - Update helpers (see table_update). */
+
+int db_update_book(DB *db, const Book *src)
+{
+	if (!db || !db->books || !src)
+		return -1;
+
+	if (db_recording())
+		db_record_book(DB_OP_UPDATE_BOOK, false, src);
+	DB_STATS_START(t0);
+	int rc = table_update(db, &db->books_lock, db->book_index, &book_type, src);
+	DB_STATS_STOP(t0, DB_OP_UPDATE_BOOK);
+	return rc;
+}
+
+int db_update_user(DB *db, const User *src)
+{
+	if (!db || !db->users || !src)
+		return -1;
 
-	On success, the three lists (books/users/loans) are ready to use.
-	On error (e.g. out of memory), any partially created lists
-	are destroyed and the function returns -1.
-*/
-int db_init(DB *db,
-			const char *books_path,
-			const char *users_path,
-			const char *loans_path,
-			const char *suggestions_path)
+	if (db_recording())
+		db_record_user(DB_OP_UPDATE_USER, false, src);
+	DB_STATS_START(t0);
+	int rc = table_update(db, &db->users_lock, db->user_index, &user_type, src);
+	DB_STATS_STOP(t0, DB_OP_UPDATE_USER);
+	return rc;
+}
+
+int db_update_loan(DB *db, const Loan *src)
 {
-	if (!db)
+	if (!db || !db->loans || !src)
 		return -1;
 
-	db->books = file_load_books(books_path);
-	db->users = file_load_users(users_path);
-	db->loans = file_load_loans(loans_path);
-	db->suggestions = file_load_suggestions(suggestions_path);
+	if (db_recording())
+		db_record_loan(DB_OP_UPDATE_LOAN, false, src);
+	DB_STATS_START(t0);
+	int rc = table_update(db, &db->loans_lock, db->loan_index, &loan_type, src);
+	DB_STATS_STOP(t0, DB_OP_UPDATE_LOAN);
+	return rc;
+}
 
-	if (!db->books || !db->users || !db->loans || !db->suggestions)
-	{
-		/* Clean up anything that was allocated before signaling failure. */
-		db_destroy(db);
+int db_update_suggestion(DB *db, const Suggestion *src)
+{
+	if (!db || !db->suggestions || !src)
 		return -1;
-	}
 
-	return 0;
+	if (db_recording())
+		db_record_suggestion(DB_OP_UPDATE_SUGGESTION, false, src);
+	DB_STATS_START(t0);
+	int rc = table_update(db, &db->suggestions_lock, db->suggestion_index,
+						&suggestion_type, src);
+	DB_STATS_STOP(t0, DB_OP_UPDATE_SUGGESTION);
+	return rc;
 }
 
 /*
-	Persists the current in-memory state of the DB to disk.
-	Each list is written using the filesystem helpers, overwriting
-	the corresponding .txt file with a header + all records.
+	CRUD - Delete helpers.
+	The id index gives us the list node directly, so removal is O(1).
 */
-int db_save(const DB *db,
-			const char *books_path,
-			const char *users_path,
-			const char *loans_path,
-			const char *suggestions_path)
+
+int db_remove_book(DB *db, unsigned id)
 {
-	if (!db)
+	if (!db || !db->books)
 		return -1;
 
-	int ok = 0;
+	if (db_recording())
+		db_record_id(DB_OP_REMOVE_BOOK, id);
+	DB_STATS_START(t0);
+	/* Its holds go with it, or a book re-added under this id would inherit them. */
+	table_write_lock(db, &db->books_lock);
+	int rc = remove_locked(db, db->books, db->book_index, &book_type, id);
+	if (rc == 0)
+		reservation_queues_drop_book(db->reservations, id);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_REMOVE_BOOK);
+	return rc;
+}
 
-	if (file_save_books(books_path, db->books) != 0)
-		ok = -1;
-	if (file_save_users(users_path, db->users) != 0)
-		ok = -1;
-	if (file_save_loans(loans_path, db->loans) != 0)
-		ok = -1;
-	if (file_save_suggestions(suggestions_path, db->suggestions) != 0)
-		ok = -1;
+int db_remove_user(DB *db, unsigned id)
+{
+	if (!db || !db->users)
+		return -1;
 
-	return ok;
+	if (db_recording())
+		db_record_id(DB_OP_REMOVE_USER, id);
+	DB_STATS_START(t0);
+	/* The user's holds live under books_lock, taken first. */
+	table_write_lock(db, &db->books_lock);
+	table_write_lock(db, &db->users_lock);
+	int rc = remove_locked(db, db->users, db->user_index, &user_type, id);
+	if (rc == 0)
+		reservation_queues_drop_user(db->reservations, id);
+	table_unlock(db, &db->users_lock);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_REMOVE_USER);
+	return rc;
 }
 
-/*
-	Releases all memory owned by the DB.
-	Each list is destroyed and every stored Book/User/Loan is freed.
-*/
-void db_destroy(DB *db)
+int db_remove_loan(DB *db, unsigned id)
 {
-	if (!db)
-		return;
+	if (!db || !db->loans)
+		return -1;
 
-	if (db->books)
-		dlist_destroy(db->books, free_book);
-	if (db->users)
-		dlist_destroy(db->users, free_user);
-	if (db->loans)
-		dlist_destroy(db->loans, free_loan);
-	if (db->suggestions)
-		dlist_destroy(db->suggestions, free_suggestion);
+	if (db_recording())
+		db_record_id(DB_OP_REMOVE_LOAN, id);
+	DB_STATS_START(t0);
+	int rc = table_remove(db, db->loans, &db->loans_lock, db->loan_index,
+						  &loan_type, id);
+	DB_STATS_STOP(t0, DB_OP_REMOVE_LOAN);
+	return rc;
+}
 
-	db->books = NULL;
-	db->users = NULL;
-	db->loans = NULL;
-	db->suggestions = NULL;
+int db_remove_suggestion(DB *db, unsigned id)
+{
+	if (!db || !db->suggestions)
+		return -1;
+
+	if (db_recording())
+		db_record_id(DB_OP_REMOVE_SUGGESTION, id);
+	DB_STATS_START(t0);
+	int rc = table_remove(db, db->suggestions, &db->suggestions_lock,
+						db->suggestion_index, &suggestion_type, id);
+	DB_STATS_STOP(t0, DB_OP_REMOVE_SUGGESTION);
+	return rc;
 }
 
 /*
-	Linear search helpers.
-	These are small convenience functions used by the app layer
-	to locate a specific element by its id.
+	Circulation.
+	The loan is written first: it is the only step that can fail (a
+	new B+tree key may need a node). The book update that follows only
+	changes 'available', which no index is keyed on, and its copy for
+	concurrent mode is allocated before any lock is taken, so it cannot
+	fail and nothing ever has to be undone. A hand-off on return does
+	not touch the book at all: one copy comes back, the same copy goes
+	out.
 */
-
-Book *db_find_book_by_id(const DB *db, unsigned id)
+static void *spare_record(const DB *db, const RecordType *type)
 {
-	if (!db || !db->books)
-		return NULL;
+	return db->concurrent ? aed_malloc(type->category, type->size) : NULL;
+}
 
-	DLIST_FOREACH(db->books, node)
-	{
-		Book *b = (Book *)node->data;
-		if (b->id == id)
-			return b;
-	}
+static void free_spare(const RecordType *type, void *spare)
+{
+	if (spare)
+		type->free_fn(spare);
+}
 
-	return NULL;
+/* A YYYYMMDD that names a day: not 0 and not rounded by date_from_yyyymmdd. */
+static bool real_date(unsigned yyyymmdd)
+{
+	return yyyymmdd != 0 && date_to_yyyymmdd(date_from_yyyymmdd(yyyymmdd)) == yyyymmdd;
 }
 
-User *db_find_user_by_id(const DB *db, unsigned id)
+DBCirculationResult db_checkout(DB *db, unsigned user_id, unsigned book_id,
+								unsigned date, unsigned *loan_id)
 {
-	if (!db || !db->users)
-		return NULL;
+	if (!db || !db->books || !db->loans || !real_date(date))
+		return DB_CIRC_ERROR;
+
+	if (db_recording())
+		db_record_circulation(DB_OP_CHECKOUT, user_id, book_id, date);
 
-	DLIST_FOREACH(db->users, node)
+	Loan *loan = aed_malloc(AED_MEM_LOAN, sizeof *loan);
+	void *spare = spare_record(db, &book_type);
+	if (!loan || (db->concurrent && !spare))
+	{
+		if (loan)
+			free_loan(loan);
+		free_spare(&book_type, spare);
+		return DB_CIRC_ERROR;
+	}
+	loan_init(loan, 0, user_id, book_id, date, 0);
+
+	DB_STATS_START(t0);
+	table_write_lock(db, &db->books_lock);
+	table_read_lock(db, &db->users_lock);
+	table_write_lock(db, &db->loans_lock);
+
+	DBCirculationResult rc = DB_CIRC_OK;
+	const Book *b = id_index_get(db->book_index, book_id);
+	unsigned id = 0;
+
+	if (!id_index_get(db->user_index, user_id))
+		rc = DB_CIRC_NO_USER;
+	else if (!b)
+		rc = DB_CIRC_NO_BOOK;
+	else if (b->available <= 0)
+		rc = DB_CIRC_UNAVAILABLE;
+	else if (insert_locked(db, db->loans, db->loan_index, &loan_type, loan, &id) != 0)
+		rc = DB_CIRC_ERROR;
+	else
 	{
-		User *u = (User *)node->data;
-		if (u->id == id)
-			return u;
+		Book taken = *b;
+		taken.available--;
+		update_locked(db, db->book_index, &book_type, &taken, &spare);
+		reservation_queues_remove(db->reservations, book_id, user_id);
+		loan = NULL;
 	}
 
-	return NULL;
+	table_unlock(db, &db->loans_lock);
+	table_unlock(db, &db->users_lock);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_CHECKOUT);
+
+	if (loan)
+		free_loan(loan);
+	free_spare(&book_type, spare);
+	if (rc == DB_CIRC_OK && loan_id)
+		*loan_id = id;
+	return rc;
 }
 
-Loan *db_find_loan_by_id(const DB *db, unsigned id)
+/*
+	Lends a returned copy of book_id to the first hold whose user still
+	exists, with *loan (consumed on success). Returns the new loan's id,
+	or 0 if nobody is waiting or the loan could not be stored (the hold
+	then stays in the queue).
+*/
+static unsigned hand_off_locked(DB *db, unsigned book_id, unsigned date, Loan **loan)
 {
-	if (!db || !db->loans)
-		return NULL;
-
-	DLIST_FOREACH(db->loans, node)
+	const Reservation *r;
+	while ((r = reservation_queues_peek(db->reservations, book_id)) != NULL)
 	{
-		Loan *l = (Loan *)node->data;
-		if (l->id == id)
-			return l;
-	}
+		if (!id_index_get(db->user_index, r->user_id))
+		{
+			reservation_queues_pop(db->reservations, book_id);
+			continue;
+		}
+
+		unsigned id = 0;
+		loan_init(*loan, 0, r->user_id, book_id, date, 0);
+		if (insert_locked(db, db->loans, db->loan_index, &loan_type, *loan, &id) != 0)
+			return 0;
 
-	return NULL;
+		reservation_queues_pop(db->reservations, book_id);
+		*loan = NULL;
+		return id;
+	}
+	return 0;
 }
 
-Suggestion *db_find_suggestion_by_id(const DB *db, unsigned id)
+DBCirculationResult db_return(DB *db, unsigned loan_id, unsigned date,
+							  unsigned *handoff_loan_id)
 {
-	if (!db || !db->suggestions)
-		return NULL;
-
-	DLIST_FOREACH(db->suggestions, node)
+	if (handoff_loan_id)
+		*handoff_loan_id = 0;
+	if (!db || !db->books || !db->loans || !real_date(date))
+		return DB_CIRC_ERROR;
+
+	if (db_recording())
+		db_record_circulation(DB_OP_RETURN, loan_id, 0, date);
+
+	/* Either the book's new version or the next reserver's loan gets used. */
+	Loan *next = aed_malloc(AED_MEM_LOAN, sizeof *next);
+	void *spare = spare_record(db, &book_type);
+	if (!next || (db->concurrent && !spare))
 	{
-		Suggestion *s = (Suggestion *)node->data;
-		if (s->id == id)
-			return s;
+		if (next)
+			free_loan(next);
+		free_spare(&book_type, spare);
+		return DB_CIRC_ERROR;
 	}
 
-	return NULL;
-}
+	DB_STATS_START(t0);
+	table_write_lock(db, &db->books_lock);
+	table_read_lock(db, &db->users_lock);
+	table_write_lock(db, &db->loans_lock);
 
-/* Simple accessors so UI code can iterate over lists. */
+	DBCirculationResult rc = DB_CIRC_OK;
+	const Loan *l = id_index_get(db->loan_index, loan_id);
+	unsigned handed = 0;
 
-DList *db_get_books(const DB *db)
-{
-	return db ? db->books : NULL;
-}
+	if (!l)
+		rc = DB_CIRC_NO_LOAN;
+	else if (l->date_return != 0)
+		rc = DB_CIRC_RETURNED;
+	else if (date < l->date_borrow)
+		rc = DB_CIRC_BEFORE_BORROW;
+	else
+	{
+		Loan closed = *l;
+		closed.date_return = date;
+		if (update_locked(db, db->loan_index, &loan_type, &closed, NULL) != 0)
+			rc = DB_CIRC_ERROR;
+		else
+		{
+			const Book *b = id_index_get(db->book_index, closed.book_id);
+			if (b)
+				handed = hand_off_locked(db, closed.book_id, date, &next);
+			if (b && !handed)
+			{
+				Book back = *b;
+				back.available++;
+				update_locked(db, db->book_index, &book_type, &back, &spare);
+			}
+		}
+	}
 
-DList *db_get_users(const DB *db)
-{
-	return db ? db->users : NULL;
+	table_unlock(db, &db->loans_lock);
+	table_unlock(db, &db->users_lock);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_RETURN);
+
+	if (next)
+		free_loan(next);
+	free_spare(&book_type, spare);
+	if (handoff_loan_id)
+		*handoff_loan_id = handed;
+	return rc;
 }
 
-DList *db_get_loans(const DB *db)
+unsigned db_user_active_loans(const DB *db, unsigned user_id)
 {
-	return db ? db->loans : NULL;
+	if (!db || !db->active_loans)
+		return 0;
+
+	if (db_recording())
+		db_record_id(DB_OP_ACTIVE_LOANS, user_id);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	unsigned n = id_counts_get(db->active_loans, user_id);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_ACTIVE_LOANS);
+	return n;
 }
 
-DList *db_get_suggestions(const DB *db)
+/*
+	Circulation aggregates.
+	The counters are maintained by the book and loan mirrors, so
+	reading them is a lock and a load per table.
+*/
+static size_t table_size(const DB *db, DList *list, const pthread_rwlock_t *lock)
 {
-	return db ? db->suggestions : NULL;
+	table_read_lock(db, lock);
+	size_t n = dlist_size(list);
+	table_unlock(db, lock);
+	return n;
 }
 
-/*
-	CRUD - Create helpers.
+int db_totals(const DB *db, DBTotals *out)
+{
+	if (!db || !db->books || !db->users || !db->loans || !db->suggestions || !out)
+		return -1;
 
-	Each "add" function:
-		- validates the DB and source pointer,
-		- allocates a new element on the heap,
-		- copies the contents of the provided struct,
-		- appends it to the appropriate list.
+	if (db_recording())
+		db_record_none(DB_OP_TOTALS);
+	DB_STATS_START(t0);
 
-	The caller is responsible for picking an id (e.g. next free id).
-*/
+	table_read_lock(db, &db->books_lock);
+	out->books = dlist_size(db->books);
+	out->copies_available = db->copies_available;
+	out->reservations = reservation_queues_size(db->reservations);
+	table_unlock(db, &db->books_lock);
 
-int db_add_book(DB *db, const Book *src)
-{
-	if (!db || !db->books || !src)
-		return -1;
+	out->users = table_size(db, db->users, &db->users_lock);
 
-	Book *b = malloc(sizeof *b);
-	if (!b)
-		return -1;
+	table_read_lock(db, &db->loans_lock);
+	out->loans = dlist_size(db->loans);
+	out->loans_active = db->loans_active;
+	table_unlock(db, &db->loans_lock);
 
-	*b = *src;
+	out->suggestions = table_size(db, db->suggestions, &db->suggestions_lock);
 
-	dlist_insert_priority(db->books, b, id_priority(b->id));
+	DB_STATS_STOP(t0, DB_OP_TOTALS);
 	return 0;
 }
 
-int db_add_user(DB *db, const User *src)
+unsigned db_book_loans(const DB *db, unsigned book_id)
 {
-	if (!db || !db->users || !src)
-		return -1;
+	if (!db || !db->book_loans)
+		return 0;
+
+	if (db_recording())
+		db_record_id(DB_OP_BOOK_LOANS, book_id);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	unsigned n = id_counts_get(db->book_loans, book_id);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_BOOK_LOANS);
+	return n;
+}
 
-	User *u = malloc(sizeof *u);
-	if (!u)
-		return -1;
+/* Compares a rebuilt IdCounts with the maintained one, key by key. */
+struct counts_check {
+	const IdCounts *other;
+	int mismatches;
+};
 
-	*u = *src;
+static int count_differs(unsigned id, unsigned count, void *ctx)
+{
+	struct counts_check *c = ctx;
+	if (id_counts_get(c->other, id) != count)
+		c->mismatches++;
+	return 0;
+}
 
-	dlist_insert_priority(db->users, u, id_priority(u->id));
+static int count_missing(unsigned id, unsigned count, void *ctx)
+{
+	(void)count;
+	struct counts_check *c = ctx;
+	if (id_counts_get(c->other, id) == 0)
+		c->mismatches++;
 	return 0;
 }
 
-int db_add_loan(DB *db, const Loan *src)
+/* Ids whose count differs between fresh and kept (each counted once). */
+static int compare_counts(const IdCounts *fresh, const IdCounts *kept)
 {
-	if (!db || !db->loans || !src)
+	struct counts_check c = { kept, 0 };
+	id_counts_foreach(fresh, count_differs, &c);
+	c.other = fresh;
+	id_counts_foreach(kept, count_missing, &c);
+	return c.mismatches;
+}
+
+int db_check_totals(const DB *db)
+{
+	if (!db || !db->books || !db->loans || !db->book_loans || !db->user_loans ||
+		!db->active_loans)
 		return -1;
 
-	Loan *l = malloc(sizeof *l);
-	if (!l)
+	if (db_recording())
+		db_record_none(DB_OP_CHECK_TOTALS);
+
+	IdCounts *book_loans = id_counts_create();
+	IdCounts *user_loans = id_counts_create();
+	IdCounts *active_loans = id_counts_create();
+	if (!book_loans || !user_loans || !active_loans)
+	{
+		id_counts_destroy(book_loans);
+		id_counts_destroy(user_loans);
+		id_counts_destroy(active_loans);
 		return -1;
+	}
 
-	*l = *src;
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->books_lock);
+	table_read_lock(db, &db->loans_lock);
 
-	dlist_insert_priority(db->loans, l, id_priority(l->id));
-	return 0;
+	int rc = 0;
+	long long copies = 0;
+	size_t active = 0;
+
+	DLIST_FOREACH(db->books, node)
+		copies += ((const Book *)node->data)->available;
+
+	DLIST_FOREACH(db->loans, node)
+	{
+		const Loan *l = node->data;
+		if (id_counts_add(book_loans, l->book_id, 1) != 0 ||
+			id_counts_add(user_loans, l->user_id, 1) != 0)
+			rc = -1;
+		if (l->date_return == 0)
+		{
+			active++;
+			if (id_counts_add(active_loans, l->user_id, 1) != 0)
+				rc = -1;
+		}
+		if (rc != 0)
+			break;
+	}
+
+	if (rc == 0)
+	{
+		rc += copies != db->copies_available;
+		rc += active != db->loans_active;
+		rc += compare_counts(book_loans, db->book_loans);
+		rc += compare_counts(user_loans, db->user_loans);
+		rc += compare_counts(active_loans, db->active_loans);
+	}
+
+	table_unlock(db, &db->loans_lock);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_CHECK_TOTALS);
+
+	id_counts_destroy(book_loans);
+	id_counts_destroy(user_loans);
+	id_counts_destroy(active_loans);
+	return rc;
 }
 
-int db_add_suggestion(DB *db, const Suggestion *src)
+/*
+	Top k books or users. All-time rankings read the maintained
+	counters; a window is tallied from the column store into a scratch
+	IdCounts first. Both run under the loans read lock.
+*/
+static int top_loans(const DB *db, LoanGroup by, size_t k, unsigned date_from,
+					 unsigned date_to, IdCount *out, size_t *n)
 {
-	if (!db || !db->suggestions || !src)
+	if (n)
+		*n = 0;
+	if (!db || !db->loan_columns || !n || (k > 0 && !out))
 		return -1;
 
-	Suggestion *s = malloc(sizeof *s);
-	if (!s)
+	bool window = date_from != 0 || date_to != 0;
+	IdCounts *tally = window ? id_counts_create() : NULL;
+	if (window && !tally)
 		return -1;
 
-	*s = *src;
-	dlist_insert_priority(db->suggestions, s, id_priority(s->id));
-	return 0;
+	table_read_lock(db, &db->loans_lock);
+	const IdCounts *counts = by == LOAN_BY_USER ? db->user_loans : db->book_loans;
+	int rc = 0;
+	if (window)
+	{
+		LoanFilter f = { .borrow_from = date_from, .borrow_to = date_to };
+		rc = loan_columns_tally(db->loan_columns, &f, by, tally);
+		counts = tally;
+	}
+	if (rc == 0)
+		rc = id_counts_top(counts, k, out, n);
+	table_unlock(db, &db->loans_lock);
+
+	id_counts_destroy(tally);
+	return rc;
 }
 
-/*
-	Internal helper for the "delete" operations.
+int db_top_books(const DB *db, size_t k, unsigned date_from, unsigned date_to,
+				 IdCount *out, size_t *n)
+{
+	if (db_recording())
+		db_record_circulation(DB_OP_TOP_BOOKS, k > UINT_MAX ? UINT_MAX : (unsigned)k,
+							  date_from, date_to);
+	DB_STATS_START(t0);
+	int rc = top_loans(db, LOAN_BY_BOOK, k, date_from, date_to, out, n);
+	DB_STATS_STOP(t0, DB_OP_TOP_BOOKS);
+	return rc;
+}
 
-	Given:
-		- a list of elements (Book pointers, User pointers or Loan pointers)
-		- the id we want to remove
-		- a small callback that extracts the id from a void* element
+int db_top_users(const DB *db, size_t k, unsigned date_from, unsigned date_to,
+				 IdCount *out, size_t *n)
+{
+	if (db_recording())
+		db_record_circulation(DB_OP_TOP_USERS, k > UINT_MAX ? UINT_MAX : (unsigned)k,
+							  date_from, date_to);
+	DB_STATS_START(t0);
+	int rc = top_loans(db, LOAN_BY_USER, k, date_from, date_to, out, n);
+	DB_STATS_STOP(t0, DB_OP_TOP_USERS);
+	return rc;
+}
 
-	it walks the list, finds the first matching element, and
-	removes plus frees it.
+/*
+	Co-borrowing recommendations.
+	Only the snapshot and the swap hold the loans lock; the build
+	itself runs unlocked on the copy.
 */
-static int db_remove_from_list(DList *list, unsigned id,
-							   unsigned (*get_id)(const void *))
+int db_build_recommendations(DB *db, const RecommendConfig *cfg, ThreadPool *pool)
 {
-	if (!list || !get_id)
+	if (!db || !db->loans)
 		return -1;
 
-	DListNode *node = list->head;
-	while (node)
+	if (db_recording())
+		db_record_none(DB_OP_BUILD_RECOMMENDATIONS);
+	DB_STATS_START(t0);
+
+	table_read_lock(db, &db->loans_lock);
+	size_t n = dlist_size(db->loans), i = 0;
+	CoBorrow *loans = aed_malloc(AED_MEM_INDEX, (n ? n : 1) * sizeof *loans);
+	if (loans)
 	{
-		void *data = node->data;
-		if (get_id(data) == id)
+		DLIST_FOREACH(db->loans, node)
 		{
-			dlist_remove_node(list, node, free);
-			return 0;
+			const Loan *l = node->data;
+			loans[i].user_id = l->user_id;
+			loans[i].book_id = l->book_id;
+			loans[i].date = l->date_borrow;
+			++i;
 		}
-		node = node->next;
 	}
+	table_unlock(db, &db->loans_lock);
 
-	return -1;
-}
+	Recommendations *built = loans ? recommendations_build(loans, n, cfg, pool) : NULL;
+	aed_free(AED_MEM_INDEX, loans, (n ? n : 1) * sizeof *loans);
+
+	Recommendations *old = NULL;
+	if (built)
+	{
+		table_write_lock(db, &db->loans_lock);
+		old = db->recommendations;
+		db->recommendations = built;
+		table_unlock(db, &db->loans_lock);
+	}
+	recommendations_destroy(old);
 
-/* id accessors used by db_remove_from_list */
+	DB_STATS_STOP(t0, DB_OP_BUILD_RECOMMENDATIONS);
+	return built ? 0 : -1;
+}
 
-static unsigned get_book_id(const void *p)
+bool db_has_recommendations(const DB *db)
 {
-	const Book *b = (const Book *)p;
-	return b->id;
+	if (!db)
+		return false;
+
+	table_read_lock(db, &db->loans_lock);
+	bool built = db->recommendations != NULL;
+	table_unlock(db, &db->loans_lock);
+	return built;
 }
 
-static unsigned get_user_id(const void *p)
+int db_recommend_for_book(const DB *db, unsigned book_id, size_t n, IdCount *out, size_t *got)
 {
-	const User *u = (const User *)p;
-	return u->id;
+	if (got)
+		*got = 0;
+	if (!db || !got || (n > 0 && !out))
+		return -1;
+
+	if (db_recording())
+		db_record_circulation(DB_OP_RECOMMEND, book_id, n > UINT_MAX ? UINT_MAX : (unsigned)n, 0);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->loans_lock);
+	*got = recommendations_get(db->recommendations, book_id, out, n);
+	table_unlock(db, &db->loans_lock);
+	DB_STATS_STOP(t0, DB_OP_RECOMMEND);
+	return 0;
 }
 
-static unsigned get_loan_id(const void *p)
+/*
+	Near-duplicate titles: the trigram index of the table is read
+	under that table's read lock.
+*/
+static int similar_titles(const DB *db, const pthread_rwlock_t *lock, const TitleIndex *index,
+						  const char *title, unsigned min_similarity,
+						  TitleMatch *out, size_t cap, size_t *n)
 {
-	const Loan *l = (const Loan *)p;
-	return l->id;
+	table_read_lock(db, lock);
+	int rc = title_index_similar(index, title, min_similarity, out, cap, n);
+	table_unlock(db, lock);
+	return rc;
 }
 
-static unsigned get_suggestion_id(const void *p)
+int db_similar_books(const DB *db, const char *title, unsigned min_similarity,
+					 TitleMatch *out, size_t cap, size_t *n)
 {
-	const Suggestion *s = (const Suggestion *)p;
-	return s->id;
+	if (n)
+		*n = 0;
+	if (!db || !db->book_titles || !title || !n)
+		return -1;
+
+	if (db_recording())
+		db_record_similar(DB_OP_SIMILAR_BOOKS, min_similarity, cap, title);
+	DB_STATS_START(t0);
+	int rc = similar_titles(db, &db->books_lock, db->book_titles, title, min_similarity,
+							out, cap, n);
+	DB_STATS_STOP(t0, DB_OP_SIMILAR_BOOKS);
+	return rc;
 }
 
-int db_remove_book(DB *db, unsigned id)
+int db_similar_suggestions(const DB *db, const char *title, unsigned min_similarity,
+						   TitleMatch *out, size_t cap, size_t *n)
 {
-	if (!db || !db->books)
+	if (n)
+		*n = 0;
+	if (!db || !db->suggestion_titles || !title || !n)
 		return -1;
 
-	return db_remove_from_list(db->books, id, get_book_id);
+	if (db_recording())
+		db_record_similar(DB_OP_SIMILAR_SUGGESTIONS, min_similarity, cap, title);
+	DB_STATS_START(t0);
+	int rc = similar_titles(db, &db->suggestions_lock, db->suggestion_titles, title,
+							min_similarity, out, cap, n);
+	DB_STATS_STOP(t0, DB_OP_SIMILAR_SUGGESTIONS);
+	return rc;
 }
 
-int db_remove_user(DB *db, unsigned id)
+/*
+	Autocomplete: each trie is read under the lock of the table its
+	field belongs to.
+*/
+int db_autocomplete(const DB *db, DBCompleteField field, const char *prefix, size_t limit,
+					unsigned *ids, size_t *n)
 {
-	if (!db || !db->users)
+	if (n)
+		*n = 0;
+	if (!db || !prefix || !n || (limit > 0 && !ids))
+		return -1;
+
+	const PrefixIndex *index;
+	const pthread_rwlock_t *lock;
+	switch (field)
+	{
+	case DB_COMPLETE_TITLE:
+		index = db->book_title_keys;
+		lock = &db->books_lock;
+		break;
+	case DB_COMPLETE_AUTHOR:
+		index = db->book_author_keys;
+		lock = &db->books_lock;
+		break;
+	case DB_COMPLETE_USER_NAME:
+		index = db->user_name_keys;
+		lock = &db->users_lock;
+		break;
+	default:
+		return -1;
+	}
+	if (!index)
 		return -1;
 
-	return db_remove_from_list(db->users, id, get_user_id);
+	if (db_recording())
+		db_record_complete(DB_OP_AUTOCOMPLETE, (unsigned)field, limit, prefix);
+	DB_STATS_START(t0);
+	table_read_lock(db, lock);
+	int rc = prefix_index_complete(index, prefix, limit, ids, n);
+	table_unlock(db, lock);
+	DB_STATS_STOP(t0, DB_OP_AUTOCOMPLETE);
+	return rc;
 }
 
-int db_remove_loan(DB *db, unsigned id)
+/*
+	Reservations.
+	The queues hang off the books, so they are guarded by books_lock;
+	placing a hold also checks the user, under users_lock (taken
+	second, like in checkout).
+*/
+DBCirculationResult db_reserve(DB *db, unsigned user_id, unsigned book_id,
+							   unsigned tier, unsigned date)
 {
-	if (!db || !db->loans)
+	if (!db || !db->reservations || !real_date(date) || tier > RESERVATION_TIER_MAX)
+		return DB_CIRC_ERROR;
+
+	Reservation r;
+	reservation_init(&r, book_id, user_id, tier, date);
+	if (db_recording())
+		db_record_reservation(DB_OP_RESERVE, &r);
+
+	DB_STATS_START(t0);
+	table_write_lock(db, &db->books_lock);
+	table_read_lock(db, &db->users_lock);
+
+	DBCirculationResult rc = DB_CIRC_OK;
+	const Book *b = id_index_get(db->book_index, book_id);
+
+	if (!id_index_get(db->user_index, user_id))
+		rc = DB_CIRC_NO_USER;
+	else if (!b)
+		rc = DB_CIRC_NO_BOOK;
+	else if (b->available > 0)
+		rc = DB_CIRC_AVAILABLE;
+	else
+	{
+		int added = reservation_queues_add(db->reservations, &r);
+		if (added == -2)
+			rc = DB_CIRC_RESERVED;
+		else if (added != 0)
+			rc = DB_CIRC_ERROR;
+	}
+
+	table_unlock(db, &db->users_lock);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_RESERVE);
+	return rc;
+}
+
+DBCirculationResult db_cancel_reservation(DB *db, unsigned user_id, unsigned book_id)
+{
+	if (!db || !db->reservations)
+		return DB_CIRC_ERROR;
+
+	if (db_recording())
+		db_record_circulation(DB_OP_CANCEL_RESERVATION, user_id, book_id, 0);
+	DB_STATS_START(t0);
+	table_write_lock(db, &db->books_lock);
+	int removed = reservation_queues_remove(db->reservations, book_id, user_id);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_CANCEL_RESERVATION);
+
+	return removed == 0 ? DB_CIRC_OK : DB_CIRC_NO_RESERVATION;
+}
+
+int db_book_reservations(const DB *db, unsigned book_id,
+						 DBReservationVisitor fn, void *ctx)
+{
+	if (!db || !db->reservations || !fn)
 		return -1;
 
-	return db_remove_from_list(db->loans, id, get_loan_id);
+	if (db_recording())
+		db_record_id(DB_OP_BOOK_RESERVATIONS, book_id);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->books_lock);
+	int rc = reservation_queues_visit_book(db->reservations, book_id, fn, ctx);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_BOOK_RESERVATIONS);
+	return rc;
 }
 
-int db_remove_suggestion(DB *db, unsigned id)
+static void free_reservation(void *p) { aed_free(AED_MEM_RESERVATION, p, sizeof(Reservation)); }
+
+int db_load_reservations(DB *db, const char *path)
 {
-	if (!db || !db->suggestions)
+	if (!db || !db->reservations || !path)
 		return -1;
 
-	return db_remove_from_list(db->suggestions, id, get_suggestion_id);
+	TRACE_SPAN_BEGIN(span);
+	DB_STATS_START(t0);
+	DList *list = file_load_reservations(path);
+	int rc = -1;
+
+	if (list)
+	{
+		rc = 0;
+		table_write_lock(db, &db->books_lock);
+		table_read_lock(db, &db->users_lock);
+		DLIST_FOREACH(list, node)
+		{
+			Reservation *r = node->data;
+			if (!id_index_get(db->book_index, r->book_id) ||
+				!id_index_get(db->user_index, r->user_id))
+				continue;
+			if (reservation_queues_add(db->reservations, r) == -1)
+				rc = -1;
+		}
+		table_unlock(db, &db->users_lock);
+		table_unlock(db, &db->books_lock);
+		dlist_destroy(list, free_reservation);
+	}
+	DB_STATS_STOP(t0, DB_OP_LOAD_RESERVATIONS);
+	TRACE_SPAN_END(span, "db", "db_load_reservations");
+	return rc;
+}
+
+static int collect_reservation(const Reservation *r, void *ctx)
+{
+	DList *list = ctx;
+	size_t before = list->size;
+	dlist_push_back(list, (void *)r);
+	return list->size == before ? -1 : 0;
 }
 
+int db_save_reservations(const DB *db, const char *path)
+{
+	if (!db || !db->reservations || !path)
+		return -1;
+
+	DList *list = dlist_create(false, NULL);
+	if (!list)
+		return -1;
+
+	TRACE_SPAN_BEGIN(span);
+	DB_STATS_START(t0);
+	table_read_lock(db, &db->books_lock);
+	int rc = reservation_queues_foreach(db->reservations, collect_reservation, list);
+	if (rc == 0)
+		rc = file_save_reservations(path, list);
+	table_unlock(db, &db->books_lock);
+	DB_STATS_STOP(t0, DB_OP_SAVE_RESERVATIONS);
+	TRACE_SPAN_END(span, "db", "db_save_reservations");
+
+	/* The list only borrowed the holds. */
+	dlist_destroy(list, NULL);
+	return rc == 0 ? 0 : -1;
+}
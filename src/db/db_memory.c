@@ -0,0 +1,130 @@
+/*
+	Memory usage report of the DB (see db/db_memory.h).
+*/
+
+#include "db/db_memory.h"
+
+#include <string.h>
+
+static void measure_table(const DB *db, const DList *list,
+						  const pthread_rwlock_t *lock, const IdIndex *index,
+						  const BPTree *const *trees, size_t n_trees,
+						  size_t (*extra_bytes)(const DB *db),
+						  size_t record_size, DBTableMemory *out)
+{
+	/* The locks only exist in concurrent mode (see db.c). */
+	if (db->concurrent)
+		pthread_rwlock_rdlock((pthread_rwlock_t *)lock);
+
+	out->records = list ? list->size : 0;
+	out->record_bytes = out->records * record_size;
+	out->list_bytes = list ? sizeof(DList) + out->records * sizeof(DListNode) : 0;
+	out->index_bytes = id_index_bytes(index);
+	for (size_t i = 0; i < n_trees; ++i)
+		out->index_bytes += bptree_bytes(trees[i]);
+	if (extra_bytes)
+		out->index_bytes += extra_bytes(db);
+
+	if (db->concurrent)
+		pthread_rwlock_unlock((pthread_rwlock_t *)lock);
+
+	out->total_bytes = out->record_bytes + out->list_bytes + out->index_bytes;
+}
+
+/* Loan structures that are not trees: column store, due-date wheel, counters, recommendations. */
+static size_t loan_mirror_bytes(const DB *db)
+{
+	return loan_columns_bytes(db->loan_columns) + due_wheel_bytes(db->due_wheel) +
+		   id_counts_bytes(db->active_loans) + id_counts_bytes(db->book_loans) +
+		   id_counts_bytes(db->user_loans) + recommendations_bytes(db->recommendations);
+}
+
+/* Reservation queues and the title indexes hang off the books (same lock). */
+static size_t book_mirror_bytes(const DB *db)
+{
+	return reservation_queues_bytes(db->reservations) + title_index_bytes(db->book_titles) +
+		   prefix_index_bytes(db->book_title_keys) + prefix_index_bytes(db->book_author_keys);
+}
+
+static size_t user_mirror_bytes(const DB *db)
+{
+	return prefix_index_bytes(db->user_name_keys);
+}
+
+static size_t suggestion_mirror_bytes(const DB *db)
+{
+	return title_index_bytes(db->suggestion_titles);
+}
+
+int db_memory_stats(const DB *db, DBMemoryStats *out)
+{
+	if (!db || !out)
+		return -1;
+
+	memset(out, 0, sizeof *out);
+
+	const BPTree *book_trees[] = { db->books_by_id, db->books_by_year };
+	const BPTree *user_trees[] = { db->users_by_id };
+	const BPTree *loan_trees[] = { db->loans_by_id, db->loans_by_borrow, db->loans_by_return };
+	const BPTree *suggestion_trees[] = { db->suggestions_by_id };
+
+	measure_table(db, db->books, &db->books_lock, db->book_index,
+				  book_trees, 2, book_mirror_bytes, sizeof(Book), &out->tables[DB_TABLE_BOOKS]);
+	measure_table(db, db->users, &db->users_lock, db->user_index,
+				  user_trees, 1, user_mirror_bytes, sizeof(User), &out->tables[DB_TABLE_USERS]);
+	measure_table(db, db->loans, &db->loans_lock, db->loan_index,
+				  loan_trees, 3, loan_mirror_bytes, sizeof(Loan), &out->tables[DB_TABLE_LOANS]);
+	measure_table(db, db->suggestions, &db->suggestions_lock, db->suggestion_index,
+				  suggestion_trees, 1, suggestion_mirror_bytes, sizeof(Suggestion),
+				  &out->tables[DB_TABLE_SUGGESTIONS]);
+
+	for (int i = 0; i < AED_MEM_COUNT; ++i)
+		aed_mem_stats((AedMemCategory)i, &out->categories[i]);
+
+	return 0;
+}
+
+static double kib(size_t bytes)
+{
+	return (double)bytes / 1024.0;
+}
+
+void db_memory_print(const DBMemoryStats *stats, FILE *out)
+{
+	if (!stats || !out)
+		return;
+
+	fprintf(out, "Memoria por tabela (KiB):\n");
+	fprintf(out, "  %-12s %10s %12s %12s %12s %12s\n",
+			"tabela", "registos", "dados", "lista", "indice", "total");
+
+	DBTableMemory sum = { 0 };
+	for (int i = 0; i < DB_TABLE_COUNT; ++i)
+	{
+		const DBTableMemory *t = &stats->tables[i];
+		fprintf(out, "  %-12s %10zu %12.1f %12.1f %12.1f %12.1f\n",
+				db_table_name((DBTable)i), t->records, kib(t->record_bytes),
+				kib(t->list_bytes), kib(t->index_bytes), kib(t->total_bytes));
+
+		sum.records += t->records;
+		sum.record_bytes += t->record_bytes;
+		sum.list_bytes += t->list_bytes;
+		sum.index_bytes += t->index_bytes;
+		sum.total_bytes += t->total_bytes;
+	}
+	fprintf(out, "  %-12s %10zu %12.1f %12.1f %12.1f %12.1f\n",
+			"total", sum.records, kib(sum.record_bytes), kib(sum.list_bytes),
+			kib(sum.index_bytes), kib(sum.total_bytes));
+
+	fprintf(out, "Memoria por categoria (processo, KiB):\n");
+	fprintf(out, "  %-12s %10s %12s %12s %14s\n",
+			"categoria", "objetos", "atual", "pico", "alocacoes");
+	for (int i = 0; i < AED_MEM_COUNT; ++i)
+	{
+		const AedMemStats *c = &stats->categories[i];
+		fprintf(out, "  %-12s %10zu %12.1f %12.1f %14llu\n",
+				aed_mem_category_name((AedMemCategory)i), c->objects,
+				kib(c->bytes), kib(c->peak_bytes),
+				(unsigned long long)c->allocations);
+	}
+}
@@ -0,0 +1,478 @@
+/*
+	Workload trace writer and reader (see db/db_record.h).
+*/
+
+#include "db/db_record.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cutils.h"
+
+typedef enum {
+	KIND_INVALID,
+	KIND_NONE,
+	KIND_ID,
+	KIND_RECORD,
+	KIND_SEARCH,
+	KIND_RANGE,
+	KIND_FILTER,
+	KIND_CIRCULATION,
+	KIND_SIMILAR,
+	KIND_COMPLETE
+} PayloadKind;
+
+#define AUTO_ID_FLAG 0x80u
+
+static _Atomic bool recording = false;
+static pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_file = NULL;
+static uint64_t last_ns = 0;
+static bool write_failed = false;
+
+static PayloadKind kind_of(DBOp op)
+{
+	switch (op)
+	{
+	case DB_OP_FIND_BOOK:
+	case DB_OP_FIND_USER:
+	case DB_OP_FIND_LOAN:
+	case DB_OP_FIND_SUGGESTION:
+	case DB_OP_COPY_BOOK:
+	case DB_OP_COPY_USER:
+	case DB_OP_COPY_LOAN:
+	case DB_OP_COPY_SUGGESTION:
+	case DB_OP_REMOVE_BOOK:
+	case DB_OP_REMOVE_USER:
+	case DB_OP_REMOVE_LOAN:
+	case DB_OP_REMOVE_SUGGESTION:
+	case DB_OP_ACTIVE_LOANS:
+	case DB_OP_BOOK_RESERVATIONS:
+	case DB_OP_BOOK_LOANS:
+		return KIND_ID;
+	case DB_OP_ADD_BOOK:
+	case DB_OP_ADD_USER:
+	case DB_OP_ADD_LOAN:
+	case DB_OP_ADD_SUGGESTION:
+	case DB_OP_UPDATE_BOOK:
+	case DB_OP_UPDATE_USER:
+	case DB_OP_UPDATE_LOAN:
+	case DB_OP_UPDATE_SUGGESTION:
+	case DB_OP_RESERVE:
+		return KIND_RECORD;
+	case DB_OP_FOREACH_BOOK:
+	case DB_OP_FOREACH_USER:
+	case DB_OP_FOREACH_LOAN:
+	case DB_OP_FOREACH_SUGGESTION:
+	case DB_OP_TOTALS:
+	case DB_OP_CHECK_TOTALS:
+	case DB_OP_BUILD_RECOMMENDATIONS:
+		return KIND_NONE;
+	case DB_OP_SEARCH_BOOKS:
+		return KIND_SEARCH;
+	case DB_OP_BOOKS_BY_YEAR:
+	case DB_OP_LOANS_BY_BORROW:
+	case DB_OP_LOANS_BY_RETURN:
+	case DB_OP_PAGE_BOOKS:
+	case DB_OP_PAGE_USERS:
+	case DB_OP_PAGE_LOANS:
+	case DB_OP_PAGE_SUGGESTIONS:
+	case DB_OP_LOANS_DUE_ON:
+	case DB_OP_LOANS_OVERDUE:
+		return KIND_RANGE;
+	case DB_OP_COUNT_LOANS:
+	case DB_OP_SELECT_LOANS:
+	case DB_OP_LOANS_DAYS_OUT:
+		return KIND_FILTER;
+	case DB_OP_CHECKOUT:
+	case DB_OP_RETURN:
+	case DB_OP_CANCEL_RESERVATION:
+	case DB_OP_TOP_BOOKS:
+	case DB_OP_TOP_USERS:
+	case DB_OP_RECOMMEND:
+		return KIND_CIRCULATION;
+	case DB_OP_SIMILAR_BOOKS:
+	case DB_OP_SIMILAR_SUGGESTIONS:
+		return KIND_SIMILAR;
+	case DB_OP_AUTOCOMPLETE:
+		return KIND_COMPLETE;
+	default:
+		return KIND_INVALID;
+	}
+}
+
+/* ---------------------------------------------------------------
+   Writing
+   --------------------------------------------------------------- */
+
+static void put_varint(FILE *f, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		fputc((int)(v & 0x7F) | 0x80, f);
+		v >>= 7;
+	}
+	fputc((int)v, f);
+}
+
+static void put_text(FILE *f, const char *text)
+{
+	size_t len = strnlen(text, DB_RECORD_TEXT_MAX - 1);
+	put_varint(f, len);
+	fwrite(text, 1, len, f);
+}
+
+int db_record_start(const char *path)
+{
+	if (!path)
+		return -1;
+
+	pthread_mutex_lock(&record_lock);
+	if (trace_file)
+	{
+		pthread_mutex_unlock(&record_lock);
+		return -1;
+	}
+
+	trace_file = fopen(path, "wb");
+	if (!trace_file)
+	{
+		pthread_mutex_unlock(&record_lock);
+		return -1;
+	}
+
+	fwrite(DB_RECORD_MAGIC, 1, strlen(DB_RECORD_MAGIC), trace_file);
+	last_ns = cutils_now_ns();
+	write_failed = false;
+	atomic_store(&recording, true);
+	pthread_mutex_unlock(&record_lock);
+
+	return 0;
+}
+
+int db_record_stop(void)
+{
+	pthread_mutex_lock(&record_lock);
+	atomic_store(&recording, false);
+
+	int rc = -1;
+	if (trace_file)
+	{
+		rc = (write_failed || ferror(trace_file)) ? -1 : 0;
+		if (fclose(trace_file) != 0)
+			rc = -1;
+		trace_file = NULL;
+	}
+	pthread_mutex_unlock(&record_lock);
+
+	return rc;
+}
+
+bool db_recording(void)
+{
+	return atomic_load_explicit(&recording, memory_order_relaxed);
+}
+
+/*
+	Writes one entry. The timestamp is taken under the lock so the
+	deltas are never negative even with several threads recording.
+*/
+static void write_entry(DBOp op, bool auto_id, unsigned id, unsigned to,
+						DBBookField field, const char *text,
+						const LoanFilter *filter, size_t cap, unsigned date)
+{
+	PayloadKind kind = kind_of(op);
+	if (kind == KIND_INVALID)
+		return;
+
+	pthread_mutex_lock(&record_lock);
+	if (!trace_file)
+	{
+		pthread_mutex_unlock(&record_lock);
+		return;
+	}
+
+	uint64_t now = cutils_now_ns();
+	uint64_t delta_us = (now - last_ns) / 1000;
+	last_ns += delta_us * 1000; /* keep the remainder for the next delta */
+
+	fputc((int)op | (auto_id ? (int)AUTO_ID_FLAG : 0), trace_file);
+	put_varint(trace_file, delta_us);
+
+	switch (kind)
+	{
+	case KIND_ID:
+		put_varint(trace_file, id);
+		break;
+	case KIND_RECORD:
+		put_text(trace_file, text);
+		break;
+	case KIND_SEARCH:
+		fputc((int)field, trace_file);
+		put_text(trace_file, text);
+		break;
+	case KIND_RANGE:
+		put_varint(trace_file, id);
+		put_varint(trace_file, to);
+		break;
+	case KIND_FILTER:
+		put_varint(trace_file, filter->borrow_from);
+		put_varint(trace_file, filter->borrow_to);
+		fputc(filter->active_only ? 1 : 0, trace_file);
+		put_varint(trace_file, filter->book_id);
+		put_varint(trace_file, cap);
+		break;
+	case KIND_CIRCULATION:
+		put_varint(trace_file, id);
+		put_varint(trace_file, to);
+		put_varint(trace_file, date);
+		break;
+	case KIND_SIMILAR:
+		put_varint(trace_file, id);
+		put_varint(trace_file, cap);
+		put_text(trace_file, text);
+		break;
+	case KIND_COMPLETE:
+		fputc((int)id, trace_file);
+		put_varint(trace_file, cap);
+		put_text(trace_file, text);
+		break;
+	default:
+		break;
+	}
+
+	if (ferror(trace_file))
+		write_failed = true;
+	pthread_mutex_unlock(&record_lock);
+}
+
+void db_record_id(DBOp op, unsigned id)
+{
+	write_entry(op, false, id, 0, DB_BOOK_TITLE, NULL, NULL, 0, 0);
+}
+
+void db_record_none(DBOp op)
+{
+	write_entry(op, false, 0, 0, DB_BOOK_TITLE, NULL, NULL, 0, 0);
+}
+
+void db_record_search(DBBookField field, const char *term)
+{
+	write_entry(DB_OP_SEARCH_BOOKS, false, 0, 0, field, term ? term : "", NULL, 0, 0);
+}
+
+/* The range is stored in the id slot (from) and the extra one (to). */
+void db_record_range(DBOp op, unsigned from, unsigned to)
+{
+	write_entry(op, false, from, to, DB_BOOK_TITLE, NULL, NULL, 0, 0);
+}
+
+void db_record_filter(DBOp op, const LoanFilter *filter, size_t cap)
+{
+	write_entry(op, false, 0, 0, DB_BOOK_TITLE, NULL, filter, cap, 0);
+}
+
+void db_record_circulation(DBOp op, unsigned id, unsigned book_id, unsigned date)
+{
+	write_entry(op, false, id, book_id, DB_BOOK_TITLE, NULL, NULL, 0, date);
+}
+
+void db_record_similar(DBOp op, unsigned min_similarity, size_t cap, const char *title)
+{
+	write_entry(op, false, min_similarity, 0, DB_BOOK_TITLE, title ? title : "", NULL, cap, 0);
+}
+
+/* The field is stored in the id slot and the limit in the cap one. */
+void db_record_complete(DBOp op, unsigned field, size_t limit, const char *prefix)
+{
+	write_entry(op, false, field, 0, DB_BOOK_TITLE, prefix ? prefix : "", NULL, limit, 0);
+}
+
+void db_record_book(DBOp op, bool auto_id, const Book *b)
+{
+	char line[DB_RECORD_TEXT_MAX];
+	book_to_csv(b, line, sizeof line);
+	write_entry(op, auto_id, 0, 0, DB_BOOK_TITLE, line, NULL, 0, 0);
+}
+
+void db_record_user(DBOp op, bool auto_id, const User *u)
+{
+	char line[DB_RECORD_TEXT_MAX];
+	user_to_csv(u, line, sizeof line);
+	write_entry(op, auto_id, 0, 0, DB_BOOK_TITLE, line, NULL, 0, 0);
+}
+
+void db_record_loan(DBOp op, bool auto_id, const Loan *l)
+{
+	char line[DB_RECORD_TEXT_MAX];
+	loan_to_csv(l, line, sizeof line);
+	write_entry(op, auto_id, 0, 0, DB_BOOK_TITLE, line, NULL, 0, 0);
+}
+
+void db_record_suggestion(DBOp op, bool auto_id, const Suggestion *s)
+{
+	char line[DB_RECORD_TEXT_MAX];
+	suggestion_to_csv(s, line, sizeof line);
+	write_entry(op, auto_id, 0, 0, DB_BOOK_TITLE, line, NULL, 0, 0);
+}
+
+void db_record_reservation(DBOp op, const Reservation *r)
+{
+	char line[DB_RECORD_TEXT_MAX];
+	reservation_to_csv(r, line, sizeof line);
+	write_entry(op, false, 0, 0, DB_BOOK_TITLE, line, NULL, 0, 0);
+}
+
+/* ---------------------------------------------------------------
+   Reading
+   --------------------------------------------------------------- */
+
+static int get_varint(FILE *f, uint64_t *out)
+{
+	uint64_t v = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(f);
+		if (c == EOF)
+			return -1;
+
+		v |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+		{
+			*out = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int get_text(FILE *f, char *out)
+{
+	uint64_t len;
+	if (get_varint(f, &len) != 0 || len >= DB_RECORD_TEXT_MAX)
+		return -1;
+
+	if (fread(out, 1, (size_t)len, f) != (size_t)len)
+		return -1;
+	out[len] = '\0';
+	return 0;
+}
+
+int db_record_read_header(FILE *f)
+{
+	char magic[sizeof DB_RECORD_MAGIC];
+	size_t len = strlen(DB_RECORD_MAGIC);
+
+	if (!f || fread(magic, 1, len, f) != len)
+		return -1;
+	return memcmp(magic, DB_RECORD_MAGIC, len) == 0 ? 0 : -1;
+}
+
+int db_record_read(FILE *f, uint64_t *clock_us, DBRecordEntry *out)
+{
+	int c = fgetc(f);
+	if (c == EOF)
+		return 0;
+
+	out->op = (DBOp)(c & ~(int)AUTO_ID_FLAG);
+	out->auto_id = (c & AUTO_ID_FLAG) != 0;
+	out->id = 0;
+	out->field = DB_BOOK_TITLE;
+	out->from = 0;
+	out->to = 0;
+	memset(&out->filter, 0, sizeof out->filter);
+	out->cap = 0;
+	out->text[0] = '\0';
+
+	PayloadKind kind = kind_of(out->op);
+	uint64_t delta, value;
+	if (kind == KIND_INVALID || get_varint(f, &delta) != 0)
+		return -1;
+
+	*clock_us += delta;
+	out->time_us = *clock_us;
+
+	switch (kind)
+	{
+	case KIND_ID:
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->id = (unsigned)value;
+		break;
+	case KIND_RECORD:
+		if (get_text(f, out->text) != 0)
+			return -1;
+		break;
+	case KIND_SEARCH:
+		c = fgetc(f);
+		if (c != DB_BOOK_TITLE && c != DB_BOOK_AUTHOR)
+			return -1;
+		out->field = (DBBookField)c;
+		if (get_text(f, out->text) != 0)
+			return -1;
+		break;
+	case KIND_RANGE:
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->from = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->to = (unsigned)value;
+		break;
+	case KIND_FILTER:
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->filter.borrow_from = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->filter.borrow_to = (unsigned)value;
+		c = fgetc(f);
+		if (c != 0 && c != 1)
+			return -1;
+		out->filter.active_only = c == 1;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->filter.book_id = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->cap = (size_t)value;
+		break;
+	case KIND_CIRCULATION:
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->id = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->from = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->to = (unsigned)value;
+		break;
+	case KIND_SIMILAR:
+		if (get_varint(f, &value) != 0 || value > 100)
+			return -1;
+		out->id = (unsigned)value;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->cap = (size_t)value;
+		if (get_text(f, out->text) != 0)
+			return -1;
+		break;
+	case KIND_COMPLETE:
+		c = fgetc(f);
+		if (c < DB_COMPLETE_TITLE || c > DB_COMPLETE_USER_NAME)
+			return -1;
+		out->id = (unsigned)c;
+		if (get_varint(f, &value) != 0 || value > 0xFFFFFFFFu)
+			return -1;
+		out->cap = (size_t)value;
+		if (get_text(f, out->text) != 0)
+			return -1;
+		break;
+	default:
+		break;
+	}
+
+	return 1;
+}
@@ -0,0 +1,244 @@
+/*
+	DB operation counters and log-linear latency histograms.
+	See db/db_stats.h for the bucket layout and the build flag.
+
+	Bucket index of a value v (in ns):
+	- v < 16:  the value itself (exact);
+	- else:    with m = position of the highest set bit of v, the
+	           group is m - 3 and the 16 sub-buckets split
+	           [2^m, 2^(m+1)) linearly using the 4 bits below m.
+	Values above 2^MAX_BIT ns (~18 minutes) land in the last bucket.
+*/
+
+#include "db/db_stats.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define SUB_BITS 4
+#define MAX_BIT 40
+#define GROUPS (MAX_BIT - SUB_BITS + 2)
+#define BUCKETS (GROUPS * DB_STATS_SUB_BUCKETS)
+
+typedef struct {
+	_Atomic uint64_t count;
+	_Atomic uint64_t sum;
+	_Atomic uint64_t max;
+	_Atomic uint64_t buckets[BUCKETS];
+} OpHistogram;
+
+static OpHistogram histograms[DB_OP_COUNT];
+
+#define DB_STATS_NAME_ENTRY(name, label) label,
+static const char *const op_names[DB_OP_COUNT] = {
+	DB_STATS_OPS(DB_STATS_NAME_ENTRY)
+};
+#undef DB_STATS_NAME_ENTRY
+
+static unsigned highest_bit(uint64_t v)
+{
+#if defined(__GNUC__)
+	return 63u - (unsigned)__builtin_clzll(v);
+#else
+	unsigned bit = 0;
+	while (v >>= 1)
+		++bit;
+	return bit;
+#endif
+}
+
+static size_t bucket_of(uint64_t v)
+{
+	if (v < DB_STATS_SUB_BUCKETS)
+		return (size_t)v;
+
+	unsigned msb = highest_bit(v);
+	if (msb > MAX_BIT)
+		return BUCKETS - 1;
+
+	unsigned shift = msb - SUB_BITS;
+	size_t group = msb - SUB_BITS + 1;
+	size_t sub = (size_t)(v >> shift) - DB_STATS_SUB_BUCKETS;
+	return group * DB_STATS_SUB_BUCKETS + sub;
+}
+
+/* Largest value that falls in bucket i. */
+static uint64_t bucket_upper(size_t i)
+{
+	if (i < DB_STATS_SUB_BUCKETS)
+		return (uint64_t)i;
+
+	size_t group = i / DB_STATS_SUB_BUCKETS;
+	uint64_t sub = i % DB_STATS_SUB_BUCKETS;
+	unsigned shift = (unsigned)group - 1;
+	return ((DB_STATS_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+bool db_stats_enabled(void)
+{
+#ifdef DB_STATS_ENABLED
+	return true;
+#else
+	return false;
+#endif
+}
+
+void db_stats_record(DBOp op, uint64_t ns)
+{
+	if ((unsigned)op >= DB_OP_COUNT)
+		return;
+
+	OpHistogram *h = &histograms[op];
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->sum, ns, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->buckets[bucket_of(ns)], 1, memory_order_relaxed);
+
+	uint64_t seen = atomic_load_explicit(&h->max, memory_order_relaxed);
+	while (ns > seen &&
+		   !atomic_compare_exchange_weak_explicit(&h->max, &seen, ns,
+												  memory_order_relaxed,
+												  memory_order_relaxed))
+	{
+	}
+}
+
+void db_stats_reset(void)
+{
+	for (size_t op = 0; op < DB_OP_COUNT; ++op)
+	{
+		OpHistogram *h = &histograms[op];
+		atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+		atomic_store_explicit(&h->sum, 0, memory_order_relaxed);
+		atomic_store_explicit(&h->max, 0, memory_order_relaxed);
+		for (size_t i = 0; i < BUCKETS; ++i)
+			atomic_store_explicit(&h->buckets[i], 0, memory_order_relaxed);
+	}
+}
+
+const char *db_stats_op_name(DBOp op)
+{
+	return (unsigned)op < DB_OP_COUNT ? op_names[op] : "?";
+}
+
+uint64_t db_stats_count(DBOp op)
+{
+	if ((unsigned)op >= DB_OP_COUNT)
+		return 0;
+
+	return atomic_load_explicit(&histograms[op].count, memory_order_relaxed);
+}
+
+uint64_t db_stats_percentile(DBOp op, double p)
+{
+	if ((unsigned)op >= DB_OP_COUNT)
+		return 0;
+
+	const OpHistogram *h = &histograms[op];
+
+	/* The buckets are summed here instead of trusting 'count', which may
+	   be a few samples ahead while other threads are still recording. */
+	uint64_t total = 0;
+	for (size_t i = 0; i < BUCKETS; ++i)
+		total += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	if (p < 0.0)
+		p = 0.0;
+	if (p > 100.0)
+		p = 100.0;
+
+	uint64_t rank = (uint64_t)((p / 100.0) * (double)total + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS; ++i)
+	{
+		seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+		if (seen >= rank)
+		{
+			/* Never report more than the largest value actually seen. */
+			uint64_t upper = bucket_upper(i);
+			return (max && upper > max) ? max : upper;
+		}
+	}
+
+	return max;
+}
+
+/* Prints ns with a unit that keeps it readable (ns, us, ms, s). */
+static void print_duration(FILE *out, uint64_t ns)
+{
+	if (ns < 10000)
+		fprintf(out, " %8lluns", (unsigned long long)ns);
+	else if (ns < 10000000)
+		fprintf(out, " %8.1fus", (double)ns / 1e3);
+	else if (ns < 10000000000ull)
+		fprintf(out, " %8.1fms", (double)ns / 1e6);
+	else
+		fprintf(out, " %8.2fs ", (double)ns / 1e9);
+}
+
+int db_stats_dump(FILE *out)
+{
+	if (!out)
+		return -1;
+
+	/* Samples recorded by hand (e.g. by the replay tool) are shown in any build. */
+	uint64_t total = 0;
+	for (size_t i = 0; i < DB_OP_COUNT; ++i)
+		total += db_stats_count((DBOp)i);
+
+	if (!db_stats_enabled() && total == 0)
+	{
+		fprintf(out, "Estatisticas da DB desativadas (compilar com make DB_STATS=1).\n");
+		return 0;
+	}
+
+	fprintf(out, "%-20s %10s %10s %10s %10s %10s %10s\n",
+			"operacao", "chamadas", "media", "p50", "p90", "p99", "max");
+
+	bool any = false;
+	for (size_t i = 0; i < DB_OP_COUNT; ++i)
+	{
+		DBOp op = (DBOp)i;
+		uint64_t count = db_stats_count(op);
+		if (count == 0)
+			continue;
+
+		const OpHistogram *h = &histograms[op];
+		uint64_t sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+		uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+
+		fprintf(out, "%-20s %10llu", op_names[op], (unsigned long long)count);
+		print_duration(out, sum / count);
+		print_duration(out, db_stats_percentile(op, 50.0));
+		print_duration(out, db_stats_percentile(op, 90.0));
+		print_duration(out, db_stats_percentile(op, 99.0));
+		print_duration(out, max);
+		fputc('\n', out);
+		any = true;
+	}
+
+	if (!any)
+		fprintf(out, "(nenhuma operacao registada)\n");
+
+	return 0;
+}
+
+int db_stats_dump_file(const char *path)
+{
+	if (!path)
+		return -1;
+
+	FILE *f = fopen(path, "w");
+	if (!f)
+		return -1;
+
+	int rc = db_stats_dump(f);
+	if (fclose(f) != 0)
+		rc = -1;
+	return rc;
+}
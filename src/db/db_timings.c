@@ -0,0 +1,87 @@
+/*
+	Formatting of the load/save phase timings (see db/db_timings.h).
+	The measuring itself happens in db.c.
+*/
+
+#include "db/db_timings.h"
+
+static const char *const table_names[DB_TABLE_COUNT] = {
+	"books", "users", "loans", "suggestions"
+};
+
+const char *db_table_name(DBTable table)
+{
+	return (unsigned)table < DB_TABLE_COUNT ? table_names[table] : "?";
+}
+
+long db_timings_file_size(const char *path)
+{
+	if (!path)
+		return -1;
+
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return -1;
+
+	long size = -1;
+	if (fseek(f, 0, SEEK_END) == 0)
+		size = ftell(f);
+	fclose(f);
+
+	return size;
+}
+
+static double per_second(double amount, uint64_t ns)
+{
+	return ns ? amount * 1e9 / (double)ns : 0.0;
+}
+
+static void print_header(FILE *out)
+{
+	fprintf(out, "  %-6s %-12s %10s %12s %10s %12s %9s\n",
+			"fase", "tabela", "linhas", "bytes", "ms", "linhas/s", "MB/s");
+}
+
+static void print_phase(FILE *out, const char *phase, DBTable table,
+						const DBPhaseTiming *p)
+{
+	fprintf(out, "  %-6s %-12s %10zu", phase, db_table_name(table), p->rows);
+
+	if (p->bytes > 0)
+		fprintf(out, " %12ld", p->bytes);
+	else
+		fprintf(out, " %12s", "-");
+
+	fprintf(out, " %10.3f %12.0f", (double)p->ns / 1e6,
+			per_second((double)p->rows, p->ns));
+
+	if (p->bytes > 0)
+		fprintf(out, " %9.1f\n", per_second((double)p->bytes, p->ns) / 1e6);
+	else
+		fprintf(out, " %9s\n", "-");
+}
+
+void db_timings_print_load(const DBTimings *t, FILE *out)
+{
+	if (!t || !out)
+		return;
+
+	fprintf(out, "[timings] Carregamento da DB: %.3f ms\n", (double)t->init_ns / 1e6);
+	print_header(out);
+	for (int i = 0; i < DB_TABLE_COUNT; ++i)
+	{
+		print_phase(out, "load", (DBTable)i, &t->load[i]);
+		print_phase(out, "index", (DBTable)i, &t->index[i]);
+	}
+}
+
+void db_timings_print_save(const DBTimings *t, FILE *out)
+{
+	if (!t || !out)
+		return;
+
+	fprintf(out, "[timings] Gravacao da DB: %.3f ms\n", (double)t->save_ns / 1e6);
+	print_header(out);
+	for (int i = 0; i < DB_TABLE_COUNT; ++i)
+		print_phase(out, "save", (DBTable)i, &t->save[i]);
+}
@@ -0,0 +1,390 @@
+/*
+	Hierarchical timing wheel of due days (see db/due_wheel.h).
+
+	Layout:
+		- every bucket is a circular doubly-linked list with a sentinel
+		  node, so unlinking an entry and moving a whole bucket are O(1);
+		- level 0 bucket i holds day (now & ~63) + i, level 1 bucket j
+		  holds the 64-day block whose number is j modulo 64;
+		- overflow only ever holds days beyond level 1, so bucket_of
+		  also tells lookups where to look. overflow_min is a lower
+		  bound of its due days (removals do not raise it); the ring
+		  is re-placed on the block step that brings that day within
+		  level 1;
+		- an entry is found by id through a chained hash (the 'hnext'
+		  link), which doubles when it holds more entries than buckets.
+		  If doubling fails the chains just get longer.
+*/
+
+#include "db/due_wheel.h"
+
+#include <stdbool.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+/* Days covered by level 0 + level 1; a longer jump rebuilds the wheel. */
+#define WHEEL_SPAN (WHEEL_SLOTS * WHEEL_SLOTS)
+
+#define HASH_MIN_BUCKETS 64
+
+typedef struct DueNode {
+	struct DueNode *prev, *next; /* bucket ring */
+	struct DueNode *hnext;       /* hash chain, or free list */
+	unsigned id;
+	uint32_t due;
+} DueNode;
+
+struct DueWheel {
+	uint32_t now;
+	DueNode level0[WHEEL_SLOTS];
+	DueNode level1[WHEEL_SLOTS];
+	DueNode overflow;
+	uint32_t overflow_min; /* no entry of overflow is due earlier (UINT32_MAX if none) */
+	DueNode overdue;
+
+	DueNode **hash;
+	size_t hash_mask;
+	size_t count;
+
+	DueNode *free_nodes;
+	size_t nodes; /* allocated, live or free */
+};
+
+/* ---------------------------------------------------------------
+   Rings
+   --------------------------------------------------------------- */
+
+static void ring_init(DueNode *head)
+{
+	head->prev = head->next = head;
+}
+
+static bool ring_empty(const DueNode *head)
+{
+	return head->next == head;
+}
+
+static void ring_push(DueNode *head, DueNode *n)
+{
+	n->next = head;
+	n->prev = head->prev;
+	head->prev->next = n;
+	head->prev = n;
+}
+
+static void ring_unlink(DueNode *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+}
+
+/* Appends every entry of src to dst and leaves src empty. */
+static void ring_splice(DueNode *dst, DueNode *src)
+{
+	if (ring_empty(src))
+		return;
+
+	DueNode *first = src->next, *last = src->prev;
+	first->prev = dst->prev;
+	dst->prev->next = first;
+	last->next = dst;
+	dst->prev = last;
+	ring_init(src);
+}
+
+/* ---------------------------------------------------------------
+   Placement
+   --------------------------------------------------------------- */
+
+/* Bucket an entry due on day belongs to, given the current day. */
+static DueNode *bucket_of(DueWheel *w, uint32_t day)
+{
+	if (day < w->now)
+		return &w->overdue;
+
+	uint32_t block = day >> WHEEL_BITS, now_block = w->now >> WHEEL_BITS;
+	if (block == now_block)
+		return &w->level0[day & WHEEL_MASK];
+	if (block - now_block < WHEEL_SLOTS)
+		return &w->level1[block & WHEEL_MASK];
+	return &w->overflow;
+}
+
+/* Links n into the bucket of its due day, keeping overflow_min a lower bound. */
+static void place(DueWheel *w, DueNode *n)
+{
+	DueNode *bucket = bucket_of(w, n->due);
+	if (bucket == &w->overflow && n->due < w->overflow_min)
+		w->overflow_min = n->due;
+	ring_push(bucket, n);
+}
+
+/* Re-places every entry of a ring (detached first, entries may land back in it). */
+static void redistribute(DueWheel *w, DueNode *ring)
+{
+	if (ring == &w->overflow)
+		w->overflow_min = UINT32_MAX;
+
+	DueNode pending;
+	ring_init(&pending);
+	ring_splice(&pending, ring);
+
+	while (!ring_empty(&pending))
+	{
+		DueNode *n = pending.next;
+		ring_unlink(n);
+		place(w, n);
+	}
+}
+
+/* ---------------------------------------------------------------
+   Id hash
+   --------------------------------------------------------------- */
+
+static size_t hash_of(const DueWheel *w, unsigned id)
+{
+	return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ull) >> 32) & w->hash_mask;
+}
+
+static DueNode **hash_find(const DueWheel *w, unsigned id)
+{
+	DueNode **link = &w->hash[hash_of(w, id)];
+	while (*link && (*link)->id != id)
+		link = &(*link)->hnext;
+	return link;
+}
+
+static void hash_grow(DueWheel *w)
+{
+	size_t buckets = 2 * (w->hash_mask + 1);
+	DueNode **hash = aed_calloc(AED_MEM_INDEX, buckets, sizeof *hash);
+	if (!hash)
+		return;
+
+	DueNode **old = w->hash;
+	size_t old_buckets = w->hash_mask + 1;
+	w->hash = hash;
+	w->hash_mask = buckets - 1;
+
+	for (size_t i = 0; i < old_buckets; ++i)
+	{
+		DueNode *n = old[i];
+		while (n)
+		{
+			DueNode *next = n->hnext;
+			DueNode **link = &w->hash[hash_of(w, n->id)];
+			n->hnext = *link;
+			*link = n;
+			n = next;
+		}
+	}
+	aed_free(AED_MEM_INDEX, old, old_buckets * sizeof *old);
+}
+
+/* ---------------------------------------------------------------
+   Public API
+   --------------------------------------------------------------- */
+
+DueWheel *due_wheel_create(uint32_t today)
+{
+	DueWheel *w = aed_malloc(AED_MEM_INDEX, sizeof *w);
+	if (!w)
+		return NULL;
+
+	w->hash = aed_calloc(AED_MEM_INDEX, HASH_MIN_BUCKETS, sizeof *w->hash);
+	if (!w->hash)
+	{
+		aed_free(AED_MEM_INDEX, w, sizeof *w);
+		return NULL;
+	}
+
+	w->now = today;
+	for (unsigned i = 0; i < WHEEL_SLOTS; ++i)
+	{
+		ring_init(&w->level0[i]);
+		ring_init(&w->level1[i]);
+	}
+	ring_init(&w->overflow);
+	w->overflow_min = UINT32_MAX;
+	ring_init(&w->overdue);
+	w->hash_mask = HASH_MIN_BUCKETS - 1;
+	w->count = 0;
+	w->free_nodes = NULL;
+	w->nodes = 0;
+
+	return w;
+}
+
+void due_wheel_destroy(DueWheel *w)
+{
+	if (!w)
+		return;
+
+	for (size_t i = 0; i <= w->hash_mask; ++i)
+	{
+		DueNode *n = w->hash[i];
+		while (n)
+		{
+			DueNode *next = n->hnext;
+			aed_free(AED_MEM_INDEX, n, sizeof *n);
+			n = next;
+		}
+	}
+	while (w->free_nodes)
+	{
+		DueNode *next = w->free_nodes->hnext;
+		aed_free(AED_MEM_INDEX, w->free_nodes, sizeof *w->free_nodes);
+		w->free_nodes = next;
+	}
+
+	aed_free(AED_MEM_INDEX, w->hash, (w->hash_mask + 1) * sizeof *w->hash);
+	aed_free(AED_MEM_INDEX, w, sizeof *w);
+}
+
+int due_wheel_put(DueWheel *w, unsigned id, uint32_t due)
+{
+	if (!w)
+		return -1;
+
+	DueNode **link = hash_find(w, id);
+	DueNode *n = *link;
+	if (n)
+	{
+		ring_unlink(n);
+		n->due = due;
+		place(w, n);
+		return 0;
+	}
+
+	if (w->free_nodes)
+	{
+		n = w->free_nodes;
+		w->free_nodes = n->hnext;
+	}
+	else
+	{
+		n = aed_malloc(AED_MEM_INDEX, sizeof *n);
+		if (!n)
+			return -1;
+		++w->nodes;
+	}
+
+	n->id = id;
+	n->due = due;
+	n->hnext = NULL;
+	*link = n;
+	place(w, n);
+
+	if (++w->count > w->hash_mask + 1)
+		hash_grow(w);
+	return 0;
+}
+
+int due_wheel_remove(DueWheel *w, unsigned id)
+{
+	if (!w)
+		return -1;
+
+	DueNode **link = hash_find(w, id);
+	DueNode *n = *link;
+	if (!n)
+		return -1;
+
+	*link = n->hnext;
+	ring_unlink(n);
+	n->hnext = w->free_nodes;
+	w->free_nodes = n;
+	--w->count;
+	return 0;
+}
+
+void due_wheel_advance(DueWheel *w, uint32_t today)
+{
+	if (!w || today <= w->now)
+		return;
+
+	if (today - w->now > WHEEL_SPAN)
+	{
+		/* Too far for day-by-day steps: gather everything and re-place it. */
+		for (unsigned i = 0; i < WHEEL_SLOTS; ++i)
+		{
+			ring_splice(&w->overflow, &w->level0[i]);
+			ring_splice(&w->overflow, &w->level1[i]);
+		}
+		w->now = today;
+		redistribute(w, &w->overflow);
+		return;
+	}
+
+	while (w->now < today)
+	{
+		ring_splice(&w->overdue, &w->level0[w->now & WHEEL_MASK]);
+		++w->now;
+
+		if ((w->now & WHEEL_MASK) == 0)
+		{
+			/*
+				Overflow entries that level 1 now reaches move there
+				first, so the block about to start is complete and
+				lookups never have to look in overflow.
+			*/
+			uint32_t block = w->now >> WHEEL_BITS;
+			if ((w->overflow_min >> WHEEL_BITS) - block < WHEEL_SLOTS)
+				redistribute(w, &w->overflow);
+			redistribute(w, &w->level1[block & WHEEL_MASK]);
+		}
+	}
+}
+
+uint32_t due_wheel_now(const DueWheel *w)
+{
+	return w ? w->now : 0;
+}
+
+/* Walks one ring; only entries due on day match unless day is UINT32_MAX. */
+static int visit_ring(const DueNode *head, uint32_t day, DueWheelVisitor fn, void *ctx)
+{
+	for (const DueNode *n = head->next; n != head; n = n->next)
+	{
+		if (day != UINT32_MAX && n->due != day)
+			continue;
+
+		int rc = fn(n->id, n->due, ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+int due_wheel_visit_due(const DueWheel *w, uint32_t day, DueWheelVisitor fn, void *ctx)
+{
+	if (!w || !fn)
+		return -1;
+
+	/* bucket_of only reads the wheel. */
+	return visit_ring(bucket_of((DueWheel *)w, day), day, fn, ctx);
+}
+
+int due_wheel_visit_overdue(const DueWheel *w, DueWheelVisitor fn, void *ctx)
+{
+	if (!w || !fn)
+		return -1;
+
+	return visit_ring(&w->overdue, UINT32_MAX, fn, ctx);
+}
+
+size_t due_wheel_size(const DueWheel *w)
+{
+	return w ? w->count : 0;
+}
+
+size_t due_wheel_bytes(const DueWheel *w)
+{
+	if (!w)
+		return 0;
+	return sizeof *w + (w->hash_mask + 1) * sizeof *w->hash + w->nodes * sizeof(DueNode);
+}
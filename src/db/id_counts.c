@@ -0,0 +1,227 @@
+/*
+	Per-id counters (see db/id_counts.h).
+
+	Layout: one array of (key, count) slots with linear probing, kept
+	at most half full. The key is id + 1, so a zeroed slot is empty.
+	Nothing is ever removed, which keeps the probing trivial.
+*/
+
+#include "db/id_counts.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/cutils/aed_alloc.h"
+#include "lib/heap/heap.h"
+
+#define ID_COUNTS_MIN_SLOTS 64
+
+typedef struct {
+	uint32_t key; /* id + 1, 0 = empty */
+	uint32_t count;
+} CountSlot;
+
+struct IdCounts {
+	CountSlot *slots;
+	size_t mask;
+	size_t used;
+	unsigned shift;
+};
+
+/* Fibonacci hashing, like the id index. */
+static size_t slot_of(const IdCounts *c, uint32_t key)
+{
+	return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> c->shift);
+}
+
+static CountSlot *find(const IdCounts *c, uint32_t key)
+{
+	size_t i = slot_of(c, key);
+	while (c->slots[i].key && c->slots[i].key != key)
+		i = (i + 1) & c->mask;
+	return &c->slots[i];
+}
+
+static int init_slots(IdCounts *c, size_t n)
+{
+	c->slots = aed_calloc(AED_MEM_INDEX, n, sizeof *c->slots);
+	if (!c->slots)
+		return -1;
+
+	unsigned bits = 0;
+	while (((size_t)1 << bits) < n)
+		++bits;
+	c->mask = n - 1;
+	c->shift = 64 - bits;
+	return 0;
+}
+
+static int grow(IdCounts *c)
+{
+	CountSlot *old = c->slots;
+	size_t old_n = c->mask + 1;
+
+	if (init_slots(c, 2 * old_n) != 0)
+	{
+		c->slots = old;
+		return -1;
+	}
+
+	for (size_t i = 0; i < old_n; ++i)
+	{
+		if (old[i].key)
+			*find(c, old[i].key) = old[i];
+	}
+	aed_free(AED_MEM_INDEX, old, old_n * sizeof *old);
+	return 0;
+}
+
+IdCounts *id_counts_create(void)
+{
+	IdCounts *c = aed_malloc(AED_MEM_INDEX, sizeof *c);
+	if (!c)
+		return NULL;
+
+	c->used = 0;
+	if (init_slots(c, ID_COUNTS_MIN_SLOTS) != 0)
+	{
+		aed_free(AED_MEM_INDEX, c, sizeof *c);
+		return NULL;
+	}
+	return c;
+}
+
+void id_counts_destroy(IdCounts *c)
+{
+	if (!c)
+		return;
+
+	aed_free(AED_MEM_INDEX, c->slots, (c->mask + 1) * sizeof *c->slots);
+	aed_free(AED_MEM_INDEX, c, sizeof *c);
+}
+
+int id_counts_add(IdCounts *c, unsigned id, int delta)
+{
+	if (!c || id == UINT_MAX)
+		return -1;
+
+	uint32_t key = (uint32_t)id + 1;
+	CountSlot *s = find(c, key);
+	int64_t count = (s->key ? (int64_t)s->count : 0) + delta;
+	if (count < 0 || count > UINT32_MAX)
+		return -1;
+
+	if (!s->key)
+	{
+		if (count == 0)
+			return 0;
+		if (2 * (c->used + 1) > c->mask + 1)
+		{
+			if (grow(c) != 0)
+				return -1;
+			s = find(c, key);
+		}
+		s->key = key;
+		++c->used;
+	}
+	s->count = (uint32_t)count;
+	return 0;
+}
+
+unsigned id_counts_get(const IdCounts *c, unsigned id)
+{
+	if (!c || id == UINT_MAX)
+		return 0;
+
+	const CountSlot *s = find(c, (uint32_t)id + 1);
+	return s->key ? s->count : 0;
+}
+
+int id_counts_foreach(const IdCounts *c, IdCountsVisitor fn, void *ctx)
+{
+	if (!c || !fn)
+		return -1;
+
+	for (size_t i = 0; i <= c->mask; ++i)
+	{
+		const CountSlot *s = &c->slots[i];
+		if (!s->key || s->count == 0)
+			continue;
+
+		int rc = fn(s->key - 1, s->count, ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+/* Order of the result: larger count first, then lower id. */
+static int count_order(const IdCount *a, const IdCount *b)
+{
+	if (a->count != b->count)
+		return a->count > b->count ? -1 : 1;
+	return a->id < b->id ? -1 : a->id > b->id;
+}
+
+/* The heap keeps the worst of the k best at its root. */
+static int worst_first(const void *a, const void *b, void *ctx)
+{
+	(void)ctx;
+	return count_order(b, a);
+}
+
+static int sort_top(const void *a, const void *b)
+{
+	return count_order(a, b);
+}
+
+int id_counts_top(const IdCounts *c, size_t k, IdCount *out, size_t *n)
+{
+	if (!c || !n || (k > 0 && !out))
+		return -1;
+
+	*n = 0;
+	if (k == 0)
+		return 0;
+
+	/* The heap orders pointers into out, which holds the entries. */
+	Heap *h = heap_create(worst_first, NULL, NULL);
+	if (!h)
+		return -1;
+
+	size_t size = 0;
+	for (size_t i = 0; i <= c->mask; ++i)
+	{
+		const CountSlot *s = &c->slots[i];
+		if (!s->key || !s->count)
+			continue;
+
+		IdCount e = { s->key - 1, s->count };
+		if (size < k)
+		{
+			out[size] = e;
+			if (heap_push(h, &out[size]) != 0)
+			{
+				heap_destroy(h);
+				return -1;
+			}
+			++size;
+		}
+		else if (count_order(&e, heap_peek(h)) < 0)
+		{
+			*(IdCount *)heap_peek(h) = e;
+			heap_update_at(h, 0);
+		}
+	}
+	heap_destroy(h);
+
+	qsort(out, size, sizeof *out, sort_top);
+	*n = size;
+	return 0;
+}
+
+size_t id_counts_bytes(const IdCounts *c)
+{
+	return c ? sizeof *c + (c->mask + 1) * sizeof *c->slots : 0;
+}
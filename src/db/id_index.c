@@ -0,0 +1,268 @@
+/*
+	Open-addressing hash index (id -> record) with lock-free reads.
+
+	Layout:
+		- linear probing over a power-of-two bucket array;
+		- a slot key of 0 means "never used", otherwise it holds id + 1;
+		- removing an entry only clears its value (tombstone). Keys are
+		  never rewritten while readers might be probing, so a reader
+		  that matched a key can never end up reading another id's value.
+
+	Tombstones are dropped the next time the array is rebuilt. A rebuild
+	publishes a brand new array with a single atomic store and retires
+	the old one through the epoch domain.
+*/
+
+#include "db/id_index.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+#define ID_INDEX_MIN_CAPACITY 16
+
+typedef struct {
+	_Atomic uint64_t key;
+	_Atomic(void *) value;
+	void *aux;
+} IdSlot;
+
+typedef struct {
+	size_t mask;
+	unsigned shift;
+	IdSlot slots[];
+} IdTable;
+
+struct IdIndex {
+	_Atomic(IdTable *) table;
+	size_t used; /* slots with a key, including tombstones */
+	size_t live; /* slots with a value */
+	EpochDomain *epoch;
+};
+
+/* Fibonacci hashing: spreads consecutive ids over the whole array. */
+static size_t slot_of(const IdTable *t, unsigned id)
+{
+	return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ull) >> t->shift);
+}
+
+static size_t table_bytes(size_t capacity)
+{
+	return sizeof(IdTable) + capacity * sizeof(IdSlot);
+}
+
+/* Also used as the epoch free function of replaced tables. */
+static void table_free(void *p)
+{
+	IdTable *t = p;
+	if (t)
+		aed_free(AED_MEM_INDEX, t, table_bytes(t->mask + 1));
+}
+
+static IdTable *table_create(size_t capacity)
+{
+	IdTable *t = aed_malloc(AED_MEM_INDEX, table_bytes(capacity));
+	if (!t)
+		return NULL;
+
+	unsigned bits = 0;
+	while (((size_t)1 << bits) < capacity)
+		++bits;
+
+	t->mask = capacity - 1;
+	t->shift = 64 - bits;
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		atomic_init(&t->slots[i].key, 0);
+		atomic_init(&t->slots[i].value, NULL);
+		t->slots[i].aux = NULL;
+	}
+
+	return t;
+}
+
+IdIndex *id_index_create(EpochDomain *epoch)
+{
+	IdIndex *idx = aed_malloc(AED_MEM_INDEX, sizeof *idx);
+	if (!idx)
+		return NULL;
+
+	IdTable *t = table_create(ID_INDEX_MIN_CAPACITY);
+	if (!t)
+	{
+		aed_free(AED_MEM_INDEX, idx, sizeof *idx);
+		return NULL;
+	}
+
+	atomic_init(&idx->table, t);
+	idx->used = 0;
+	idx->live = 0;
+	idx->epoch = epoch;
+	return idx;
+}
+
+void id_index_destroy(IdIndex *idx)
+{
+	if (!idx)
+		return;
+
+	table_free(atomic_load(&idx->table));
+	aed_free(AED_MEM_INDEX, idx, sizeof *idx);
+}
+
+/* Writer-side probe: slot holding id, or NULL. */
+static IdSlot *find_slot(IdTable *t, unsigned id)
+{
+	uint64_t want = (uint64_t)id + 1;
+	size_t i = slot_of(t, id);
+
+	for (;;)
+	{
+		uint64_t k = atomic_load_explicit(&t->slots[i].key, memory_order_relaxed);
+		if (k == want)
+			return &t->slots[i];
+		if (k == 0)
+			return NULL;
+		i = (i + 1) & t->mask;
+	}
+}
+
+/*
+	Copies every live entry into a fresh array sized for the current
+	population and swaps it in. Readers still probing the old array
+	keep seeing consistent data until they leave their read section.
+*/
+static int rebuild(IdIndex *idx, size_t min_live)
+{
+	size_t capacity = ID_INDEX_MIN_CAPACITY;
+	while (capacity < min_live * 4)
+		capacity *= 2;
+
+	IdTable *old = atomic_load_explicit(&idx->table, memory_order_relaxed);
+	IdTable *t = table_create(capacity);
+	if (!t)
+		return -1;
+
+	size_t used = 0;
+	for (size_t i = 0; i <= old->mask; ++i)
+	{
+		void *value = atomic_load_explicit(&old->slots[i].value, memory_order_relaxed);
+		if (!value)
+			continue;
+
+		uint64_t key = atomic_load_explicit(&old->slots[i].key, memory_order_relaxed);
+		size_t j = slot_of(t, (unsigned)(key - 1));
+		while (atomic_load_explicit(&t->slots[j].key, memory_order_relaxed) != 0)
+			j = (j + 1) & t->mask;
+
+		atomic_store_explicit(&t->slots[j].value, value, memory_order_relaxed);
+		atomic_store_explicit(&t->slots[j].key, key, memory_order_relaxed);
+		t->slots[j].aux = old->slots[i].aux;
+		++used;
+	}
+
+	atomic_store_explicit(&idx->table, t, memory_order_release);
+	idx->used = used;
+	epoch_retire(idx->epoch, old, table_free);
+	return 0;
+}
+
+int id_index_put(IdIndex *idx, unsigned id, void *value, void *aux)
+{
+	if (!idx || !value)
+		return -1;
+
+	IdTable *t = atomic_load_explicit(&idx->table, memory_order_relaxed);
+	IdSlot *s = find_slot(t, id);
+	if (s)
+	{
+		if (!atomic_load_explicit(&s->value, memory_order_relaxed))
+			++idx->live;
+		s->aux = aux;
+		atomic_store_explicit(&s->value, value, memory_order_release);
+		return 0;
+	}
+
+	/* Keep the load factor (tombstones included) at or below 1/2. */
+	if ((idx->used + 1) * 2 > t->mask + 1)
+	{
+		if (rebuild(idx, idx->live + 1) != 0)
+			return -1;
+		t = atomic_load_explicit(&idx->table, memory_order_relaxed);
+	}
+
+	size_t i = slot_of(t, id);
+	while (atomic_load_explicit(&t->slots[i].key, memory_order_relaxed) != 0)
+		i = (i + 1) & t->mask;
+
+	/* Value first, key last: a reader that sees the key sees the value. */
+	t->slots[i].aux = aux;
+	atomic_store_explicit(&t->slots[i].value, value, memory_order_relaxed);
+	atomic_store_explicit(&t->slots[i].key, (uint64_t)id + 1, memory_order_release);
+
+	++idx->used;
+	++idx->live;
+	return 0;
+}
+
+int id_index_remove(IdIndex *idx, unsigned id)
+{
+	if (!idx)
+		return -1;
+
+	IdTable *t = atomic_load_explicit(&idx->table, memory_order_relaxed);
+	IdSlot *s = find_slot(t, id);
+	if (!s || !atomic_load_explicit(&s->value, memory_order_relaxed))
+		return -1;
+
+	atomic_store_explicit(&s->value, NULL, memory_order_release);
+	s->aux = NULL;
+	--idx->live;
+	return 0;
+}
+
+void *id_index_get(const IdIndex *idx, unsigned id)
+{
+	if (!idx)
+		return NULL;
+
+	IdTable *t = atomic_load_explicit(&((IdIndex *)idx)->table, memory_order_acquire);
+	uint64_t want = (uint64_t)id + 1;
+	size_t i = slot_of(t, id);
+
+	for (;;)
+	{
+		uint64_t k = atomic_load_explicit(&t->slots[i].key, memory_order_acquire);
+		if (k == want)
+			return atomic_load_explicit(&t->slots[i].value, memory_order_acquire);
+		if (k == 0)
+			return NULL;
+		i = (i + 1) & t->mask;
+	}
+}
+
+void *id_index_aux(const IdIndex *idx, unsigned id)
+{
+	if (!idx)
+		return NULL;
+
+	IdTable *t = atomic_load_explicit(&((IdIndex *)idx)->table, memory_order_relaxed);
+	IdSlot *s = find_slot(t, id);
+	return (s && atomic_load_explicit(&s->value, memory_order_relaxed)) ? s->aux : NULL;
+}
+
+size_t id_index_size(const IdIndex *idx)
+{
+	return idx ? idx->live : 0;
+}
+
+size_t id_index_bytes(const IdIndex *idx)
+{
+	if (!idx)
+		return 0;
+
+	const IdTable *t = atomic_load_explicit(&idx->table, memory_order_relaxed);
+	return sizeof *idx + table_bytes(t->mask + 1);
+}
@@ -0,0 +1,533 @@
+/*
+	Column store of the loans table (see db/loan_columns.h).
+
+	Layout:
+		- one block of COL_COUNT * capacity uint32_t, split into the
+		  five columns, so growing is a single allocation and copy;
+		- rows 0..rows-1 are live; removing a row moves the last one
+		  into its place;
+		- an open-addressing hash (linear probing, load <= 1/2) maps
+		  an id to its row + 1 (0 = empty). Removal shifts the probe
+		  chain back instead of leaving tombstones.
+
+	The two date columns hold day numbers (model/date.h), not YYYYMMDD,
+	so a filter's bounds are converted once per scan and the length of
+	a loan is a subtraction.
+
+	Scans:
+		Every filter is reduced to three tests that need no branches:
+
+			(date_borrow - lo) <= span         unsigned, one subtraction
+			(date_return & return_mask) == 0   mask 0 disables the test
+			(book_id & book_mask) == book      mask 0 and book 0 disable it
+
+		The SSE2 and AVX2 kernels run them on 4 and 8 rows at a time
+		(SSE2 has no unsigned compare, so both sides are biased by
+		2^31 and compared signed). Counting keeps per-lane totals in a
+		register; selecting turns the lane mask into bits and writes
+		the ids of the set ones. The kernel is picked once from the
+		CPU features (GCC/Clang on x86); other builds use the scalar
+		loop, which the compiler may still vectorize.
+*/
+
+#include "db/loan_columns.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOAN_COLUMNS_X86 1
+#include <immintrin.h>
+#endif
+
+#define LOAN_COLUMNS_MIN_CAPACITY 64
+
+enum { COL_ID, COL_USER, COL_BOOK, COL_BORROW, COL_RETURN, COL_COUNT };
+
+struct LoanColumns {
+	uint32_t *block;
+	uint32_t *col[COL_COUNT];
+	size_t rows;
+	size_t capacity;
+
+	uint32_t *slots;  /* 2 * capacity entries */
+	size_t slot_mask;
+	unsigned shift;
+};
+
+/* ---------------------------------------------------------------
+   Storage and id hash
+   --------------------------------------------------------------- */
+
+/* Fibonacci hashing, like the id index. */
+static size_t slot_of(const LoanColumns *c, uint32_t id)
+{
+	return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ull) >> c->shift);
+}
+
+/* Slot holding id, or the empty slot where it would go. */
+static size_t find_slot(const LoanColumns *c, uint32_t id)
+{
+	size_t i = slot_of(c, id);
+	while (c->slots[i] && c->col[COL_ID][c->slots[i] - 1] != id)
+		i = (i + 1) & c->slot_mask;
+	return i;
+}
+
+static void free_storage(uint32_t *block, uint32_t *slots, size_t capacity)
+{
+	aed_free(AED_MEM_INDEX, block, COL_COUNT * capacity * sizeof(uint32_t));
+	aed_free(AED_MEM_INDEX, slots, 2 * capacity * sizeof(uint32_t));
+}
+
+/* Moves the rows to a block of new_capacity rows and rebuilds the hash. */
+static int resize(LoanColumns *c, size_t new_capacity)
+{
+	uint32_t *block = aed_malloc(AED_MEM_INDEX, COL_COUNT * new_capacity * sizeof(uint32_t));
+	uint32_t *slots = aed_calloc(AED_MEM_INDEX, 2 * new_capacity, sizeof(uint32_t));
+	if (!block || !slots)
+	{
+		aed_free(AED_MEM_INDEX, block, block ? COL_COUNT * new_capacity * sizeof(uint32_t) : 0);
+		aed_free(AED_MEM_INDEX, slots, slots ? 2 * new_capacity * sizeof(uint32_t) : 0);
+		return -1;
+	}
+
+	for (int k = 0; k < COL_COUNT; ++k)
+	{
+		uint32_t *col = block + (size_t)k * new_capacity;
+		if (c->rows)
+			memcpy(col, c->col[k], c->rows * sizeof(uint32_t));
+		c->col[k] = col;
+	}
+	free_storage(c->block, c->slots, c->capacity);
+
+	unsigned bits = 0;
+	while (((size_t)1 << bits) < 2 * new_capacity)
+		++bits;
+
+	c->block = block;
+	c->slots = slots;
+	c->capacity = new_capacity;
+	c->slot_mask = 2 * new_capacity - 1;
+	c->shift = 64 - bits;
+
+	for (size_t r = 0; r < c->rows; ++r)
+		c->slots[find_slot(c, c->col[COL_ID][r])] = (uint32_t)(r + 1);
+
+	return 0;
+}
+
+LoanColumns *loan_columns_create(size_t capacity)
+{
+	LoanColumns *c = aed_calloc(AED_MEM_INDEX, 1, sizeof *c);
+	if (!c)
+		return NULL;
+
+	size_t cap = LOAN_COLUMNS_MIN_CAPACITY;
+	while (cap < capacity)
+		cap *= 2;
+
+	if (resize(c, cap) != 0)
+	{
+		aed_free(AED_MEM_INDEX, c, sizeof *c);
+		return NULL;
+	}
+	return c;
+}
+
+void loan_columns_destroy(LoanColumns *c)
+{
+	if (!c)
+		return;
+
+	free_storage(c->block, c->slots, c->capacity);
+	aed_free(AED_MEM_INDEX, c, sizeof *c);
+}
+
+static void write_row(LoanColumns *c, size_t r, const Loan *l)
+{
+	c->col[COL_ID][r] = l->id;
+	c->col[COL_USER][r] = l->user_id;
+	c->col[COL_BOOK][r] = l->book_id;
+	c->col[COL_BORROW][r] = loan_borrow_day(l);
+	c->col[COL_RETURN][r] = loan_return_day(l);
+}
+
+int loan_columns_put(LoanColumns *c, const Loan *l)
+{
+	if (!c || !l)
+		return -1;
+
+	size_t i = find_slot(c, l->id);
+	if (c->slots[i])
+	{
+		write_row(c, c->slots[i] - 1, l);
+		return 0;
+	}
+
+	if (c->rows == c->capacity || c->rows >= UINT32_MAX - 1)
+	{
+		if (c->rows >= UINT32_MAX - 1 || resize(c, 2 * c->capacity) != 0)
+			return -1;
+		i = find_slot(c, l->id);
+	}
+
+	write_row(c, c->rows, l);
+	c->slots[i] = (uint32_t)(++c->rows);
+	return 0;
+}
+
+/* Empties slot i, shifting back the entries that probed past it. */
+static void clear_slot(LoanColumns *c, size_t i)
+{
+	size_t j = i;
+	for (;;)
+	{
+		j = (j + 1) & c->slot_mask;
+		if (!c->slots[j])
+			break;
+
+		/* The entry at j may move to i only if its home is not in (i, j]. */
+		size_t home = slot_of(c, c->col[COL_ID][c->slots[j] - 1]);
+		bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+		if (!stays)
+		{
+			c->slots[i] = c->slots[j];
+			i = j;
+		}
+	}
+	c->slots[i] = 0;
+}
+
+int loan_columns_remove(LoanColumns *c, unsigned id)
+{
+	if (!c)
+		return -1;
+
+	size_t i = find_slot(c, id);
+	if (!c->slots[i])
+		return -1;
+
+	size_t r = c->slots[i] - 1;
+	size_t last = c->rows - 1;
+	clear_slot(c, i);
+
+	if (r != last)
+	{
+		for (int k = 0; k < COL_COUNT; ++k)
+			c->col[k][r] = c->col[k][last];
+		c->slots[find_slot(c, c->col[COL_ID][r])] = (uint32_t)(r + 1);
+	}
+	--c->rows;
+	return 0;
+}
+
+size_t loan_columns_size(const LoanColumns *c)
+{
+	return c ? c->rows : 0;
+}
+
+size_t loan_columns_bytes(const LoanColumns *c)
+{
+	if (!c)
+		return 0;
+	return sizeof *c + (COL_COUNT + 2) * c->capacity * sizeof(uint32_t);
+}
+
+/* ---------------------------------------------------------------
+   Scan kernels
+   --------------------------------------------------------------- */
+
+typedef struct {
+	uint32_t lo, span;
+	uint32_t return_mask;
+	uint32_t book_mask, book;
+} ScanParams;
+
+/* '&' rather than '&&': no branches, so the compiler can vectorize the count loop. */
+static bool row_matches(const LoanColumns *c, const ScanParams *p, size_t r)
+{
+	return ((c->col[COL_BORROW][r] - p->lo) <= p->span) &
+		   ((c->col[COL_RETURN][r] & p->return_mask) == 0) &
+		   ((c->col[COL_BOOK][r] & p->book_mask) == p->book);
+}
+
+/* Rows from..rows-1, one at a time; n matches were found before them. */
+static size_t scan_rows(const LoanColumns *c, const ScanParams *p, size_t from,
+						unsigned *ids, size_t cap, size_t n)
+{
+	if (!ids)
+	{
+		for (size_t r = from; r < c->rows; ++r)
+			n += row_matches(c, p, r);
+		return n;
+	}
+
+	for (size_t r = from; r < c->rows; ++r)
+	{
+		if (!row_matches(c, p, r))
+			continue;
+		if (n < cap)
+			ids[n] = c->col[COL_ID][r];
+		++n;
+	}
+	return n;
+}
+
+static size_t scan_scalar(const LoanColumns *c, const ScanParams *p,
+						  unsigned *ids, size_t cap)
+{
+	return scan_rows(c, p, 0, ids, cap, 0);
+}
+
+#ifdef LOAN_COLUMNS_X86
+
+/* Writes the ids of the set bits of a lane mask. */
+static inline size_t emit_ids(unsigned bits, const uint32_t *row_ids,
+							  unsigned *ids, size_t cap, size_t n)
+{
+	while (bits)
+	{
+		if (n < cap)
+			ids[n] = row_ids[__builtin_ctz(bits)];
+		++n;
+		bits &= bits - 1;
+	}
+	return n;
+}
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const LoanColumns *c, const ScanParams *p,
+						unsigned *ids, size_t cap)
+{
+	const __m128i bias = _mm_set1_epi32(INT32_MIN);
+	const __m128i lo = _mm_set1_epi32((int32_t)p->lo);
+	const __m128i span = _mm_set1_epi32((int32_t)(p->span ^ 0x80000000u));
+	const __m128i return_mask = _mm_set1_epi32((int32_t)p->return_mask);
+	const __m128i book_mask = _mm_set1_epi32((int32_t)p->book_mask);
+	const __m128i book = _mm_set1_epi32((int32_t)p->book);
+	const __m128i zero = _mm_setzero_si128();
+	const uint32_t *borrow = c->col[COL_BORROW];
+	const uint32_t *ret = c->col[COL_RETURN];
+	const uint32_t *books = c->col[COL_BOOK];
+
+	__m128i counts = zero;
+	size_t n = 0, r = 0;
+	for (; r + 4 <= c->rows; r += 4)
+	{
+		__m128i d = _mm_xor_si128(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(borrow + r)), lo), bias);
+		__m128i outside = _mm_cmpgt_epi32(d, span);
+		__m128i ret_ok = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(ret + r)), return_mask), zero);
+		__m128i book_ok = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(books + r)), book_mask), book);
+		__m128i hit = _mm_andnot_si128(outside, _mm_and_si128(ret_ok, book_ok));
+
+		if (ids)
+			n = emit_ids((unsigned)_mm_movemask_ps(_mm_castsi128_ps(hit)),
+						 c->col[COL_ID] + r, ids, cap, n);
+		else
+			counts = _mm_sub_epi32(counts, hit); /* a hit lane is -1 */
+	}
+
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, counts);
+	for (int k = 0; k < 4; ++k)
+		n += lanes[k];
+
+	return scan_rows(c, p, r, ids, cap, n);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const LoanColumns *c, const ScanParams *p,
+						unsigned *ids, size_t cap)
+{
+	const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+	const __m256i lo = _mm256_set1_epi32((int32_t)p->lo);
+	const __m256i span = _mm256_set1_epi32((int32_t)(p->span ^ 0x80000000u));
+	const __m256i return_mask = _mm256_set1_epi32((int32_t)p->return_mask);
+	const __m256i book_mask = _mm256_set1_epi32((int32_t)p->book_mask);
+	const __m256i book = _mm256_set1_epi32((int32_t)p->book);
+	const __m256i zero = _mm256_setzero_si256();
+	const uint32_t *borrow = c->col[COL_BORROW];
+	const uint32_t *ret = c->col[COL_RETURN];
+	const uint32_t *books = c->col[COL_BOOK];
+
+	__m256i counts = zero;
+	size_t n = 0, r = 0;
+	for (; r + 8 <= c->rows; r += 8)
+	{
+		__m256i d = _mm256_xor_si256(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(borrow + r)), lo), bias);
+		__m256i outside = _mm256_cmpgt_epi32(d, span);
+		__m256i ret_ok = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(ret + r)), return_mask), zero);
+		__m256i book_ok = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(books + r)), book_mask), book);
+		__m256i hit = _mm256_andnot_si256(outside, _mm256_and_si256(ret_ok, book_ok));
+
+		if (ids)
+			n = emit_ids((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(hit)),
+						 c->col[COL_ID] + r, ids, cap, n);
+		else
+			counts = _mm256_sub_epi32(counts, hit);
+	}
+
+	uint32_t lanes[8];
+	_mm256_storeu_si256((__m256i *)lanes, counts);
+	for (int k = 0; k < 8; ++k)
+		n += lanes[k];
+
+	return scan_rows(c, p, r, ids, cap, n);
+}
+
+#endif /* LOAN_COLUMNS_X86 */
+
+/* ---------------------------------------------------------------
+   Kernel selection
+   --------------------------------------------------------------- */
+
+static _Atomic int current_kernel = LOAN_KERNEL_AUTO;
+
+static bool kernel_supported(LoanKernel kernel)
+{
+	switch (kernel)
+	{
+	case LOAN_KERNEL_SCALAR:
+		return true;
+#ifdef LOAN_COLUMNS_X86
+	case LOAN_KERNEL_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case LOAN_KERNEL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+static LoanKernel best_kernel(void)
+{
+	if (kernel_supported(LOAN_KERNEL_AVX2))
+		return LOAN_KERNEL_AVX2;
+	if (kernel_supported(LOAN_KERNEL_SSE2))
+		return LOAN_KERNEL_SSE2;
+	return LOAN_KERNEL_SCALAR;
+}
+
+static LoanKernel active_kernel(void)
+{
+	LoanKernel kernel = (LoanKernel)atomic_load_explicit(&current_kernel, memory_order_relaxed);
+	if (kernel == LOAN_KERNEL_AUTO)
+	{
+		kernel = best_kernel();
+		atomic_store_explicit(&current_kernel, (int)kernel, memory_order_relaxed);
+	}
+	return kernel;
+}
+
+int loan_columns_set_kernel(LoanKernel kernel)
+{
+	if (kernel == LOAN_KERNEL_AUTO)
+		kernel = best_kernel();
+	else if (!kernel_supported(kernel))
+		return -1;
+
+	atomic_store_explicit(&current_kernel, (int)kernel, memory_order_relaxed);
+	return 0;
+}
+
+const char *loan_columns_kernel_name(void)
+{
+	switch (active_kernel())
+	{
+	case LOAN_KERNEL_AVX2: return "avx2";
+	case LOAN_KERNEL_SSE2: return "sse2";
+	default:               return "scalar";
+	}
+}
+
+/* Turns a filter into scan parameters; false if nothing can match. */
+static bool scan_params(const LoanFilter *f, ScanParams *p)
+{
+	Date lo = date_ceil_yyyymmdd(f->borrow_from);
+	Date hi = f->borrow_to ? date_from_yyyymmdd(f->borrow_to) : UINT32_MAX;
+	if (lo > hi)
+		return false;
+
+	p->lo = lo;
+	p->span = hi - lo;
+	p->return_mask = f->active_only ? UINT32_MAX : 0;
+	p->book_mask = f->book_id ? UINT32_MAX : 0;
+	p->book = f->book_id;
+	return true;
+}
+
+static size_t scan(const LoanColumns *c, const LoanFilter *f, unsigned *ids, size_t cap)
+{
+	ScanParams p;
+	if (!c || !f || !scan_params(f, &p))
+		return 0;
+
+	switch (active_kernel())
+	{
+#ifdef LOAN_COLUMNS_X86
+	case LOAN_KERNEL_AVX2: return scan_avx2(c, &p, ids, cap);
+	case LOAN_KERNEL_SSE2: return scan_sse2(c, &p, ids, cap);
+#endif
+	default:               return scan_scalar(c, &p, ids, cap);
+	}
+}
+
+size_t loan_columns_count(const LoanColumns *c, const LoanFilter *f)
+{
+	return scan(c, f, NULL, 0);
+}
+
+size_t loan_columns_select(const LoanColumns *c, const LoanFilter *f,
+						   unsigned *ids, size_t cap)
+{
+	return scan(c, f, ids, ids ? cap : 0);
+}
+
+size_t loan_columns_days_out(const LoanColumns *c, const LoanFilter *f, uint64_t *days)
+{
+	ScanParams p;
+	*days = 0;
+	if (!c || !f || f->active_only || !scan_params(f, &p))
+		return 0;
+
+	const uint32_t *borrow = c->col[COL_BORROW];
+	const uint32_t *ret = c->col[COL_RETURN];
+	size_t n = 0;
+	uint64_t total = 0;
+
+	/* Day numbers make the length a subtraction; no branch per row. */
+	for (size_t r = 0; r < c->rows; ++r)
+	{
+		uint32_t ok = row_matches(c, &p, r) & (ret[r] >= borrow[r]) & (ret[r] != DATE_NONE);
+		n += ok;
+		total += (uint64_t)((ret[r] - borrow[r]) & -ok);
+	}
+
+	*days = total;
+	return n;
+}
+
+int loan_columns_tally(const LoanColumns *c, const LoanFilter *f, LoanGroup by,
+					   IdCounts *counts)
+{
+	ScanParams p;
+	if (!c || !f || !counts)
+		return -1;
+	if (!scan_params(f, &p))
+		return 0;
+
+	const uint32_t *key = c->col[by == LOAN_BY_USER ? COL_USER : COL_BOOK];
+	for (size_t r = 0; r < c->rows; ++r)
+	{
+		if (row_matches(c, &p, r) && id_counts_add(counts, key[r], 1) != 0)
+			return -1;
+	}
+	return 0;
+}
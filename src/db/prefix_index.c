@@ -0,0 +1,463 @@
+/*
+	Radix trie of folded keys (see db/prefix_index.h).
+
+	Layout: each node is one allocation holding its edge label, with
+	two side arrays, the children (sorted by the first byte of their
+	label) and the ids whose key ends at the node (ascending). The root
+	has an empty label and is never pruned. total counts the ids in the
+	subtree; a node other than the root with total == 0 is "dead".
+
+	An add allocates everything it needs before touching the trie, so
+	a failure leaves it as it was. Arrays never shrink and removals
+	never free nodes, which is why adding back what was just removed
+	cannot fail; dead nodes are reclaimed by prune, from an add, once
+	they are half of the trie.
+*/
+
+#include "db/prefix_index.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+/* Dead nodes tolerated before a prune is even considered. */
+#define PRUNE_MIN_DEAD 64
+
+typedef struct TrieNode TrieNode;
+
+struct TrieNode {
+	TrieNode **children;
+	unsigned *ids;
+	uint32_t n_children;
+	uint32_t cap_children;
+	uint32_t n_ids;
+	uint32_t cap_ids;
+	uint32_t total;
+	uint32_t label_len;
+	uint32_t label_cap;
+	unsigned char label[];
+};
+
+struct PrefixIndex {
+	TrieNode *root;
+	size_t nodes; /* without the root */
+	size_t dead;
+	size_t ids;
+	size_t bytes;
+};
+
+/* Lowers ASCII letters; returns the folded length (at most PREFIX_KEY_MAX). */
+static size_t fold(const char *key, unsigned char *out)
+{
+	size_t len = 0;
+	for (const unsigned char *c = (const unsigned char *)key; *c && len < PREFIX_KEY_MAX; ++c)
+		out[len++] = (*c >= 'A' && *c <= 'Z') ? (unsigned char)(*c - 'A' + 'a') : *c;
+	return len;
+}
+
+static size_t node_size(uint32_t label_cap)
+{
+	return sizeof(TrieNode) + label_cap;
+}
+
+static TrieNode *node_new(PrefixIndex *p, const unsigned char *label, size_t len)
+{
+	TrieNode *n = aed_malloc(AED_MEM_INDEX, node_size((uint32_t)len));
+	if (!n)
+		return NULL;
+
+	memset(n, 0, sizeof *n);
+	if (len > 0)
+		memcpy(n->label, label, len);
+	n->label_len = n->label_cap = (uint32_t)len;
+	p->bytes += node_size(n->label_cap);
+	return n;
+}
+
+/* Frees the node and its arrays, not its children. */
+static void node_free(PrefixIndex *p, TrieNode *n)
+{
+	p->bytes -= node_size(n->label_cap) + n->cap_children * sizeof *n->children +
+				n->cap_ids * sizeof *n->ids;
+	aed_free(AED_MEM_INDEX, n->children, n->cap_children * sizeof *n->children);
+	aed_free(AED_MEM_INDEX, n->ids, n->cap_ids * sizeof *n->ids);
+	aed_free(AED_MEM_INDEX, n, node_size(n->label_cap));
+}
+
+/* Frees a subtree; returns how many nodes it had. */
+static size_t subtree_free(PrefixIndex *p, TrieNode *n)
+{
+	size_t count = 1;
+	for (uint32_t i = 0; i < n->n_children; ++i)
+		count += subtree_free(p, n->children[i]);
+	node_free(p, n);
+	return count;
+}
+
+/* Makes room for one more child / id. */
+static int reserve_children(PrefixIndex *p, TrieNode *n)
+{
+	if (n->n_children < n->cap_children)
+		return 0;
+
+	uint32_t cap = n->cap_children ? 2 * n->cap_children : 2;
+	TrieNode **children = aed_realloc(AED_MEM_INDEX, n->children,
+									  n->cap_children * sizeof *children, cap * sizeof *children);
+	if (!children)
+		return -1;
+	p->bytes += (cap - n->cap_children) * sizeof *children;
+	n->children = children;
+	n->cap_children = cap;
+	return 0;
+}
+
+static int reserve_ids(PrefixIndex *p, TrieNode *n)
+{
+	if (n->n_ids < n->cap_ids)
+		return 0;
+
+	uint32_t cap = n->cap_ids ? 2 * n->cap_ids : 1;
+	unsigned *ids = aed_realloc(AED_MEM_INDEX, n->ids, n->cap_ids * sizeof *ids,
+								cap * sizeof *ids);
+	if (!ids)
+		return -1;
+	p->bytes += (cap - n->cap_ids) * sizeof *ids;
+	n->ids = ids;
+	n->cap_ids = cap;
+	return 0;
+}
+
+/* Position of the child starting with byte c, or where it would go (*found false). */
+static uint32_t child_slot(const TrieNode *n, unsigned char c, bool *found)
+{
+	uint32_t lo = 0, hi = n->n_children;
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (n->children[mid]->label[0] < c)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = lo < n->n_children && n->children[lo]->label[0] == c;
+	return lo;
+}
+
+static void insert_child(TrieNode *n, uint32_t at, TrieNode *child)
+{
+	memmove(&n->children[at + 1], &n->children[at], (n->n_children - at) * sizeof *n->children);
+	n->children[at] = child;
+	n->n_children++;
+}
+
+/* Position of id in the ids of n, or where it would go (*found true if present). */
+static uint32_t id_slot(const TrieNode *n, unsigned id, bool *found)
+{
+	uint32_t lo = 0, hi = n->n_ids;
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (n->ids[mid] < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = lo < n->n_ids && n->ids[lo] == id;
+	return lo;
+}
+
+static size_t common_prefix(const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len)
+{
+	size_t i = 0;
+	while (i < a_len && i < b_len && a[i] == b[i])
+		++i;
+	return i;
+}
+
+/*
+	Drops the dead subtrees under n and merges the chains left behind
+	(a node with no ids and a single child takes that child's place
+	with the two labels joined). Returns what now stands where n was.
+	Only ever frees, apart from the merged node: if that allocation
+	fails the chain simply stays.
+*/
+static TrieNode *prune(PrefixIndex *p, TrieNode *n, bool is_root)
+{
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < n->n_children; ++i)
+	{
+		TrieNode *c = n->children[i];
+		if (c->total == 0)
+		{
+			size_t freed = subtree_free(p, c);
+			p->nodes -= freed;
+			p->dead -= freed;
+			continue;
+		}
+		n->children[kept++] = prune(p, c, false);
+	}
+	n->n_children = kept;
+
+	if (is_root || n->n_ids > 0 || n->n_children != 1)
+		return n;
+
+	TrieNode *c = n->children[0];
+	TrieNode *m = aed_malloc(AED_MEM_INDEX, node_size(n->label_len + c->label_len));
+	if (!m)
+		return n;
+
+	*m = *c;
+	memcpy(m->label, n->label, n->label_len);
+	memcpy(m->label + n->label_len, c->label, c->label_len);
+	m->label_len = m->label_cap = n->label_len + c->label_len;
+
+	/* c's arrays now belong to m: only its node goes. */
+	p->bytes += node_size(m->label_cap) - node_size(c->label_cap);
+	aed_free(AED_MEM_INDEX, c, node_size(c->label_cap));
+	node_free(p, n);
+	p->nodes--;
+	return m;
+}
+
+PrefixIndex *prefix_index_create(void)
+{
+	PrefixIndex *p = aed_calloc(AED_MEM_INDEX, 1, sizeof *p);
+	if (!p)
+		return NULL;
+
+	p->root = node_new(p, NULL, 0);
+	if (!p->root)
+	{
+		aed_free(AED_MEM_INDEX, p, sizeof *p);
+		return NULL;
+	}
+	return p;
+}
+
+void prefix_index_destroy(PrefixIndex *p)
+{
+	if (!p)
+		return;
+
+	subtree_free(p, p->root);
+	aed_free(AED_MEM_INDEX, p, sizeof *p);
+}
+
+int prefix_index_add(PrefixIndex *p, const char *key, unsigned id)
+{
+	if (!p || !key)
+		return -1;
+
+	unsigned char k[PREFIX_KEY_MAX];
+	size_t len = fold(key, k);
+
+	/* The nodes whose total grows, root to target. */
+	TrieNode *path[PREFIX_KEY_MAX + 2];
+	size_t depth = 0;
+	TrieNode *n = p->root;
+	size_t i = 0;
+	path[depth++] = n;
+
+	while (i < len)
+	{
+		bool found;
+		uint32_t at = child_slot(n, k[i], &found);
+		if (!found)
+		{
+			/* New leaf under n. */
+			TrieNode *leaf = node_new(p, k + i, len - i);
+			if (!leaf || reserve_ids(p, leaf) != 0 || reserve_children(p, n) != 0)
+			{
+				if (leaf)
+					node_free(p, leaf);
+				return -1;
+			}
+			insert_child(n, at, leaf);
+			p->nodes++;
+			p->dead++;
+			n = leaf;
+			path[depth++] = n;
+			break;
+		}
+
+		TrieNode *c = n->children[at];
+		size_t j = common_prefix(c->label, c->label_len, k + i, len - i);
+		if (j == c->label_len)
+		{
+			n = c;
+			path[depth++] = n;
+			i += j;
+			continue;
+		}
+
+		/*
+			The key leaves c's edge after j bytes: split the edge with a
+			node holding those j bytes, which is the target itself or
+			gets a new leaf for the rest of the key.
+		*/
+		TrieNode *split = node_new(p, c->label, j);
+		TrieNode *leaf = i + j < len ? node_new(p, k + i + j, len - i - j) : NULL;
+		if (!split || reserve_children(p, split) != 0 || (i + j < len && !leaf) ||
+			reserve_ids(p, leaf ? leaf : split) != 0)
+		{
+			if (split)
+				node_free(p, split);
+			if (leaf)
+				node_free(p, leaf);
+			return -1;
+		}
+
+		memmove(c->label, c->label + j, c->label_len - j);
+		c->label_len -= (uint32_t)j;
+		split->total = c->total;
+		split->children[0] = c;
+		split->n_children = 1;
+		n->children[at] = split;
+		p->nodes++;
+		if (split->total == 0)
+			p->dead++;
+		path[depth++] = split;
+		n = split;
+
+		if (leaf)
+		{
+			bool dummy;
+			insert_child(split, child_slot(split, leaf->label[0], &dummy), leaf);
+			p->nodes++;
+			p->dead++;
+			path[depth++] = leaf;
+			n = leaf;
+		}
+		break;
+	}
+
+	bool present;
+	uint32_t at = id_slot(n, id, &present);
+	if (present)
+		return 0;
+	if (reserve_ids(p, n) != 0)
+		return -1;
+
+	memmove(&n->ids[at + 1], &n->ids[at], (n->n_ids - at) * sizeof *n->ids);
+	n->ids[at] = id;
+	n->n_ids++;
+	p->ids++;
+	for (size_t d = 0; d < depth; ++d)
+	{
+		if (path[d]->total++ == 0 && d > 0)
+			p->dead--;
+	}
+
+	if (p->dead > PRUNE_MIN_DEAD && 2 * p->dead > p->nodes)
+		prune(p, p->root, true);
+	return 0;
+}
+
+void prefix_index_remove(PrefixIndex *p, const char *key, unsigned id)
+{
+	if (!p || !key)
+		return;
+
+	unsigned char k[PREFIX_KEY_MAX];
+	size_t len = fold(key, k);
+
+	TrieNode *path[PREFIX_KEY_MAX + 2];
+	size_t depth = 0;
+	TrieNode *n = p->root;
+	size_t i = 0;
+	path[depth++] = n;
+
+	while (i < len)
+	{
+		bool found;
+		uint32_t at = child_slot(n, k[i], &found);
+		if (!found)
+			return;
+		TrieNode *c = n->children[at];
+		if (c->label_len > len - i || memcmp(c->label, k + i, c->label_len) != 0)
+			return;
+		n = c;
+		path[depth++] = n;
+		i += c->label_len;
+	}
+
+	bool present;
+	uint32_t at = id_slot(n, id, &present);
+	if (!present)
+		return;
+
+	memmove(&n->ids[at], &n->ids[at + 1], (n->n_ids - at - 1) * sizeof *n->ids);
+	n->n_ids--;
+	p->ids--;
+	for (size_t d = 0; d < depth; ++d)
+	{
+		if (--path[d]->total == 0 && d > 0)
+			p->dead++;
+	}
+}
+
+/* Appends the ids of the subtree, in order, until *n reaches limit. */
+static void collect(const TrieNode *node, unsigned *ids, size_t limit, size_t *n)
+{
+	for (uint32_t i = 0; i < node->n_ids && *n < limit; ++i)
+		ids[(*n)++] = node->ids[i];
+
+	for (uint32_t i = 0; i < node->n_children && *n < limit; ++i)
+	{
+		if (node->children[i]->total > 0)
+			collect(node->children[i], ids, limit, n);
+	}
+}
+
+int prefix_index_complete(const PrefixIndex *p, const char *prefix, size_t limit,
+						  unsigned *ids, size_t *n)
+{
+	if (!p || !prefix || !n || (limit > 0 && !ids))
+		return -1;
+
+	*n = 0;
+	unsigned char k[PREFIX_KEY_MAX];
+	size_t len = fold(prefix, k);
+
+	/* The prefix may end in the middle of an edge: its whole subtree matches. */
+	const TrieNode *node = p->root;
+	size_t i = 0;
+	while (i < len)
+	{
+		bool found;
+		uint32_t at = child_slot(node, k[i], &found);
+		if (!found)
+			return 0;
+		const TrieNode *c = node->children[at];
+		size_t j = common_prefix(c->label, c->label_len, k + i, len - i);
+		if (j < c->label_len && i + j < len)
+			return 0;
+		node = c;
+		i += j;
+	}
+
+	collect(node, ids, limit, n);
+	return 0;
+}
+
+int prefix_index_key_cmp(const char *a, const char *b)
+{
+	unsigned char x[PREFIX_KEY_MAX], y[PREFIX_KEY_MAX];
+	size_t nx = fold(a, x), ny = fold(b, y);
+	int c = memcmp(x, y, nx < ny ? nx : ny);
+	if (c != 0)
+		return c;
+	return nx < ny ? -1 : nx > ny;
+}
+
+size_t prefix_index_size(const PrefixIndex *p)
+{
+	return p ? p->ids : 0;
+}
+
+size_t prefix_index_bytes(const PrefixIndex *p)
+{
+	return p ? sizeof *p + p->bytes : 0;
+}
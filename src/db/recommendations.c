@@ -0,0 +1,439 @@
+/*
+	Co-borrowing recommendations (see db/recommendations.h).
+
+	Build, for n loans by U users of B distinct books:
+		1. sort the loans by user, newest first;
+		2. give every book a dense row number (the id -> row hash that
+		   lookups use later);
+		3. keep each user's first history_cap distinct books: the
+		   histories, in CSR form (offsets per user, rows);
+		4. invert them: the users of every row, also CSR;
+		5. for each row a, in parallel chunks: add 1 to count[b] for
+		   every book b in the history of every user of a, then keep
+		   the best 'neighbors' entries of the touched counts. The
+		   count array is per chunk and reset through the touched list,
+		   so a row costs what it touches, not B;
+		6. pack the kept neighbors back to back (offsets per row).
+
+	Rows are sorted by book id, so comparing rows is comparing ids.
+*/
+
+#include "db/recommendations.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+struct Recommendations {
+	uint32_t *ids;       /* book id of each row, ascending */
+	uint32_t *offsets;   /* rows + 1 entries: neighbors of row r are [offsets[r], offsets[r+1]) */
+	uint32_t *neighbors; /* book ids */
+	uint32_t *scores;    /* shared borrowers */
+	size_t rows;
+	size_t pairs;
+
+	uint32_t *slots; /* row + 1 per slot, 0 = empty */
+	size_t slot_mask;
+	unsigned shift;
+};
+
+static uint32_t *alloc_u32(size_t n)
+{
+	return aed_malloc(AED_MEM_INDEX, (n ? n : 1) * sizeof(uint32_t));
+}
+
+static void free_u32(uint32_t *p, size_t n)
+{
+	aed_free(AED_MEM_INDEX, p, (n ? n : 1) * sizeof(uint32_t));
+}
+
+/* ---------------------------------------------------------------
+   id -> row hash
+   --------------------------------------------------------------- */
+
+/* Fibonacci hashing, like the id index. */
+static size_t slot_of(const Recommendations *r, uint32_t id)
+{
+	return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ull) >> r->shift);
+}
+
+static int build_slots(Recommendations *r)
+{
+	size_t n = 2;
+	unsigned bits = 1;
+	while (n < 2 * r->rows)
+	{
+		n <<= 1;
+		++bits;
+	}
+
+	r->slots = aed_calloc(AED_MEM_INDEX, n, sizeof *r->slots);
+	if (!r->slots)
+		return -1;
+	r->slot_mask = n - 1;
+	r->shift = 64 - bits;
+
+	for (size_t row = 0; row < r->rows; ++row)
+	{
+		size_t i = slot_of(r, r->ids[row]);
+		while (r->slots[i])
+			i = (i + 1) & r->slot_mask;
+		r->slots[i] = (uint32_t)row + 1;
+	}
+	return 0;
+}
+
+/* Row of id, or SIZE_MAX if the book is not in the build. */
+static size_t row_of(const Recommendations *r, uint32_t id)
+{
+	for (size_t i = slot_of(r, id); r->slots[i]; i = (i + 1) & r->slot_mask)
+	{
+		size_t row = r->slots[i] - 1;
+		if (r->ids[row] == id)
+			return row;
+	}
+	return SIZE_MAX;
+}
+
+/* ---------------------------------------------------------------
+   Build
+   --------------------------------------------------------------- */
+
+static int by_user_newest(const void *a, const void *b)
+{
+	const CoBorrow *x = a, *y = b;
+	if (x->user_id != y->user_id)
+		return x->user_id < y->user_id ? -1 : 1;
+	if (x->date != y->date)
+		return x->date > y->date ? -1 : 1;
+	return x->book_id < y->book_id ? -1 : x->book_id > y->book_id;
+}
+
+static int by_value(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Step 2: the distinct book ids, ascending, and the hash over them. */
+static int build_rows(Recommendations *r, const CoBorrow *loans, size_t n)
+{
+	uint32_t *ids = alloc_u32(n);
+	if (!ids)
+		return -1;
+	for (size_t i = 0; i < n; ++i)
+		ids[i] = loans[i].book_id;
+	qsort(ids, n, sizeof *ids, by_value);
+
+	size_t rows = 0;
+	for (size_t i = 0; i < n; ++i)
+		if (rows == 0 || ids[rows - 1] != ids[i])
+			ids[rows++] = ids[i];
+
+	/* Give back the tail; shrinking cannot fail in practice, and if it does the big block is kept. */
+	uint32_t *fit = aed_realloc(AED_MEM_INDEX, ids, (n ? n : 1) * sizeof *ids,
+								(rows ? rows : 1) * sizeof *ids);
+	if (!fit)
+	{
+		free_u32(ids, n);
+		return -1;
+	}
+	r->ids = fit;
+	r->rows = rows;
+	return build_slots(r);
+}
+
+/* What the row workers share. */
+typedef struct {
+	const uint32_t *hist_off; /* users + 1 */
+	const uint32_t *hist;     /* rows */
+	const uint32_t *user_off; /* rows + 1 */
+	const uint32_t *users;    /* user ordinals */
+	size_t rows;
+	unsigned neighbors;
+	uint32_t *stage_rows;   /* rows * neighbors */
+	uint32_t *stage_scores; /* rows * neighbors */
+	uint8_t *stage_len;     /* rows */
+	atomic_bool failed;
+} RowJob;
+
+/* Inserts (row, score) into the sorted best list if it makes the cut. */
+static void keep_best(uint32_t *best_rows, uint32_t *best_scores, unsigned *len,
+					  unsigned cap, uint32_t row, uint32_t score)
+{
+	unsigned i = *len;
+	if (i == cap)
+	{
+		/* Full: only a higher score, or the same score on a lower id, gets in. */
+		if (score < best_scores[i - 1] || (score == best_scores[i - 1] && row > best_rows[i - 1]))
+			return;
+		--i;
+	}
+	else
+		++*len;
+
+	while (i > 0 && (best_scores[i - 1] < score ||
+					 (best_scores[i - 1] == score && best_rows[i - 1] > row)))
+	{
+		best_rows[i] = best_rows[i - 1];
+		best_scores[i] = best_scores[i - 1];
+		--i;
+	}
+	best_rows[i] = row;
+	best_scores[i] = score;
+}
+
+static void build_row_range(size_t begin, size_t end, void *ctx)
+{
+	RowJob *job = ctx;
+	uint32_t *count = aed_calloc(AED_MEM_INDEX, job->rows ? job->rows : 1, sizeof *count);
+	uint32_t *touched = alloc_u32(job->rows);
+	if (!count || !touched)
+	{
+		atomic_store(&job->failed, true);
+		aed_free(AED_MEM_INDEX, count, (job->rows ? job->rows : 1) * sizeof *count);
+		free_u32(touched, job->rows);
+		return;
+	}
+
+	for (size_t a = begin; a < end; ++a)
+	{
+		size_t n_touched = 0;
+		for (uint32_t k = job->user_off[a]; k < job->user_off[a + 1]; ++k)
+		{
+			uint32_t u = job->users[k];
+			for (uint32_t h = job->hist_off[u]; h < job->hist_off[u + 1]; ++h)
+			{
+				uint32_t b = job->hist[h];
+				if (b != a && count[b]++ == 0)
+					touched[n_touched++] = b;
+			}
+		}
+
+		uint32_t *best_rows = &job->stage_rows[a * job->neighbors];
+		uint32_t *best_scores = &job->stage_scores[a * job->neighbors];
+		unsigned len = 0;
+		for (size_t t = 0; t < n_touched; ++t)
+		{
+			uint32_t b = touched[t];
+			keep_best(best_rows, best_scores, &len, job->neighbors, b, count[b]);
+			count[b] = 0;
+		}
+		job->stage_len[a] = (uint8_t)len;
+	}
+
+	aed_free(AED_MEM_INDEX, count, (job->rows ? job->rows : 1) * sizeof *count);
+	free_u32(touched, job->rows);
+}
+
+/* Steps 3 and 4: capped histories per user and their inverse, users per row. */
+typedef struct {
+	uint32_t *hist_off, *hist, *user_off, *users;
+	size_t n_users, n_hist;
+} Histories;
+
+static void free_histories(Histories *h, size_t rows)
+{
+	free_u32(h->hist_off, h->n_users + 1);
+	free_u32(h->hist, h->n_hist);
+	free_u32(h->user_off, rows + 1);
+	free_u32(h->users, h->n_hist);
+}
+
+static int build_histories(const Recommendations *r, const CoBorrow *loans, size_t n,
+						   unsigned cap, Histories *h)
+{
+	h->n_users = 0;
+	for (size_t i = 0; i < n; ++i)
+		if (i == 0 || loans[i].user_id != loans[i - 1].user_id)
+			h->n_users++;
+
+	h->n_hist = n;
+	h->hist_off = alloc_u32(h->n_users + 1);
+	h->hist = alloc_u32(n);
+	h->user_off = aed_calloc(AED_MEM_INDEX, r->rows + 1, sizeof(uint32_t));
+	h->users = alloc_u32(n);
+	uint32_t *seen = aed_calloc(AED_MEM_INDEX, r->rows ? r->rows : 1, sizeof *seen);
+	if (!h->hist_off || !h->hist || !h->user_off || !h->users || !seen)
+	{
+		aed_free(AED_MEM_INDEX, seen, (r->rows ? r->rows : 1) * sizeof *seen);
+		return -1;
+	}
+
+	/* seen[row] holds the ordinal + 1 of the last user that kept the row. */
+	size_t u = 0, len = 0, kept = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (i > 0 && loans[i].user_id != loans[i - 1].user_id)
+		{
+			++u;
+			len = 0;
+		}
+		if (len == 0)
+			h->hist_off[u] = (uint32_t)kept;
+
+		uint32_t row = (uint32_t)row_of(r, loans[i].book_id);
+		if (len == cap || seen[row] == u + 1)
+			continue;
+		seen[row] = (uint32_t)(u + 1);
+		h->hist[kept++] = row;
+		h->user_off[row + 1]++;
+		++len;
+	}
+	h->hist_off[h->n_users] = (uint32_t)kept;
+	aed_free(AED_MEM_INDEX, seen, (r->rows ? r->rows : 1) * sizeof *seen);
+
+	/* Inverse: prefix sums, then fill with a cursor per row (reuses hist order). */
+	for (size_t row = 0; row < r->rows; ++row)
+		h->user_off[row + 1] += h->user_off[row];
+
+	uint32_t *cursor = alloc_u32(r->rows);
+	if (!cursor)
+		return -1;
+	for (size_t row = 0; row < r->rows; ++row)
+		cursor[row] = h->user_off[row];
+	for (size_t user = 0; user < h->n_users; ++user)
+		for (uint32_t k = h->hist_off[user]; k < h->hist_off[user + 1]; ++k)
+			h->users[cursor[h->hist[k]]++] = (uint32_t)user;
+	free_u32(cursor, r->rows);
+	return 0;
+}
+
+/* Step 6: staged fixed-size rows -> packed arrays of book ids and scores. */
+static int pack(Recommendations *r, const RowJob *job)
+{
+	r->offsets = alloc_u32(r->rows + 1);
+	if (!r->offsets)
+		return -1;
+
+	size_t pairs = 0;
+	for (size_t row = 0; row < r->rows; ++row)
+	{
+		r->offsets[row] = (uint32_t)pairs;
+		pairs += job->stage_len[row];
+	}
+	r->offsets[r->rows] = (uint32_t)pairs;
+
+	r->pairs = pairs;
+	r->neighbors = alloc_u32(pairs);
+	r->scores = alloc_u32(pairs);
+	if (!r->neighbors || !r->scores)
+		return -1;
+
+	for (size_t row = 0; row < r->rows; ++row)
+	{
+		const uint32_t *rows = &job->stage_rows[row * job->neighbors];
+		const uint32_t *scores = &job->stage_scores[row * job->neighbors];
+		for (unsigned k = 0; k < job->stage_len[row]; ++k)
+		{
+			r->neighbors[r->offsets[row] + k] = r->ids[rows[k]];
+			r->scores[r->offsets[row] + k] = scores[k];
+		}
+	}
+	return 0;
+}
+
+Recommendations *recommendations_build(CoBorrow *loans, size_t n, const RecommendConfig *cfg,
+									   ThreadPool *pool)
+{
+	unsigned cap = cfg && cfg->history_cap ? cfg->history_cap : RECOMMEND_HISTORY_DEFAULT;
+	unsigned neighbors = cfg && cfg->neighbors ? cfg->neighbors : RECOMMEND_NEIGHBORS_DEFAULT;
+	if ((n > 0 && !loans) || n >= UINT32_MAX || neighbors > RECOMMEND_NEIGHBORS_MAX)
+		return NULL;
+
+	Recommendations *r = aed_calloc(AED_MEM_INDEX, 1, sizeof *r);
+	if (!r)
+		return NULL;
+
+	qsort(loans, n, sizeof *loans, by_user_newest);
+	if (build_rows(r, loans, n) != 0)
+	{
+		recommendations_destroy(r);
+		return NULL;
+	}
+
+	Histories h = { 0 };
+	RowJob job = {
+		.rows = r->rows,
+		.neighbors = neighbors,
+		.stage_rows = alloc_u32(r->rows * neighbors),
+		.stage_scores = alloc_u32(r->rows * neighbors),
+		.stage_len = aed_malloc(AED_MEM_INDEX, r->rows ? r->rows : 1),
+	};
+	atomic_init(&job.failed, false);
+
+	int rc = -1;
+	if (job.stage_rows && job.stage_scores && job.stage_len &&
+		build_histories(r, loans, n, cap, &h) == 0)
+	{
+		job.hist_off = h.hist_off;
+		job.hist = h.hist;
+		job.user_off = h.user_off;
+		job.users = h.users;
+		thread_pool_parallel_for(pool, 0, r->rows, 0, build_row_range, &job);
+		if (!atomic_load(&job.failed))
+			rc = pack(r, &job);
+	}
+
+	free_histories(&h, r->rows);
+	free_u32(job.stage_rows, r->rows * neighbors);
+	free_u32(job.stage_scores, r->rows * neighbors);
+	aed_free(AED_MEM_INDEX, job.stage_len, r->rows ? r->rows : 1);
+
+	if (rc != 0)
+	{
+		recommendations_destroy(r);
+		return NULL;
+	}
+	return r;
+}
+
+void recommendations_destroy(Recommendations *r)
+{
+	if (!r)
+		return;
+
+	free_u32(r->ids, r->rows);
+	free_u32(r->offsets, r->rows + 1);
+	free_u32(r->neighbors, r->pairs);
+	free_u32(r->scores, r->pairs);
+	if (r->slots)
+		aed_free(AED_MEM_INDEX, r->slots, (r->slot_mask + 1) * sizeof *r->slots);
+	aed_free(AED_MEM_INDEX, r, sizeof *r);
+}
+
+size_t recommendations_get(const Recommendations *r, unsigned book_id, IdCount *out, size_t n)
+{
+	if (!r || !r->slots || !r->offsets || (n > 0 && !out))
+		return 0;
+
+	size_t row = row_of(r, book_id);
+	if (row == SIZE_MAX)
+		return 0;
+
+	size_t first = r->offsets[row], len = r->offsets[row + 1] - first;
+	if (len > n)
+		len = n;
+	for (size_t i = 0; i < len; ++i)
+	{
+		out[i].id = r->neighbors[first + i];
+		out[i].count = r->scores[first + i];
+	}
+	return len;
+}
+
+size_t recommendations_books(const Recommendations *r)
+{
+	return r ? r->rows : 0;
+}
+
+size_t recommendations_bytes(const Recommendations *r)
+{
+	if (!r)
+		return 0;
+	return sizeof *r + ((r->rows ? r->rows : 1) + (r->rows + 1) + 2 * (r->pairs ? r->pairs : 1)) *
+		   sizeof(uint32_t) + (r->slots ? (r->slot_mask + 1) * sizeof *r->slots : 0);
+}
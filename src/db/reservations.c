@@ -0,0 +1,455 @@
+/*
+	Reservation queues (see db/reservations.h).
+
+	Layout:
+		- every book with holds has a Queue: a binary heap (lib/heap)
+		  of Hold pointers, found through a chained hash by book id;
+		- every Hold also sits in a chained hash keyed by (book, user)
+		  and knows its current slot in the heap (the heap's 'moved'
+		  callback keeps it up to date), so a cancellation goes
+		  straight to heap_remove_at.
+	Both hashes double when they hold more entries than buckets. If
+	doubling fails the chains just get longer.
+*/
+
+#include "db/reservations.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/heap/heap.h"
+#include "lib/cutils/aed_alloc.h"
+
+#define HASH_MIN_BUCKETS 64
+
+typedef struct Hold {
+	Reservation r;
+	size_t slot;        /* index in its queue's heap */
+	struct Hold *hnext; /* (book, user) hash chain */
+} Hold;
+
+typedef struct Queue {
+	unsigned book_id;
+	Heap *heap;          /* of Hold* */
+	struct Queue *hnext; /* book hash chain */
+} Queue;
+
+struct ReservationQueues {
+	Queue **queues;
+	size_t queue_mask;
+	size_t queue_count;
+
+	Hold **holds;
+	size_t hold_mask;
+	size_t hold_count;
+
+	unsigned last_seq;
+};
+
+/* ---------------------------------------------------------------
+   Hashes
+   --------------------------------------------------------------- */
+
+static size_t mix(uint64_t key, size_t mask)
+{
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+static size_t queue_bucket(unsigned book_id, size_t mask)
+{
+	return mix(book_id, mask);
+}
+
+static size_t hold_bucket(unsigned book_id, unsigned user_id, size_t mask)
+{
+	return mix(((uint64_t)book_id << 32) | user_id, mask);
+}
+
+static Queue **queue_find(const ReservationQueues *q, unsigned book_id)
+{
+	Queue **link = &q->queues[queue_bucket(book_id, q->queue_mask)];
+	while (*link && (*link)->book_id != book_id)
+		link = &(*link)->hnext;
+	return link;
+}
+
+static Hold **hold_find(const ReservationQueues *q, unsigned book_id, unsigned user_id)
+{
+	Hold **link = &q->holds[hold_bucket(book_id, user_id, q->hold_mask)];
+	while (*link && ((*link)->r.book_id != book_id || (*link)->r.user_id != user_id))
+		link = &(*link)->hnext;
+	return link;
+}
+
+static void queues_grow(ReservationQueues *q)
+{
+	size_t buckets = 2 * (q->queue_mask + 1);
+	Queue **table = aed_calloc(AED_MEM_INDEX, buckets, sizeof *table);
+	if (!table)
+		return;
+
+	for (size_t i = 0; i <= q->queue_mask; ++i)
+	{
+		Queue *e = q->queues[i];
+		while (e)
+		{
+			Queue *next = e->hnext;
+			Queue **link = &table[queue_bucket(e->book_id, buckets - 1)];
+			e->hnext = *link;
+			*link = e;
+			e = next;
+		}
+	}
+	aed_free(AED_MEM_INDEX, q->queues, (q->queue_mask + 1) * sizeof *q->queues);
+	q->queues = table;
+	q->queue_mask = buckets - 1;
+}
+
+static void holds_grow(ReservationQueues *q)
+{
+	size_t buckets = 2 * (q->hold_mask + 1);
+	Hold **table = aed_calloc(AED_MEM_INDEX, buckets, sizeof *table);
+	if (!table)
+		return;
+
+	for (size_t i = 0; i <= q->hold_mask; ++i)
+	{
+		Hold *h = q->holds[i];
+		while (h)
+		{
+			Hold *next = h->hnext;
+			Hold **link = &table[hold_bucket(h->r.book_id, h->r.user_id, buckets - 1)];
+			h->hnext = *link;
+			*link = h;
+			h = next;
+		}
+	}
+	aed_free(AED_MEM_INDEX, q->holds, (q->hold_mask + 1) * sizeof *q->holds);
+	q->holds = table;
+	q->hold_mask = buckets - 1;
+}
+
+/* ---------------------------------------------------------------
+   Queues
+   --------------------------------------------------------------- */
+
+static int hold_cmp(const void *a, const void *b, void *ctx)
+{
+	(void)ctx;
+	return reservation_cmp(&((const Hold *)a)->r, &((const Hold *)b)->r);
+}
+
+static void hold_moved(void *elem, size_t index, void *ctx)
+{
+	(void)ctx;
+	((Hold *)elem)->slot = index;
+}
+
+static Queue *queue_create(ReservationQueues *q, unsigned book_id)
+{
+	Queue *e = aed_malloc(AED_MEM_INDEX, sizeof *e);
+	if (!e)
+		return NULL;
+
+	e->heap = heap_create(hold_cmp, hold_moved, NULL);
+	if (!e->heap)
+	{
+		aed_free(AED_MEM_INDEX, e, sizeof *e);
+		return NULL;
+	}
+	e->book_id = book_id;
+
+	Queue **link = queue_find(q, book_id);
+	e->hnext = *link;
+	*link = e;
+	if (++q->queue_count > q->queue_mask + 1)
+		queues_grow(q);
+	return e;
+}
+
+/* Unlinks and frees the queue of book_id; its holds must be released already. */
+static void queue_drop(ReservationQueues *q, unsigned book_id)
+{
+	Queue **link = queue_find(q, book_id);
+	Queue *e = *link;
+	if (!e)
+		return;
+
+	*link = e->hnext;
+	heap_destroy(e->heap);
+	aed_free(AED_MEM_INDEX, e, sizeof *e);
+	--q->queue_count;
+}
+
+/* Unlinks hold from the (book, user) hash and frees it. */
+static void hold_release(ReservationQueues *q, Hold *hold)
+{
+	Hold **link = hold_find(q, hold->r.book_id, hold->r.user_id);
+	if (*link == hold)
+		*link = hold->hnext;
+	aed_free(AED_MEM_RESERVATION, hold, sizeof *hold);
+	--q->hold_count;
+}
+
+/* ---------------------------------------------------------------
+   Public API
+   --------------------------------------------------------------- */
+
+ReservationQueues *reservation_queues_create(void)
+{
+	ReservationQueues *q = aed_malloc(AED_MEM_INDEX, sizeof *q);
+	if (!q)
+		return NULL;
+
+	q->queues = aed_calloc(AED_MEM_INDEX, HASH_MIN_BUCKETS, sizeof *q->queues);
+	q->holds = aed_calloc(AED_MEM_INDEX, HASH_MIN_BUCKETS, sizeof *q->holds);
+	if (!q->queues || !q->holds)
+	{
+		aed_free(AED_MEM_INDEX, q->queues, q->queues ? HASH_MIN_BUCKETS * sizeof *q->queues : 0);
+		aed_free(AED_MEM_INDEX, q->holds, q->holds ? HASH_MIN_BUCKETS * sizeof *q->holds : 0);
+		aed_free(AED_MEM_INDEX, q, sizeof *q);
+		return NULL;
+	}
+
+	q->queue_mask = HASH_MIN_BUCKETS - 1;
+	q->hold_mask = HASH_MIN_BUCKETS - 1;
+	q->queue_count = 0;
+	q->hold_count = 0;
+	q->last_seq = 0;
+	return q;
+}
+
+void reservation_queues_destroy(ReservationQueues *q)
+{
+	if (!q)
+		return;
+
+	for (size_t i = 0; i <= q->queue_mask; ++i)
+	{
+		Queue *e = q->queues[i];
+		while (e)
+		{
+			Queue *next = e->hnext;
+			for (size_t j = 0; j < heap_size(e->heap); ++j)
+				aed_free(AED_MEM_RESERVATION, heap_at(e->heap, j), sizeof(Hold));
+			heap_destroy(e->heap);
+			aed_free(AED_MEM_INDEX, e, sizeof *e);
+			e = next;
+		}
+	}
+
+	aed_free(AED_MEM_INDEX, q->queues, (q->queue_mask + 1) * sizeof *q->queues);
+	aed_free(AED_MEM_INDEX, q->holds, (q->hold_mask + 1) * sizeof *q->holds);
+	aed_free(AED_MEM_INDEX, q, sizeof *q);
+}
+
+int reservation_queues_add(ReservationQueues *q, Reservation *r)
+{
+	if (!q || !r)
+		return -1;
+
+	Hold **link = hold_find(q, r->book_id, r->user_id);
+	if (*link)
+		return -2;
+
+	Hold *hold = aed_malloc(AED_MEM_RESERVATION, sizeof *hold);
+	if (!hold)
+		return -1;
+	hold->r = *r;
+	if (hold->r.seq == 0)
+		hold->r.seq = q->last_seq + 1;
+
+	Queue *e = *queue_find(q, r->book_id);
+	bool created = false;
+	if (!e)
+	{
+		e = queue_create(q, r->book_id);
+		created = true;
+	}
+	if (!e || heap_push(e->heap, hold) != 0)
+	{
+		if (e && created)
+			queue_drop(q, r->book_id);
+		aed_free(AED_MEM_RESERVATION, hold, sizeof *hold);
+		return -1;
+	}
+
+	/* queue_create may have grown the book hash, not this one: link is still good. */
+	hold->hnext = *link;
+	*link = hold;
+	if (++q->hold_count > q->hold_mask + 1)
+		holds_grow(q);
+
+	if (hold->r.seq > q->last_seq)
+		q->last_seq = hold->r.seq;
+	r->seq = hold->r.seq;
+	return 0;
+}
+
+int reservation_queues_remove(ReservationQueues *q, unsigned book_id, unsigned user_id)
+{
+	if (!q)
+		return -1;
+
+	Hold *hold = *hold_find(q, book_id, user_id);
+	Queue *e = hold ? *queue_find(q, book_id) : NULL;
+	if (!e)
+		return -1;
+
+	heap_remove_at(e->heap, hold->slot);
+	hold_release(q, hold);
+	if (heap_empty(e->heap))
+		queue_drop(q, book_id);
+	return 0;
+}
+
+size_t reservation_queues_drop_book(ReservationQueues *q, unsigned book_id)
+{
+	if (!q)
+		return 0;
+
+	Queue *e = *queue_find(q, book_id);
+	if (!e)
+		return 0;
+
+	size_t n = heap_size(e->heap);
+	for (size_t i = 0; i < n; ++i)
+		hold_release(q, heap_at(e->heap, i));
+	queue_drop(q, book_id);
+	return n;
+}
+
+size_t reservation_queues_drop_user(ReservationQueues *q, unsigned user_id)
+{
+	if (!q)
+		return 0;
+
+	size_t dropped = 0;
+	for (size_t i = 0; i <= q->queue_mask; ++i)
+	{
+		Queue *e = q->queues[i];
+		while (e)
+		{
+			/* queue_drop may free e. */
+			Queue *next = e->hnext;
+			Hold *hold = *hold_find(q, e->book_id, user_id);
+			if (hold)
+			{
+				heap_remove_at(e->heap, hold->slot);
+				hold_release(q, hold);
+				if (heap_empty(e->heap))
+					queue_drop(q, e->book_id);
+				++dropped;
+			}
+			e = next;
+		}
+	}
+	return dropped;
+}
+
+const Reservation *reservation_queues_peek(const ReservationQueues *q, unsigned book_id)
+{
+	if (!q)
+		return NULL;
+
+	const Queue *e = *queue_find(q, book_id);
+	const Hold *hold = e ? heap_peek(e->heap) : NULL;
+	return hold ? &hold->r : NULL;
+}
+
+int reservation_queues_pop(ReservationQueues *q, unsigned book_id)
+{
+	if (!q)
+		return -1;
+
+	Queue *e = *queue_find(q, book_id);
+	Hold *hold = e ? heap_pop(e->heap) : NULL;
+	if (!hold)
+		return -1;
+
+	hold_release(q, hold);
+	if (heap_empty(e->heap))
+		queue_drop(q, book_id);
+	return 0;
+}
+
+size_t reservation_queues_length(const ReservationQueues *q, unsigned book_id)
+{
+	if (!q)
+		return 0;
+
+	const Queue *e = *queue_find(q, book_id);
+	return e ? heap_size(e->heap) : 0;
+}
+
+static int hold_ptr_cmp(const void *a, const void *b)
+{
+	return hold_cmp(*(const Hold *const *)a, *(const Hold *const *)b, NULL);
+}
+
+int reservation_queues_visit_book(const ReservationQueues *q, unsigned book_id,
+								  ReservationVisitor fn, void *ctx)
+{
+	if (!q || !fn)
+		return -1;
+
+	const Queue *e = *queue_find(q, book_id);
+	size_t n = e ? heap_size(e->heap) : 0;
+	if (n == 0)
+		return 0;
+
+	const Hold **sorted = aed_malloc(AED_MEM_OTHER, n * sizeof *sorted);
+	if (!sorted)
+		return -1;
+	for (size_t i = 0; i < n; ++i)
+		sorted[i] = heap_at(e->heap, i);
+	qsort(sorted, n, sizeof *sorted, hold_ptr_cmp);
+
+	int rc = 0;
+	for (size_t i = 0; i < n && rc == 0; ++i)
+		rc = fn(&sorted[i]->r, ctx);
+
+	aed_free(AED_MEM_OTHER, sorted, n * sizeof *sorted);
+	return rc;
+}
+
+int reservation_queues_foreach(const ReservationQueues *q, ReservationVisitor fn, void *ctx)
+{
+	if (!q || !fn)
+		return -1;
+
+	for (size_t i = 0; i <= q->queue_mask; ++i)
+	{
+		for (const Queue *e = q->queues[i]; e; e = e->hnext)
+		{
+			for (size_t j = 0; j < heap_size(e->heap); ++j)
+			{
+				const Hold *hold = heap_at(e->heap, j);
+				int rc = fn(&hold->r, ctx);
+				if (rc != 0)
+					return rc;
+			}
+		}
+	}
+	return 0;
+}
+
+size_t reservation_queues_size(const ReservationQueues *q)
+{
+	return q ? q->hold_count : 0;
+}
+
+size_t reservation_queues_bytes(const ReservationQueues *q)
+{
+	if (!q)
+		return 0;
+
+	size_t bytes = sizeof *q + (q->queue_mask + 1) * sizeof *q->queues +
+				   (q->hold_mask + 1) * sizeof *q->holds +
+				   q->queue_count * sizeof(Queue) + q->hold_count * sizeof(Hold);
+	for (size_t i = 0; i <= q->queue_mask; ++i)
+		for (const Queue *e = q->queues[i]; e; e = e->hnext)
+			bytes += heap_bytes(e->heap);
+	return bytes;
+}
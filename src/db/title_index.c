@@ -0,0 +1,563 @@
+/*
+	Trigram index of normalized titles (see db/title_index.h).
+
+	Layout:
+	- entries: one slot per title (id, normalized text), reused through
+	  a free list. A freed slot keeps its text buffer and goes to the
+	  head of the list, so putting back a title that was just replaced
+	  lands in the same slot and allocates nothing.
+	- lens: the normalized length of each slot (FREE_SLOT if unused),
+	  apart from the entries so the length filter reads one byte per
+	  title.
+	- ids: id -> slot, linear probing with backward-shift deletion.
+	- grams: trigram -> posting list of slots, linear probing. Lists
+	  are unordered (removal swaps the last slot in) and never shrink,
+	  which is the other half of the "putting back never fails" rule.
+*/
+
+#include "db/title_index.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/cutils/aed_alloc.h"
+#include "lib/fuzzy/fuzzy.h"
+
+#define TITLE_MIN_SLOTS 64
+#define FREE_SLOT UINT8_MAX
+#define NO_SLOT UINT32_MAX
+
+typedef struct {
+	unsigned id;   /* next free slot while the slot is free */
+	uint32_t cap;  /* bytes of text */
+	char *text;
+} TitleEntry;
+
+typedef struct {
+	uint32_t key; /* id + 1, 0 = empty */
+	uint32_t slot;
+} IdSlot;
+
+typedef struct {
+	uint32_t key; /* trigram + 1, 0 = empty */
+	uint32_t n;
+	uint32_t cap;
+	uint32_t *slots;
+} Posting;
+
+struct TitleIndex {
+	TitleEntry *entries;
+	uint8_t *lens;
+	size_t n_entries;
+	size_t cap_entries;
+	uint32_t free_head;
+	size_t live;
+
+	IdSlot *ids;
+	size_t ids_mask;
+	size_t ids_used;
+	unsigned ids_shift;
+
+	Posting *grams;
+	size_t grams_mask;
+	size_t grams_used;
+	unsigned grams_shift;
+
+	size_t bytes; /* text buffers and posting lists */
+};
+
+/* Fibonacci hashing, like the id index. */
+static size_t hash_of(uint32_t key, unsigned shift)
+{
+	return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static unsigned shift_for(size_t n)
+{
+	unsigned bits = 0;
+	while (((size_t)1 << bits) < n)
+		++bits;
+	return 64 - bits;
+}
+
+/* ---- id -> slot ---- */
+
+static IdSlot *find_id(const TitleIndex *t, uint32_t key)
+{
+	size_t i = hash_of(key, t->ids_shift);
+	while (t->ids[i].key && t->ids[i].key != key)
+		i = (i + 1) & t->ids_mask;
+	return &t->ids[i];
+}
+
+static int grow_ids(TitleIndex *t)
+{
+	IdSlot *old = t->ids;
+	size_t old_n = t->ids_mask + 1, n = 2 * old_n;
+
+	t->ids = aed_calloc(AED_MEM_INDEX, n, sizeof *t->ids);
+	if (!t->ids)
+	{
+		t->ids = old;
+		return -1;
+	}
+	t->ids_mask = n - 1;
+	t->ids_shift = shift_for(n);
+	for (size_t i = 0; i < old_n; ++i)
+	{
+		if (old[i].key)
+			*find_id(t, old[i].key) = old[i];
+	}
+	aed_free(AED_MEM_INDEX, old, old_n * sizeof *old);
+	return 0;
+}
+
+/* Empties s and shifts back the entries of its probe run that can move up. */
+static void erase_id(TitleIndex *t, IdSlot *s)
+{
+	size_t hole = (size_t)(s - t->ids);
+	size_t i = hole;
+	for (;;)
+	{
+		i = (i + 1) & t->ids_mask;
+		if (!t->ids[i].key)
+			break;
+
+		size_t home = hash_of(t->ids[i].key, t->ids_shift);
+		if (((i - home) & t->ids_mask) >= ((i - hole) & t->ids_mask))
+		{
+			t->ids[hole] = t->ids[i];
+			hole = i;
+		}
+	}
+	t->ids[hole].key = 0;
+	--t->ids_used;
+}
+
+/* ---- trigram -> posting list ---- */
+
+static Posting *find_gram(const TitleIndex *t, uint32_t key)
+{
+	size_t i = hash_of(key, t->grams_shift);
+	while (t->grams[i].key && t->grams[i].key != key)
+		i = (i + 1) & t->grams_mask;
+	return &t->grams[i];
+}
+
+static int grow_grams(TitleIndex *t)
+{
+	Posting *old = t->grams;
+	size_t old_n = t->grams_mask + 1, n = 2 * old_n;
+
+	t->grams = aed_calloc(AED_MEM_INDEX, n, sizeof *t->grams);
+	if (!t->grams)
+	{
+		t->grams = old;
+		return -1;
+	}
+	t->grams_mask = n - 1;
+	t->grams_shift = shift_for(n);
+	for (size_t i = 0; i < old_n; ++i)
+	{
+		if (old[i].key)
+			*find_gram(t, old[i].key) = old[i];
+	}
+	aed_free(AED_MEM_INDEX, old, old_n * sizeof *old);
+	return 0;
+}
+
+/* Appends slot to the list of gram, creating the list. */
+static int posting_push(TitleIndex *t, uint32_t gram, uint32_t slot)
+{
+	uint32_t key = gram + 1;
+	Posting *p = find_gram(t, key);
+	if (!p->key)
+	{
+		if (2 * (t->grams_used + 1) > t->grams_mask + 1)
+		{
+			if (grow_grams(t) != 0)
+				return -1;
+			p = find_gram(t, key);
+		}
+		p->key = key;
+		++t->grams_used;
+	}
+
+	if (p->n == p->cap)
+	{
+		uint32_t cap = p->cap ? 2 * p->cap : 4;
+		uint32_t *slots = aed_realloc(AED_MEM_INDEX, p->slots, p->cap * sizeof *slots,
+									  cap * sizeof *slots);
+		if (!slots)
+			return -1;
+		t->bytes += (size_t)(cap - p->cap) * sizeof *slots;
+		p->slots = slots;
+		p->cap = cap;
+	}
+	p->slots[p->n++] = slot;
+	return 0;
+}
+
+/* Removes slot from the list of gram, if it is there. */
+static void posting_drop(TitleIndex *t, uint32_t gram, uint32_t slot)
+{
+	Posting *p = find_gram(t, gram + 1);
+	for (uint32_t i = 0; p->key && i < p->n; ++i)
+	{
+		if (p->slots[i] == slot)
+		{
+			p->slots[i] = p->slots[--p->n];
+			return;
+		}
+	}
+}
+
+/* ---- slots ---- */
+
+/* Takes a slot off the free list or the end of the array. */
+static uint32_t take_slot(TitleIndex *t)
+{
+	if (t->free_head != NO_SLOT)
+	{
+		uint32_t s = t->free_head;
+		t->free_head = t->entries[s].id;
+		return s;
+	}
+
+	if (t->n_entries == t->cap_entries)
+	{
+		size_t cap = t->cap_entries ? 2 * t->cap_entries : TITLE_MIN_SLOTS;
+		if (cap > NO_SLOT)
+			return NO_SLOT;
+
+		uint8_t *lens = aed_malloc(AED_MEM_INDEX, cap);
+		if (!lens)
+			return NO_SLOT;
+		TitleEntry *entries = aed_realloc(AED_MEM_INDEX, t->entries,
+										  t->cap_entries * sizeof *entries,
+										  cap * sizeof *entries);
+		if (!entries)
+		{
+			aed_free(AED_MEM_INDEX, lens, cap);
+			return NO_SLOT;
+		}
+		if (t->n_entries)
+			memcpy(lens, t->lens, t->n_entries);
+		aed_free(AED_MEM_INDEX, t->lens, t->cap_entries);
+		t->entries = entries;
+		t->lens = lens;
+		t->cap_entries = cap;
+	}
+
+	TitleEntry *e = &t->entries[t->n_entries];
+	e->cap = 0;
+	e->text = NULL;
+	t->lens[t->n_entries] = FREE_SLOT;
+	return (uint32_t)t->n_entries++;
+}
+
+/* Puts s back at the head of the free list, keeping its text buffer. */
+static void give_slot(TitleIndex *t, uint32_t s)
+{
+	t->lens[s] = FREE_SLOT;
+	t->entries[s].id = t->free_head;
+	t->free_head = s;
+}
+
+/* Drops the postings of slot s, whose normalized text is text[0..len). */
+static void unlink_slot(TitleIndex *t, uint32_t s, const char *text, size_t len)
+{
+	uint32_t grams[FUZZY_MAX_LEN];
+	size_t n = fuzzy_trigrams(text, len, grams, FUZZY_MAX_LEN);
+	for (size_t i = 0; i < n; ++i)
+		posting_drop(t, grams[i], s);
+}
+
+/* Fills slot s with id and text[0..len): text buffer, length, postings. */
+static int link_slot(TitleIndex *t, uint32_t s, unsigned id, const char *text, size_t len)
+{
+	TitleEntry *e = &t->entries[s];
+	if (e->cap < len + 1)
+	{
+		char *buf = aed_realloc(AED_MEM_INDEX, e->text, e->cap, len + 1);
+		if (!buf)
+			return -1;
+		t->bytes += len + 1 - e->cap;
+		e->text = buf;
+		e->cap = (uint32_t)(len + 1);
+	}
+
+	uint32_t grams[FUZZY_MAX_LEN];
+	size_t n = fuzzy_trigrams(text, len, grams, FUZZY_MAX_LEN);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (posting_push(t, grams[i], s) != 0)
+		{
+			/* The slot was pushed last on the lists done so far. */
+			while (i-- > 0)
+				find_gram(t, grams[i] + 1)->n--;
+			return -1;
+		}
+	}
+
+	memcpy(e->text, text, len);
+	e->text[len] = '\0';
+	e->id = id;
+	t->lens[s] = (uint8_t)len;
+	return 0;
+}
+
+TitleIndex *title_index_create(void)
+{
+	TitleIndex *t = aed_calloc(AED_MEM_INDEX, 1, sizeof *t);
+	if (!t)
+		return NULL;
+
+	t->free_head = NO_SLOT;
+	t->ids = aed_calloc(AED_MEM_INDEX, TITLE_MIN_SLOTS, sizeof *t->ids);
+	t->grams = aed_calloc(AED_MEM_INDEX, TITLE_MIN_SLOTS, sizeof *t->grams);
+	if (!t->ids || !t->grams)
+	{
+		title_index_destroy(t);
+		return NULL;
+	}
+	t->ids_mask = t->grams_mask = TITLE_MIN_SLOTS - 1;
+	t->ids_shift = t->grams_shift = shift_for(TITLE_MIN_SLOTS);
+	return t;
+}
+
+void title_index_destroy(TitleIndex *t)
+{
+	if (!t)
+		return;
+
+	for (size_t i = 0; i < t->n_entries; ++i)
+		aed_free(AED_MEM_INDEX, t->entries[i].text, t->entries[i].cap);
+	if (t->grams)
+	{
+		for (size_t i = 0; i <= t->grams_mask; ++i)
+			aed_free(AED_MEM_INDEX, t->grams[i].slots, t->grams[i].cap * sizeof(uint32_t));
+	}
+	aed_free(AED_MEM_INDEX, t->entries, t->cap_entries * sizeof *t->entries);
+	aed_free(AED_MEM_INDEX, t->lens, t->cap_entries);
+	aed_free(AED_MEM_INDEX, t->ids, t->ids ? (t->ids_mask + 1) * sizeof *t->ids : 0);
+	aed_free(AED_MEM_INDEX, t->grams, t->grams ? (t->grams_mask + 1) * sizeof *t->grams : 0);
+	aed_free(AED_MEM_INDEX, t, sizeof *t);
+}
+
+int title_index_put(TitleIndex *t, unsigned id, const char *title)
+{
+	if (!t || !title || id == UINT_MAX)
+		return -1;
+
+	char text[FUZZY_MAX_LEN];
+	size_t len = fuzzy_normalize(title, text, sizeof text);
+
+	uint32_t key = (uint32_t)id + 1;
+	IdSlot *known = find_id(t, key);
+	if (known->key)
+	{
+		const TitleEntry *e = &t->entries[known->slot];
+		if (t->lens[known->slot] == len && memcmp(e->text, text, len) == 0)
+			return 0;
+	}
+	else if (2 * (t->ids_used + 1) > t->ids_mask + 1)
+	{
+		if (grow_ids(t) != 0)
+			return -1;
+		known = find_id(t, key);
+	}
+
+	/* The new version is complete before the old one goes away. */
+	uint32_t s = take_slot(t);
+	if (s == NO_SLOT)
+		return -1;
+	if (link_slot(t, s, id, text, len) != 0)
+	{
+		give_slot(t, s);
+		return -1;
+	}
+
+	if (known->key)
+	{
+		uint32_t old = known->slot;
+		unlink_slot(t, old, t->entries[old].text, t->lens[old]);
+		give_slot(t, old);
+	}
+	else
+	{
+		known->key = key;
+		++t->ids_used;
+		++t->live;
+	}
+	known->slot = s;
+	return 0;
+}
+
+void title_index_remove(TitleIndex *t, unsigned id)
+{
+	if (!t || id == UINT_MAX)
+		return;
+
+	IdSlot *known = find_id(t, (uint32_t)id + 1);
+	if (!known->key)
+		return;
+
+	uint32_t s = known->slot;
+	unlink_slot(t, s, t->entries[s].text, t->lens[s]);
+	give_slot(t, s);
+	erase_id(t, known);
+	--t->live;
+}
+
+/* Order of the result: more similar, then fewer edits, then lower id. */
+static int match_order(const void *a, const void *b)
+{
+	const TitleMatch *x = a, *y = b;
+	if (x->similarity != y->similarity)
+		return x->similarity > y->similarity ? -1 : 1;
+	if (x->distance != y->distance)
+		return x->distance < y->distance ? -1 : 1;
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* Most edits a title of length len may be from a query of length q. */
+static size_t edits_allowed(size_t q, size_t len, unsigned min_similarity)
+{
+	size_t longer = q > len ? q : len;
+	return longer * (100 - min_similarity) / 100;
+}
+
+/* Verifies slot s and appends it to *found if it is close enough. */
+static int consider(const TitleIndex *t, uint32_t s, const FuzzyPattern *pattern, size_t q,
+					const unsigned *edits, TitleMatch **found, size_t *used, size_t *room)
+{
+	size_t len = t->lens[s];
+	unsigned d = fuzzy_distance(pattern, t->entries[s].text, len, edits[len]);
+	if (d > edits[len])
+		return 0;
+
+	if (*used == *room)
+	{
+		size_t grown = *room ? 2 * *room : 16;
+		TitleMatch *more = aed_realloc(AED_MEM_INDEX, *found, *room * sizeof *more,
+									   grown * sizeof *more);
+		if (!more)
+			return -1;
+		*found = more;
+		*room = grown;
+	}
+	(*found)[(*used)++] = (TitleMatch){ t->entries[s].id, d, fuzzy_similarity(d, q, len) };
+	return 0;
+}
+
+int title_index_similar(const TitleIndex *t, const char *title, unsigned min_similarity,
+						TitleMatch *out, size_t cap, size_t *n)
+{
+	if (!t || !title || !n || (cap > 0 && !out) || min_similarity < TITLE_SIMILARITY_MIN ||
+		min_similarity > 100)
+		return -1;
+
+	*n = 0;
+	char text[FUZZY_MAX_LEN];
+	size_t q = fuzzy_normalize(title, text, sizeof text);
+	if (cap == 0 || q == 0 || t->live == 0)
+		return 0;
+
+	FuzzyPattern pattern;
+	fuzzy_pattern_init(&pattern, text, q);
+
+	uint32_t grams[FUZZY_MAX_LEN];
+	size_t distinct = fuzzy_trigrams(text, q, grams, FUZZY_MAX_LEN);
+
+	/*
+		Per title length: the edits allowed and the trigrams that must be
+		shared (0 when the bound proves nothing). Lengths outside
+		[lo, hi] need more edits than allowed just to match the length;
+		they keep need above any count.
+	*/
+	size_t lo = q * min_similarity / 100, hi = q * 100 / min_similarity;
+	unsigned edits[FUZZY_MAX_LEN];
+	unsigned need[FUZZY_MAX_LEN];
+	bool blind = false;
+	for (size_t len = 0; len < FUZZY_MAX_LEN; ++len)
+	{
+		edits[len] = (unsigned)edits_allowed(q, len, min_similarity);
+		if (len == 0 || len < lo || len > hi)
+			need[len] = UINT_MAX;
+		else if (3 * (size_t)edits[len] >= distinct)
+		{
+			need[len] = 0;
+			blind = true;
+		}
+		else
+			need[len] = (unsigned)(distinct - 3 * (size_t)edits[len]);
+	}
+
+	uint8_t *shared = aed_calloc(AED_MEM_INDEX, t->n_entries, 1);
+	uint32_t *touched = blind ? NULL : aed_malloc(AED_MEM_INDEX, t->n_entries * sizeof *touched);
+	if (!shared || (!blind && !touched))
+	{
+		aed_free(AED_MEM_INDEX, shared, shared ? t->n_entries : 0);
+		aed_free(AED_MEM_INDEX, touched, touched ? t->n_entries * sizeof *touched : 0);
+		return -1;
+	}
+
+	/* Count the shared trigrams, remembering which slots got any. */
+	size_t n_touched = 0;
+	for (size_t g = 0; g < distinct; ++g)
+	{
+		const Posting *p = find_gram(t, grams[g] + 1);
+		if (!p->key)
+			continue;
+		for (uint32_t i = 0; i < p->n; ++i)
+		{
+			uint32_t s = p->slots[i];
+			if (shared[s]++ == 0 && touched)
+				touched[n_touched++] = s;
+		}
+	}
+
+	/*
+		Titles sharing no trigram can only match when the bound is blind
+		for their length: then every slot is a candidate.
+	*/
+	TitleMatch *found = NULL;
+	size_t used = 0, room = 0, candidates = blind ? t->n_entries : n_touched;
+	int rc = 0;
+	for (size_t i = 0; i < candidates && rc == 0; ++i)
+	{
+		uint32_t s = blind ? (uint32_t)i : touched[i];
+		size_t len = t->lens[s];
+		if (len == FREE_SLOT || shared[s] < need[len])
+			continue;
+		rc = consider(t, s, &pattern, q, edits, &found, &used, &room);
+	}
+
+	if (rc == 0 && used > 0)
+	{
+		qsort(found, used, sizeof *found, match_order);
+		*n = used < cap ? used : cap;
+		memcpy(out, found, *n * sizeof *out);
+	}
+	aed_free(AED_MEM_INDEX, found, room * sizeof *found);
+	aed_free(AED_MEM_INDEX, touched, touched ? t->n_entries * sizeof *touched : 0);
+	aed_free(AED_MEM_INDEX, shared, t->n_entries);
+	return rc;
+}
+
+size_t title_index_size(const TitleIndex *t)
+{
+	return t ? t->live : 0;
+}
+
+size_t title_index_bytes(const TitleIndex *t)
+{
+	if (!t)
+		return 0;
+	return sizeof *t + t->bytes + t->cap_entries * (sizeof *t->entries + 1) +
+		   (t->ids_mask + 1) * sizeof *t->ids + (t->grams_mask + 1) * sizeof *t->grams;
+}
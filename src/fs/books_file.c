@@ -16,6 +16,7 @@
 
 #include "model/books.h"
 #include "lib/dlist/dlist.h"
+#include "lib/cutils/aed_alloc.h"
 
 #include "fs/books_file.h"
 
@@ -89,14 +90,14 @@ DList *file_load_books(const char *path)
 		{
 			/* Not a header, process this line as data */
 			/* fall through into normal loop by handling it manually */
-			Book *first = malloc(sizeof *first);
+			Book *first = aed_malloc(AED_MEM_BOOK, sizeof *first);
 			if (first && book_from_csv(first, line) == 0)
 			{
 				dlist_insert_priority(list, first, book_priority(first->id));
 			}
 			else if (first)
 			{
-				free(first);
+				aed_free(AED_MEM_BOOK, first, sizeof *first);
 			}
 		}
 	}
@@ -108,14 +109,14 @@ DList *file_load_books(const char *path)
 		if (line[0] == '\0')
 			continue; /* skip empty lines */
 
-		Book *b = malloc(sizeof *b);
+		Book *b = aed_malloc(AED_MEM_BOOK, sizeof *b);
 		if (!b)
 			break;
 
 		if (!book_from_csv(b, line))
 		{
 			/* malformed line, discard this book and continue */
-			free(b);
+			aed_free(AED_MEM_BOOK, b, sizeof *b);
 			continue;
 		}
 
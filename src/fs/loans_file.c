@@ -16,6 +16,7 @@
 
 #include "model/loans.h"
 #include "lib/dlist/dlist.h"
+#include "lib/cutils/aed_alloc.h"
 
 #include "fs/loans_file.h"
 
@@ -75,14 +76,14 @@ DList *file_load_loans(const char *path)
         trim_newline(line);
         if (strncmp(line, "id;", 3) != 0)
         {
-            Loan *first = malloc(sizeof *first);
+            Loan *first = aed_malloc(AED_MEM_LOAN, sizeof *first);
             if (first && loan_from_csv(first, line) == 0)
             {
                 dlist_insert_priority(list, first, loan_priority(first->id));
             }
             else if (first)
             {
-                free(first);
+                aed_free(AED_MEM_LOAN, first, sizeof *first);
             }
         }
     }
@@ -94,13 +95,13 @@ DList *file_load_loans(const char *path)
         if (line[0] == '\0')
             continue;
 
-        Loan *l = malloc(sizeof *l);
+        Loan *l = aed_malloc(AED_MEM_LOAN, sizeof *l);
         if (!l)
             break;
 
         if (!loan_from_csv(l, line))
         {
-            free(l);
+            aed_free(AED_MEM_LOAN, l, sizeof *l);
             continue;
         }
 
@@ -0,0 +1,108 @@
+/*
+    Filesystem helpers for the Reservation model.
+
+        - file_load_reservations: CSV text file -> DList of Reservation*
+        - file_save_reservations: DList of Reservation* -> CSV text file
+
+    Unlike the other tables the list is kept in file order (no priority
+    mode): the order a book's holds are served in comes from the
+    fields themselves (see reservation_cmp), not from their position.
+*/
+
+#include "fs/reservations_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/cutils/aed_alloc.h"
+
+#define RESERVATION_LINE_MAX 512
+
+static void trim_newline(char *s)
+{
+    if (!s)
+        return;
+
+    size_t len = strlen(s);
+    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+    {
+        s[--len] = '\0';
+    }
+}
+
+/*
+    Load all reservations from a CSV file into a DList.
+
+    A missing file is an empty list (reservations.txt only exists once
+    a hold has been saved). Returns NULL on allocation failure.
+*/
+DList *file_load_reservations(const char *path)
+{
+    DList *list = dlist_create(false, NULL);
+    if (!list)
+        return NULL;
+
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return list;
+
+    char line[RESERVATION_LINE_MAX];
+    while (fgets(line, sizeof line, f))
+    {
+        trim_newline(line);
+
+        /* Skip the header and blank lines. */
+        if (line[0] == '\0' || strncmp(line, "book_id;", 8) == 0)
+            continue;
+
+        Reservation *r = aed_malloc(AED_MEM_RESERVATION, sizeof *r);
+        if (!r)
+            break;
+
+        if (!reservation_from_csv(r, line))
+        {
+            aed_free(AED_MEM_RESERVATION, r, sizeof *r);
+            continue;
+        }
+
+        size_t before = dlist_size(list);
+        dlist_push_back(list, r);
+        if (dlist_size(list) == before)
+        {
+            aed_free(AED_MEM_RESERVATION, r, sizeof *r);
+            break;
+        }
+    }
+
+    fclose(f);
+    return list;
+}
+
+/*
+    Write all reservations to a CSV text file, overwriting the file.
+
+    Header written:
+        "book_id;user_id;tier;date;seq"
+*/
+int file_save_reservations(const char *path, const DList *reservations)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    char buffer[RESERVATION_LINE_MAX];
+    fprintf(f, "book_id;user_id;tier;date;seq\n");
+
+    if (reservations)
+    {
+        DLIST_FOREACH(reservations, node)
+        {
+            const Reservation *r = (const Reservation *)node->data;
+            reservation_to_csv(r, buffer, sizeof buffer);
+            fprintf(f, "%s\n", buffer);
+        }
+    }
+
+    return fclose(f) == 0 ? 0 : -1;
+}
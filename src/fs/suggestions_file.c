@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "lib/cutils/aed_alloc.h"
+
 #define SUGGESTION_LINE_MAX 512
 
 /* Reutilizamos o id como prioridade para ordenar sugestoes sem logica adicional. */
@@ -46,14 +48,14 @@ DList *file_load_suggestions(const char *path)
         trim_newline(line);
         if (strncmp(line, "id;", 3) != 0)
         {
-            Suggestion *first = malloc(sizeof *first);
+            Suggestion *first = aed_malloc(AED_MEM_SUGGESTION, sizeof *first);
             if (first && suggestion_from_csv(first, line))
             {
                 dlist_insert_priority(list, first, suggestion_priority(first->id));
             }
             else if (first)
             {
-                free(first);
+                aed_free(AED_MEM_SUGGESTION, first, sizeof *first);
             }
         }
     }
@@ -64,13 +66,13 @@ DList *file_load_suggestions(const char *path)
         if (line[0] == '\0')
             continue;
 
-        Suggestion *s = malloc(sizeof *s);
+        Suggestion *s = aed_malloc(AED_MEM_SUGGESTION, sizeof *s);
         if (!s)
             break;
 
         if (!suggestion_from_csv(s, line))
         {
-            free(s);
+            aed_free(AED_MEM_SUGGESTION, s, sizeof *s);
             continue;
         }
 
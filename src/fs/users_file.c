@@ -15,6 +15,7 @@
 
 #include "model/user.h"
 #include "lib/dlist/dlist.h"
+#include "lib/cutils/aed_alloc.h"
 
 #include "fs/users_file.h"
 
@@ -74,14 +75,14 @@ DList *file_load_users(const char *path)
         trim_newline(line);
         if (strncmp(line, "id;", 3) != 0)
         {
-            User *first = malloc(sizeof *first);
+            User *first = aed_malloc(AED_MEM_USER, sizeof *first);
             if (first && user_from_csv(first, line) == 0)
             {
                 dlist_insert_priority(list, first, user_priority(first->id));
             }
             else if (first)
             {
-                free(first);
+                aed_free(AED_MEM_USER, first, sizeof *first);
             }
         }
     }
@@ -93,13 +94,13 @@ DList *file_load_users(const char *path)
         if (line[0] == '\0')
             continue;
 
-        User *u = malloc(sizeof *u);
+        User *u = aed_malloc(AED_MEM_USER, sizeof *u);
         if (!u)
             break;
 
         if (!user_from_csv(u, line))
         {
-            free(u);
+            aed_free(AED_MEM_USER, u, sizeof *u);
             continue;
         }
 
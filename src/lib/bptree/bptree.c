@@ -0,0 +1,434 @@
+#include <string.h>
+
+#include "lib/bptree/bptree.h"
+#include "lib/cutils/aed_alloc.h"
+
+/*
+    Fewest keys a non-root node may keep after a removal. With an even
+    order a split leaves 16 and 15 keys in the two halves, and merging
+    an underflowing node with a minimal sibling (plus the separator,
+    for inner nodes) always fits in one node.
+*/
+#define MIN_KEYS ((BPTREE_ORDER - 1) / 2)
+
+/*
+    One node. In a leaf, values[i] belongs to keys[i]. In an inner
+    node, children[i] holds the keys k with keys[i-1] <= k < keys[i].
+*/
+typedef struct BPNode {
+    bool leaf;
+    unsigned count;
+    struct BPNode *next; /* next leaf to the right (leaves only) */
+    uint64_t keys[BPTREE_ORDER];
+    union {
+        struct BPNode *children[BPTREE_ORDER + 1];
+        void *values[BPTREE_ORDER];
+    } u;
+} BPNode;
+
+struct BPTree {
+    BPNode *root;
+    size_t size;
+    size_t nodes;
+};
+
+static BPNode *node_create(BPTree *tree, bool leaf)
+{
+    BPNode *n = aed_malloc(AED_MEM_INDEX, sizeof *n);
+    if (!n)
+        return NULL;
+
+    n->leaf = leaf;
+    n->count = 0;
+    n->next = NULL;
+    tree->nodes++;
+    return n;
+}
+
+static void node_free(BPTree *tree, BPNode *n)
+{
+    aed_free(AED_MEM_INDEX, n, sizeof *n);
+    tree->nodes--;
+}
+
+/* First position whose key is >= key. */
+static unsigned lower_bound(const BPNode *n, uint64_t key)
+{
+    unsigned lo = 0, hi = n->count;
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (n->keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Child of an inner node that may hold key. */
+static unsigned child_index(const BPNode *n, uint64_t key)
+{
+    unsigned lo = 0, hi = n->count;
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (n->keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static const BPNode *find_leaf(const BPTree *tree, uint64_t key)
+{
+    const BPNode *n = tree->root;
+    while (!n->leaf)
+        n = n->u.children[child_index(n, key)];
+    return n;
+}
+
+BPTree *bptree_create(void)
+{
+    BPTree *tree = aed_malloc(AED_MEM_INDEX, sizeof *tree);
+    if (!tree)
+        return NULL;
+
+    tree->size = 0;
+    tree->nodes = 0;
+    tree->root = node_create(tree, true);
+    if (!tree->root)
+    {
+        aed_free(AED_MEM_INDEX, tree, sizeof *tree);
+        return NULL;
+    }
+    return tree;
+}
+
+static void destroy_subtree(BPTree *tree, BPNode *n)
+{
+    if (!n->leaf)
+    {
+        for (unsigned i = 0; i <= n->count; ++i)
+            destroy_subtree(tree, n->u.children[i]);
+    }
+    node_free(tree, n);
+}
+
+void bptree_destroy(BPTree *tree)
+{
+    if (!tree)
+        return;
+
+    destroy_subtree(tree, tree->root);
+    aed_free(AED_MEM_INDEX, tree, sizeof *tree);
+}
+
+size_t bptree_size(const BPTree *tree)
+{
+    return tree ? tree->size : 0;
+}
+
+size_t bptree_bytes(const BPTree *tree)
+{
+    return tree ? sizeof *tree + tree->nodes * sizeof(BPNode) : 0;
+}
+
+void *bptree_get(const BPTree *tree, uint64_t key)
+{
+    if (!tree)
+        return NULL;
+
+    const BPNode *leaf = find_leaf(tree, key);
+    unsigned pos = lower_bound(leaf, key);
+    return (pos < leaf->count && leaf->keys[pos] == key) ? leaf->u.values[pos] : NULL;
+}
+
+/* ---------------------------------------------------------------
+   Insertion (top-down: full nodes are split on the way down, so the
+   leaf always has room and no split has to travel back up)
+   --------------------------------------------------------------- */
+
+/*
+    Splits the full child parent->children[i] in two; parent is never
+    full here. Returns -1 (nothing changed) if the new node cannot be
+    allocated.
+*/
+static int split_child(BPTree *tree, BPNode *parent, unsigned i)
+{
+    BPNode *left = parent->u.children[i];
+    BPNode *right = node_create(tree, left->leaf);
+    if (!right)
+        return -1;
+
+    uint64_t separator;
+    if (left->leaf)
+    {
+        /* Leaves keep every key; the first key of the right half is copied up. */
+        unsigned keep = BPTREE_ORDER / 2;
+        right->count = left->count - keep;
+        memcpy(right->keys, left->keys + keep, right->count * sizeof right->keys[0]);
+        memcpy(right->u.values, left->u.values + keep, right->count * sizeof right->u.values[0]);
+        left->count = keep;
+
+        right->next = left->next;
+        left->next = right;
+        separator = right->keys[0];
+    }
+    else
+    {
+        /* Inner nodes move the middle key up instead. */
+        unsigned mid = BPTREE_ORDER / 2;
+        right->count = left->count - mid - 1;
+        memcpy(right->keys, left->keys + mid + 1, right->count * sizeof right->keys[0]);
+        memcpy(right->u.children, left->u.children + mid + 1,
+               (right->count + 1) * sizeof right->u.children[0]);
+        separator = left->keys[mid];
+        left->count = mid;
+    }
+
+    memmove(parent->keys + i + 1, parent->keys + i,
+            (parent->count - i) * sizeof parent->keys[0]);
+    memmove(parent->u.children + i + 2, parent->u.children + i + 1,
+            (parent->count - i) * sizeof parent->u.children[0]);
+    parent->keys[i] = separator;
+    parent->u.children[i + 1] = right;
+    parent->count++;
+
+    return 0;
+}
+
+int bptree_insert(BPTree *tree, uint64_t key, void *value)
+{
+    if (!tree)
+        return -1;
+
+    /* Replacing needs no room, so do it before any split. */
+    BPNode *leaf = (BPNode *)find_leaf(tree, key);
+    unsigned pos = lower_bound(leaf, key);
+    if (pos < leaf->count && leaf->keys[pos] == key)
+    {
+        leaf->u.values[pos] = value;
+        return 0;
+    }
+
+    if (tree->root->count == BPTREE_ORDER)
+    {
+        BPNode *root = node_create(tree, false);
+        if (!root)
+            return -1;
+
+        root->u.children[0] = tree->root;
+        if (split_child(tree, root, 0) != 0)
+        {
+            node_free(tree, root);
+            return -1;
+        }
+        tree->root = root;
+    }
+
+    BPNode *n = tree->root;
+    while (!n->leaf)
+    {
+        unsigned i = child_index(n, key);
+        if (n->u.children[i]->count == BPTREE_ORDER)
+        {
+            if (split_child(tree, n, i) != 0)
+                return -1;
+            if (key >= n->keys[i])
+                ++i;
+        }
+        n = n->u.children[i];
+    }
+
+    pos = lower_bound(n, key);
+    memmove(n->keys + pos + 1, n->keys + pos, (n->count - pos) * sizeof n->keys[0]);
+    memmove(n->u.values + pos + 1, n->u.values + pos, (n->count - pos) * sizeof n->u.values[0]);
+    n->keys[pos] = key;
+    n->u.values[pos] = value;
+    n->count++;
+    tree->size++;
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------
+   Removal (bottom-up: a child left with fewer than MIN_KEYS keys
+   borrows from a sibling or is merged into it by its parent)
+   --------------------------------------------------------------- */
+
+/* Merges parent->children[i + 1] into parent->children[i]. */
+static void merge_children(BPTree *tree, BPNode *parent, unsigned i)
+{
+    BPNode *left = parent->u.children[i];
+    BPNode *right = parent->u.children[i + 1];
+
+    if (left->leaf)
+    {
+        memcpy(left->keys + left->count, right->keys, right->count * sizeof left->keys[0]);
+        memcpy(left->u.values + left->count, right->u.values,
+               right->count * sizeof left->u.values[0]);
+        left->count += right->count;
+        left->next = right->next;
+    }
+    else
+    {
+        left->keys[left->count] = parent->keys[i];
+        memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof left->keys[0]);
+        memcpy(left->u.children + left->count + 1, right->u.children,
+               (right->count + 1) * sizeof left->u.children[0]);
+        left->count += right->count + 1;
+    }
+
+    memmove(parent->keys + i, parent->keys + i + 1,
+            (parent->count - i - 1) * sizeof parent->keys[0]);
+    memmove(parent->u.children + i + 1, parent->u.children + i + 2,
+            (parent->count - i - 1) * sizeof parent->u.children[0]);
+    parent->count--;
+
+    node_free(tree, right);
+}
+
+static void borrow_from_left(BPNode *parent, unsigned i)
+{
+    BPNode *child = parent->u.children[i];
+    BPNode *left = parent->u.children[i - 1];
+
+    memmove(child->keys + 1, child->keys, child->count * sizeof child->keys[0]);
+    if (child->leaf)
+    {
+        memmove(child->u.values + 1, child->u.values, child->count * sizeof child->u.values[0]);
+        child->keys[0] = left->keys[left->count - 1];
+        child->u.values[0] = left->u.values[left->count - 1];
+        parent->keys[i - 1] = child->keys[0];
+    }
+    else
+    {
+        memmove(child->u.children + 1, child->u.children,
+                (child->count + 1) * sizeof child->u.children[0]);
+        child->keys[0] = parent->keys[i - 1];
+        child->u.children[0] = left->u.children[left->count];
+        parent->keys[i - 1] = left->keys[left->count - 1];
+    }
+    child->count++;
+    left->count--;
+}
+
+static void borrow_from_right(BPNode *parent, unsigned i)
+{
+    BPNode *child = parent->u.children[i];
+    BPNode *right = parent->u.children[i + 1];
+
+    if (child->leaf)
+    {
+        child->keys[child->count] = right->keys[0];
+        child->u.values[child->count] = right->u.values[0];
+        memmove(right->u.values, right->u.values + 1, (right->count - 1) * sizeof right->u.values[0]);
+        memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof right->keys[0]);
+        parent->keys[i] = right->keys[0];
+    }
+    else
+    {
+        child->keys[child->count] = parent->keys[i];
+        child->u.children[child->count + 1] = right->u.children[0];
+        parent->keys[i] = right->keys[0];
+        memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof right->keys[0]);
+        memmove(right->u.children, right->u.children + 1, right->count * sizeof right->u.children[0]);
+    }
+    child->count++;
+    right->count--;
+}
+
+static void rebalance(BPTree *tree, BPNode *parent, unsigned i)
+{
+    if (i > 0 && parent->u.children[i - 1]->count > MIN_KEYS)
+        borrow_from_left(parent, i);
+    else if (i < parent->count && parent->u.children[i + 1]->count > MIN_KEYS)
+        borrow_from_right(parent, i);
+    else if (i > 0)
+        merge_children(tree, parent, i - 1);
+    else
+        merge_children(tree, parent, i);
+}
+
+static int remove_from(BPTree *tree, BPNode *n, uint64_t key)
+{
+    if (n->leaf)
+    {
+        unsigned pos = lower_bound(n, key);
+        if (pos == n->count || n->keys[pos] != key)
+            return -1;
+
+        memmove(n->keys + pos, n->keys + pos + 1, (n->count - pos - 1) * sizeof n->keys[0]);
+        memmove(n->u.values + pos, n->u.values + pos + 1,
+                (n->count - pos - 1) * sizeof n->u.values[0]);
+        n->count--;
+        return 0;
+    }
+
+    unsigned i = child_index(n, key);
+    if (remove_from(tree, n->u.children[i], key) != 0)
+        return -1;
+
+    if (n->u.children[i]->count < MIN_KEYS)
+        rebalance(tree, n, i);
+    return 0;
+}
+
+int bptree_remove(BPTree *tree, uint64_t key)
+{
+    if (!tree || remove_from(tree, tree->root, key) != 0)
+        return -1;
+
+    tree->size--;
+
+    /* An inner root left with a single child hands the root over to it. */
+    if (!tree->root->leaf && tree->root->count == 0)
+    {
+        BPNode *old = tree->root;
+        tree->root = old->u.children[0];
+        node_free(tree, old);
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------
+   Cursors
+   --------------------------------------------------------------- */
+
+void bptree_seek(const BPTree *tree, uint64_t key, BPTreeCursor *cur)
+{
+    if (!tree)
+    {
+        cur->leaf = NULL;
+        cur->pos = 0;
+        return;
+    }
+
+    const BPNode *leaf = find_leaf(tree, key);
+    cur->leaf = leaf;
+    cur->pos = lower_bound(leaf, key);
+}
+
+bool bptree_next(BPTreeCursor *cur, uint64_t *key, void **value)
+{
+    const BPNode *leaf = cur->leaf;
+
+    /* Skips the end of a leaf and any leaf emptied by removals. */
+    while (leaf && cur->pos >= leaf->count)
+    {
+        leaf = leaf->next;
+        cur->pos = 0;
+    }
+    cur->leaf = leaf;
+    if (!leaf)
+        return false;
+
+    if (key)
+        *key = leaf->keys[cur->pos];
+    if (value)
+        *value = leaf->u.values[cur->pos];
+    cur->pos++;
+    return true;
+}
@@ -0,0 +1,142 @@
+/*
+    Implementation of the accounted allocator (see aed_alloc.h).
+*/
+
+#include "aed_alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct {
+    _Atomic size_t bytes;
+    _Atomic size_t objects;
+    _Atomic size_t peak_bytes;
+    _Atomic uint64_t allocations;
+} Counters;
+
+static Counters counters[AED_MEM_COUNT];
+
+static const char *const category_names[AED_MEM_COUNT] = {
+    "other", "list", "list_node", "arraylist", "index",
+    "book", "user", "loan", "suggestion", "reservation"
+};
+
+static void *std_malloc(size_t size, void *ctx)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *std_realloc(void *ptr, size_t size, void *ctx)
+{
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void std_free(void *ptr, void *ctx)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static const AedAllocator default_allocator = { std_malloc, std_realloc, std_free, NULL };
+static AedAllocator allocator = { std_malloc, std_realloc, std_free, NULL };
+
+void aed_set_allocator(const AedAllocator *a)
+{
+    allocator = a ? *a : default_allocator;
+}
+
+static Counters *counters_of(AedMemCategory category)
+{
+    return (unsigned)category < AED_MEM_COUNT ? &counters[category] : &counters[AED_MEM_OTHER];
+}
+
+static void account_grow(Counters *c, size_t bytes)
+{
+    size_t now = atomic_fetch_add_explicit(&c->bytes, bytes, memory_order_relaxed) + bytes;
+    size_t peak = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+    while (now > peak &&
+           !atomic_compare_exchange_weak_explicit(&c->peak_bytes, &peak, now,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+    {
+    }
+}
+
+void *aed_malloc(AedMemCategory category, size_t size)
+{
+    void *p = allocator.malloc_fn(size, allocator.ctx);
+    if (p)
+    {
+        Counters *c = counters_of(category);
+        account_grow(c, size);
+        atomic_fetch_add_explicit(&c->objects, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&c->allocations, 1, memory_order_relaxed);
+    }
+    return p;
+}
+
+void *aed_calloc(AedMemCategory category, size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size)
+        return NULL;
+
+    void *p = aed_malloc(category, count * size);
+    if (p)
+        memset(p, 0, count * size);
+    return p;
+}
+
+void *aed_realloc(AedMemCategory category, void *ptr, size_t old_size, size_t new_size)
+{
+    if (!ptr)
+        return aed_malloc(category, new_size);
+
+    void *p = allocator.realloc_fn(ptr, new_size, allocator.ctx);
+    if (!p)
+        return NULL;
+
+    Counters *c = counters_of(category);
+    if (new_size >= old_size)
+        account_grow(c, new_size - old_size);
+    else
+        atomic_fetch_sub_explicit(&c->bytes, old_size - new_size, memory_order_relaxed);
+
+    return p;
+}
+
+void aed_free(AedMemCategory category, void *ptr, size_t size)
+{
+    if (!ptr)
+        return;
+
+    Counters *c = counters_of(category);
+    atomic_fetch_sub_explicit(&c->bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&c->objects, 1, memory_order_relaxed);
+    allocator.free_fn(ptr, allocator.ctx);
+}
+
+void aed_mem_stats(AedMemCategory category, AedMemStats *out)
+{
+    if (!out)
+        return;
+
+    if ((unsigned)category >= AED_MEM_COUNT)
+    {
+        memset(out, 0, sizeof *out);
+        return;
+    }
+
+    const Counters *c = &counters[category];
+    out->bytes = atomic_load_explicit(&c->bytes, memory_order_relaxed);
+    out->objects = atomic_load_explicit(&c->objects, memory_order_relaxed);
+    out->peak_bytes = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+    out->allocations = atomic_load_explicit(&c->allocations, memory_order_relaxed);
+}
+
+const char *aed_mem_category_name(AedMemCategory category)
+{
+    return (unsigned)category < AED_MEM_COUNT ? category_names[category] : "?";
+}
@@ -8,11 +8,19 @@
 */
 
 #include "cutils.h"
+#include "aed_alloc.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #define INITIAL_CAPACITY 4
 
 /*
@@ -53,7 +61,8 @@ static bool ensure_capacity(ArrayList *list, size_t min_capacity)
     if (new_size / list->elem_size != new_capacity)
         return false; /* overflow guard */
 
-    void *new_items = realloc(list->items, new_size);
+    void *new_items = aed_realloc(AED_MEM_ARRAYLIST, list->items,
+                                  list->capacity * list->elem_size, new_size);
     if (!new_items)
     {
         fprintf(stderr, "[ArrayList] Memory allocation failed.\n");
@@ -96,9 +105,32 @@ void *arraylist_get(ArrayList *list, size_t index)
 */
 void arraylist_free(ArrayList *list)
 {
-    free(list->items);
+    aed_free(AED_MEM_ARRAYLIST, list->items, list->capacity * list->elem_size);
     list->items = NULL;
     list->count = 0;
     list->capacity = 0;
     list->elem_size = 0;
-}
\ No newline at end of file
+}
+
+/*
+    Monotonic clock in nanoseconds.
+    Windows uses the performance counter, everything else
+    clock_gettime(CLOCK_MONOTONIC).
+*/
+uint64_t cutils_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000000ull +
+           (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000000ull / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
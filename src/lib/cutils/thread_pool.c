@@ -0,0 +1,493 @@
+/*
+    Work-stealing thread pool (see thread_pool.h).
+
+    Each deque is a growable ring buffer guarded by its own mutex.
+    A lock per deque keeps the code short and obviously correct; the
+    owner and the thieves work on opposite ends, so in practice the
+    lock is almost never contended.
+
+    Completion is tracked with task groups: every task points at a
+    counter that is decremented when it finishes. thread_pool_wait
+    uses the pool-wide group, each parallel-for uses its own group on
+    the caller's stack. Waiters keep running queued tasks while their
+    group is not done, which is what makes nested parallel-for safe.
+*/
+
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+/* Chunks per worker when the caller lets the pool choose the grain. */
+#define AUTO_CHUNKS_PER_WORKER 4
+
+typedef struct {
+    _Atomic size_t remaining;
+} TaskGroup;
+
+typedef struct {
+    ThreadPoolTask fn;
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+/* Padded so neighbouring deques never share a cache line. */
+typedef struct {
+    pthread_mutex_t lock;
+    Task *buf;
+    size_t capacity; /* always a power of two */
+    size_t head;     /* index of the top (oldest) task */
+    size_t count;
+    char pad[64];
+} TaskDeque;
+
+struct ThreadPool {
+    TaskDeque *deques;
+    pthread_t *threads;
+    unsigned n_threads; /* deques; fixed before any worker starts */
+    unsigned n_started; /* workers actually running */
+
+    _Atomic size_t queued;      /* tasks sitting in some deque */
+    _Atomic unsigned next_deque; /* round-robin for external submits */
+    TaskGroup all;              /* tasks from thread_pool_submit */
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready; /* a task was queued, or stopping */
+    pthread_cond_t group_done; /* some group reached zero */
+    bool stopping;
+};
+
+/* Which pool/deque the current thread works for, if any. */
+static _Thread_local ThreadPool *current_pool;
+static _Thread_local unsigned current_index;
+
+/* ---------------------------------------------------------------
+   Deque
+   --------------------------------------------------------------- */
+
+static bool deque_init(TaskDeque *d)
+{
+    d->buf = malloc(DEQUE_INITIAL_CAPACITY * sizeof *d->buf);
+    if (!d->buf)
+        return false;
+
+    if (pthread_mutex_init(&d->lock, NULL) != 0)
+    {
+        free(d->buf);
+        return false;
+    }
+
+    d->capacity = DEQUE_INITIAL_CAPACITY;
+    d->head = 0;
+    d->count = 0;
+    return true;
+}
+
+static void deque_destroy(TaskDeque *d)
+{
+    pthread_mutex_destroy(&d->lock);
+    free(d->buf);
+}
+
+/* Called with d->lock held. Unrolls the ring into a buffer twice as big. */
+static bool deque_grow(TaskDeque *d)
+{
+    if (d->capacity > SIZE_MAX / 2 / sizeof *d->buf)
+        return false;
+
+    size_t new_capacity = d->capacity * 2;
+    Task *grown = malloc(new_capacity * sizeof *grown);
+    if (!grown)
+        return false;
+
+    for (size_t i = 0; i < d->count; ++i)
+        grown[i] = d->buf[(d->head + i) & (d->capacity - 1)];
+
+    free(d->buf);
+    d->buf = grown;
+    d->capacity = new_capacity;
+    d->head = 0;
+    return true;
+}
+
+static bool deque_push_bottom(TaskDeque *d, Task task)
+{
+    pthread_mutex_lock(&d->lock);
+
+    if (d->count == d->capacity && !deque_grow(d))
+    {
+        pthread_mutex_unlock(&d->lock);
+        return false;
+    }
+
+    d->buf[(d->head + d->count) & (d->capacity - 1)] = task;
+    d->count++;
+
+    pthread_mutex_unlock(&d->lock);
+    return true;
+}
+
+static bool deque_pop_bottom(TaskDeque *d, Task *out)
+{
+    pthread_mutex_lock(&d->lock);
+
+    bool found = d->count > 0;
+    if (found)
+    {
+        d->count--;
+        *out = d->buf[(d->head + d->count) & (d->capacity - 1)];
+    }
+
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static bool deque_steal_top(TaskDeque *d, Task *out)
+{
+    pthread_mutex_lock(&d->lock);
+
+    bool found = d->count > 0;
+    if (found)
+    {
+        *out = d->buf[d->head];
+        d->head = (d->head + 1) & (d->capacity - 1);
+        d->count--;
+    }
+
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/* ---------------------------------------------------------------
+   Scheduling
+   --------------------------------------------------------------- */
+
+/*
+    Takes one task for the calling thread: its own deque first (if it
+    is a worker of this pool), then a steal sweep over the others.
+*/
+static bool take_task(ThreadPool *pool, Task *out)
+{
+    unsigned n = pool->n_threads;
+    unsigned start = 0;
+
+    if (current_pool == pool)
+    {
+        if (deque_pop_bottom(&pool->deques[current_index], out))
+            goto taken;
+        start = current_index + 1;
+    }
+
+    for (unsigned k = 0; k < n; ++k)
+    {
+        unsigned victim = (start + k) % n;
+        if (current_pool == pool && victim == current_index)
+            continue;
+        if (deque_steal_top(&pool->deques[victim], out))
+            goto taken;
+    }
+
+    return false;
+
+taken:
+    atomic_fetch_sub(&pool->queued, 1);
+    return true;
+}
+
+static void run_task(ThreadPool *pool, Task *task)
+{
+    task->fn(task->arg);
+
+    if (atomic_fetch_sub(&task->group->remaining, 1) == 1)
+    {
+        /* Last task of its group: wake whoever waits on it. */
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->group_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static bool enqueue(ThreadPool *pool, ThreadPoolTask fn, void *arg, TaskGroup *group)
+{
+    unsigned target;
+    if (current_pool == pool)
+        target = current_index;
+    else
+        target = atomic_fetch_add(&pool->next_deque, 1) % pool->n_threads;
+
+    /*
+        Count first, push second: queued may briefly overstate the
+        deques (a worker then just retries) but never understate them,
+        so nobody goes to sleep while a task is waiting.
+    */
+    atomic_fetch_add(&group->remaining, 1);
+    atomic_fetch_add(&pool->queued, 1);
+
+    Task task = { fn, arg, group };
+    if (!deque_push_bottom(&pool->deques[target], task))
+    {
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_sub(&group->remaining, 1);
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+/* Runs queued tasks until group is done, sleeping when nothing is left to help with. */
+static void wait_group(ThreadPool *pool, TaskGroup *group)
+{
+    while (atomic_load(&group->remaining) > 0)
+    {
+        Task task;
+        if (take_task(pool, &task))
+        {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&group->remaining) > 0 && atomic_load(&pool->queued) == 0)
+            pthread_cond_wait(&pool->group_done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    ThreadPool *pool = arg;
+
+    for (;;)
+    {
+        Task task;
+        if (take_task(pool, &task))
+        {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stopping && atomic_load(&pool->queued) == 0)
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        bool stop = pool->stopping && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop)
+            break;
+    }
+
+    current_pool = NULL;
+    return NULL;
+}
+
+typedef struct {
+    ThreadPool *pool;
+    unsigned index;
+} WorkerStart;
+
+static void *thread_start(void *arg)
+{
+    WorkerStart start = *(WorkerStart *)arg;
+    free(arg);
+
+    current_pool = start.pool;
+    current_index = start.index;
+    return worker_main(start.pool);
+}
+
+/* ---------------------------------------------------------------
+   Public API
+   --------------------------------------------------------------- */
+
+static unsigned online_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+ThreadPool *thread_pool_create(unsigned n_threads)
+{
+    if (n_threads == 0)
+        n_threads = online_cpus();
+
+    unsigned ready = 0;
+    ThreadPool *pool = calloc(1, sizeof *pool);
+    if (!pool)
+        return NULL;
+
+    pool->deques = calloc(n_threads, sizeof *pool->deques);
+    pool->threads = calloc(n_threads, sizeof *pool->threads);
+    if (!pool->deques || !pool->threads)
+        goto fail_alloc;
+
+    while (ready < n_threads && deque_init(&pool->deques[ready]))
+        ++ready;
+    if (ready < n_threads)
+        goto fail_deques;
+
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->next_deque, 0);
+    atomic_init(&pool->all.remaining, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->group_done, NULL);
+
+    pool->n_threads = n_threads;
+
+    /*
+        If only some workers start, the pool still works: the running
+        ones steal from the deques of the missing ones.
+    */
+    for (unsigned i = 0; i < n_threads; ++i)
+    {
+        WorkerStart *start = malloc(sizeof *start);
+        if (!start)
+            break;
+
+        start->pool = pool;
+        start->index = i;
+        if (pthread_create(&pool->threads[i], NULL, thread_start, start) != 0)
+        {
+            free(start);
+            break;
+        }
+        pool->n_started++;
+    }
+
+    if (pool->n_started == 0)
+    {
+        pthread_cond_destroy(&pool->group_done);
+        pthread_cond_destroy(&pool->work_ready);
+        pthread_mutex_destroy(&pool->lock);
+        goto fail_deques;
+    }
+
+    return pool;
+
+fail_deques:
+    for (unsigned i = 0; i < ready; ++i)
+        deque_destroy(&pool->deques[i]);
+fail_alloc:
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+    return NULL;
+}
+
+void thread_pool_destroy(ThreadPool *pool)
+{
+    if (!pool)
+        return;
+
+    thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->n_started; ++i)
+        pthread_join(pool->threads[i], NULL);
+
+    for (unsigned i = 0; i < pool->n_threads; ++i)
+        deque_destroy(&pool->deques[i]);
+
+    pthread_cond_destroy(&pool->group_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
+
+unsigned thread_pool_size(const ThreadPool *pool)
+{
+    return pool ? pool->n_started : 0;
+}
+
+bool thread_pool_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg)
+{
+    if (!pool || !fn)
+        return false;
+
+    return enqueue(pool, fn, arg, &pool->all);
+}
+
+void thread_pool_wait(ThreadPool *pool)
+{
+    if (pool)
+        wait_group(pool, &pool->all);
+}
+
+typedef struct {
+    ThreadPoolRangeFn fn;
+    void *ctx;
+    size_t begin;
+    size_t end;
+} RangeChunk;
+
+static void run_chunk(void *arg)
+{
+    RangeChunk *chunk = arg;
+    chunk->fn(chunk->begin, chunk->end, chunk->ctx);
+}
+
+int thread_pool_parallel_for(ThreadPool *pool, size_t begin, size_t end, size_t grain,
+                             ThreadPoolRangeFn fn, void *ctx)
+{
+    if (!fn)
+        return -1;
+    if (begin >= end)
+        return 0;
+
+    size_t total = end - begin;
+    if (grain == 0)
+    {
+        size_t chunks = pool ? (size_t)pool->n_threads * AUTO_CHUNKS_PER_WORKER : 1;
+        grain = (total + chunks - 1) / chunks;
+    }
+
+    size_t n_chunks = (total + grain - 1) / grain;
+    RangeChunk *chunks = NULL;
+    if (pool && n_chunks > 1)
+        chunks = malloc(n_chunks * sizeof *chunks);
+
+    /* No pool, one chunk, or out of memory: just run it here. */
+    if (!chunks)
+    {
+        fn(begin, end, ctx);
+        return 0;
+    }
+
+    TaskGroup group;
+    atomic_init(&group.remaining, 0);
+
+    /*
+        Queue every chunk but the first, then run the first one here
+        while the workers pick up the rest.
+    */
+    for (size_t i = 0; i < n_chunks; ++i)
+    {
+        chunks[i].fn = fn;
+        chunks[i].ctx = ctx;
+        chunks[i].begin = begin + i * grain;
+        chunks[i].end = (i + 1 == n_chunks) ? end : chunks[i].begin + grain;
+
+        if (i > 0 && !enqueue(pool, run_chunk, &chunks[i], &group))
+            run_chunk(&chunks[i]);
+    }
+
+    run_chunk(&chunks[0]);
+    wait_group(pool, &group);
+
+    free(chunks);
+    return 0;
+}
@@ -1,13 +1,14 @@
 #include <stdlib.h>
 #include <dlist.h>
 #include "internal.h"
+#include "aed_alloc.h"
 
 /*
     Helper to allocate and initialize a node.
     Always returns a fully set-up node or NULL if malloc fails.
 */
 Node *dlist_create_node(void *data, int priority) {
-    Node *node = malloc(sizeof(Node));
+    Node *node = aed_malloc(AED_MEM_LIST_NODE, sizeof(Node));
     if (!node)
         return NULL;
 
@@ -24,7 +25,7 @@ Node *dlist_create_node(void *data, int priority) {
     Keeping everything zeroed and clean avoids undefined behavior.
 */
 DList *dlist_create(bool priority_mode, int (*cmp)(void*, void*)) {
-    DList *list = malloc(sizeof(DList));
+    DList *list = aed_malloc(AED_MEM_LIST, sizeof(DList));
     if (!list)
         return NULL;
 
@@ -50,11 +51,11 @@ void dlist_destroy(DList *list, void (*free_fn)(void*)) {
         if (free_fn)
             free_fn(curr->data);
 
-        free(curr);
+        aed_free(AED_MEM_LIST_NODE, curr, sizeof(Node));
         curr = next;
     }
 
-    free(list);
+    aed_free(AED_MEM_LIST, list, sizeof(DList));
 }
 
 /*
@@ -115,7 +116,7 @@ void *dlist_pop_front(DList *list) {
     else
         list->tail = NULL; // list became empty.
 
-    free(node);
+    aed_free(AED_MEM_LIST_NODE, node, sizeof(Node));
     list->size--;
 
     return data;
@@ -139,7 +140,7 @@ void *dlist_pop_back(DList *list) {
     else
         list->head = NULL;
 
-    free(node);
+    aed_free(AED_MEM_LIST_NODE, node, sizeof(Node));
     list->size--;
 
     return data;
@@ -166,7 +167,7 @@ void dlist_remove_node(DList *list, Node *node, void (*free_fn)(void*)) {
     if (free_fn)
         free_fn(node->data);
 
-    free(node);
+    aed_free(AED_MEM_LIST_NODE, node, sizeof(Node));
     list->size--;
 }
 
@@ -223,7 +224,7 @@ void dlist_clear(DList *list, void (*free_fn)(void*)) {
         if (free_fn)
             free_fn(curr->data);
 
-        free(curr);
+        aed_free(AED_MEM_LIST_NODE, curr, sizeof(Node));
         curr = next;
     }
 
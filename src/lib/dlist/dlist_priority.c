@@ -17,22 +17,27 @@
         1. Create node.
         2. Handle empty list.
         3. If new node has higher priority than head, it becomes new head.
-        4. Walk the list until we find a node with lower priority.
-        5. Insert right before that node.
+        4. If it is not higher than the tail, it goes right after the tail.
+        5. Otherwise walk the list until we find a node with lower priority.
+        6. Insert right before that node.
+
+    Steps 3 and 4 make ascending and descending insertion orders O(1).
+    Descending order is what the loaders see (files are saved highest
+    id first), so loading a file no longer costs O(n^2).
 */
-void dlist_insert_priority(DList *list, void *data, int priority)
+DListNode *dlist_insert_priority(DList *list, void *data, int priority)
 {
     // Create the new node to insert.
     Node *node = dlist_create_node(data, priority);
     if (!node)
-        return;
+        return NULL;
 
     // Empty list -> easy case.
     if (!list->head) {
         list->head = node;
         list->tail = node;
         list->size = 1;
-        return;
+        return node;
     }
 
     // If new node has higher priority than the head -> becomes new head.
@@ -41,7 +46,16 @@ void dlist_insert_priority(DList *list, void *data, int priority)
         list->head->prev = node;
         list->head = node;
         list->size++;
-        return;
+        return node;
+    }
+
+    // Not higher than the tail -> append (equal priorities stay stable).
+    if (priority <= list->tail->priority) {
+        node->prev = list->tail;
+        list->tail->next = node;
+        list->tail = node;
+        list->size++;
+        return node;
     }
 
     // Walk through the list until we find the correct spot.
@@ -63,7 +77,7 @@ void dlist_insert_priority(DList *list, void *data, int priority)
         list->tail->next = node;
         list->tail = node;
         list->size++;
-        return;
+        return node;
     }
 
     // Otherwise we insert BEFORE 'curr'.
@@ -79,4 +93,5 @@ void dlist_insert_priority(DList *list, void *data, int priority)
 
     // This one is self-explanatory.
     list->size++;
+    return node;
 }
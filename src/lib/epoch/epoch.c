@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "lib/epoch/epoch.h"
+
+/* Run a collection pass every time this many objects were retired. */
+#define EPOCH_COLLECT_EVERY 64
+
+/*
+    Per-thread slot.
+    state is 0 while the thread is outside any read section, otherwise
+    (observed_epoch << 1) | 1. Each slot sits on its own cache line so
+    readers on different cores never write to the same line.
+*/
+typedef struct {
+    _Atomic uint64_t state;
+    _Atomic(const void *) owner;
+    unsigned nest;
+    char pad[64 - sizeof(uint64_t) - sizeof(void *) - sizeof(unsigned)];
+} EpochSlot;
+
+typedef struct {
+    void *ptr;
+    void (*free_fn)(void *);
+    uint64_t epoch;
+} Retired;
+
+struct EpochDomain {
+    _Atomic uint64_t global;
+    uint64_t id;
+    EpochSlot slots[EPOCH_MAX_THREADS];
+
+    pthread_mutex_t lock; /* protects the retired array */
+    Retired *retired;
+    size_t count;
+    size_t capacity;
+    size_t since_collect;
+};
+
+/*
+    Each thread caches the slot it owns in the last domain it used,
+    so the common path of epoch_enter is a couple of loads and stores.
+    Domains get a unique id so a new domain allocated at the address
+    of a destroyed one never matches a stale cache entry.
+*/
+static _Atomic uint64_t next_domain_id = 1;
+static _Thread_local char thread_token;
+static _Thread_local struct {
+    uint64_t domain_id;
+    EpochSlot *slot;
+} thread_cache;
+
+EpochDomain *epoch_create(void) {
+    EpochDomain *d = calloc(1, sizeof *d);
+    if (!d)
+        return NULL;
+
+    if (pthread_mutex_init(&d->lock, NULL) != 0) {
+        free(d);
+        return NULL;
+    }
+
+    atomic_init(&d->global, 0);
+    for (size_t i = 0; i < EPOCH_MAX_THREADS; ++i) {
+        atomic_init(&d->slots[i].state, 0);
+        atomic_init(&d->slots[i].owner, NULL);
+    }
+    d->id = atomic_fetch_add(&next_domain_id, 1);
+
+    return d;
+}
+
+static void release(Retired *r) {
+    if (r->free_fn)
+        r->free_fn(r->ptr);
+    else
+        free(r->ptr);
+}
+
+void epoch_destroy(EpochDomain *d) {
+    if (!d)
+        return;
+
+    for (size_t i = 0; i < d->count; ++i)
+        release(&d->retired[i]);
+
+    free(d->retired);
+    pthread_mutex_destroy(&d->lock);
+    free(d);
+}
+
+/*
+    Finds (or claims) the slot owned by the calling thread.
+    Claiming is a CAS on the owner field, so two threads can never
+    end up sharing a slot.
+*/
+static EpochSlot *thread_slot(EpochDomain *d) {
+    if (thread_cache.domain_id == d->id)
+        return thread_cache.slot;
+
+    const void *me = &thread_token;
+    EpochSlot *found = NULL;
+
+    for (size_t i = 0; i < EPOCH_MAX_THREADS && !found; ++i)
+        if (atomic_load(&d->slots[i].owner) == me)
+            found = &d->slots[i];
+
+    for (size_t i = 0; i < EPOCH_MAX_THREADS && !found; ++i) {
+        const void *expected = NULL;
+        if (atomic_compare_exchange_strong(&d->slots[i].owner, &expected, me)) {
+            found = &d->slots[i];
+            found->nest = 0;
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "[epoch] More than %d threads in one domain.\n", EPOCH_MAX_THREADS);
+        abort();
+    }
+
+    thread_cache.domain_id = d->id;
+    thread_cache.slot = found;
+    return found;
+}
+
+void epoch_enter(EpochDomain *d) {
+    EpochSlot *s = thread_slot(d);
+    if (s->nest++ > 0)
+        return;
+
+    /*
+        seq_cst store: the announcement must be visible to a reclaimer
+        before any of the loads this reader does next.
+    */
+    uint64_t e = atomic_load(&d->global);
+    atomic_store(&s->state, (e << 1) | 1);
+}
+
+void epoch_exit(EpochDomain *d) {
+    EpochSlot *s = thread_slot(d);
+    if (s->nest == 0 || --s->nest > 0)
+        return;
+
+    atomic_store_explicit(&s->state, 0, memory_order_release);
+}
+
+void epoch_thread_exit(EpochDomain *d) {
+    if (!d || thread_cache.domain_id != d->id)
+        return;
+
+    EpochSlot *s = thread_cache.slot;
+    s->nest = 0;
+    atomic_store(&s->state, 0);
+    atomic_store(&s->owner, NULL);
+
+    thread_cache.domain_id = 0;
+    thread_cache.slot = NULL;
+}
+
+/*
+    The global epoch moves from g to g+1 only if every active reader
+    has announced g. Called with d->lock held.
+*/
+static void try_advance(EpochDomain *d) {
+    uint64_t g = atomic_load(&d->global);
+
+    for (size_t i = 0; i < EPOCH_MAX_THREADS; ++i) {
+        uint64_t st = atomic_load(&d->slots[i].state);
+        if ((st & 1) && (st >> 1) != g)
+            return;
+    }
+
+    atomic_store(&d->global, g + 1);
+}
+
+void epoch_collect(EpochDomain *d) {
+    if (!d)
+        return;
+
+    pthread_mutex_lock(&d->lock);
+
+    try_advance(d);
+    uint64_t g = atomic_load(&d->global);
+
+    /*
+        Move everything retired at least two epochs ago out of the
+        array, then free it after dropping the lock so free functions
+        never run inside the critical section.
+    */
+    size_t keep = 0;
+    size_t n_free = 0;
+    Retired *to_free = NULL;
+
+    for (size_t i = 0; i < d->count; ++i)
+        if (d->retired[i].epoch + 2 <= g)
+            ++n_free;
+
+    if (n_free > 0)
+        to_free = malloc(n_free * sizeof *to_free);
+
+    if (to_free) {
+        size_t j = 0;
+        for (size_t i = 0; i < d->count; ++i) {
+            if (d->retired[i].epoch + 2 <= g)
+                to_free[j++] = d->retired[i];
+            else
+                d->retired[keep++] = d->retired[i];
+        }
+        d->count = keep;
+    }
+    d->since_collect = 0;
+
+    pthread_mutex_unlock(&d->lock);
+
+    for (size_t i = 0; to_free && i < n_free; ++i)
+        release(&to_free[i]);
+    free(to_free);
+}
+
+void epoch_retire(EpochDomain *d, void *ptr, void (*free_fn)(void *)) {
+    if (!ptr)
+        return;
+
+    if (!d) {
+        Retired r = { ptr, free_fn, 0 };
+        release(&r);
+        return;
+    }
+
+    pthread_mutex_lock(&d->lock);
+
+    if (d->count == d->capacity) {
+        size_t new_capacity = d->capacity ? d->capacity * 2 : 64;
+        Retired *grown = realloc(d->retired, new_capacity * sizeof *grown);
+        if (!grown) {
+            /*
+                Out of memory: the only safe fallback is to keep the
+                object alive forever rather than free it under a reader.
+            */
+            pthread_mutex_unlock(&d->lock);
+            fprintf(stderr, "[epoch] Memory allocation failed, leaking retired object.\n");
+            return;
+        }
+        d->retired = grown;
+        d->capacity = new_capacity;
+    }
+
+    d->retired[d->count].ptr = ptr;
+    d->retired[d->count].free_fn = free_fn;
+    d->retired[d->count].epoch = atomic_load(&d->global);
+    d->count++;
+
+    bool collect = ++d->since_collect >= EPOCH_COLLECT_EVERY;
+
+    pthread_mutex_unlock(&d->lock);
+
+    if (collect)
+        epoch_collect(d);
+}
+
+size_t epoch_pending(EpochDomain *d) {
+    if (!d)
+        return 0;
+
+    pthread_mutex_lock(&d->lock);
+    size_t n = d->count;
+    pthread_mutex_unlock(&d->lock);
+
+    return n;
+}
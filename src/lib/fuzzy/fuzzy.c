@@ -0,0 +1,157 @@
+#include "lib/fuzzy/fuzzy.h"
+
+#include <string.h>
+
+/*
+    The DP matrix has a row per pattern character and a column per text
+    character. Adjacent cells differ by -1, 0 or +1, so a column is kept
+    as two bit vectors of vertical deltas (Pv: +1, Mv: -1), one word per
+    64 rows. Each text character turns the column into the next one; the
+    horizontal delta leaving the bottom of a word is carried into the
+    top of the next word, and the score (bottom-left to current cell)
+    follows the delta that leaves the pattern's last row.
+*/
+
+size_t fuzzy_normalize(const char *s, char *out, size_t out_size)
+{
+    if (!out || out_size == 0)
+        return 0;
+
+    size_t n = 0;
+    int pending_space = 0;
+    for (const unsigned char *c = (const unsigned char *)(s ? s : ""); *c && n + 1 < out_size; ++c)
+    {
+        unsigned char ch = *c;
+        if (ch >= 'A' && ch <= 'Z')
+            ch = (unsigned char)(ch - 'A' + 'a');
+        else if (ch < 0x80 && !(ch >= 'a' && ch <= 'z') && !(ch >= '0' && ch <= '9'))
+        {
+            pending_space = n > 0;
+            continue;
+        }
+
+        if (pending_space)
+        {
+            if (n + 2 >= out_size)
+                break;
+            out[n++] = ' ';
+            pending_space = 0;
+        }
+        out[n++] = (char)ch;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+int fuzzy_pattern_init(FuzzyPattern *p, const char *s, size_t len)
+{
+    if (!p || len > FUZZY_MAX_LEN || (len > 0 && !s))
+        return -1;
+
+    p->len = len;
+    p->words = (len + 63) / 64;
+    memset(p->peq, 0, p->words * sizeof p->peq[0]);
+    for (size_t i = 0; i < len; ++i)
+        p->peq[i / 64][(unsigned char)s[i]] |= (uint64_t)1 << (i % 64);
+    return 0;
+}
+
+/*
+    Advances one word of the column by one text character.
+    hin is the horizontal delta entering at the top of the word; the
+    one leaving at row 'last' is returned.
+*/
+static int advance_word(uint64_t *pv, uint64_t *mv, uint64_t eq, int hin, uint64_t last)
+{
+    uint64_t hin_neg = hin < 0;
+    uint64_t xv = eq | *mv;
+    eq |= hin_neg;
+    uint64_t xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+    uint64_t ph = *mv | ~(xh | *pv);
+    uint64_t mh = *pv & xh;
+
+    int hout = (ph & last) ? 1 : (mh & last) ? -1 : 0;
+
+    ph = (ph << 1) | (uint64_t)(hin > 0);
+    mh = (mh << 1) | hin_neg;
+    *pv = mh | ~(xv | ph);
+    *mv = ph & xv;
+    return hout;
+}
+
+unsigned fuzzy_distance(const FuzzyPattern *p, const char *text, size_t len, unsigned max)
+{
+    if (!p || (len > 0 && !text))
+        return max + 1;
+
+    size_t m = p->len;
+    if ((m > len ? m - len : len - m) > max)
+        return max + 1;
+    if (m == 0)
+        return (unsigned)len;
+
+    uint64_t pv[FUZZY_WORDS], mv[FUZZY_WORDS];
+    for (size_t w = 0; w < p->words; ++w)
+    {
+        pv[w] = ~(uint64_t)0;
+        mv[w] = 0;
+    }
+
+    const uint64_t high = (uint64_t)1 << 63;
+    const uint64_t last = (uint64_t)1 << ((m - 1) % 64);
+    size_t score = m;
+
+    for (size_t j = 0; j < len; ++j)
+    {
+        unsigned char c = (unsigned char)text[j];
+        int h = 1; /* the top row is 0, 1, 2, ...: +1 per column */
+        for (size_t w = 0; w < p->words; ++w)
+            h = advance_word(&pv[w], &mv[w], p->peq[w][c], h, w + 1 == p->words ? last : high);
+        score += h;
+
+        /* The remaining columns can lower the score by at most one each. */
+        if (score > max + (len - j - 1))
+            return max + 1;
+    }
+    return score > max ? max + 1 : (unsigned)score;
+}
+
+unsigned fuzzy_similarity(unsigned distance, size_t a_len, size_t b_len)
+{
+    size_t longer = a_len > b_len ? a_len : b_len;
+    if (longer == 0)
+        return 100;
+    if (distance >= longer)
+        return 0;
+    return (unsigned)(100 * (longer - distance) / longer);
+}
+
+size_t fuzzy_trigrams(const char *s, size_t len, uint32_t *out, size_t cap)
+{
+    if (!out || cap == 0 || len == 0 || !s)
+        return 0;
+
+    /*
+        Padded character i is ' ' at both ends and s[i - 1] in between.
+        Titles are short, so an insertion sort beats qsort here.
+    */
+    size_t n = 0;
+    for (size_t i = 0; i < len && n < cap; ++i)
+    {
+        unsigned char a = i == 0 ? ' ' : (unsigned char)s[i - 1];
+        unsigned char b = (unsigned char)s[i];
+        unsigned char c = i + 1 == len ? ' ' : (unsigned char)s[i + 1];
+        uint32_t gram = (uint32_t)a << 16 | (uint32_t)b << 8 | c;
+
+        size_t j = n++;
+        for (; j > 0 && out[j - 1] > gram; --j)
+            out[j] = out[j - 1];
+        out[j] = gram;
+    }
+
+    size_t distinct = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (distinct == 0 || out[distinct - 1] != out[i])
+            out[distinct++] = out[i];
+    return distinct;
+}
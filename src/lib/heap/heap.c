@@ -0,0 +1,168 @@
+#include "lib/heap/heap.h"
+#include "lib/cutils/aed_alloc.h"
+
+/*
+    Implicit binary tree in an array: the children of slot i are
+    2i + 1 and 2i + 2, and no element is served after either child.
+    The array grows by doubling and never shrinks.
+*/
+
+#define HEAP_MIN_CAPACITY 8
+
+struct Heap {
+    void **items;
+    size_t size;
+    size_t capacity;
+    HeapCmp cmp;
+    HeapMoved moved;
+    void *ctx;
+};
+
+static void place(Heap *h, size_t i, void *elem)
+{
+    h->items[i] = elem;
+    if (h->moved)
+        h->moved(elem, i, h->ctx);
+}
+
+static bool before(const Heap *h, const void *a, const void *b)
+{
+    return h->cmp(a, b, h->ctx) < 0;
+}
+
+/* Moves the element at i towards the root until its parent is served first. */
+static void sift_up(Heap *h, size_t i)
+{
+    void *elem = h->items[i];
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!before(h, elem, h->items[parent]))
+            break;
+        place(h, i, h->items[parent]);
+        i = parent;
+    }
+    place(h, i, elem);
+}
+
+/* Moves the element at i towards the leaves until both children are served after it. */
+static void sift_down(Heap *h, size_t i)
+{
+    void *elem = h->items[i];
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= h->size)
+            break;
+        if (child + 1 < h->size && before(h, h->items[child + 1], h->items[child]))
+            ++child;
+        if (!before(h, h->items[child], elem))
+            break;
+        place(h, i, h->items[child]);
+        i = child;
+    }
+    place(h, i, elem);
+}
+
+Heap *heap_create(HeapCmp cmp, HeapMoved moved, void *ctx)
+{
+    if (!cmp)
+        return NULL;
+
+    Heap *h = aed_malloc(AED_MEM_INDEX, sizeof *h);
+    if (!h)
+        return NULL;
+
+    h->items = NULL;
+    h->size = 0;
+    h->capacity = 0;
+    h->cmp = cmp;
+    h->moved = moved;
+    h->ctx = ctx;
+    return h;
+}
+
+void heap_destroy(Heap *h)
+{
+    if (!h)
+        return;
+
+    aed_free(AED_MEM_INDEX, h->items, h->capacity * sizeof *h->items);
+    aed_free(AED_MEM_INDEX, h, sizeof *h);
+}
+
+int heap_push(Heap *h, void *elem)
+{
+    if (!h)
+        return -1;
+
+    if (h->size == h->capacity)
+    {
+        size_t capacity = h->capacity ? 2 * h->capacity : HEAP_MIN_CAPACITY;
+        void **items = aed_realloc(AED_MEM_INDEX, h->items,
+                                   h->capacity * sizeof *items, capacity * sizeof *items);
+        if (!items)
+            return -1;
+        h->items = items;
+        h->capacity = capacity;
+    }
+
+    h->items[h->size++] = elem;
+    sift_up(h, h->size - 1);
+    return 0;
+}
+
+void *heap_peek(const Heap *h)
+{
+    return h && h->size > 0 ? h->items[0] : NULL;
+}
+
+void *heap_pop(Heap *h)
+{
+    return heap_remove_at(h, 0);
+}
+
+void *heap_remove_at(Heap *h, size_t index)
+{
+    if (!h || index >= h->size)
+        return NULL;
+
+    void *elem = h->items[index];
+    void *last = h->items[--h->size];
+    if (index < h->size)
+    {
+        /* The last element fills the hole and may need to go either way. */
+        h->items[index] = last;
+        if (index > 0 && before(h, last, h->items[(index - 1) / 2]))
+            sift_up(h, index);
+        else
+            sift_down(h, index);
+    }
+    return elem;
+}
+
+void heap_update_at(Heap *h, size_t index)
+{
+    if (!h || index >= h->size)
+        return;
+
+    if (index > 0 && before(h, h->items[index], h->items[(index - 1) / 2]))
+        sift_up(h, index);
+    else
+        sift_down(h, index);
+}
+
+void *heap_at(const Heap *h, size_t index)
+{
+    return h && index < h->size ? h->items[index] : NULL;
+}
+
+size_t heap_size(const Heap *h)
+{
+    return h ? h->size : 0;
+}
+
+size_t heap_bytes(const Heap *h)
+{
+    return h ? sizeof *h + h->capacity * sizeof *h->items : 0;
+}
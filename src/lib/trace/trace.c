@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "lib/trace/trace.h"
+#include "cutils.h"
+
+#define TRACE_THREAD_NAME_MAX 32
+
+typedef struct {
+    const char *name;
+    const char *category;
+    uint64_t start;     /* cutils_now_ns at the beginning of the span */
+    uint64_t duration;  /* ns */
+} TraceEvent;
+
+/*
+    Ring buffer of one thread.
+    Only the owning thread writes to it; trace_stop reads it once every
+    recording thread is done. written counts every event ever recorded,
+    so written - capacity (when positive) events were overwritten.
+*/
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    unsigned tid;
+    char name[TRACE_THREAD_NAME_MAX];
+    uint64_t written;
+    size_t capacity;
+    TraceEvent events[];
+} TraceBuffer;
+
+static _Atomic bool enabled = false;
+
+/*
+    Each trace_start bumps the generation, so a thread whose cached
+    buffer belongs to a previous (already freed) trace allocates a new
+    one instead of writing into freed memory.
+*/
+static _Atomic unsigned generation = 0;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers = NULL; /* every thread buffer of the current trace */
+static unsigned next_tid = 1;
+static char *out_path = NULL;
+static size_t events_per_thread = 0;
+static uint64_t trace_origin = 0;
+
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+static _Thread_local unsigned thread_generation = 0;
+static _Thread_local char thread_name[TRACE_THREAD_NAME_MAX] = "";
+
+int trace_start(const char *path, size_t per_thread)
+{
+    if (!path)
+        return -1;
+
+    pthread_mutex_lock(&registry_lock);
+    if (atomic_load(&enabled) || out_path)
+    {
+        pthread_mutex_unlock(&registry_lock);
+        return -1;
+    }
+
+    out_path = malloc(strlen(path) + 1);
+    if (!out_path)
+    {
+        pthread_mutex_unlock(&registry_lock);
+        return -1;
+    }
+    strcpy(out_path, path);
+
+    events_per_thread = per_thread ? per_thread : TRACE_DEFAULT_EVENTS_PER_THREAD;
+    next_tid = 1;
+    trace_origin = cutils_now_ns();
+    atomic_fetch_add(&generation, 1);
+    atomic_store(&enabled, true);
+    pthread_mutex_unlock(&registry_lock);
+
+    return 0;
+}
+
+bool trace_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+/* Returns the calling thread's buffer, registering it on first use. */
+static TraceBuffer *get_buffer(void)
+{
+    unsigned gen = atomic_load_explicit(&generation, memory_order_acquire);
+    if (thread_buffer && thread_generation == gen)
+        return thread_buffer;
+
+    pthread_mutex_lock(&registry_lock);
+    TraceBuffer *b = NULL;
+    if (atomic_load(&enabled))
+    {
+        b = malloc(sizeof *b + events_per_thread * sizeof b->events[0]);
+        if (b)
+        {
+            b->tid = next_tid++;
+            memcpy(b->name, thread_name, sizeof b->name);
+            b->written = 0;
+            b->capacity = events_per_thread;
+            b->next = buffers;
+            buffers = b;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    thread_buffer = b;
+    thread_generation = gen;
+    return b;
+}
+
+void trace_set_thread_name(const char *name)
+{
+    snprintf(thread_name, sizeof thread_name, "%s", name ? name : "");
+
+    if (trace_enabled())
+    {
+        TraceBuffer *b = get_buffer();
+        if (b)
+            memcpy(b->name, thread_name, sizeof b->name);
+    }
+}
+
+uint64_t trace_begin(void)
+{
+    return trace_enabled() ? cutils_now_ns() : 0;
+}
+
+void trace_end(const char *category, const char *name, uint64_t start)
+{
+    if (start == 0 || !trace_enabled())
+        return;
+
+    uint64_t now = cutils_now_ns();
+    TraceBuffer *b = get_buffer();
+    if (!b)
+        return;
+
+    TraceEvent *e = &b->events[b->written % b->capacity];
+    e->name = name;
+    e->category = category;
+    e->start = start;
+    e->duration = now - start;
+    b->written++;
+}
+
+/* Writes s as a JSON string (names are plain identifiers, but be safe). */
+static void write_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; s && *s; ++s)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/* Timestamps are microseconds since trace_start, as the format expects. */
+static double to_us(uint64_t ns)
+{
+    return (double)ns / 1000.0;
+}
+
+static int write_trace(const char *path, const TraceBuffer *list)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    uint64_t dropped = 0;
+    bool first = true;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (const TraceBuffer *b = list; b; b = b->next)
+    {
+        if (b->name[0])
+        {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                    first ? "" : ",\n", b->tid);
+            write_json_string(f, b->name);
+            fprintf(f, "}}");
+            first = false;
+        }
+
+        uint64_t kept = b->written < b->capacity ? b->written : b->capacity;
+        dropped += b->written - kept;
+
+        for (uint64_t i = b->written - kept; i < b->written; ++i)
+        {
+            const TraceEvent *e = &b->events[i % b->capacity];
+            uint64_t ts = e->start >= trace_origin ? e->start - trace_origin : 0;
+
+            fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(f, e->name);
+            fprintf(f, ",\"cat\":");
+            write_json_string(f, e->category);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    to_us(ts), to_us(e->duration), b->tid);
+            first = false;
+        }
+    }
+
+    fprintf(f, "\n],\"otherData\":{\"dropped_events\":%llu}}\n",
+            (unsigned long long)dropped);
+
+    int rc = ferror(f) ? -1 : 0;
+    if (fclose(f) != 0)
+        rc = -1;
+    return rc;
+}
+
+int trace_stop(void)
+{
+    pthread_mutex_lock(&registry_lock);
+    if (!out_path)
+    {
+        pthread_mutex_unlock(&registry_lock);
+        return -1;
+    }
+
+    atomic_store(&enabled, false);
+
+    TraceBuffer *list = buffers;
+    char *path = out_path;
+    buffers = NULL;
+    out_path = NULL;
+    pthread_mutex_unlock(&registry_lock);
+
+    int rc = write_trace(path, list);
+
+    while (list)
+    {
+        TraceBuffer *next = list->next;
+        free(list);
+        list = next;
+    }
+    free(path);
+
+    return rc;
+}
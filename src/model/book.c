@@ -11,7 +11,9 @@ void book_init(Book* b, unsigned id,
 {
     b->id = id;
     strncpy(b->title, title, sizeof(b->title));
+    b->title[sizeof(b->title) - 1] = '\0';
     strncpy(b->author, author, sizeof(b->author));
+    b->author[sizeof(b->author) - 1] = '\0';
     b->year = year;
     b->available = available;
 }
@@ -28,10 +30,12 @@ int book_from_csv(Book* b, const char* line) {
     token = strtok(NULL, ";");
     if (!token) return 0;
     strncpy(b->title, token, sizeof(b->title));
+    b->title[sizeof(b->title) - 1] = '\0';
 
     token = strtok(NULL, ";");
     if (!token) return 0;
     strncpy(b->author, token, sizeof(b->author));
+    b->author[sizeof(b->author) - 1] = '\0';
 
     token = strtok(NULL, ";");
     if (!token) return 0;
@@ -0,0 +1,115 @@
+#include "model/date.h"
+
+#include <time.h>
+
+/*
+    Days before month m (1..12) of a common / leap year; entry 13 is the
+    length of the year, so month_start[l][m + 1] - month_start[l][m] is
+    the length of month m.
+*/
+static const uint16_t month_start[2][14] = {
+    { 0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 },
+    { 0, 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366 }
+};
+
+static int is_leap(unsigned y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+/* Days of the years before y (from year 1). */
+static Date days_before_year(unsigned y)
+{
+    unsigned p = y - 1;
+    return 365 * p + p / 4 - p / 100 + p / 400;
+}
+
+Date date_from_ymd(unsigned y, unsigned m, unsigned d)
+{
+    return days_before_year(y) + month_start[is_leap(y)][m] + d;
+}
+
+unsigned date_days_in_month(unsigned y, unsigned m)
+{
+    const uint16_t *starts = month_start[is_leap(y)];
+    return (unsigned)(starts[m + 1] - starts[m]);
+}
+
+Date date_from_yyyymmdd(unsigned yyyymmdd)
+{
+    unsigned y = yyyymmdd / 10000;
+    unsigned m = yyyymmdd / 100 % 100;
+    unsigned d = yyyymmdd % 100;
+
+    if (y == 0)
+        return DATE_NONE;
+    if (m == 0)
+        return date_from_ymd(y, 1, 1) - 1;
+    if (m > 12)
+        return date_from_ymd(y, 12, 31);
+    if (d == 0)
+        return date_from_ymd(y, m, 1) - 1;
+
+    unsigned last = date_days_in_month(y, m);
+    return date_from_ymd(y, m, d > last ? last : d);
+}
+
+Date date_ceil_yyyymmdd(unsigned yyyymmdd)
+{
+    unsigned y = yyyymmdd / 10000;
+    unsigned m = yyyymmdd / 100 % 100;
+    unsigned d = yyyymmdd % 100;
+
+    if (yyyymmdd == 0)
+        return DATE_NONE;
+    if (y == 0 || m == 0)
+        return date_from_ymd(y ? y : 1, 1, 1);
+    if (m > 12)
+        return date_from_ymd(y, 12, 31) + 1;
+    if (d == 0)
+        return date_from_ymd(y, m, 1);
+
+    unsigned last = date_days_in_month(y, m);
+    return d > last ? date_from_ymd(y, m, last) + 1 : date_from_ymd(y, m, d);
+}
+
+unsigned date_to_yyyymmdd(Date date)
+{
+    if (date == DATE_NONE)
+        return 0;
+
+    /* Whole 400-, 100-, 4- and 1-year spans before the date. */
+    uint32_t n = date - 1;
+    unsigned n400 = n / 146097;
+    n %= 146097;
+    unsigned n100 = n / 36524;
+    if (n100 == 4)
+        n100 = 3; /* last day of a leap 400th year */
+    n -= n100 * 36524;
+    unsigned n4 = n / 1461;
+    n %= 1461;
+    unsigned n1 = n / 365;
+    if (n1 == 4)
+        n1 = 3; /* last day of a leap year */
+    n -= n1 * 365;
+
+    unsigned y = 400 * n400 + 100 * n100 + 4 * n4 + n1 + 1;
+
+    /* n is now the day of the year (0-based); no month has 32 days, so
+       n / 32 is the month or the one before it. */
+    const uint16_t *starts = month_start[is_leap(y)];
+    unsigned m = n / 32 + 1;
+    if (n >= starts[m + 1])
+        ++m;
+
+    return y * 10000 + m * 100 + (n - starts[m] + 1);
+}
+
+Date date_today(void)
+{
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    return date_from_ymd((unsigned)tm_now.tm_year + 1900, (unsigned)tm_now.tm_mon + 1,
+                         (unsigned)tm_now.tm_mday);
+}
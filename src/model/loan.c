@@ -16,6 +16,26 @@ void loan_init(Loan* l, unsigned id,
     l->date_return = date_return;
 }
 
+Date loan_borrow_day(const Loan* l)
+{
+    return date_from_yyyymmdd(l->date_borrow);
+}
+
+Date loan_return_day(const Loan* l)
+{
+    return date_from_yyyymmdd(l->date_return);
+}
+
+Date loan_due_day(const Loan* l)
+{
+    return loan_borrow_day(l) + LOAN_PERIOD_DAYS;
+}
+
+unsigned loan_due_date(const Loan* l)
+{
+    return date_to_yyyymmdd(loan_due_day(l));
+}
+
 int loan_from_csv(Loan* l, const char* line) {
     char tmp[512];
     strncpy(tmp, line, sizeof(tmp));
@@ -0,0 +1,69 @@
+#include "model/reservation.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+void reservation_init(Reservation* r,
+                      unsigned book_id,
+                      unsigned user_id,
+                      unsigned tier,
+                      unsigned date)
+{
+    r->book_id = book_id;
+    r->user_id = user_id;
+    r->tier = tier;
+    r->date = date;
+    r->seq = 0;
+}
+
+static int compare_unsigned(unsigned a, unsigned b)
+{
+    return a < b ? -1 : a > b;
+}
+
+int reservation_cmp(const Reservation* a, const Reservation* b)
+{
+    if (a->tier != b->tier)
+        return compare_unsigned(b->tier, a->tier);
+    if (a->date != b->date)
+        return compare_unsigned(a->date, b->date);
+    return compare_unsigned(a->seq, b->seq);
+}
+
+int reservation_from_csv(Reservation* r, const char* line) {
+    char tmp[512];
+    strncpy(tmp, line, sizeof(tmp));
+    tmp[sizeof(tmp)-1] = '\0';
+
+    char* token = strtok(tmp, ";");
+    if (!token) return 0;
+    r->book_id = atoi(token);
+
+    token = strtok(NULL, ";");
+    if (!token) return 0;
+    r->user_id = atoi(token);
+
+    token = strtok(NULL, ";");
+    if (!token) return 0;
+    r->tier = atoi(token);
+
+    token = strtok(NULL, ";");
+    if (!token) return 0;
+    r->date = atoi(token);
+
+    token = strtok(NULL, ";");
+    if (!token) return 0;
+    r->seq = atoi(token);
+
+    return 1;
+}
+
+void reservation_to_csv(const Reservation* r, char* out, size_t out_size) {
+    snprintf(out, out_size, "%u;%u;%u;%u;%u",
+        r->book_id,
+        r->user_id,
+        r->tier,
+        r->date,
+        r->seq
+    );
+}
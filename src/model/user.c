@@ -8,7 +8,9 @@ void user_init(User* u, unsigned id,
                const char* email) {
     u->id = id;
     strncpy(u->name, name, sizeof(u->name));
+    u->name[sizeof(u->name) - 1] = '\0';
     strncpy(u->email, email, sizeof(u->email));
+    u->email[sizeof(u->email) - 1] = '\0';
 }
 
 int user_from_csv(User* u, const char* line) {
@@ -23,10 +25,12 @@ int user_from_csv(User* u, const char* line) {
     token = strtok(NULL, ";");
     if (!token) return 0;
     strncpy(u->name, token, sizeof(u->name));
+    u->name[sizeof(u->name) - 1] = '\0';
 
     token = strtok(NULL, ";");
     if (!token) return 0;
     strncpy(u->email, token, sizeof(u->email));
+    u->email[sizeof(u->email) - 1] = '\0';
 
     return 1;
 }
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lib/bptree/bptree.h"
+#include "lib/cutils/aed_alloc.h"
+
+/*
+    B+tree tests:
+      - ascending, descending and random inserts read back in order;
+      - random inserts/removes checked against a plain presence array,
+        including range scans from random seek points;
+      - removing everything collapses the tree back to one leaf;
+      - replacing a value keeps the size;
+      - every node is given back (allocation counters end at zero).
+*/
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+#define KEY_SPACE 20000
+
+/* Values are derived from the key, so every lookup can be checked. */
+static void *value_of(uint64_t key)
+{
+    return (void *)(uintptr_t)(key + 1);
+}
+
+/* Walks the whole tree; keys must be strictly increasing and match present[]. */
+static bool scan_matches(const BPTree *tree, const bool *present)
+{
+    BPTreeCursor cur;
+    bptree_seek(tree, 0, &cur);
+
+    uint64_t key, expected = 0;
+    void *value;
+    size_t seen = 0;
+    while (bptree_next(&cur, &key, &value))
+    {
+        while (expected < KEY_SPACE && !present[expected])
+            ++expected;
+        if (key != expected || value != value_of(key))
+            return false;
+        ++expected;
+        ++seen;
+    }
+    return seen == bptree_size(tree);
+}
+
+/* ---- ordered inserts ---- */
+
+static void test_sequential(void)
+{
+    BPTree *tree = bptree_create();
+    CHECK(tree != NULL, "create");
+
+    for (uint64_t k = 0; k < KEY_SPACE; ++k)
+        CHECK(bptree_insert(tree, k, value_of(k)) == 0, "ascending insert");
+    for (uint64_t k = 2 * KEY_SPACE; k > KEY_SPACE; --k)
+        CHECK(bptree_insert(tree, k, value_of(k)) == 0, "descending insert");
+
+    CHECK(bptree_size(tree) == 2 * KEY_SPACE, "size after inserts");
+
+    BPTreeCursor cur;
+    uint64_t key, last = 0;
+    size_t n = 0;
+    bptree_seek(tree, 0, &cur);
+    while (bptree_next(&cur, &key, NULL))
+    {
+        CHECK(n == 0 || key > last, "keys in order");
+        last = key;
+        ++n;
+    }
+    CHECK(n == 2 * KEY_SPACE, "scan sees every key");
+
+    /* Seek lands on the first key >= the target, including the gap at KEY_SPACE. */
+    bptree_seek(tree, KEY_SPACE, &cur);
+    CHECK(bptree_next(&cur, &key, NULL) && key == KEY_SPACE + 1, "seek into a gap");
+    bptree_seek(tree, 3 * KEY_SPACE, &cur);
+    CHECK(!bptree_next(&cur, &key, NULL), "seek past the end");
+
+    CHECK(bptree_insert(tree, 7, value_of(99)) == 0, "replace");
+    CHECK(bptree_get(tree, 7) == value_of(99), "replaced value");
+    CHECK(bptree_size(tree) == 2 * KEY_SPACE, "replace keeps size");
+
+    bptree_destroy(tree);
+}
+
+/* ---- random inserts / removes ---- */
+
+static void test_random(void)
+{
+    static bool present[KEY_SPACE];
+    size_t count = 0;
+
+    BPTree *tree = bptree_create();
+    srand(12345);
+
+    for (int round = 0; round < 200000; ++round)
+    {
+        uint64_t key = (uint64_t)(rand() % KEY_SPACE);
+        if (rand() % 3 != 0)
+        {
+            CHECK(bptree_insert(tree, key, value_of(key)) == 0, "random insert");
+            if (!present[key])
+                ++count;
+            present[key] = true;
+        }
+        else
+        {
+            int rc = bptree_remove(tree, key);
+            CHECK(rc == (present[key] ? 0 : -1), "random remove result");
+            if (present[key])
+                --count;
+            present[key] = false;
+        }
+
+        if (round % 20000 == 0)
+        {
+            CHECK(scan_matches(tree, present), "scan matches after random ops");
+
+            /* Range scan from a random point. */
+            uint64_t from = (uint64_t)(rand() % KEY_SPACE);
+            BPTreeCursor cur;
+            uint64_t k;
+            bptree_seek(tree, from, &cur);
+            uint64_t expected = from;
+            while (expected < KEY_SPACE && !present[expected])
+                ++expected;
+            CHECK(bptree_next(&cur, &k, NULL) ? k == expected : expected == KEY_SPACE,
+                  "seek returns the first key >= target");
+        }
+    }
+
+    CHECK(bptree_size(tree) == count, "size tracks inserts and removes");
+    for (uint64_t k = 0; k < KEY_SPACE; ++k)
+        CHECK((bptree_get(tree, k) != NULL) == present[k], "get agrees with presence");
+
+    /* Remove everything in random-ish order (stride coprime with KEY_SPACE). */
+    for (uint64_t i = 0, k = 0; i < KEY_SPACE; ++i, k = (k + 7919) % KEY_SPACE)
+        if (present[k])
+            CHECK(bptree_remove(tree, k) == 0, "drain remove");
+
+    CHECK(bptree_size(tree) == 0, "empty after drain");
+    BPTree *fresh = bptree_create();
+    CHECK(bptree_bytes(tree) == bptree_bytes(fresh), "drain collapses to a single leaf");
+    bptree_destroy(fresh);
+
+    BPTreeCursor cur;
+    bptree_seek(tree, 0, &cur);
+    CHECK(!bptree_next(&cur, NULL, NULL), "empty tree has no entries");
+
+    /* The emptied tree is still usable. */
+    CHECK(bptree_insert(tree, 5, value_of(5)) == 0 && bptree_get(tree, 5) == value_of(5),
+          "reuse after drain");
+
+    bptree_destroy(tree);
+}
+
+int main(void)
+{
+    printf("== B+tree Test ==\n");
+
+    AedMemStats before;
+    aed_mem_stats(AED_MEM_INDEX, &before);
+
+    test_sequential();
+    test_random();
+
+    AedMemStats after;
+    aed_mem_stats(AED_MEM_INDEX, &after);
+    CHECK(after.bytes == before.bytes && after.objects == before.objects,
+          "every node was freed");
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
@@ -1,10 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 #include "db/db.h"
+#include "db/db_stats.h"
+#include "db/db_memory.h"
+#include "db/db_record.h"
 #include "model/books.h"
 #include "model/user.h"
 #include "model/loans.h"
+#include "lib/cutils/thread_pool.h"
+#include "lib/fuzzy/fuzzy.h"
 
 /* Simple DB integration test.
    - loads existing data from data/x.txt through fs+db
@@ -20,6 +29,1940 @@ static void print_db_summary(const DB *db)
            (unsigned long)dlist_size(db->loans));
 }
 
+/*
+   Concurrent mode smoke test.
+   Two writers insert disjoint id ranges while a remover keeps
+   removing and re-adding a third one, so records are retired to the
+   epoch domain all the time. Lock-free readers meanwhile copy records
+   out (db_copy_book_by_id) and read them in place (db_find_book_by_id
+   inside db_read_begin/db_read_end); every record they see must be
+   whole (year and available are always written together) and, under
+   -fsanitize=address or thread, never freed under them. Afterwards
+   every inserted book must be present once and every removed one gone.
+*/
+#define CONC_WRITERS 2
+#define CONC_READERS 2
+#define CONC_BOOKS_PER_WRITER 200
+#define CONC_FIRST_ID 50000
+#define CONC_REMOVED_ID (CONC_FIRST_ID + CONC_WRITERS * CONC_BOOKS_PER_WRITER)
+#define CONC_REMOVED 200
+#define CONC_REMOVE_ROUNDS 5
+
+struct conc_args {
+    DB *db;
+    unsigned first_id;
+    atomic_bool *stop;
+    unsigned torn; /* readers: records seen half-written */
+    unsigned seen; /* readers: records found */
+};
+
+static void *conc_writer(void *p)
+{
+    struct conc_args *a = p;
+    for (unsigned i = 0; i < CONC_BOOKS_PER_WRITER; ++i)
+    {
+        Book b;
+        book_init(&b, a->first_id + i, "Concurrent", "Writer", 2000, 2000);
+        db_add_book(a->db, &b);
+
+        /* Rewrite it a few times so readers race with updates too. */
+        for (int v = 2001; v < 2004; ++v)
+        {
+            b.year = v;
+            b.available = v;
+            db_update_book(a->db, &b);
+        }
+    }
+    return NULL;
+}
+
+/* Removes the whole range and puts it back, CONC_REMOVE_ROUNDS times; ends removed. */
+static void *conc_remover(void *p)
+{
+    struct conc_args *a = p;
+    for (int round = 0; round < CONC_REMOVE_ROUNDS; ++round)
+        for (unsigned i = 0; i < CONC_REMOVED; ++i)
+        {
+            db_remove_book(a->db, a->first_id + i);
+            if (round + 1 < CONC_REMOVE_ROUNDS)
+            {
+                Book b;
+                book_init(&b, a->first_id + i, "Concurrent", "Remover", 3000 + round, 3000 + round);
+                db_add_book(a->db, &b);
+            }
+        }
+    return NULL;
+}
+
+static void *conc_reader(void *p)
+{
+    struct conc_args *a = p;
+    const unsigned span = CONC_REMOVED_ID + CONC_REMOVED - a->first_id;
+    Book copy;
+    do
+    {
+        for (unsigned i = 0; i < span; ++i)
+        {
+            unsigned id = a->first_id + i;
+            if (db_copy_book_by_id(a->db, id, &copy) == 0)
+            {
+                ++a->seen;
+                if (copy.year != copy.available)
+                    ++a->torn;
+            }
+
+            db_read_begin(a->db);
+            const Book *b = db_find_book_by_id(a->db, id);
+            if (b && (b->id != id || b->year != b->available))
+                ++a->torn;
+            db_read_end(a->db);
+        }
+    } while (!atomic_load(a->stop));
+    return NULL;
+}
+
+static int count_concurrent_books(const Book *b, void *ctx)
+{
+    if (b->id >= CONC_FIRST_ID && b->id < CONC_REMOVED_ID + CONC_REMOVED)
+        ++*(unsigned *)ctx;
+    return 0;
+}
+
+static int test_concurrent_mode(DB *db)
+{
+    enum { WRITERS_AND_REMOVER = CONC_WRITERS + 1 };
+    pthread_t threads[WRITERS_AND_REMOVER + CONC_READERS];
+    struct conc_args args[WRITERS_AND_REMOVER + CONC_READERS];
+    atomic_bool stop;
+    atomic_init(&stop, false);
+
+    for (unsigned i = 0; i < CONC_REMOVED; ++i)
+    {
+        Book b;
+        book_init(&b, CONC_REMOVED_ID + i, "Concurrent", "Remover", 2999, 2999);
+        if (db_add_book(db, &b) != 0)
+            return 1;
+    }
+
+    db_set_concurrent(db, true);
+
+    for (unsigned t = 0; t < WRITERS_AND_REMOVER + CONC_READERS; ++t)
+    {
+        args[t].db = db;
+        args[t].first_id = t < CONC_WRITERS ? CONC_FIRST_ID + t * CONC_BOOKS_PER_WRITER
+                         : t == CONC_WRITERS ? CONC_REMOVED_ID : CONC_FIRST_ID;
+        args[t].stop = &stop;
+        args[t].torn = 0;
+        args[t].seen = 0;
+    }
+    for (unsigned t = 0; t < CONC_READERS; ++t)
+        pthread_create(&threads[WRITERS_AND_REMOVER + t], NULL, conc_reader,
+                       &args[WRITERS_AND_REMOVER + t]);
+    for (unsigned t = 0; t < CONC_WRITERS; ++t)
+        pthread_create(&threads[t], NULL, conc_writer, &args[t]);
+    pthread_create(&threads[CONC_WRITERS], NULL, conc_remover, &args[CONC_WRITERS]);
+
+    for (unsigned t = 0; t < WRITERS_AND_REMOVER; ++t)
+        pthread_join(threads[t], NULL);
+    atomic_store(&stop, true);
+
+    unsigned torn = 0, read = 0;
+    for (unsigned t = 0; t < CONC_READERS; ++t)
+    {
+        pthread_join(threads[WRITERS_AND_REMOVER + t], NULL);
+        torn += args[WRITERS_AND_REMOVER + t].torn;
+        read += args[WRITERS_AND_REMOVER + t].seen;
+    }
+
+    unsigned seen = 0;
+    db_foreach_book(db, count_concurrent_books, &seen);
+
+    for (unsigned i = 0; i < CONC_WRITERS * CONC_BOOKS_PER_WRITER; ++i)
+        db_remove_book(db, CONC_FIRST_ID + i);
+
+    db_set_concurrent(db, false);
+
+    if (torn != 0)
+    {
+        printf("Concurrent mode: readers saw %u torn records\n", torn);
+        return 1;
+    }
+
+    if (seen != CONC_WRITERS * CONC_BOOKS_PER_WRITER)
+    {
+        printf("Concurrent mode: expected %u books, saw %u\n",
+               (unsigned)(CONC_WRITERS * CONC_BOOKS_PER_WRITER), seen);
+        return 1;
+    }
+
+    printf("Concurrent mode: %u books inserted by %d writers, %d removed %d times, "
+           "%u lock-free reads.\n", seen, CONC_WRITERS, CONC_REMOVED, CONC_REMOVE_ROUNDS, read);
+    return 0;
+}
+
+/*
+   Histogram sanity check: samples 1..1000 ns recorded by hand must give
+   percentiles within one bucket (~6%) of the exact values. Then, in a
+   DB_STATS=1 build, the calls made by the test must have been counted.
+*/
+static int within_bucket(uint64_t got, uint64_t want)
+{
+    return got >= want && got <= want + want / 16 + 1;
+}
+
+static int test_stats(const DB *db)
+{
+    db_stats_reset();
+    for (uint64_t v = 1; v <= 1000; ++v)
+        db_stats_record(DB_OP_SEARCH_BOOKS, v);
+
+    uint64_t p50 = db_stats_percentile(DB_OP_SEARCH_BOOKS, 50.0);
+    uint64_t p99 = db_stats_percentile(DB_OP_SEARCH_BOOKS, 99.0);
+    uint64_t p100 = db_stats_percentile(DB_OP_SEARCH_BOOKS, 100.0);
+    if (db_stats_count(DB_OP_SEARCH_BOOKS) != 1000 ||
+        !within_bucket(p50, 500) || !within_bucket(p99, 990) || p100 != 1000)
+    {
+        printf("Stats: unexpected percentiles p50=%llu p99=%llu max=%llu\n",
+               (unsigned long long)p50, (unsigned long long)p99,
+               (unsigned long long)p100);
+        return 1;
+    }
+    db_stats_reset();
+
+    db_find_book_by_id(db, 1);
+    uint64_t expected = db_stats_enabled() ? 1 : 0;
+    if (db_stats_count(DB_OP_FIND_BOOK) != expected)
+    {
+        printf("Stats: expected %llu find_book samples\n", (unsigned long long)expected);
+        return 1;
+    }
+
+    printf("Stats: histograms ok (%s).\n", db_stats_enabled() ? "enabled" : "disabled");
+    return 0;
+}
+
+/*
+   Allocation accounting: with only this DB alive, the record category
+   of each table must hold exactly the bytes of its records, and adding
+   a book must move both by sizeof(Book).
+*/
+static int test_memory(DB *db)
+{
+    static const AedMemCategory record_category[DB_TABLE_COUNT] = {
+        AED_MEM_BOOK, AED_MEM_USER, AED_MEM_LOAN, AED_MEM_SUGGESTION
+    };
+
+    DBMemoryStats before;
+    db_memory_stats(db, &before);
+
+    for (int i = 0; i < DB_TABLE_COUNT; ++i)
+    {
+        const DBTableMemory *t = &before.tables[i];
+        const AedMemStats *c = &before.categories[record_category[i]];
+        if (c->bytes != t->record_bytes || c->objects != t->records)
+        {
+            printf("Memory: %s category has %zu bytes / %zu objects, table %zu / %zu\n",
+                   db_table_name((DBTable)i), c->bytes, c->objects,
+                   t->record_bytes, t->records);
+            return 1;
+        }
+    }
+
+    Book b;
+    book_init(&b, 0, "Memory", "Accounting", 2024, 1);
+    if (db_add_book_auto(db, &b) != 0)
+        return 1;
+
+    DBMemoryStats after;
+    db_memory_stats(db, &after);
+    db_remove_book(db, b.id);
+
+    size_t grown = after.categories[AED_MEM_BOOK].bytes - before.categories[AED_MEM_BOOK].bytes;
+    size_t nodes = after.categories[AED_MEM_LIST_NODE].objects - before.categories[AED_MEM_LIST_NODE].objects;
+    if (grown != sizeof(Book) || nodes != 1)
+    {
+        printf("Memory: adding a book grew books by %zu bytes and nodes by %zu\n", grown, nodes);
+        return 1;
+    }
+
+    printf("Memory: %zu KiB in records, lists and indexes.\n",
+           (before.tables[0].total_bytes + before.tables[1].total_bytes +
+            before.tables[2].total_bytes + before.tables[3].total_bytes) / 1024);
+    return 0;
+}
+
+/*
+   Ordered indexes: books added with years nobody else uses must come
+   back from the year range in (year, id) order, follow an update of
+   their year and disappear when removed; same for loan dates.
+*/
+#define RANGE_FIRST_ID 70000
+
+struct range_ctx {
+    unsigned ids[8];
+    int years[8];
+    size_t n;
+};
+
+static int collect_book(const Book *b, void *c)
+{
+    struct range_ctx *r = c;
+    if (r->n < 8)
+    {
+        r->ids[r->n] = b->id;
+        r->years[r->n] = b->year;
+    }
+    r->n++;
+    return 0;
+}
+
+static int collect_loan(const Loan *l, void *c)
+{
+    struct range_ctx *r = c;
+    if (r->n < 8)
+        r->ids[r->n] = l->id;
+    r->n++;
+    return 0;
+}
+
+static int test_ranges(DB *db)
+{
+    static const int years[] = { 3002, 3001, 3003, 3001 };
+    struct range_ctx r = { .n = 0 };
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        Book b;
+        book_init(&b, RANGE_FIRST_ID + i, "Range", "Test", years[i], 1);
+        if (db_add_book(db, &b) != 0)
+            return 1;
+    }
+
+    /* 3001 (ids +1, +3), then 3002 (+0); 3003 is out of range. */
+    db_books_by_year_range(db, 3001, 3002, collect_book, &r);
+    if (r.n != 3 || r.ids[0] != RANGE_FIRST_ID + 1 || r.ids[1] != RANGE_FIRST_ID + 3 ||
+        r.ids[2] != RANGE_FIRST_ID)
+    {
+        printf("Ranges: unexpected books for 3001..3002 (%zu found)\n", r.n);
+        return 1;
+    }
+
+    Book moved;
+    book_init(&moved, RANGE_FIRST_ID + 2, "Range", "Test", 3000, 1);
+    db_update_book(db, &moved);
+    db_remove_book(db, RANGE_FIRST_ID + 1);
+
+    r.n = 0;
+    db_books_by_year_range(db, 3000, 3003, collect_book, &r);
+    if (r.n != 3 || r.ids[0] != RANGE_FIRST_ID + 2 || r.years[0] != 3000 ||
+        r.ids[1] != RANGE_FIRST_ID + 3 || r.ids[2] != RANGE_FIRST_ID)
+    {
+        printf("Ranges: update/remove not reflected (%zu found)\n", r.n);
+        return 1;
+    }
+
+    Loan l;
+    loan_init(&l, RANGE_FIRST_ID, 1, RANGE_FIRST_ID, 29990105, 0);
+    db_add_loan(db, &l);
+    loan_init(&l, RANGE_FIRST_ID + 1, 1, RANGE_FIRST_ID, 29990101, 29990110);
+    db_add_loan(db, &l);
+
+    r.n = 0;
+    db_loans_by_borrow_date(db, 29990101, 29991231, collect_loan, &r);
+    int borrow_ok = r.n == 2 && r.ids[0] == RANGE_FIRST_ID + 1 && r.ids[1] == RANGE_FIRST_ID;
+
+    r.n = 0;
+    db_loans_by_return_date(db, 29990110, 29990110, collect_loan, &r);
+    int return_ok = r.n == 1 && r.ids[0] == RANGE_FIRST_ID + 1;
+
+    for (unsigned i = 0; i < 4; ++i)
+        db_remove_book(db, RANGE_FIRST_ID + i);
+    db_remove_loan(db, RANGE_FIRST_ID);
+    db_remove_loan(db, RANGE_FIRST_ID + 1);
+
+    if (!borrow_ok || !return_ok)
+    {
+        printf("Ranges: loan date ranges wrong (borrow %d, return %d)\n", borrow_ok, return_ok);
+        return 1;
+    }
+
+    r.n = 0;
+    db_books_by_year_range(db, 3000, 3003, collect_book, &r);
+    if (r.n != 0)
+        return 1;
+
+    printf("Ranges: year and loan date indexes ok.\n");
+    return 0;
+}
+
+/*
+   Keyset pagination: walking the books 2 at a time must give exactly
+   the db_foreach_book order, and removing the record a cursor points
+   at must not break the next page.
+*/
+struct id_list {
+    unsigned ids[4096];
+    size_t n;
+};
+
+static int append_book_id(const Book *b, void *c)
+{
+    struct id_list *l = c;
+    if (l->n < sizeof l->ids / sizeof l->ids[0])
+        l->ids[l->n] = b->id;
+    l->n++;
+    return 0;
+}
+
+static int test_pages(DB *db)
+{
+    static struct id_list all, paged;
+    all.n = paged.n = 0;
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        Book extra;
+        book_init(&extra, RANGE_FIRST_ID + 20 + i, "Page", "Extra", 2000, 1);
+        db_add_book(db, &extra);
+    }
+
+    db_foreach_book(db, append_book_id, &all);
+    unsigned after = 0;
+    int pages = 0;
+    do {
+        if (db_books_page(db, after, 2, append_book_id, &paged, &after) < 0)
+            return 1;
+        ++pages;
+    } while (after != 0 && paged.n <= all.n);
+
+    for (unsigned i = 0; i < 5; ++i)
+        db_remove_book(db, RANGE_FIRST_ID + 20 + i);
+
+    /* ids[] only keeps the first 4096, which is plenty for the test files. */
+    size_t compared = all.n < 4096 ? all.n : 4096;
+    if (pages < 3 || paged.n != all.n ||
+        memcmp(paged.ids, all.ids, compared * sizeof all.ids[0]) != 0)
+    {
+        printf("Pages: paged walk saw %zu books, foreach %zu\n", paged.n, all.n);
+        return 1;
+    }
+
+    /* Cursor on a removed record: the next page starts right below it. */
+    Book a, b;
+    book_init(&a, RANGE_FIRST_ID + 10, "Page", "A", 2000, 1);
+    book_init(&b, RANGE_FIRST_ID + 9, "Page", "B", 2000, 1);
+    db_add_book(db, &a);
+    db_add_book(db, &b);
+
+    paged.n = 0;
+    after = 0;
+    db_books_page(db, RANGE_FIRST_ID + 11, 1, append_book_id, &paged, &after);
+    db_remove_book(db, a.id);
+    db_books_page(db, after, 1, append_book_id, &paged, &after);
+    db_remove_book(db, b.id);
+
+    if (paged.n != 2 || paged.ids[0] != a.id || paged.ids[1] != b.id)
+    {
+        printf("Pages: cursor on a removed record lost its place\n");
+        return 1;
+    }
+
+    printf("Pages: %d pages match the list order (%zu books).\n", pages, all.n);
+    return 0;
+}
+
+/*
+   Due dates: walks the calendar day by day (plus a couple of long
+   jumps) with loans being returned, reopened and removed on the way,
+   and checks the wheel's answers against a plain scan of the loans.
+*/
+#define DUE_FIRST_ID 90000
+#define DUE_LOANS 300
+
+static int count_due_test_loan(const Loan *l, void *ctx)
+{
+    if (l->id >= DUE_FIRST_ID && l->id < DUE_FIRST_ID + DUE_LOANS)
+        ++*(size_t *)ctx;
+    return 0;
+}
+
+struct due_scan {
+    unsigned today;  /* day number */
+    size_t overdue;
+    size_t due_yesterday;
+};
+
+static int scan_due(const Loan *l, void *ctx)
+{
+    struct due_scan *d = ctx;
+    if (l->id < DUE_FIRST_ID || l->id >= DUE_FIRST_ID + DUE_LOANS || l->date_return != 0)
+        return 0;
+    if (loan_due_day(l) < d->today)
+        d->overdue++;
+    if (loan_due_day(l) == d->today - 1)
+        d->due_yesterday++;
+    return 0;
+}
+
+static int check_due_day(DB *db, unsigned day)
+{
+    struct due_scan expected = { day, 0, 0 };
+    db_foreach_loan(db, scan_due, &expected);
+
+    size_t overdue = 0, due = 0;
+    db_loans_overdue(db, date_to_yyyymmdd(day), count_due_test_loan, &overdue);
+    db_loans_due_on(db, date_to_yyyymmdd(day - 1), count_due_test_loan, &due);
+
+    if (overdue != expected.overdue || due != expected.due_yesterday)
+    {
+        printf("Due dates: %u: %zu overdue / %zu due (expected %zu / %zu)\n",
+               date_to_yyyymmdd(day), overdue, due, expected.overdue, expected.due_yesterday);
+        return 1;
+    }
+    return 0;
+}
+
+static int test_due_dates(DB *db)
+{
+    const unsigned base = date_from_yyyymmdd(29990101);
+    int rc = 0;
+
+    srand(777);
+    for (unsigned i = 0; i < DUE_LOANS; ++i)
+    {
+        Loan l;
+        unsigned borrow = date_to_yyyymmdd(base + (unsigned)(rand() % 200));
+        loan_init(&l, DUE_FIRST_ID + i, 1, 1, borrow, rand() % 4 ? 0 : borrow);
+        if (db_add_loan(db, &l) != 0)
+            return 1;
+    }
+
+    /* The wheel starts at the real date, so this first step is a long jump. */
+    unsigned day = base;
+    for (int step = 0; step < 260 && rc == 0; ++step, ++day)
+    {
+        rc = check_due_day(db, day);
+
+        /* Close, reopen or drop a loan now and then. */
+        unsigned id = DUE_FIRST_ID + (unsigned)(rand() % DUE_LOANS);
+        Loan l;
+        if (step % 3 == 0 && db_copy_loan_by_id(db, id, &l) == 0)
+        {
+            l.date_return = l.date_return ? 0 : date_to_yyyymmdd(day);
+            db_update_loan(db, &l);
+        }
+        else if (step % 7 == 0)
+        {
+            db_remove_loan(db, id);
+        }
+    }
+
+    /* Past days only filter; a jump of years rebuilds the wheel. */
+    if (rc == 0)
+        rc = check_due_day(db, base + 10);
+    if (rc == 0)
+        rc = check_due_day(db, base + 5000);
+
+    for (unsigned i = 0; i < DUE_LOANS; ++i)
+        db_remove_loan(db, DUE_FIRST_ID + i);
+
+    if (rc == 0)
+        printf("Due dates: overdue and due-on queries match a full scan.\n");
+    return rc;
+}
+
+/*
+   Far due dates: loans due over ~94 64-day blocks, more than the
+   wheel's two levels reach, with 'now' on a day that is not aligned
+   to any block boundary. Every future day must list exactly its loans
+   while the wheel moves forward in uneven steps.
+*/
+#define FAR_DUE_SPAN 6000
+#define FAR_DUE_STEPS 12
+
+struct far_due_scan {
+    unsigned first_day;
+    size_t due[FAR_DUE_SPAN + LOAN_PERIOD_DAYS];
+};
+
+static int scan_far_due(const Loan *l, void *ctx)
+{
+    struct far_due_scan *d = ctx;
+    if (l->id >= DUE_FIRST_ID && l->id < DUE_FIRST_ID + DUE_LOANS && l->date_return == 0)
+        d->due[loan_due_day(l) - d->first_day]++;
+    return 0;
+}
+
+static int test_far_due_dates(DB *db)
+{
+    /* After the days test_due_dates walked; 17 is not a block boundary. */
+    const unsigned base = date_from_yyyymmdd(30200101) | 17;
+    int rc = 0;
+
+    srand(4242);
+    for (unsigned i = 0; i < DUE_LOANS; ++i)
+    {
+        Loan l;
+        unsigned borrow = date_to_yyyymmdd(base + (unsigned)(rand() % FAR_DUE_SPAN));
+        loan_init(&l, DUE_FIRST_ID + i, 1, 1, borrow, rand() % 4 ? 0 : borrow);
+        if (db_add_loan(db, &l) != 0)
+            return 1;
+    }
+
+    struct far_due_scan *expected = calloc(1, sizeof *expected);
+    if (!expected)
+        return 1;
+    expected->first_day = base;
+    db_foreach_loan(db, scan_far_due, expected);
+
+    unsigned today = base;
+    for (int step = 0; step < FAR_DUE_STEPS && rc == 0; ++step)
+    {
+        size_t ignored = 0;
+        db_loans_overdue(db, date_to_yyyymmdd(today), count_due_test_loan, &ignored);
+
+        for (unsigned d = today; d < base + FAR_DUE_SPAN + LOAN_PERIOD_DAYS && rc == 0; ++d)
+        {
+            size_t due = 0;
+            db_loans_due_on(db, date_to_yyyymmdd(d), count_due_test_loan, &due);
+            if (due != expected->due[d - base])
+            {
+                printf("Far due dates: %u seen from %u: %zu due (expected %zu)\n",
+                       date_to_yyyymmdd(d), date_to_yyyymmdd(today), due, expected->due[d - base]);
+                rc = 1;
+            }
+        }
+        today += 101 + (unsigned)step * 37;
+    }
+
+    free(expected);
+    for (unsigned i = 0; i < DUE_LOANS; ++i)
+        db_remove_loan(db, DUE_FIRST_ID + i);
+
+    if (rc == 0)
+        printf("Far due dates: days beyond the wheel's levels are found from any day.\n");
+    return rc;
+}
+
+/*
+   Circulation: checkout/return keep Book.available and the per-user
+   counters right, report every failure, and never lend more copies
+   than there are when several threads check out the same book.
+*/
+#define CIRC_USER_ID 96000
+#define CIRC_BOOK_ID 96000
+#define CIRC_THREADS 4
+#define CIRC_ROUNDS 500
+#define CIRC_COPIES 3
+
+/* Loans out right now, as seen by the workers; never above CIRC_COPIES. */
+static _Atomic unsigned circ_out;
+static _Atomic bool circ_overlent;
+
+struct circ_args {
+    DB *db;
+    unsigned lent;
+};
+
+static void *circ_worker(void *p)
+{
+    struct circ_args *a = p;
+    for (unsigned i = 0; i < CIRC_ROUNDS; ++i)
+    {
+        unsigned loan_id;
+        if (db_checkout(a->db, CIRC_USER_ID, CIRC_BOOK_ID, 20240101, &loan_id) != DB_CIRC_OK)
+            continue;
+        ++a->lent;
+        if (atomic_fetch_add(&circ_out, 1) + 1 > CIRC_COPIES)
+            atomic_store(&circ_overlent, true);
+        atomic_fetch_sub(&circ_out, 1);
+        if (db_return(a->db, loan_id, 20240102, NULL) != DB_CIRC_OK)
+            a->lent = CIRC_ROUNDS + 1;
+    }
+    return NULL;
+}
+
+static int remove_circulation_loan(const Loan *l, void *ctx)
+{
+    if (l->user_id == CIRC_USER_ID)
+    {
+        unsigned *ids = ctx;
+        ids[++ids[0]] = l->id;
+    }
+    return 0;
+}
+
+static int book_available(DB *db)
+{
+    Book b;
+    return db_copy_book_by_id(db, CIRC_BOOK_ID, &b) == 0 ? b.available : -1;
+}
+
+static int test_circulation(DB *db)
+{
+    User u;
+    Book b;
+    unsigned first = 0, second = 0;
+    int rc = 0;
+
+    user_init(&u, CIRC_USER_ID, "Circulation", "circ@example.com");
+    book_init(&b, CIRC_BOOK_ID, "Circulation", "Test", 2020, 2);
+    if (db_add_user(db, &u) != 0 || db_add_book(db, &b) != 0)
+        return 1;
+
+    /* Days that do not exist are refused before anything changes. */
+    if (db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID, 20241399, NULL) != DB_CIRC_ERROR ||
+        db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID, 20240231, NULL) != DB_CIRC_ERROR ||
+        book_available(db) != 2 || db_user_active_loans(db, CIRC_USER_ID) != 0)
+    {
+        printf("Circulation: checkout accepted a date that is not a day\n");
+        rc = 1;
+    }
+
+    if (rc == 0 && (db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID, 20240101, &first) != DB_CIRC_OK ||
+        db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID, 20240102, &second) != DB_CIRC_OK ||
+        db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID, 20240103, NULL) != DB_CIRC_UNAVAILABLE ||
+        db_checkout(db, CIRC_USER_ID + 1, CIRC_BOOK_ID, 20240103, NULL) != DB_CIRC_NO_USER ||
+        db_checkout(db, CIRC_USER_ID, CIRC_BOOK_ID + 1, 20240103, NULL) != DB_CIRC_NO_BOOK ||
+        book_available(db) != 0 || db_user_active_loans(db, CIRC_USER_ID) != 2))
+    {
+        printf("Circulation: checkout results are wrong\n");
+        rc = 1;
+    }
+
+    /* A return on a day that does not exist, or before the borrow, leaves the loan open. */
+    if (rc == 0 &&
+        (db_return(db, first, 20240132, NULL) != DB_CIRC_ERROR ||
+         db_return(db, first, 20231231, NULL) != DB_CIRC_BEFORE_BORROW ||
+         book_available(db) != 0 || db_user_active_loans(db, CIRC_USER_ID) != 2))
+    {
+        printf("Circulation: return accepted a bad date\n");
+        rc = 1;
+    }
+
+    if (rc == 0 &&
+        (db_return(db, first, 20240110, NULL) != DB_CIRC_OK ||
+         db_return(db, first, 20240111, NULL) != DB_CIRC_RETURNED ||
+         db_return(db, 0xFFFFFFF0u, 20240111, NULL) != DB_CIRC_NO_LOAN ||
+         book_available(db) != 1 || db_user_active_loans(db, CIRC_USER_ID) != 1))
+    {
+        printf("Circulation: return results are wrong\n");
+        rc = 1;
+    }
+
+    /* A plain loan update is counted too. */
+    Loan l;
+    if (rc == 0 && db_copy_loan_by_id(db, second, &l) == 0)
+    {
+        l.date_return = 20240120;
+        db_update_loan(db, &l);
+        if (db_user_active_loans(db, CIRC_USER_ID) != 0)
+        {
+            printf("Circulation: update did not release the user's loan\n");
+            rc = 1;
+        }
+        b.available = CIRC_COPIES;
+        db_update_book(db, &b);
+    }
+
+    /* Threads fighting over CIRC_COPIES copies. */
+    pthread_t threads[CIRC_THREADS];
+    struct circ_args args[CIRC_THREADS];
+    unsigned lent = 0;
+
+    db_set_concurrent(db, true);
+    for (unsigned t = 0; t < CIRC_THREADS && rc == 0; ++t)
+    {
+        args[t].db = db;
+        args[t].lent = 0;
+        pthread_create(&threads[t], NULL, circ_worker, &args[t]);
+    }
+    for (unsigned t = 0; t < CIRC_THREADS && rc == 0; ++t)
+    {
+        pthread_join(threads[t], NULL);
+        lent += args[t].lent;
+    }
+    db_set_concurrent(db, false);
+
+    if (rc == 0 && (atomic_load(&circ_overlent) || lent > CIRC_THREADS * CIRC_ROUNDS ||
+                    book_available(db) != CIRC_COPIES ||
+                    db_user_active_loans(db, CIRC_USER_ID) != 0))
+    {
+        printf("Circulation: %u loans, %d copies left, %u still active after the threads\n",
+               lent, book_available(db), db_user_active_loans(db, CIRC_USER_ID));
+        rc = 1;
+    }
+
+    static unsigned ids[1 + CIRC_THREADS * CIRC_ROUNDS + 2];
+    ids[0] = 0;
+    db_foreach_loan(db, remove_circulation_loan, ids);
+    for (unsigned i = 1; i <= ids[0]; ++i)
+        db_remove_loan(db, ids[i]);
+    db_remove_book(db, CIRC_BOOK_ID);
+    db_remove_user(db, CIRC_USER_ID);
+
+    if (rc == 0)
+        printf("Circulation: %u threaded loans, stock and counters consistent.\n", lent);
+    return rc;
+}
+
+/*
+   Reservations: holds are served by tier, then date, then arrival; a
+   return hands the copy to the next hold (skipping users removed
+   meanwhile) and only a return with nobody waiting restocks the book.
+   Saving and loading the holds keeps their order.
+*/
+#define RES_BOOK_ID 97000
+#define RES_USER_ID 97000
+#define RES_USERS 5
+#define RES_PATH "data/reservations_test.txt"
+
+struct res_order {
+    unsigned users[RES_USERS];
+    unsigned n;
+};
+
+static int collect_reserver(const Reservation *r, void *ctx)
+{
+    struct res_order *o = ctx;
+    if (o->n < RES_USERS)
+        o->users[o->n] = r->user_id;
+    ++o->n;
+    return 0;
+}
+
+/* 1 if the book's queue holds exactly the given user offsets, in that order. */
+static int queue_is(DB *db, const unsigned *offsets, unsigned n)
+{
+    struct res_order o = { { 0 }, 0 };
+    if (db_book_reservations(db, RES_BOOK_ID, collect_reserver, &o) != 0 || o.n != n)
+        return 0;
+    for (unsigned i = 0; i < n; ++i)
+        if (o.users[i] != RES_USER_ID + offsets[i])
+            return 0;
+    return 1;
+}
+
+static int res_available(DB *db)
+{
+    Book b;
+    return db_copy_book_by_id(db, RES_BOOK_ID, &b) == 0 ? b.available : -1;
+}
+
+static int remove_reservation_loan(const Loan *l, void *ctx)
+{
+    if (l->book_id == RES_BOOK_ID)
+    {
+        unsigned *ids = ctx;
+        if (ids[0] < 16)
+            ids[++ids[0]] = l->id;
+    }
+    return 0;
+}
+
+static int test_reservations(DB *db)
+{
+    Book b;
+    book_init(&b, RES_BOOK_ID, "Reservations", "Test", 2020, 1);
+    if (db_add_book(db, &b) != 0)
+        return 1;
+    for (unsigned i = 0; i < RES_USERS; ++i)
+    {
+        User u;
+        user_init(&u, RES_USER_ID + i, "Reserver", "res@example.com");
+        if (db_add_user(db, &u) != 0)
+            return 1;
+    }
+
+    int rc = 0;
+    unsigned first = 0, next = 0;
+    if (db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID, 0, 20240101) != DB_CIRC_AVAILABLE ||
+        db_checkout(db, RES_USER_ID, RES_BOOK_ID, 20240101, &first) != DB_CIRC_OK)
+        rc = 1;
+
+    /* Arrival 1..4: regular, premium, regular a day earlier, premium again. */
+    if (rc == 0 &&
+        (db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID, 0, 20240105) != DB_CIRC_OK ||
+         db_reserve(db, RES_USER_ID + 2, RES_BOOK_ID, 2, 20240105) != DB_CIRC_OK ||
+         db_reserve(db, RES_USER_ID + 3, RES_BOOK_ID, 0, 20240104) != DB_CIRC_OK ||
+         db_reserve(db, RES_USER_ID + 4, RES_BOOK_ID, 2, 20240105) != DB_CIRC_OK ||
+         db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID, 3, 20240106) != DB_CIRC_RESERVED ||
+         db_reserve(db, RES_USER_ID + 99, RES_BOOK_ID, 0, 20240106) != DB_CIRC_NO_USER ||
+         db_reserve(db, RES_USER_ID, RES_BOOK_ID + 1, 0, 20240106) != DB_CIRC_NO_BOOK ||
+         db_reserve(db, RES_USER_ID, RES_BOOK_ID, RESERVATION_TIER_MAX + 1, 20240106) != DB_CIRC_ERROR ||
+         db_reserve(db, RES_USER_ID, RES_BOOK_ID, 0, 20240231) != DB_CIRC_ERROR))
+    {
+        printf("Reservations: reserve results are wrong\n");
+        rc = 1;
+    }
+
+    const unsigned order[] = { 2, 4, 3, 1 };
+    if (rc == 0 && !queue_is(db, order, 4))
+    {
+        printf("Reservations: queue is not in tier/date/arrival order\n");
+        rc = 1;
+    }
+
+    /* Round trip through the file, into an emptied queue. */
+    if (rc == 0)
+    {
+        if (db_save_reservations(db, RES_PATH) != 0)
+            rc = 1;
+        for (unsigned i = 0; i < 4; ++i)
+            db_cancel_reservation(db, RES_USER_ID + order[i], RES_BOOK_ID);
+        if (rc == 0 && (queue_is(db, order, 0) != 1 || db_load_reservations(db, RES_PATH) != 0 ||
+                        !queue_is(db, order, 4)))
+        {
+            printf("Reservations: save/load did not keep the queue\n");
+            rc = 1;
+        }
+        remove(RES_PATH);
+    }
+
+    /* The first return goes to user 2; user 4 was removed, so the next one to user 3. */
+    if (rc == 0 &&
+        (db_cancel_reservation(db, RES_USER_ID + 1, RES_BOOK_ID) != DB_CIRC_OK ||
+         db_cancel_reservation(db, RES_USER_ID + 1, RES_BOOK_ID) != DB_CIRC_NO_RESERVATION ||
+         db_return(db, first, 20240110, &next) != DB_CIRC_OK || next == 0 ||
+         res_available(db) != 0 || db_user_active_loans(db, RES_USER_ID + 2) != 1))
+    {
+        printf("Reservations: first return was not handed to the next hold\n");
+        rc = 1;
+    }
+
+    first = next;
+    db_remove_user(db, RES_USER_ID + 4);
+    if (rc == 0 &&
+        (db_return(db, first, 20240120, &next) != DB_CIRC_OK || next == 0 ||
+         db_user_active_loans(db, RES_USER_ID + 3) != 1 || res_available(db) != 0))
+    {
+        printf("Reservations: removed user was not skipped\n");
+        rc = 1;
+    }
+
+    const unsigned none[] = { 0 };
+    if (rc == 0 &&
+        (db_return(db, next, 20240130, &next) != DB_CIRC_OK || next != 0 ||
+         res_available(db) != 1 || !queue_is(db, none, 0)))
+    {
+        printf("Reservations: last return did not restock the book\n");
+        rc = 1;
+    }
+
+    /* A checkout by a reserver clears their hold. */
+    if (rc == 0)
+    {
+        b.available = 0;
+        db_update_book(db, &b);
+        db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID, 0, 20240201);
+        b.available = 1;
+        db_update_book(db, &b);
+        if (db_checkout(db, RES_USER_ID + 1, RES_BOOK_ID, 20240202, &next) != DB_CIRC_OK ||
+            !queue_is(db, none, 0))
+        {
+            printf("Reservations: checkout did not clear the hold\n");
+            rc = 1;
+        }
+    }
+
+    /*
+       Removing a user cancels their holds on every book; removing a
+       book drops its queue, so a book re-added under its id starts
+       with none.
+    */
+    if (rc == 0)
+    {
+        DBTotals before, after;
+        Book other;
+        book_init(&other, RES_BOOK_ID + 1, "Reservations 2", "Test", 2020, 0);
+        b.available = 0;
+        db_update_book(db, &b);
+        const unsigned kept[] = { 2 };
+        if (db_add_book(db, &other) != 0 || db_totals(db, &before) != 0 ||
+            db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID, 0, 20240301) != DB_CIRC_OK ||
+            db_reserve(db, RES_USER_ID + 2, RES_BOOK_ID, 0, 20240302) != DB_CIRC_OK ||
+            db_reserve(db, RES_USER_ID + 1, RES_BOOK_ID + 1, 0, 20240303) != DB_CIRC_OK ||
+            db_remove_user(db, RES_USER_ID + 1) != 0 || !queue_is(db, kept, 1) ||
+            db_remove_book(db, RES_BOOK_ID) != 0 || db_add_book(db, &b) != 0 ||
+            !queue_is(db, none, 0) ||
+            db_totals(db, &after) != 0 || after.reservations != before.reservations)
+        {
+            printf("Reservations: removed users or books kept their holds\n");
+            rc = 1;
+        }
+        db_remove_book(db, RES_BOOK_ID + 1);
+    }
+
+    static unsigned ids[1 + 16];
+    ids[0] = 0;
+    db_foreach_loan(db, remove_reservation_loan, ids);
+    for (unsigned i = 1; i <= ids[0]; ++i)
+        db_remove_loan(db, ids[i]);
+    for (unsigned i = 0; i < RES_USERS; ++i)
+        db_remove_user(db, RES_USER_ID + i);
+    db_remove_book(db, RES_BOOK_ID);
+
+    if (rc == 0)
+        printf("Reservations: queue order, hand-offs, save/load and removal are right.\n");
+    return rc;
+}
+
+/*
+   Circulation aggregates: the O(1) counters follow adds, checkouts,
+   returns, updates and removes, and agree with a full rebuild
+   (db_check_totals) after every step, including the threaded
+   circulation test that ran before.
+*/
+#define TOTALS_ID 96000
+
+static int totals_delta(DB *db, const DBTotals *base, long books, long loans,
+                        long active, long long copies)
+{
+    DBTotals t;
+    return db_totals(db, &t) == 0 &&
+           (long)(t.books - base->books) == books &&
+           (long)(t.loans - base->loans) == loans &&
+           (long)(t.loans_active - base->loans_active) == active &&
+           t.copies_available - base->copies_available == copies &&
+           db_check_totals(db) == 0;
+}
+
+static int test_totals(DB *db)
+{
+    DBTotals base;
+    if (db_check_totals(db) != 0 || db_totals(db, &base) != 0)
+    {
+        printf("Totals: counters disagree with the loaded tables\n");
+        return 1;
+    }
+
+    Book b, other;
+    User u;
+    book_init(&b, TOTALS_ID, "Totals", "Test", 2020, 3);
+    book_init(&other, TOTALS_ID + 1, "Totals", "Other", 2020, 1);
+    user_init(&u, TOTALS_ID, "Totals", "totals@example.com");
+    if (db_add_book(db, &b) != 0 || db_add_book(db, &other) != 0 || db_add_user(db, &u) != 0)
+        return 1;
+
+    int rc = 0;
+    unsigned first = 0, second = 0;
+    if (!totals_delta(db, &base, 2, 0, 0, 4) ||
+        db_checkout(db, TOTALS_ID, TOTALS_ID, 20240101, &first) != DB_CIRC_OK ||
+        db_checkout(db, TOTALS_ID, TOTALS_ID, 20240102, &second) != DB_CIRC_OK ||
+        !totals_delta(db, &base, 2, 2, 2, 2) || db_book_loans(db, TOTALS_ID) != 2)
+    {
+        printf("Totals: checkouts were not counted\n");
+        rc = 1;
+    }
+
+    if (rc == 0 &&
+        (db_return(db, first, 20240110, NULL) != DB_CIRC_OK ||
+         !totals_delta(db, &base, 2, 2, 1, 3) || db_book_loans(db, TOTALS_ID) != 2))
+    {
+        printf("Totals: return was not counted\n");
+        rc = 1;
+    }
+
+    /*
+       Moving a loan to another book moves its count. Plain loan writes
+       leave Book.available alone: only db_checkout/db_return lend.
+    */
+    Loan l;
+    if (rc == 0 && db_copy_loan_by_id(db, second, &l) == 0)
+    {
+        l.book_id = TOTALS_ID + 1;
+        if (db_update_loan(db, &l) != 0 || db_book_loans(db, TOTALS_ID) != 1 ||
+            db_book_loans(db, TOTALS_ID + 1) != 1 || !totals_delta(db, &base, 2, 2, 1, 3))
+        {
+            printf("Totals: loan update was not counted\n");
+            rc = 1;
+        }
+
+        l.date_return = 20240115;
+        if (rc == 0 &&
+            (db_update_loan(db, &l) != 0 || !totals_delta(db, &base, 2, 2, 0, 3) ||
+             db_return(db, second, 20240116, NULL) != DB_CIRC_RETURNED ||
+             !totals_delta(db, &base, 2, 2, 0, 3)))
+        {
+            printf("Totals: closing a loan by update changed the copies\n");
+            rc = 1;
+        }
+    }
+
+    unsigned open_loan = 0;
+    if (rc == 0 &&
+        (db_checkout(db, TOTALS_ID, TOTALS_ID + 1, 20240120, &open_loan) != DB_CIRC_OK ||
+         !totals_delta(db, &base, 2, 3, 1, 2) || db_remove_loan(db, open_loan) != 0 ||
+         !totals_delta(db, &base, 2, 2, 0, 2)))
+    {
+        printf("Totals: removing an active loan changed the copies\n");
+        rc = 1;
+    }
+
+    db_remove_loan(db, first);
+    db_remove_loan(db, second);
+    db_remove_book(db, TOTALS_ID);
+    db_remove_book(db, TOTALS_ID + 1);
+    db_remove_user(db, TOTALS_ID);
+
+    if (rc == 0 && (!totals_delta(db, &base, 0, 0, 0, 0) || db_book_loans(db, TOTALS_ID) != 0))
+    {
+        printf("Totals: removes did not bring the counters back\n");
+        rc = 1;
+    }
+
+    if (rc == 0)
+        printf("Totals: %zu active loans, %lld copies available, consistent with a rebuild.\n",
+               base.loans_active, base.copies_available);
+    return rc;
+}
+
+/*
+   Top books and users: a window ranks only the loans borrowed in it,
+   k truncates, ties go to the lower id, and the all-time ranking
+   agrees with the per-book counters.
+*/
+#define TOP_ID 95000
+
+static int top_is(const IdCount *top, size_t n, const unsigned *ids, const unsigned *counts,
+                  size_t expected)
+{
+    if (n != expected)
+        return 0;
+    for (size_t i = 0; i < n; ++i)
+        if (top[i].id != ids[i] || top[i].count != counts[i])
+            return 0;
+    return 1;
+}
+
+static int test_top(DB *db)
+{
+    /* Loans per book in 1990: book 2 three times, books 0 and 1 twice (tie), book 1 once more in 1991. */
+    static const unsigned books[] = { 2, 0, 2, 1, 0, 2, 1, 1 };
+    static const unsigned users[] = { 0, 1, 1, 2, 2, 2, 2, 0 };
+    static const unsigned dates[] = { 19900101, 19900105, 19900110, 19900201, 19900301,
+                                      19900401, 19901231, 19910101 };
+    enum { TOP_LOANS = sizeof books / sizeof books[0] };
+    unsigned loan_ids[TOP_LOANS] = { 0 };
+
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        Book b;
+        User u;
+        book_init(&b, TOP_ID + i, "Top", "Test", 2020, 1);
+        user_init(&u, TOP_ID + i, "Top", "top@example.com");
+        if (db_add_book(db, &b) != 0 || db_add_user(db, &u) != 0)
+            return 1;
+    }
+    for (unsigned i = 0; i < TOP_LOANS; ++i)
+    {
+        Loan l;
+        loan_init(&l, 0, TOP_ID + users[i], TOP_ID + books[i], dates[i], 19920101);
+        if (db_add_loan_auto(db, &l) != 0)
+            return 1;
+        loan_ids[i] = l.id;
+    }
+
+    int rc = 0;
+    IdCount top[8];
+    size_t n = 0;
+
+    const unsigned book_ids[] = { TOP_ID + 2, TOP_ID, TOP_ID + 1 };
+    const unsigned book_counts[] = { 3, 2, 2 };
+    if (db_top_books(db, 8, 19900101, 19901231, top, &n) != 0 ||
+        !top_is(top, n, book_ids, book_counts, 3) ||
+        db_top_books(db, 2, 19900101, 19901231, top, &n) != 0 ||
+        !top_is(top, n, book_ids, book_counts, 2) ||
+        db_top_books(db, 8, 19800101, 19800102, top, &n) != 0 || n != 0)
+    {
+        printf("Top: book ranking in a window is wrong\n");
+        rc = 1;
+    }
+
+    const unsigned user_ids[] = { TOP_ID + 2, TOP_ID + 1, TOP_ID };
+    const unsigned user_counts[] = { 4, 2, 1 };
+    if (rc == 0 && (db_top_users(db, 3, 19900101, 19901231, top, &n) != 0 ||
+                    !top_is(top, n, user_ids, user_counts, 3)))
+    {
+        printf("Top: user ranking in a window is wrong\n");
+        rc = 1;
+    }
+
+    /* All time: sorted, and every count is the book's maintained counter. */
+    static IdCount all[4096];
+    if (rc == 0 && db_top_books(db, 4096, 0, 0, all, &n) != 0)
+        rc = 1;
+    for (size_t i = 0; rc == 0 && i < n; ++i)
+    {
+        if (all[i].count != db_book_loans(db, all[i].id) ||
+            (i > 0 && (all[i - 1].count < all[i].count ||
+                       (all[i - 1].count == all[i].count && all[i - 1].id > all[i].id))))
+        {
+            printf("Top: all-time ranking disagrees with the counters\n");
+            rc = 1;
+        }
+    }
+
+    for (unsigned i = 0; i < TOP_LOANS; ++i)
+        db_remove_loan(db, loan_ids[i]);
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        db_remove_book(db, TOP_ID + i);
+        db_remove_user(db, TOP_ID + i);
+    }
+
+    if (rc == 0)
+        printf("Top: windowed and all-time rankings are right (%zu books ranked).\n", n);
+    return rc;
+}
+
+/*
+   Recommendations: co-borrowing counts distinct users, the per-user
+   history cap keeps only the newest books, and a pooled build gives
+   the same neighbors as one on the calling thread.
+*/
+#define REC_ID 94000
+
+static int neighbors_are(DB *db, unsigned book, const unsigned *books, const unsigned *shared,
+                         size_t expected)
+{
+    IdCount similar[8];
+    size_t got = 0;
+    if (db_recommend_for_book(db, REC_ID + book, 8, similar, &got) != 0 || got != expected)
+        return 0;
+    for (size_t i = 0; i < got; ++i)
+        if (similar[i].id != REC_ID + books[i] || similar[i].count != shared[i])
+            return 0;
+    return 1;
+}
+
+static int test_recommendations(DB *db)
+{
+    /* User 0: books 0, 1, 2 (newest last); user 1: book 0 twice, then 1; user 2: 0 and 3; user 3: 4 alone. */
+    static const unsigned users[] = { 0, 0, 0, 1, 1, 1, 2, 2, 3 };
+    static const unsigned books[] = { 0, 1, 2, 0, 0, 1, 0, 3, 4 };
+    enum { REC_LOANS = sizeof users / sizeof users[0] };
+    unsigned loan_ids[REC_LOANS] = { 0 };
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        Book b;
+        User u;
+        book_init(&b, REC_ID + i, "Rec", "Test", 2020, 1);
+        user_init(&u, REC_ID + i, "Rec", "rec@example.com");
+        if (db_add_book(db, &b) != 0 || db_add_user(db, &u) != 0)
+            return 1;
+    }
+    for (unsigned i = 0; i < REC_LOANS; ++i)
+    {
+        Loan l;
+        loan_init(&l, 0, REC_ID + users[i], REC_ID + books[i], 20200101 + i, 20200201);
+        if (db_add_loan_auto(db, &l) != 0)
+            return 1;
+        loan_ids[i] = l.id;
+    }
+
+    int rc = 0;
+    size_t got = 1;
+    IdCount similar[1];
+    const unsigned all_books[] = { 1, 2, 3 }, all_shared[] = { 2, 1, 1 };
+    const unsigned one_books[] = { 0, 2 }, one_shared[] = { 2, 1 };
+    if (db_has_recommendations(db) ||
+        db_recommend_for_book(db, REC_ID, 1, similar, &got) != 0 || got != 0 ||
+        db_build_recommendations(db, NULL, NULL) != 0 || !db_has_recommendations(db) ||
+        !neighbors_are(db, 0, all_books, all_shared, 3) ||
+        !neighbors_are(db, 1, one_books, one_shared, 2) ||
+        !neighbors_are(db, 4, NULL, NULL, 0) ||
+        db_recommend_for_book(db, REC_ID, 1, similar, &got) != 0 || got != 1 ||
+        similar[0].id != REC_ID + 1)
+    {
+        printf("Recommendations: co-borrowing counts are wrong\n");
+        rc = 1;
+    }
+
+    /* Two books per user: user 0 forgets book 0. */
+    RecommendConfig cfg = { .history_cap = 2, .neighbors = 4 };
+    ThreadPool *pool = thread_pool_create(4);
+    const unsigned cap_books[] = { 1, 3 }, cap_shared[] = { 1, 1 };
+    if (rc == 0 && (db_build_recommendations(db, &cfg, pool) != 0 ||
+                    !neighbors_are(db, 0, cap_books, cap_shared, 2)))
+    {
+        printf("Recommendations: history cap or pooled build is wrong\n");
+        rc = 1;
+    }
+    thread_pool_destroy(pool);
+
+    for (unsigned i = 0; i < REC_LOANS; ++i)
+        db_remove_loan(db, loan_ids[i]);
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        db_remove_book(db, REC_ID + i);
+        db_remove_user(db, REC_ID + i);
+    }
+
+    if (rc == 0)
+        printf("Recommendations: neighbors, history cap and pooled build are right.\n");
+    return rc;
+}
+
+/*
+   Near-duplicate titles: case, punctuation and small typos match, an
+   edited title leaves and re-enters the index, removed books and
+   suggestions disappear, and the trigram filter never loses a title
+   that a brute-force comparison of every book would find.
+*/
+#define SIMILAR_ID 93000
+
+static const char *const similar_titles[] = {
+    "Zyxwv Quorlam Dentes",   /* 0: the original */
+    "zyxwv, quorlam dentes!", /* 1: same normalized title */
+    "Zyxwv Quorlan Dentes",   /* 2: one edit */
+    "Dentes Quorlam",         /* 3: too different */
+};
+enum { SIMILAR_BOOKS = sizeof similar_titles / sizeof similar_titles[0] };
+
+struct brute_similar {
+    FuzzyPattern pattern;
+    size_t len;
+    unsigned min;
+    size_t n;
+};
+
+static int brute_similar_visitor(const Book *b, void *ctx)
+{
+    struct brute_similar *c = ctx;
+    char text[FUZZY_MAX_LEN];
+    size_t len = fuzzy_normalize(b->title, text, sizeof text);
+    unsigned d = fuzzy_distance(&c->pattern, text, len, FUZZY_MAX_LEN);
+    if (len > 0 && fuzzy_similarity(d, c->len, len) >= c->min)
+        c->n++;
+    return 0;
+}
+
+/* Same count as a comparison against every book? */
+static int similar_agrees_with_scan(DB *db, const char *title, unsigned min)
+{
+    struct brute_similar c = { .min = min };
+    char text[FUZZY_MAX_LEN];
+    c.len = fuzzy_normalize(title, text, sizeof text);
+    fuzzy_pattern_init(&c.pattern, text, c.len);
+    db_foreach_book(db, brute_similar_visitor, &c);
+
+    size_t cap = c.n + 1, n = 0;
+    TitleMatch *matches = malloc(cap * sizeof *matches);
+    int ok = matches && db_similar_books(db, title, min, matches, cap, &n) == 0 && n == c.n;
+    for (size_t i = 1; ok && i < n; ++i)
+        ok = matches[i - 1].similarity >= matches[i].similarity;
+    free(matches);
+    return ok;
+}
+
+static int test_similar_titles(DB *db)
+{
+    for (unsigned i = 0; i < SIMILAR_BOOKS; ++i)
+    {
+        Book b;
+        book_init(&b, SIMILAR_ID + i, similar_titles[i], "Test", 2020, 1);
+        if (db_add_book(db, &b) != 0)
+            return 1;
+    }
+
+    int rc = 0;
+    TitleMatch m[8];
+    size_t n = 0;
+    if (db_similar_books(db, "ZYXWV QUORLAM DENTES", 90, m, 8, &n) != 0 || n != 3 ||
+        m[0].id != SIMILAR_ID || m[0].similarity != 100 || m[1].id != SIMILAR_ID + 1 ||
+        m[2].id != SIMILAR_ID + 2 || m[2].distance != 1 || m[2].similarity != 95 ||
+        db_similar_books(db, "Zyxwv Quorlam Dentes", 90, m, 1, &n) != 0 || n != 1 ||
+        db_similar_books(db, "Zyxwv", 40, m, 8, &n) == 0)
+    {
+        printf("Similar titles: typos or ranking are wrong\n");
+        rc = 1;
+    }
+
+    /* Edit the typo away from the original and back. */
+    Book b;
+    book_init(&b, SIMILAR_ID + 2, "Outro Livro Qualquer", "Test", 2020, 1);
+    if (rc == 0 && (db_update_book(db, &b) != 0 ||
+                    db_similar_books(db, similar_titles[0], 90, m, 8, &n) != 0 || n != 2))
+    {
+        printf("Similar titles: an edited title is still indexed\n");
+        rc = 1;
+    }
+    book_init(&b, SIMILAR_ID + 2, similar_titles[2], "Test", 2020, 1);
+    db_remove_book(db, SIMILAR_ID + 1);
+    if (rc == 0 && (db_update_book(db, &b) != 0 ||
+                    db_similar_books(db, similar_titles[0], 90, m, 8, &n) != 0 || n != 2 ||
+                    m[1].id != SIMILAR_ID + 2))
+    {
+        printf("Similar titles: remove or re-edit is wrong\n");
+        rc = 1;
+    }
+
+    Suggestion s;
+    suggestion_init(&s, SIMILAR_ID, similar_titles[0], "Test", "");
+    if (rc == 0 && (db_add_suggestion(db, &s) != 0 ||
+                    db_similar_suggestions(db, similar_titles[2], 90, m, 8, &n) != 0 || n != 1 ||
+                    m[0].id != SIMILAR_ID || db_remove_suggestion(db, SIMILAR_ID) != 0 ||
+                    db_similar_suggestions(db, similar_titles[2], 90, m, 8, &n) != 0 || n != 0))
+    {
+        printf("Similar titles: suggestions are not indexed\n");
+        rc = 1;
+    }
+
+    const char *queries[] = { "Zyxwv Quorlan", "Test Book", "Algoritmos", "a" };
+    for (size_t i = 0; rc == 0 && i < sizeof queries / sizeof queries[0]; ++i)
+    {
+        for (unsigned min = 50; rc == 0 && min <= 100; min += 25)
+        {
+            if (!similar_agrees_with_scan(db, queries[i], min))
+            {
+                printf("Similar titles: '%s' at %u%% misses titles a scan finds\n", queries[i], min);
+                rc = 1;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < SIMILAR_BOOKS; ++i)
+        db_remove_book(db, SIMILAR_ID + i);
+
+    if (rc == 0)
+        printf("Similar titles: typos, edits, removals and the trigram filter are right.\n");
+    return rc;
+}
+
+/*
+   Autocomplete: lexical order with case folded, equal titles by id,
+   prefixes ending inside an edge, limits, edits and removals of books
+   and users, then a churn of adds and removals (enough to prune the
+   trie) checked against a sorted scan of the table.
+*/
+#define COMPLETE_ID 92000
+#define COMPLETE_CHURN 600
+
+static const char *const complete_titles[] = {
+    "Qzv Alpha",    /* 0 */
+    "qzv alpha",    /* 1: same key as 0 */
+    "Qzv Alphabet", /* 2 */
+    "Qzv Beta",     /* 3 */
+    "QZV",          /* 4: shortest, first */
+};
+enum { COMPLETE_BOOKS = sizeof complete_titles / sizeof complete_titles[0] };
+
+static int same_ids(const unsigned *got, size_t n, const unsigned *expected, size_t count)
+{
+    if (n != count)
+        return 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (got[i] != expected[i])
+            return 0;
+    }
+    return 1;
+}
+
+struct complete_entry {
+    unsigned id;
+    char title[128];
+};
+
+struct brute_complete {
+    const char *prefix;
+    struct complete_entry *entries;
+    size_t n, cap;
+};
+
+static int starts_with_folded(const char *s, const char *prefix)
+{
+    for (; *prefix; ++s, ++prefix)
+    {
+        char a = (*s >= 'A' && *s <= 'Z') ? (char)(*s - 'A' + 'a') : *s;
+        char b = (*prefix >= 'A' && *prefix <= 'Z') ? (char)(*prefix - 'A' + 'a') : *prefix;
+        if (a != b)
+            return 0;
+    }
+    return 1;
+}
+
+static int brute_complete_visitor(const Book *b, void *ctx)
+{
+    struct brute_complete *c = ctx;
+    if (!starts_with_folded(b->title, c->prefix))
+        return 0;
+    if (c->n == c->cap)
+    {
+        size_t cap = c->cap ? 2 * c->cap : 64;
+        struct complete_entry *entries = realloc(c->entries, cap * sizeof *entries);
+        if (!entries)
+            return 1;
+        c->entries = entries;
+        c->cap = cap;
+    }
+    c->entries[c->n].id = b->id;
+    strcpy(c->entries[c->n].title, b->title);
+    c->n++;
+    return 0;
+}
+
+static int compare_complete(const void *a, const void *b)
+{
+    const struct complete_entry *x = a, *y = b;
+    int c = prefix_index_key_cmp(x->title, y->title);
+    if (c != 0)
+        return c;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+/* Same ids, in the same order, as sorting every matching book? */
+static int complete_agrees_with_scan(DB *db, const char *prefix)
+{
+    struct brute_complete c = { .prefix = prefix };
+    db_foreach_book(db, brute_complete_visitor, &c);
+    if (c.n > 0)
+        qsort(c.entries, c.n, sizeof *c.entries, compare_complete);
+
+    size_t limit = c.n + 1, n = 0;
+    unsigned *ids = malloc(limit * sizeof *ids);
+    int ok = ids && db_autocomplete(db, DB_COMPLETE_TITLE, prefix, limit, ids, &n) == 0 &&
+             n == c.n;
+    for (size_t i = 0; ok && i < n; ++i)
+        ok = ids[i] == c.entries[i].id;
+    free(ids);
+    free(c.entries);
+    return ok;
+}
+
+static int test_autocomplete(DB *db)
+{
+    for (unsigned i = 0; i < COMPLETE_BOOKS; ++i)
+    {
+        Book b;
+        book_init(&b, COMPLETE_ID + i, complete_titles[i], "Qzv Autor", 2020, 1);
+        if (db_add_book(db, &b) != 0)
+            return 1;
+    }
+
+    int rc = 0;
+    unsigned ids[16];
+    size_t n = 0;
+    const unsigned all[] = { COMPLETE_ID + 4, COMPLETE_ID, COMPLETE_ID + 1, COMPLETE_ID + 2,
+                             COMPLETE_ID + 3 };
+    const unsigned alpha[] = { COMPLETE_ID, COMPLETE_ID + 1, COMPLETE_ID + 2 };
+    const unsigned by_id[] = { COMPLETE_ID, COMPLETE_ID + 1, COMPLETE_ID + 2, COMPLETE_ID + 3,
+                               COMPLETE_ID + 4 };
+    if (db_autocomplete(db, DB_COMPLETE_TITLE, "qzv", 16, ids, &n) != 0 || !same_ids(ids, n, all, 5) ||
+        db_autocomplete(db, DB_COMPLETE_TITLE, "QZV", 2, ids, &n) != 0 || !same_ids(ids, n, all, 2) ||
+        db_autocomplete(db, DB_COMPLETE_TITLE, "qZv aL", 16, ids, &n) != 0 ||
+        !same_ids(ids, n, alpha, 3) ||
+        db_autocomplete(db, DB_COMPLETE_TITLE, "qzv alphax", 16, ids, &n) != 0 || n != 0 ||
+        db_autocomplete(db, DB_COMPLETE_AUTHOR, "qzv autor", 16, ids, &n) != 0 ||
+        !same_ids(ids, n, by_id, 5) ||
+        db_autocomplete(db, (DBCompleteField)7, "qzv", 16, ids, &n) == 0)
+    {
+        printf("Autocomplete: order, prefixes or limits are wrong\n");
+        rc = 1;
+    }
+
+    /* Edit a title away and back, remove another. */
+    Book b;
+    book_init(&b, COMPLETE_ID + 3, "Outro Livro", "Qzv Autor", 2020, 1);
+    if (rc == 0 && (db_update_book(db, &b) != 0 ||
+                    db_autocomplete(db, DB_COMPLETE_TITLE, "qzv b", 16, ids, &n) != 0 || n != 0 ||
+                    db_autocomplete(db, DB_COMPLETE_TITLE, "outro livro", 16, ids, &n) != 0 ||
+                    n != 1 || ids[0] != COMPLETE_ID + 3))
+    {
+        printf("Autocomplete: an edited title is still indexed\n");
+        rc = 1;
+    }
+    book_init(&b, COMPLETE_ID + 1, "QZV ALPHA", "Qzv Autor", 2020, 1);
+    if (rc == 0 && (db_update_book(db, &b) != 0 || db_remove_book(db, COMPLETE_ID) != 0 ||
+                    db_autocomplete(db, DB_COMPLETE_TITLE, "qzv alpha", 16, ids, &n) != 0 ||
+                    !same_ids(ids, n, alpha + 1, 2)))
+    {
+        printf("Autocomplete: a recased title or a removal is wrong\n");
+        rc = 1;
+    }
+
+    User u;
+    user_init(&u, COMPLETE_ID, "Qzv Leitora", "qzv@example.com");
+    User v;
+    user_init(&v, COMPLETE_ID + 1, "Qzv Leitor", "qzv@example.com");
+    const unsigned readers[] = { COMPLETE_ID + 1, COMPLETE_ID };
+    if (rc == 0 && (db_add_user(db, &u) != 0 || db_add_user(db, &v) != 0 ||
+                    db_autocomplete(db, DB_COMPLETE_USER_NAME, "qzv leit", 16, ids, &n) != 0 ||
+                    !same_ids(ids, n, readers, 2) || db_remove_user(db, COMPLETE_ID + 1) != 0 ||
+                    db_autocomplete(db, DB_COMPLETE_USER_NAME, "qzv leit", 16, ids, &n) != 0 ||
+                    !same_ids(ids, n, readers + 1, 1)))
+    {
+        printf("Autocomplete: user names are not indexed\n");
+        rc = 1;
+    }
+    db_remove_user(db, COMPLETE_ID);
+
+    /* Churn: most of the books come and go, the rest are renamed. */
+    srand(50);
+    for (unsigned i = 0; rc == 0 && i < COMPLETE_CHURN; ++i)
+    {
+        char title[64];
+        snprintf(title, sizeof title, "Qzv %c%c Churn %u", 'a' + rand() % 4, 'a' + rand() % 4,
+                 (unsigned)rand() % 50);
+        book_init(&b, COMPLETE_ID + 100 + i, title, "Qzv Autor", 2020, 1);
+        if (db_add_book(db, &b) != 0)
+            rc = 1;
+        if (i % 3 == 0)
+        {
+            snprintf(title, sizeof title, "Qzv %c Renamed", 'a' + rand() % 4);
+            book_init(&b, COMPLETE_ID + 100 + i / 2, title, "Qzv Autor", 2020, 1);
+            db_update_book(db, &b);
+        }
+        if (i % 4 != 0)
+            db_remove_book(db, COMPLETE_ID + 100 + (unsigned)rand() % (i + 1));
+    }
+
+    const char *prefixes[] = { "qzv", "QZV A", "qzv ab churn 1", "qzv c r", "", "t" };
+    for (size_t i = 0; rc == 0 && i < sizeof prefixes / sizeof prefixes[0]; ++i)
+    {
+        if (!complete_agrees_with_scan(db, prefixes[i]))
+        {
+            printf("Autocomplete: '%s' disagrees with a sorted scan\n", prefixes[i]);
+            rc = 1;
+        }
+    }
+
+    for (unsigned i = 0; i < COMPLETE_BOOKS; ++i)
+        db_remove_book(db, COMPLETE_ID + i);
+    for (unsigned i = 0; i < COMPLETE_CHURN; ++i)
+        db_remove_book(db, COMPLETE_ID + 100 + i);
+    if (rc == 0 && (db_autocomplete(db, DB_COMPLETE_TITLE, "qzv", 16, ids, &n) != 0 || n != 0))
+    {
+        printf("Autocomplete: removed books are still listed\n");
+        rc = 1;
+    }
+
+    if (rc == 0)
+        printf("Autocomplete: order, edits, removals and churn agree with a sorted scan.\n");
+    return rc;
+}
+
+/*
+   Loan column store: adds, updates and removes a batch of loans, then
+   checks every scan kernel the CPU supports against a plain
+   db_foreach_loan filter, for counts and for the selected ids.
+*/
+#define COLUMN_FIRST_ID 80000
+#define COLUMN_LOANS 1000
+
+struct filter_ctx {
+    const LoanFilter *f;
+    size_t n;
+    size_t returned;
+    uint64_t days;
+    unsigned char seen[COLUMN_LOANS];
+};
+
+static int loan_matches(const Loan *l, const LoanFilter *f)
+{
+    return l->date_borrow >= f->borrow_from &&
+           (f->borrow_to == 0 || l->date_borrow <= f->borrow_to) &&
+           (!f->active_only || l->date_return == 0) &&
+           (f->book_id == 0 || l->book_id == f->book_id);
+}
+
+static int reference_filter(const Loan *l, void *c)
+{
+    struct filter_ctx *ctx = c;
+    if (!loan_matches(l, ctx->f))
+        return 0;
+    ctx->n++;
+    if (l->date_return != 0 && l->date_return >= l->date_borrow)
+    {
+        ctx->returned++;
+        ctx->days += loan_return_day(l) - loan_borrow_day(l);
+    }
+    if (l->id >= COLUMN_FIRST_ID && l->id < COLUMN_FIRST_ID + COLUMN_LOANS)
+        ctx->seen[l->id - COLUMN_FIRST_ID] = 1;
+    return 0;
+}
+
+static int test_loan_columns(DB *db)
+{
+    static const LoanFilter filters[] = {
+        { 0, 0, false, 0 },
+        { 0, 0, true, 0 },
+        { 20230101, 20230630, false, 0 },
+        { 20230301, 0, true, 0 },
+        { 0, 20230415, true, 7 },
+        { 20231231, 20230101, false, 0 },  /* empty range */
+        { 20230200, 20230431, false, 0 },  /* bounds that are not dates */
+        { 20230132, 20230299, true, 0 },
+        { 0, 0, false, 424242 }            /* no such book */
+    };
+    static const LoanKernel kernels[] = {
+        LOAN_KERNEL_SCALAR, LOAN_KERNEL_SSE2, LOAN_KERNEL_AVX2
+    };
+    static unsigned ids[COLUMN_LOANS + 4096];
+    static struct filter_ctx ref;
+    int rc = 0, kernels_run = 0;
+
+    srand(4242);
+    for (unsigned i = 0; i < COLUMN_LOANS; ++i)
+    {
+        Loan l;
+        Date day = date_from_ymd(2023, 1, 1) + (unsigned)(rand() % 365);
+        loan_init(&l, COLUMN_FIRST_ID + i, 1 + (unsigned)(rand() % 50),
+                  1 + (unsigned)(rand() % 20), date_to_yyyymmdd(day),
+                  rand() % 3 ? 0 : date_to_yyyymmdd(day + (unsigned)(rand() % 40)));
+        if (db_add_loan(db, &l) != 0)
+            return 1;
+    }
+
+    /* Return every 7th loan, drop every 5th: exercises overwrite and row moves. */
+    for (unsigned i = 0; i < COLUMN_LOANS; i += 7)
+    {
+        Loan l;
+        if (db_copy_loan_by_id(db, COLUMN_FIRST_ID + i, &l) == 0)
+        {
+            l.date_return = date_to_yyyymmdd(loan_borrow_day(&l) + 1);
+            db_update_loan(db, &l);
+        }
+    }
+    for (unsigned i = 0; i < COLUMN_LOANS; i += 5)
+        db_remove_loan(db, COLUMN_FIRST_ID + i);
+
+    for (size_t k = 0; k < sizeof kernels / sizeof kernels[0] && rc == 0; ++k)
+    {
+        if (loan_columns_set_kernel(kernels[k]) != 0)
+            continue;
+        ++kernels_run;
+
+        for (size_t i = 0; i < sizeof filters / sizeof filters[0] && rc == 0; ++i)
+        {
+            memset(&ref, 0, sizeof ref);
+            ref.f = &filters[i];
+            db_foreach_loan(db, reference_filter, &ref);
+
+            size_t count = 0, selected = 0, returned = 0;
+            uint64_t days = 0;
+            if (db_loans_count(db, &filters[i], &count) != 0 ||
+                db_loans_select(db, &filters[i], ids, sizeof ids / sizeof ids[0], &selected) != 0 ||
+                db_loans_days_out(db, &filters[i], &returned, &days) != 0 ||
+                count != ref.n || selected != ref.n || returned != ref.returned || days != ref.days)
+            {
+                printf("Columns (%s): filter %zu counted %zu/%zu, expected %zu\n",
+                       loan_columns_kernel_name(), i, count, selected, ref.n);
+                rc = 1;
+                break;
+            }
+
+            for (size_t j = 0; j < selected && j < sizeof ids / sizeof ids[0]; ++j)
+            {
+                unsigned id = ids[j];
+                if (id >= COLUMN_FIRST_ID && id < COLUMN_FIRST_ID + COLUMN_LOANS)
+                {
+                    if (ref.seen[id - COLUMN_FIRST_ID] != 1)
+                        rc = 1;
+                    ref.seen[id - COLUMN_FIRST_ID] = 2;
+                }
+            }
+            for (size_t j = 0; j < COLUMN_LOANS; ++j)
+                if (ref.seen[j] == 1)
+                    rc = 1;
+            if (rc != 0)
+                printf("Columns (%s): filter %zu selected the wrong ids\n",
+                       loan_columns_kernel_name(), i);
+        }
+
+        /* A short buffer still reports the full count. */
+        size_t total = 0;
+        if (rc == 0 && (db_loans_select(db, &filters[0], ids, 3, &total) != 0 ||
+                        total != dlist_size(db->loans)))
+        {
+            printf("Columns: truncated select lost the total\n");
+            rc = 1;
+        }
+    }
+    loan_columns_set_kernel(LOAN_KERNEL_AUTO);
+
+    for (unsigned i = 0; i < COLUMN_LOANS; ++i)
+        db_remove_loan(db, COLUMN_FIRST_ID + i);
+
+    size_t left = 0;
+    LoanFilter all = { 0 };
+    db_loans_count(db, &all, &left);
+    if (rc == 0 && (left != dlist_size(db->loans) || kernels_run == 0))
+        rc = 1;
+
+    if (rc == 0)
+        printf("Columns: %d scan kernel(s) match db_foreach_loan (using %s).\n",
+               kernels_run, loan_columns_kernel_name());
+    return rc;
+}
+
+/*
+   Workload recording round trip: the calls made while recording must
+   read back in order with their arguments, and the CSV of an added
+   record must parse back into the same record.
+*/
+static int count_visit(const Book *b, void *ctx)
+{
+    (void)b;
+    ++*(unsigned *)ctx;
+    return 0;
+}
+
+static int test_record(DB *db)
+{
+    const char *path = "data/workload_test.bin";
+    unsigned visited = 0;
+
+    if (db_record_start(path) != 0)
+    {
+        printf("Record: could not create %s\n", path);
+        return 1;
+    }
+
+    Book b;
+    book_init(&b, 0, "Recorded", "Replay", 2024, 1);
+    db_find_book_by_id(db, 42);
+    db_add_book_auto(db, &b);
+    db_search_books(db, DB_BOOK_AUTHOR, "replay", count_visit, &visited);
+    db_remove_book(db, b.id);
+    db_foreach_loan(db, NULL, NULL); /* rejected before recording */
+
+    if (db_record_stop() != 0)
+        return 1;
+
+    static const DBOp expected[] = {
+        DB_OP_FIND_BOOK, DB_OP_ADD_BOOK, DB_OP_SEARCH_BOOKS, DB_OP_REMOVE_BOOK
+    };
+    static DBRecordEntry e;
+    uint64_t clock_us = 0;
+    size_t n = 0;
+    int status = 0, rc = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f || db_record_read_header(f) != 0)
+        rc = 1;
+
+    while (rc == 0 && (status = db_record_read(f, &clock_us, &e)) == 1)
+    {
+        Book parsed;
+        if (n >= sizeof expected / sizeof expected[0] || e.op != expected[n])
+            rc = 1;
+        else if (n == 0 && e.id != 42)
+            rc = 1;
+        else if (n == 1 && (!e.auto_id || !book_from_csv(&parsed, e.text) ||
+                            strcmp(parsed.title, "Recorded") != 0 || parsed.year != 2024))
+            rc = 1;
+        else if (n == 2 && (e.field != DB_BOOK_AUTHOR || strcmp(e.text, "replay") != 0))
+            rc = 1;
+        else if (n == 3 && e.id != b.id)
+            rc = 1;
+        ++n;
+    }
+    if (rc == 0 && (status != 0 || n != sizeof expected / sizeof expected[0]))
+        rc = 1;
+
+    if (f)
+        fclose(f);
+    remove(path);
+
+    if (rc != 0)
+    {
+        printf("Record: entry %zu did not read back as recorded\n", n);
+        return 1;
+    }
+
+    printf("Record: %zu operations recorded and read back.\n", n);
+    return 0;
+}
+
+/*
+   A file that repeats an id loads the first copy only: the list, the
+   year index and the totals agree with the id index.
+*/
+static int test_duplicate_ids(void)
+{
+    const char *path = "data/duplicate_books_test.txt";
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return 1;
+    fputs("id;title;author;year;available\n"
+          "1;First;Author;1990;2\n"
+          "2;Other;Author;1991;1\n"
+          "1;Second;Author;1992;5\n", f);
+    fclose(f);
+
+    DB dup;
+    int rc = db_init(&dup, path, "data/missing_test.txt", "data/missing_test.txt",
+                     "data/missing_test.txt");
+    remove(path);
+    if (rc != 0)
+        return 1;
+
+    DBTotals t;
+    Book b;
+    unsigned in_years = 0;
+    if (db_totals(&dup, &t) != 0 || t.books != 2 || t.copies_available != 3 ||
+        db_check_totals(&dup) != 0 ||
+        db_books_by_year_range(&dup, 1900, 2100, count_visit, &in_years) != 0 || in_years != 2 ||
+        db_copy_book_by_id(&dup, 1, &b) != 0 || strcmp(b.title, "First") != 0)
+    {
+        printf("Duplicate ids: %zu books, %lld copies, %u by year\n",
+               t.books, t.copies_available, in_years);
+        rc = 1;
+    }
+    db_destroy(&dup);
+
+    if (rc == 0)
+        printf("Duplicate ids: later copies are dropped at load.\n");
+    return rc;
+}
+
+/* Saving a DB whose load failed leaves the files alone instead of crashing. */
+static int test_save_unloaded(void)
+{
+    const char *path = "data/unloaded_test.txt";
+    const char *content = "kept\n";
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return 1;
+    fputs(content, f);
+    fclose(f);
+
+    DB unloaded;
+    memset(&unloaded, 0, sizeof unloaded); /* what a failed db_init leaves */
+    DBTimings t;
+    memset(&t, 0xff, sizeof t);
+    int rc = db_save_timed(&unloaded, path, path, path, path, &t);
+
+    char buf[32] = "";
+    f = fopen(path, "r");
+    if (f)
+    {
+        if (!fgets(buf, sizeof buf, f))
+            buf[0] = '\0';
+        fclose(f);
+    }
+    remove(path);
+
+    if (rc != -1 || strcmp(buf, content) != 0)
+    {
+        printf("Save unloaded: rc=%d, file now '%s'\n", rc, buf);
+        return 1;
+    }
+    for (int i = 0; i < DB_TABLE_COUNT; ++i)
+        if (t.save[i].rows != 0)
+        {
+            printf("Save unloaded: %s reports %zu rows\n", db_table_name(i), t.save[i].rows);
+            return 1;
+        }
+
+    printf("Save unloaded: tables that never loaded are skipped.\n");
+    return 0;
+}
+
 int main(void)
 {
     const char *books_path = "data/books_test.txt";
@@ -54,6 +1997,22 @@ int main(void)
 
     print_db_summary(&db);
 
+    /* Memory first: concurrent mode leaves retired records in the epoch. */
+    if (test_memory(&db) != 0 || test_ranges(&db) != 0 || test_pages(&db) != 0 ||
+        test_loan_columns(&db) != 0 || test_due_dates(&db) != 0 ||
+        test_far_due_dates(&db) != 0 ||
+        test_circulation(&db) != 0 || test_reservations(&db) != 0 ||
+        test_totals(&db) != 0 || test_top(&db) != 0 ||
+        test_recommendations(&db) != 0 || test_similar_titles(&db) != 0 ||
+        test_autocomplete(&db) != 0 ||
+        test_concurrent_mode(&db) != 0 ||
+        test_stats(&db) != 0 || test_record(&db) != 0 ||
+        test_duplicate_ids() != 0 || test_save_unloaded() != 0)
+    {
+        db_destroy(&db);
+        return 1;
+    }
+
     /* Persist any changes back to disk */
     if (db_save(&db, books_path, users_path, loans_path, suggestions_path) != 0)
         printf("db_save reported an error.\n");
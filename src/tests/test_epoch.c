@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "lib/epoch/epoch.h"
+
+/*
+    Epoch reclamation tests:
+      - with no reader around, retired objects are freed within a few
+        collections and epoch_pending follows them;
+      - an object retired while a reader (another thread, or a nested
+        section) is inside is not freed until that reader leaves;
+      - epoch_thread_exit gives the slot back, so more threads than
+        EPOCH_MAX_THREADS can use a domain one after the other;
+      - readers chasing a pointer that a writer keeps swapping and
+        retiring never see a freed node (run it under
+        -fsanitize=address or thread to catch any early free).
+*/
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+#define STRESS_READERS 4
+#define STRESS_SWAPS 20000
+
+#define NODE_LIVE 0x11FE11FEu
+#define NODE_DEAD 0xDEADDEADu
+
+typedef struct {
+    unsigned magic;
+    unsigned value;
+} Node;
+
+static atomic_uint freed;
+
+static Node *node_new(unsigned value)
+{
+    Node *n = malloc(sizeof *n);
+    if (n)
+    {
+        n->magic = NODE_LIVE;
+        n->value = value;
+    }
+    return n;
+}
+
+/* Poisons the node first, so a reader that gets to it late notices even without a sanitizer. */
+static void node_free(void *p)
+{
+    Node *n = p;
+    n->magic = NODE_DEAD;
+    free(n);
+    atomic_fetch_add(&freed, 1);
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void collect_times(EpochDomain *d, int n)
+{
+    while (n-- > 0)
+        epoch_collect(d);
+}
+
+static void test_no_readers(void)
+{
+    EpochDomain *d = epoch_create();
+    CHECK(d != NULL, "create");
+    if (!d)
+        return;
+
+    atomic_store(&freed, 0);
+    for (unsigned i = 0; i < 3; ++i)
+        epoch_retire(d, node_new(i), node_free);
+    CHECK(epoch_pending(d) == 3, "retired objects are pending");
+
+    collect_times(d, 3);
+    CHECK(epoch_pending(d) == 0, "pending after collections with no reader");
+    CHECK(atomic_load(&freed) == 3, "every retired object was freed");
+
+    /* Many retires trigger collections on their own. */
+    for (unsigned i = 0; i < 1000; ++i)
+        epoch_retire(d, node_new(i), node_free);
+    CHECK(epoch_pending(d) < 1000, "retire never collects by itself");
+
+    epoch_destroy(d);
+    CHECK(atomic_load(&freed) == 1003, "destroy frees what is still pending");
+}
+
+struct pin_args {
+    EpochDomain *d;
+    atomic_bool inside;
+    atomic_bool release;
+};
+
+static void *pinning_reader(void *p)
+{
+    struct pin_args *a = p;
+    epoch_enter(a->d);
+    atomic_store(&a->inside, true);
+    while (!atomic_load(&a->release))
+        sleep_ms(1);
+    epoch_exit(a->d);
+    epoch_thread_exit(a->d);
+    return NULL;
+}
+
+static void test_reader_pins(void)
+{
+    struct pin_args a;
+    a.d = epoch_create();
+    CHECK(a.d != NULL, "create");
+    if (!a.d)
+        return;
+    atomic_init(&a.inside, false);
+    atomic_init(&a.release, false);
+    atomic_store(&freed, 0);
+
+    pthread_t reader;
+    pthread_create(&reader, NULL, pinning_reader, &a);
+    while (!atomic_load(&a.inside))
+        sleep_ms(1);
+
+    epoch_retire(a.d, node_new(1), node_free);
+    collect_times(a.d, 10);
+    CHECK(atomic_load(&freed) == 0, "freed while another thread was reading");
+
+    atomic_store(&a.release, true);
+    pthread_join(reader, NULL);
+    collect_times(a.d, 3);
+    CHECK(atomic_load(&freed) == 1, "not freed once the reader left");
+
+    /* Only the outermost exit of a nested section lets go. */
+    epoch_enter(a.d);
+    epoch_enter(a.d);
+    epoch_exit(a.d);
+    epoch_retire(a.d, node_new(2), node_free);
+    collect_times(a.d, 10);
+    CHECK(atomic_load(&freed) == 1, "freed inside a nested section");
+    epoch_exit(a.d);
+    collect_times(a.d, 3);
+    CHECK(atomic_load(&freed) == 2, "not freed after the outermost exit");
+
+    epoch_thread_exit(a.d);
+    epoch_destroy(a.d);
+}
+
+static void *short_lived(void *p)
+{
+    EpochDomain *d = p;
+    epoch_enter(d);
+    epoch_exit(d);
+    epoch_thread_exit(d);
+    return NULL;
+}
+
+static void test_slot_reuse(void)
+{
+    EpochDomain *d = epoch_create();
+    CHECK(d != NULL, "create");
+    if (!d)
+        return;
+
+    /* Would abort with "More than N threads" if slots were not given back. */
+    for (unsigned i = 0; i < 2 * EPOCH_MAX_THREADS; ++i)
+    {
+        pthread_t t;
+        pthread_create(&t, NULL, short_lived, d);
+        pthread_join(t, NULL);
+    }
+    epoch_destroy(d);
+}
+
+struct stress {
+    EpochDomain *d;
+    _Atomic(Node *) current;
+    atomic_bool done;
+    atomic_uint bad;
+    atomic_ulong reads;
+};
+
+static void *stress_reader(void *p)
+{
+    struct stress *s = p;
+    unsigned long reads = 0;
+    unsigned last = 0;
+    while (!atomic_load(&s->done))
+    {
+        epoch_enter(s->d);
+        const Node *n = atomic_load(&s->current);
+        if (n->magic != NODE_LIVE || n->value < last)
+            atomic_fetch_add(&s->bad, 1);
+        last = n->value;
+        epoch_exit(s->d);
+        ++reads;
+    }
+    atomic_fetch_add(&s->reads, reads);
+    epoch_thread_exit(s->d);
+    return NULL;
+}
+
+static void test_stress(void)
+{
+    struct stress s;
+    s.d = epoch_create();
+    CHECK(s.d != NULL, "create");
+    if (!s.d)
+        return;
+    atomic_init(&s.current, node_new(0));
+    atomic_init(&s.done, false);
+    atomic_init(&s.bad, 0);
+    atomic_init(&s.reads, 0);
+    atomic_store(&freed, 0);
+
+    pthread_t readers[STRESS_READERS];
+    for (unsigned t = 0; t < STRESS_READERS; ++t)
+        pthread_create(&readers[t], NULL, stress_reader, &s);
+
+    /* The writer: publish a new node, then retire the one it replaced. */
+    for (unsigned i = 1; i <= STRESS_SWAPS; ++i)
+    {
+        Node *old = atomic_exchange(&s.current, node_new(i));
+        epoch_retire(s.d, old, node_free);
+    }
+
+    atomic_store(&s.done, true);
+    for (unsigned t = 0; t < STRESS_READERS; ++t)
+        pthread_join(readers[t], NULL);
+
+    CHECK(atomic_load(&s.bad) == 0, "a reader saw a freed or stale node");
+    CHECK(atomic_load(&freed) > 0, "nothing was reclaimed while readers ran");
+
+    epoch_destroy(s.d);
+    CHECK(atomic_load(&freed) == STRESS_SWAPS, "a retired node was lost");
+    node_free(atomic_load(&s.current));
+
+    printf("Stress: %lu lock-free reads by %d readers over %d swaps.\n",
+           atomic_load(&s.reads), STRESS_READERS, STRESS_SWAPS);
+}
+
+int main(void)
+{
+    printf("== Epoch Test ==\n");
+
+    test_no_readers();
+    test_reader_pins();
+    test_slot_reuse();
+    test_stress();
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
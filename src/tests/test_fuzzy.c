@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lib/fuzzy/fuzzy.h"
+
+/*
+    Fuzzy matching tests:
+      - normalization folds case, punctuation and spacing;
+      - the bit-parallel distance agrees with the textbook DP on random
+        strings, across the 64-character word boundary, and reports
+        max + 1 exactly when the distance is above max;
+      - strings within k edits share at least (distinct trigrams - 3k)
+        trigrams, the bound the title index prunes with.
+*/
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+#define ROUNDS 3000
+
+static unsigned dp_distance(const char *a, size_t m, const char *b, size_t n)
+{
+    unsigned row[FUZZY_MAX_LEN + 1];
+    for (size_t i = 0; i <= m; ++i)
+        row[i] = (unsigned)i;
+
+    for (size_t j = 1; j <= n; ++j)
+    {
+        unsigned diag = row[0];
+        row[0] = (unsigned)j;
+        for (size_t i = 1; i <= m; ++i)
+        {
+            unsigned up = row[i];
+            unsigned best = diag + (a[i - 1] != b[j - 1]);
+            if (up + 1 < best)
+                best = up + 1;
+            if (row[i - 1] + 1 < best)
+                best = row[i - 1] + 1;
+            row[i] = best;
+            diag = up;
+        }
+    }
+    return row[m];
+}
+
+/* Small alphabets make long matching runs, the interesting case for the carries. */
+static size_t random_string(char *out, size_t max_len, unsigned alphabet)
+{
+    size_t len = (size_t)rand() % (max_len + 1);
+    for (size_t i = 0; i < len; ++i)
+        out[i] = (char)('a' + rand() % (int)alphabet);
+    out[len] = '\0';
+    return len;
+}
+
+/* Applies k random edits (substitution, insertion or deletion) to s. */
+static size_t random_edits(char *s, size_t len, size_t max_len, unsigned k)
+{
+    for (unsigned e = 0; e < k; ++e)
+    {
+        int kind = rand() % 3;
+        if (kind == 1 && len < max_len)
+        {
+            size_t at = (size_t)rand() % (len + 1);
+            memmove(s + at + 1, s + at, len - at + 1);
+            s[at] = (char)('a' + rand() % 26);
+            ++len;
+        }
+        else if (kind == 2 && len > 0)
+        {
+            size_t at = (size_t)rand() % len;
+            memmove(s + at, s + at + 1, len - at);
+            --len;
+        }
+        else if (len > 0)
+        {
+            s[(size_t)rand() % len] = (char)('a' + rand() % 26);
+        }
+    }
+    return len;
+}
+
+static void test_normalize(void)
+{
+    char out[FUZZY_MAX_LEN];
+
+    CHECK(fuzzy_normalize("  O Senhor dos   Aneis!! ", out, sizeof out) == 18 &&
+          strcmp(out, "o senhor dos aneis") == 0, "case, punctuation and spaces are folded");
+    CHECK(fuzzy_normalize("C++: 2a Edicao", out, sizeof out) == 11 &&
+          strcmp(out, "c 2a edicao") == 0, "symbols split words");
+    CHECK(fuzzy_normalize("...", out, sizeof out) == 0 && out[0] == '\0', "nothing left");
+    CHECK(fuzzy_normalize("abcdef", out, 4) == 3 && strcmp(out, "abc") == 0, "output is truncated");
+    CHECK(fuzzy_normalize("ab cd", out, 4) == 2 && strcmp(out, "ab") == 0,
+          "no trailing space when truncated");
+}
+
+static void test_distance(void)
+{
+    char a[FUZZY_MAX_LEN + 1], b[FUZZY_MAX_LEN + 1];
+    FuzzyPattern p;
+
+    CHECK(fuzzy_pattern_init(&p, "kitten", 6) == 0 && fuzzy_distance(&p, "sitting", 7, 10) == 3,
+          "kitten -> sitting is 3");
+    CHECK(fuzzy_distance(&p, "sitting", 7, 2) == 3, "above max reports max + 1");
+    CHECK(fuzzy_pattern_init(&p, "", 0) == 0 && fuzzy_distance(&p, "abc", 3, 5) == 3,
+          "empty pattern costs the text length");
+
+    memset(a, 'x', FUZZY_MAX_LEN + 1);
+    CHECK(fuzzy_pattern_init(&p, a, FUZZY_MAX_LEN + 1) != 0, "patterns longer than the max are refused");
+
+    int mismatches = 0, cutoffs = 0;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        unsigned alphabet = round % 3 == 0 ? 2 : round % 3 == 1 ? 4 : 26;
+        size_t m = random_string(a, FUZZY_MAX_LEN, alphabet);
+        size_t n;
+        if (round % 2)
+        {
+            memcpy(b, a, m + 1);
+            n = random_edits(b, m, FUZZY_MAX_LEN, (unsigned)(rand() % 8));
+        }
+        else
+        {
+            n = random_string(b, FUZZY_MAX_LEN, alphabet);
+        }
+
+        unsigned expected = dp_distance(a, m, b, n);
+        fuzzy_pattern_init(&p, a, m);
+        if (fuzzy_distance(&p, b, n, FUZZY_MAX_LEN) != expected)
+            mismatches++;
+
+        unsigned max = (unsigned)(rand() % 12);
+        unsigned got = fuzzy_distance(&p, b, n, max);
+        if (got != (expected <= max ? expected : max + 1))
+            cutoffs++;
+    }
+    CHECK(mismatches == 0, "distance agrees with the DP");
+    CHECK(cutoffs == 0, "bounded distance agrees with the DP");
+}
+
+static size_t shared_count(const uint32_t *x, size_t nx, const uint32_t *y, size_t ny)
+{
+    size_t i = 0, j = 0, shared = 0;
+    while (i < nx && j < ny)
+    {
+        if (x[i] == y[j])
+        {
+            ++shared;
+            ++i;
+            ++j;
+        }
+        else if (x[i] < y[j])
+            ++i;
+        else
+            ++j;
+    }
+    return shared;
+}
+
+static void test_trigrams(void)
+{
+    uint32_t g[FUZZY_MAX_LEN], h[FUZZY_MAX_LEN];
+
+    CHECK(fuzzy_trigrams("ab", 2, g, FUZZY_MAX_LEN) == 2, "two trigrams for two characters");
+    CHECK(fuzzy_trigrams("aaaa", 4, g, FUZZY_MAX_LEN) == 3, "repeated trigrams count once");
+    CHECK(fuzzy_trigrams("", 0, g, FUZZY_MAX_LEN) == 0, "no trigrams for an empty string");
+
+    char a[FUZZY_MAX_LEN + 1], b[FUZZY_MAX_LEN + 1];
+    int broken = 0;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        size_t m = random_string(a, FUZZY_MAX_LEN - 8, 6);
+        memcpy(b, a, m + 1);
+        unsigned k = (unsigned)(rand() % 6);
+        size_t n = random_edits(b, m, FUZZY_MAX_LEN, k);
+
+        size_t na = fuzzy_trigrams(a, m, g, FUZZY_MAX_LEN);
+        size_t nb = fuzzy_trigrams(b, n, h, FUZZY_MAX_LEN);
+        unsigned d = dp_distance(a, m, b, n);
+        if (shared_count(g, na, h, nb) + 3 * d < na)
+            broken++;
+    }
+    CHECK(broken == 0, "k edits lose at most 3k trigrams");
+}
+
+static void test_similarity(void)
+{
+    CHECK(fuzzy_similarity(0, 0, 0) == 100, "two empty strings are equal");
+    CHECK(fuzzy_similarity(1, 10, 9) == 90, "one edit in ten is 90%");
+    CHECK(fuzzy_similarity(12, 10, 4) == 0, "never below zero");
+}
+
+int main(void)
+{
+    printf("== Fuzzy Test ==\n");
+    srand(49);
+
+    test_normalize();
+    test_distance();
+    test_trigrams();
+    test_similarity();
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
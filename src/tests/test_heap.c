@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lib/heap/heap.h"
+#include "lib/cutils/aed_alloc.h"
+
+/*
+    Binary heap tests:
+      - random pushes come out in priority order, FIFO among equals;
+      - interleaved pushes and pops agree with a brute-force minimum;
+      - elements tracked through the 'moved' callback can be removed
+        or re-prioritized from the middle of the heap;
+      - the array is given back (allocation counters end at zero).
+*/
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+#define N 20000
+
+typedef struct {
+    int priority;   /* lower is served first */
+    unsigned seq;   /* push order, breaks ties */
+    size_t slot;    /* kept up to date by on_moved */
+    bool queued;
+} Item;
+
+static int item_cmp(const void *a, const void *b, void *ctx)
+{
+    (void)ctx;
+    const Item *x = a, *y = b;
+    if (x->priority != y->priority)
+        return x->priority < y->priority ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static void on_moved(void *elem, size_t index, void *ctx)
+{
+    (void)ctx;
+    ((Item *)elem)->slot = index;
+}
+
+/* Every slot index matches its element and no child is served before its parent. */
+static bool heap_valid(const Heap *h)
+{
+    for (size_t i = 0; i < heap_size(h); ++i)
+    {
+        const Item *it = heap_at(h, i);
+        if (it->slot != i)
+            return false;
+        if (i > 0 && item_cmp(it, heap_at(h, (i - 1) / 2), NULL) < 0)
+            return false;
+    }
+    return true;
+}
+
+/* ---- push everything, pop everything ---- */
+
+static void test_order(void)
+{
+    static Item items[N];
+    Heap *h = heap_create(item_cmp, on_moved, NULL);
+    CHECK(h != NULL, "create");
+    CHECK(heap_peek(h) == NULL && heap_pop(h) == NULL, "empty heap has nothing to pop");
+
+    srand(4242);
+    for (unsigned i = 0; i < N; ++i)
+    {
+        items[i].priority = rand() % 100; /* many ties */
+        items[i].seq = i;
+        CHECK(heap_push(h, &items[i]) == 0, "push");
+    }
+    CHECK(heap_size(h) == N, "size after pushes");
+    CHECK(heap_valid(h), "heap property after pushes");
+
+    const Item *prev = NULL;
+    size_t popped = 0;
+    while (!heap_empty(h))
+    {
+        const Item *it = heap_pop(h);
+        CHECK(prev == NULL || item_cmp(prev, it, NULL) < 0, "pops in priority order, FIFO among equals");
+        prev = it;
+        ++popped;
+    }
+    CHECK(popped == N, "every element popped once");
+
+    heap_destroy(h);
+}
+
+/* ---- random pushes, pops, removals and updates ---- */
+
+/* Brute-force answer: the queued item served first. */
+static Item *min_queued(Item *items, size_t n)
+{
+    Item *best = NULL;
+    for (size_t i = 0; i < n; ++i)
+        if (items[i].queued && (!best || item_cmp(&items[i], best, NULL) < 0))
+            best = &items[i];
+    return best;
+}
+
+static void test_random(void)
+{
+    enum { POOL = 500 };
+    static Item items[POOL];
+    Heap *h = heap_create(item_cmp, on_moved, NULL);
+    unsigned seq = 0;
+    size_t queued = 0;
+
+    srand(777);
+    for (int round = 0; round < 100000; ++round)
+    {
+        Item *it = &items[rand() % POOL];
+        int op = rand() % 4;
+
+        if (op == 0 && !it->queued)
+        {
+            it->priority = rand() % 50;
+            it->seq = seq++;
+            CHECK(heap_push(h, it) == 0, "random push");
+            it->queued = true;
+            ++queued;
+        }
+        else if (op == 1 && queued > 0)
+        {
+            Item *expected = min_queued(items, POOL);
+            Item *got = heap_pop(h);
+            CHECK(got == expected, "pop returns the brute-force minimum");
+            if (got)
+            {
+                got->queued = false;
+                --queued;
+            }
+        }
+        else if (op == 2 && it->queued)
+        {
+            CHECK(heap_remove_at(h, it->slot) == it, "remove from the middle");
+            it->queued = false;
+            --queued;
+        }
+        else if (op == 3 && it->queued)
+        {
+            it->priority = rand() % 50;
+            heap_update_at(h, it->slot);
+        }
+
+        if (round % 10000 == 0)
+            CHECK(heap_valid(h), "heap property after random ops");
+    }
+
+    CHECK(heap_size(h) == queued, "size tracks pushes and removals");
+    CHECK(heap_remove_at(h, heap_size(h)) == NULL, "remove out of range");
+    CHECK(heap_at(h, heap_size(h)) == NULL, "at out of range");
+    CHECK(heap_valid(h), "heap property at the end");
+
+    heap_destroy(h);
+}
+
+int main(void)
+{
+    printf("== Heap Test ==\n");
+
+    AedMemStats before;
+    aed_mem_stats(AED_MEM_INDEX, &before);
+
+    test_order();
+    test_random();
+
+    AedMemStats after;
+    aed_mem_stats(AED_MEM_INDEX, &after);
+    CHECK(after.bytes == before.bytes && after.objects == before.objects,
+          "every array was freed");
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "thread_pool.h"
+
+/*
+    Smoke tests for the work-stealing thread pool:
+      - plain submit/wait;
+      - parallel-for covers every index exactly once;
+      - nested parallel-for from inside tasks does not deadlock;
+      - tasks queued on one worker get stolen by the others;
+      - a NULL pool runs parallel-for inline.
+*/
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+/* ---- submit / wait ---- */
+
+static void increment(void *arg)
+{
+    atomic_fetch_add((_Atomic long *)arg, 1);
+}
+
+static void test_submit_wait(ThreadPool *pool)
+{
+    _Atomic long counter = 0;
+
+    for (int i = 0; i < 10000; ++i)
+        if (!thread_pool_submit(pool, increment, &counter))
+            increment(&counter);
+
+    thread_pool_wait(pool);
+    CHECK(atomic_load(&counter) == 10000, "submit/wait ran every task once");
+}
+
+/* ---- parallel-for ---- */
+
+#define RANGE_SIZE 1000000
+
+static void mark_range(size_t begin, size_t end, void *ctx)
+{
+    unsigned char *hits = ctx;
+    for (size_t i = begin; i < end; ++i)
+        hits[i]++;
+}
+
+static void test_parallel_for(ThreadPool *pool)
+{
+    unsigned char *hits = calloc(RANGE_SIZE, 1);
+    if (!hits)
+    {
+        CHECK(0, "allocation for parallel-for test");
+        return;
+    }
+
+    /* Automatic grain, then an explicit grain that does not divide the range. */
+    thread_pool_parallel_for(pool, 0, RANGE_SIZE, 0, mark_range, hits);
+    thread_pool_parallel_for(pool, 0, RANGE_SIZE, 777, mark_range, hits);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < RANGE_SIZE; ++i)
+        if (hits[i] != 2)
+            wrong++;
+
+    CHECK(wrong == 0, "parallel-for visited every index exactly once per call");
+    CHECK(thread_pool_parallel_for(pool, 5, 5, 0, mark_range, hits) == 0, "empty range is a no-op");
+    CHECK(thread_pool_parallel_for(pool, 0, 10, 0, NULL, NULL) == -1, "NULL body is rejected");
+
+    free(hits);
+}
+
+/* ---- nested parallel-for ---- */
+
+struct nested_ctx {
+    ThreadPool *pool;
+    _Atomic long total;
+};
+
+static void inner_body(size_t begin, size_t end, void *ctx)
+{
+    struct nested_ctx *nested = ctx;
+    atomic_fetch_add(&nested->total, (long)(end - begin));
+}
+
+static void outer_body(size_t begin, size_t end, void *ctx)
+{
+    struct nested_ctx *nested = ctx;
+    for (size_t i = begin; i < end; ++i)
+        thread_pool_parallel_for(nested->pool, 0, 1000, 10, inner_body, nested);
+}
+
+static void test_nested(ThreadPool *pool)
+{
+    struct nested_ctx nested;
+    nested.pool = pool;
+    atomic_init(&nested.total, 0);
+
+    thread_pool_parallel_for(pool, 0, 64, 1, outer_body, &nested);
+    CHECK(atomic_load(&nested.total) == 64 * 1000, "nested parallel-for completed");
+}
+
+/* ---- stealing ---- */
+
+#define SPAWNED_TASKS 64
+
+struct steal_ctx {
+    ThreadPool *pool;
+    pthread_t runners[SPAWNED_TASKS];
+    _Atomic int next;
+};
+
+static void sleepy_task(void *arg)
+{
+    struct steal_ctx *steal = arg;
+    int slot = atomic_fetch_add(&steal->next, 1);
+    steal->runners[slot] = pthread_self();
+
+    struct timespec pause = { 0, 1000000 }; /* 1 ms */
+    nanosleep(&pause, NULL);
+}
+
+/* Runs on one worker and queues everything on that worker's own deque. */
+static void spawner_task(void *arg)
+{
+    struct steal_ctx *steal = arg;
+    for (int i = 0; i < SPAWNED_TASKS; ++i)
+        if (!thread_pool_submit(steal->pool, sleepy_task, steal))
+            sleepy_task(steal);
+}
+
+static void test_stealing(ThreadPool *pool)
+{
+    struct steal_ctx steal;
+    steal.pool = pool;
+    atomic_init(&steal.next, 0);
+
+    thread_pool_submit(pool, spawner_task, &steal);
+    thread_pool_wait(pool);
+
+    CHECK(atomic_load(&steal.next) == SPAWNED_TASKS, "every spawned task ran");
+
+    int distinct = 0;
+    for (int i = 0; i < SPAWNED_TASKS; ++i)
+    {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; ++j)
+            seen = pthread_equal(steal.runners[i], steal.runners[j]);
+        if (!seen)
+            distinct++;
+    }
+
+    printf("Spawned tasks ran on %d different threads.\n", distinct);
+    CHECK(distinct > 1, "idle workers stole tasks from the busy deque");
+}
+
+/* ---- no pool ---- */
+
+static void test_null_pool(void)
+{
+    unsigned char hits[100] = { 0 };
+    thread_pool_parallel_for(NULL, 0, 100, 0, mark_range, hits);
+
+    int wrong = 0;
+    for (int i = 0; i < 100; ++i)
+        if (hits[i] != 1)
+            wrong++;
+
+    CHECK(wrong == 0, "NULL pool runs parallel-for inline");
+    CHECK(!thread_pool_submit(NULL, increment, NULL), "submit on NULL pool fails");
+}
+
+int main(void)
+{
+    printf("== Thread Pool Test ==\n");
+
+    ThreadPool *pool = thread_pool_create(4);
+    if (!pool)
+    {
+        printf("Failed to create pool!\n");
+        return 1;
+    }
+    printf("Pool started with %u workers.\n", thread_pool_size(pool));
+
+    test_submit_wait(pool);
+    test_parallel_for(pool);
+    test_nested(pool);
+    test_stealing(pool);
+    test_null_pool();
+
+    thread_pool_destroy(pool);
+
+    /* 0 = one worker per CPU; destroy must drain pending tasks. */
+    ThreadPool *auto_pool = thread_pool_create(0);
+    CHECK(auto_pool != NULL && thread_pool_size(auto_pool) > 0, "auto-sized pool starts");
+    _Atomic long counter = 0;
+    for (int i = 0; i < 1000; ++i)
+        thread_pool_submit(auto_pool, increment, &counter);
+    thread_pool_destroy(auto_pool);
+    CHECK(atomic_load(&counter) == 1000, "destroy waits for queued tasks");
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,311 @@
+/* pthread_getcpuclockid and the socket calls below are POSIX/Linux. */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+
+#include "app/server.h"
+
+/*
+    Socket server regression tests (Linux only):
+      - a client that half-closes while its command is still running
+        gets its reply, and the event loop does not spin meanwhile;
+      - a client that hangs up while its command runs is dropped
+        without the loop spinning or touching the freed connection;
+      - starting on a path that holds a regular file or a live
+        server's socket fails and leaves it alone;
+      - the server keeps serving afterwards and stops on SIGTERM.
+
+    A command is kept "running" by holding the books table lock while
+    a "search" waits for it; the loop's CPU time over that window must
+    stay near zero.
+*/
+
+#ifdef __linux__
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SOCKET_PATH "build/test_server.sock"
+#define FILE_PATH "build/test_server.file"
+
+/* How long a command is held, and the loop CPU allowed meanwhile. */
+#define HOLD_MS 300
+#define SPIN_LIMIT_MS 50
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                           \
+    do {                                           \
+        if (!(cond)) {                             \
+            printf("FAIL: %s\n", msg);             \
+            failures++;                            \
+        }                                          \
+    } while (0)
+
+static DB db;
+static int server_rc = -1;
+
+static void *serve(void *arg)
+{
+    (void)arg;
+    server_rc = server_run(&db, SOCKET_PATH, 2);
+    return NULL;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int connect_server(void)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+
+    /* The listener may not be up yet. */
+    for (int attempt = 0; attempt < 200; ++attempt)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof addr) == 0)
+            return fd;
+        close(fd);
+        sleep_ms(10);
+    }
+    return -1;
+}
+
+static void send_line(int fd, const char *line)
+{
+    size_t len = strlen(line);
+    while (len > 0)
+    {
+        ssize_t n = send(fd, line, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        line += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Reads until the server closes the connection. */
+static size_t read_all(int fd, char *buf, size_t size)
+{
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        ssize_t n = recv(fd, buf + len, size - 1 - len, 0);
+        if (n <= 0)
+            break;
+        len += (size_t)n;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static long cpu_ms(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* CPU the event loop burns while a command of a gone peer is held. */
+static long loop_cpu_while_held(clockid_t loop_clock, int fd, bool hang_up)
+{
+    pthread_rwlock_wrlock(&db.books_lock);
+    send_line(fd, "search title zzz\n");
+    if (hang_up)
+        close(fd);
+    else
+        shutdown(fd, SHUT_WR);
+
+    long before = cpu_ms(loop_clock);
+    sleep_ms(HOLD_MS);
+    long used = cpu_ms(loop_clock) - before;
+    pthread_rwlock_unlock(&db.books_lock);
+    return used;
+}
+
+/* 1 if the server at SOCKET_PATH still answers "quit". */
+static int server_answers(void)
+{
+    int fd = connect_server();
+    if (fd < 0)
+        return 0;
+    send_line(fd, "quit\n");
+    char reply[256];
+    read_all(fd, reply, sizeof reply);
+    close(fd);
+    return strstr(reply, "OK bye") != NULL;
+}
+
+static void test_half_close(clockid_t loop_clock)
+{
+    int fd = connect_server();
+    CHECK(fd >= 0, "half-close: connect");
+    if (fd < 0)
+        return;
+
+    long used = loop_cpu_while_held(loop_clock, fd, false);
+    char reply[4096];
+    read_all(fd, reply, sizeof reply);
+    close(fd);
+
+    CHECK(used < SPIN_LIMIT_MS, "half-close: the loop spins while the command runs");
+    CHECK(strstr(reply, "OK") != NULL, "half-close: the reply is still delivered");
+    printf("Half-closed client: loop used %ld ms of CPU in %d ms.\n", used, HOLD_MS);
+}
+
+static void test_hang_up(clockid_t loop_clock)
+{
+    int fd = connect_server();
+    CHECK(fd >= 0, "hang-up: connect");
+    if (fd < 0)
+        return;
+
+    long used = loop_cpu_while_held(loop_clock, fd, true);
+    CHECK(used < SPIN_LIMIT_MS, "hang-up: the loop spins while the command runs");
+    printf("Hung-up client: loop used %ld ms of CPU in %d ms.\n", used, HOLD_MS);
+
+    /* The server must still answer once the orphaned reply was dropped. */
+    sleep_ms(50);
+    CHECK(server_answers(), "hang-up: the server stopped answering");
+}
+
+static void test_occupied_paths(void)
+{
+    FILE *f = fopen(FILE_PATH, "w");
+    CHECK(f != NULL, "occupied: create file");
+    if (!f)
+        return;
+    fputs("data\n", f);
+    fclose(f);
+
+    CHECK(server_run(&db, FILE_PATH, 1) == -1, "occupied: started over a regular file");
+    char line[16] = "";
+    f = fopen(FILE_PATH, "r");
+    if (f)
+    {
+        if (!fgets(line, sizeof line, f))
+            line[0] = '\0';
+        fclose(f);
+    }
+    CHECK(strcmp(line, "data\n") == 0, "occupied: the regular file was touched");
+    remove(FILE_PATH);
+
+    CHECK(server_run(&db, SOCKET_PATH, 1) == -1, "occupied: took over a live server's socket");
+    CHECK(server_answers(), "occupied: the running server stopped answering");
+    printf("Occupied paths: a file and a live socket are left alone.\n");
+}
+
+int main(void)
+{
+    printf("== Server Test ==\n");
+
+    if (db_init(&db, "data/books_test.txt", "data/users_test.txt", "data/loans_test.txt",
+                "data/suggestions_test.txt") != 0)
+    {
+        printf("db_init failed\n");
+        return 1;
+    }
+    db_set_concurrent(&db, true);
+
+    /* SIGTERM must reach the server's signalfd, not kill this thread. */
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    pthread_t loop;
+    clockid_t loop_clock;
+    if (pthread_create(&loop, NULL, serve, NULL) != 0 ||
+        pthread_getcpuclockid(loop, &loop_clock) != 0)
+    {
+        printf("could not start the server thread\n");
+        db_destroy(&db);
+        return 1;
+    }
+
+    test_half_close(loop_clock);
+    test_hang_up(loop_clock);
+    test_occupied_paths();
+
+    kill(getpid(), SIGTERM);
+    pthread_join(loop, NULL);
+    CHECK(server_rc == 0, "the server did not stop cleanly");
+
+    db_set_concurrent(&db, false);
+    db_destroy(&db);
+
+    if (failures)
+    {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+
+    printf("OK!\n");
+    return 0;
+}
+
+#else /* !__linux__ */
+
+/* 1 if the server at SOCKET_PATH still answers "quit". */
+static int server_answers(void)
+{
+    int fd = connect_server();
+    if (fd < 0)
+        return 0;
+    send_line(fd, "quit\n");
+    char reply[256];
+    read_all(fd, reply, sizeof reply);
+    close(fd);
+    return strstr(reply, "OK bye") != NULL;
+}
+
+static void test_occupied_paths(void)
+{
+    FILE *f = fopen(FILE_PATH, "w");
+    CHECK(f != NULL, "occupied: create file");
+    if (!f)
+        return;
+    fputs("data\n", f);
+    fclose(f);
+
+    CHECK(server_run(&db, FILE_PATH, 1) == -1, "occupied: started over a regular file");
+    char line[16] = "";
+    f = fopen(FILE_PATH, "r");
+    if (f)
+    {
+        if (!fgets(line, sizeof line, f))
+            line[0] = '\0';
+        fclose(f);
+    }
+    CHECK(strcmp(line, "data\n") == 0, "occupied: the regular file was touched");
+    remove(FILE_PATH);
+
+    CHECK(server_run(&db, SOCKET_PATH, 1) == -1, "occupied: took over a live server's socket");
+    CHECK(server_answers(), "occupied: the running server stopped answering");
+    printf("Occupied paths: a file and a live socket are left alone.\n");
+}
+
+int main(void)
+{
+    printf("== Server Test ==\nSkipped: the server needs Linux.\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+    Cliente minimo para o modo servidor ('main --serve <socket>').
+
+    Uso:
+      aed_client <socket> [comando...]
+
+    Com um comando na linha de argumentos envia-o e imprime a resposta.
+    Sem comando, le linhas do stdin e envia uma de cada vez.
+    Cada resposta termina numa linha que comeca por "OK" ou "ERR";
+    o codigo de saida e 1 se a ultima resposta foi um erro.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define LINE_MAX_LEN 4096
+
+static int connect_to(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof addr.sun_path)
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+    Prints reply lines until the terminating OK/ERR line.
+    Returns 0 for OK, 1 for ERR, -1 if the server went away.
+*/
+static int read_reply(FILE *in)
+{
+    char line[LINE_MAX_LEN];
+
+    while (fgets(line, sizeof line, in))
+    {
+        fputs(line, stdout);
+        if (strncmp(line, "OK", 2) == 0)
+            return 0;
+        if (strncmp(line, "ERR", 3) == 0)
+            return 1;
+    }
+
+    return -1;
+}
+
+static int run_command(int fd, FILE *in, const char *command)
+{
+    if (send_all(fd, command, strlen(command)) != 0 || send_all(fd, "\n", 1) != 0)
+        return -1;
+    return read_reply(in);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Uso: %s <socket> [comando...]\n", argv[0]);
+        return 2;
+    }
+
+    int fd = connect_to(argv[1]);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Nao foi possivel ligar a %s.\n", argv[1]);
+        return 2;
+    }
+
+    /* Separate stream for reading, so fgets can buffer the replies. */
+    FILE *in = fdopen(dup(fd), "r");
+    if (!in)
+    {
+        close(fd);
+        return 2;
+    }
+
+    int rc = 0;
+
+    if (argc > 2)
+    {
+        char command[LINE_MAX_LEN] = "";
+        for (int i = 2; i < argc; ++i)
+        {
+            if (i > 2)
+                strncat(command, " ", sizeof command - strlen(command) - 1);
+            strncat(command, argv[i], sizeof command - strlen(command) - 1);
+        }
+        rc = run_command(fd, in, command);
+    }
+    else
+    {
+        char line[LINE_MAX_LEN];
+        while (rc >= 0 && fgets(line, sizeof line, stdin))
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0')
+                continue;
+            rc = run_command(fd, in, line);
+        }
+    }
+
+    fclose(in);
+    close(fd);
+
+    if (rc < 0)
+    {
+        fprintf(stderr, "Ligacao terminada pelo servidor.\n");
+        return 2;
+    }
+    return rc;
+}
@@ -0,0 +1,523 @@
+/*
+    Synthetic dataset generator (see tools/datagen.h).
+
+    Randomness: each record seeds its own splitmix64 stream from
+    (seed, record kind, id), so generation is deterministic and does
+    not depend on order.
+
+    Skewed choices (author of a book, book of a loan) use a Zipf
+    distribution sampled by binary search over a precomputed CDF.
+    For loans the popularity rank is scattered over the id space, so
+    the most borrowed books are not simply the lowest ids.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "tools/datagen.h"
+#include "model/date.h"
+
+/* Stream tags, so book 7 and user 7 do not share random numbers. */
+enum { KIND_BOOK = 1, KIND_USER, KIND_LOAN, KIND_SUGGESTION };
+
+/* Bigger stdio buffers make writing millions of lines much cheaper. */
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+static const char *const title_words[] = {
+    "Segredo", "Rio", "Noite", "Cidade", "Mar", "Memorias", "Viagem", "Sombra",
+    "Jardim", "Tempo", "Historia", "Casa", "Luz", "Silencio", "Caminho", "Vento",
+    "Estrela", "Montanha", "Livro", "Guerra", "Paz", "Amor", "Ilha", "Fogo",
+    "Inverno", "Verao", "Rei", "Rainha", "Coracao", "Deserto", "Janela", "Ponte",
+    "Espelho", "Chave", "Labirinto", "Mapa", "Relogio", "Farol", "Floresta", "Sonho",
+    "Perdido", "Ultimo", "Primeiro", "Eterno", "Secreto", "Antigo", "Azul", "Negro",
+    "Dourado", "Esquecido", "Proibido", "Invisivel", "Grande", "Pequeno", "Novo", "Velho",
+    "Algoritmos", "Estruturas", "Dados", "Programacao", "Sistemas", "Redes", "Calculo", "Fisica",
+    "Quimica", "Introducao", "Manual", "Guia", "Teoria", "Pratica", "Principios", "Fundamentos",
+};
+
+static const char *const linking_words[] = { "do", "da", "de", "e", "no", "na", "sem", "para" };
+
+static const char *const first_names[] = {
+    "Ana", "Joao", "Maria", "Pedro", "Ines", "Tiago", "Sofia", "Rui", "Beatriz", "Miguel",
+    "Carla", "Nuno", "Marta", "Luis", "Rita", "Jorge", "Helena", "Paulo", "Sara", "Andre",
+    "Clara", "Bruno", "Teresa", "Diogo", "Joana", "Ricardo", "Filipa", "Hugo", "Lucia", "Goncalo",
+    "Isabel", "Rafael", "Catarina", "Vasco", "Leonor", "Duarte", "Mariana", "Fernando", "Patricia", "Tomas",
+};
+
+static const char *const last_names[] = {
+    "Silva", "Santos", "Ferreira", "Pereira", "Oliveira", "Costa", "Rodrigues", "Martins", "Jesus", "Sousa",
+    "Fernandes", "Goncalves", "Gomes", "Lopes", "Marques", "Alves", "Almeida", "Ribeiro", "Pinto", "Carvalho",
+    "Teixeira", "Moreira", "Correia", "Mendes", "Nunes", "Soares", "Vieira", "Monteiro", "Cardoso", "Rocha",
+    "Raposo", "Neves", "Coelho", "Cruz", "Cunha", "Pires", "Ramos", "Reis", "Simoes", "Antunes",
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+struct DataGen {
+    DataGenConfig cfg;
+    double *author_cdf;   /* cfg.authors entries */
+    double *book_cdf;     /* cfg.books entries */
+    unsigned book_stride; /* popularity rank -> book id scatter, coprime with cfg.books */
+    int day_from;         /* cfg.date_from/to as day numbers */
+    int day_to;
+};
+
+/* ---------------------------------------------------------------
+   Random numbers
+   --------------------------------------------------------------- */
+
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static Rng record_rng(const DataGen *g, unsigned kind, unsigned id)
+{
+    Rng r;
+    r.state = g->cfg.seed ^ ((uint64_t)kind << 56) ^ ((uint64_t)id * 0xD1B54A32D192ED03ull);
+    splitmix64(&r.state); /* decorrelate neighbouring ids */
+    return r;
+}
+
+/* Uniform in [0, 1). */
+static double rng_unit(Rng *r)
+{
+    return (double)(splitmix64(&r->state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform in [lo, hi]. */
+static unsigned rng_range(Rng *r, unsigned lo, unsigned hi)
+{
+    if (hi <= lo)
+        return lo;
+    return lo + (unsigned)(splitmix64(&r->state) % ((uint64_t)hi - lo + 1));
+}
+
+/* ---------------------------------------------------------------
+   Zipf sampling
+   --------------------------------------------------------------- */
+
+static double *zipf_cdf(unsigned n, double skew)
+{
+    double *cdf = malloc((size_t)n * sizeof *cdf);
+    if (!cdf)
+        return NULL;
+
+    double total = 0.0;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        total += skew == 0.0 ? 1.0 : 1.0 / pow((double)(i + 1), skew);
+        cdf[i] = total;
+    }
+    for (unsigned i = 0; i < n; ++i)
+        cdf[i] /= total;
+
+    return cdf;
+}
+
+/* Rank in [0, n) with P(rank k) proportional to 1/(k+1)^skew. */
+static unsigned zipf_sample(const double *cdf, unsigned n, Rng *r)
+{
+    double u = rng_unit(r);
+    unsigned lo = 0, hi = n - 1;
+
+    while (lo < hi)
+    {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+    while (b)
+    {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* ---------------------------------------------------------------
+   Text helpers
+   --------------------------------------------------------------- */
+
+static void append_word(char *dst, size_t size, const char *word)
+{
+    size_t len = strlen(dst);
+    if (len > 0 && len + 1 < size)
+        dst[len++] = ' ';
+    if (len < size)
+        snprintf(dst + len, size - len, "%s", word);
+}
+
+/* Author names are a function of the author rank only. */
+static void author_name(unsigned rank, char *out, size_t size)
+{
+    unsigned nf = COUNT_OF(first_names);
+    unsigned nl = COUNT_OF(last_names);
+    const char *first = first_names[rank % nf];
+    const char *last = last_names[(rank / nf) % nl];
+    unsigned generation = rank / (nf * nl);
+
+    /* Past first x last combinations, add a middle initial to keep names distinct. */
+    if (generation == 0)
+        snprintf(out, size, "%s %s", first, last);
+    else
+        snprintf(out, size, "%s %c. %s", first, 'A' + (char)((generation - 1) % 26), last);
+}
+
+/*
+    Title of 1..n words: mostly content words, with linking words in
+    between now and then ("Memorias do Rio Azul").
+*/
+static void make_title(const DataGen *g, Rng *r, char *out, size_t size)
+{
+    /* Short titles are the most common: take the min of two draws. */
+    unsigned a = rng_range(r, g->cfg.title_words_min, g->cfg.title_words_max);
+    unsigned b = rng_range(r, g->cfg.title_words_min, g->cfg.title_words_max);
+    unsigned words = a < b ? a : b;
+
+    out[0] = '\0';
+    for (unsigned w = 0; w < words; ++w)
+    {
+        if (w > 0 && w + 1 < words && rng_unit(r) < 0.3)
+            append_word(out, size, linking_words[rng_range(r, 0, COUNT_OF(linking_words) - 1)]);
+        append_word(out, size, title_words[rng_range(r, 0, COUNT_OF(title_words) - 1)]);
+    }
+}
+
+/* ISBN-13 with a valid check digit. */
+static void make_isbn(Rng *r, char *out, size_t size)
+{
+    char digits[14];
+    memcpy(digits, "978", 3);
+    for (int i = 3; i < 12; ++i)
+        digits[i] = (char)('0' + rng_range(r, 0, 9));
+
+    int sum = 0;
+    for (int i = 0; i < 12; ++i)
+        sum += (digits[i] - '0') * (i % 2 ? 3 : 1);
+    digits[12] = (char)('0' + (10 - sum % 10) % 10);
+    digits[13] = '\0';
+
+    snprintf(out, size, "%s", digits);
+}
+
+/* One small edit that a person typing a suggestion could make. */
+static void mutate(Rng *r, char *text, size_t size)
+{
+    size_t len = strlen(text);
+    if (len < 2)
+        return;
+
+    size_t at = rng_range(r, 0, (unsigned)len - 2);
+
+    switch (rng_range(r, 0, 3))
+    {
+    case 0: /* all lower case */
+        for (size_t i = 0; i < len; ++i)
+            text[i] = (char)tolower((unsigned char)text[i]);
+        break;
+    case 1: /* dropped character */
+        memmove(text + at, text + at + 1, len - at);
+        break;
+    case 2: /* swapped neighbours */
+    {
+        char t = text[at];
+        text[at] = text[at + 1];
+        text[at + 1] = t;
+        break;
+    }
+    default: /* doubled character */
+        if (len + 1 < size)
+        {
+            memmove(text + at + 1, text + at, len - at + 1);
+        }
+        break;
+    }
+}
+
+/* ---------------------------------------------------------------
+   Public API
+   --------------------------------------------------------------- */
+
+void datagen_default_config(DataGenConfig *cfg)
+{
+    cfg->books = 10000;
+    cfg->users = 2000;
+    cfg->loans = 50000;
+    cfg->suggestions = 1000;
+
+    cfg->authors = 1500;
+    cfg->author_skew = 1.0;
+    cfg->book_skew = 0.8;
+
+    cfg->title_words_min = 1;
+    cfg->title_words_max = 7;
+
+    cfg->date_from = 20200101;
+    cfg->date_to = 20251231;
+    cfg->returned_ratio = 0.85;
+
+    cfg->duplicate_ratio = 0.2;
+
+    cfg->seed = 42;
+}
+
+DataGen *datagen_create(const DataGenConfig *cfg)
+{
+    if (!cfg || cfg->authors == 0 || cfg->title_words_min == 0 ||
+        cfg->title_words_min > cfg->title_words_max || cfg->date_from > cfg->date_to ||
+        cfg->author_skew < 0.0 || cfg->book_skew < 0.0)
+        return NULL;
+
+    DataGen *g = calloc(1, sizeof *g);
+    if (!g)
+        return NULL;
+
+    g->cfg = *cfg;
+    g->author_cdf = zipf_cdf(cfg->authors, cfg->author_skew);
+    if (cfg->books > 0)
+        g->book_cdf = zipf_cdf(cfg->books, cfg->book_skew);
+
+    if (!g->author_cdf || (cfg->books > 0 && !g->book_cdf))
+    {
+        datagen_destroy(g);
+        return NULL;
+    }
+
+    /* Any stride coprime with books visits every id exactly once. */
+    g->book_stride = 1;
+    if (cfg->books > 1)
+    {
+        g->book_stride = (unsigned)(2654435761u % cfg->books);
+        while (g->book_stride == 0 || gcd(g->book_stride, cfg->books) != 1)
+            g->book_stride++;
+    }
+
+    g->day_from = (int)date_from_yyyymmdd(cfg->date_from);
+    g->day_to = (int)date_from_yyyymmdd(cfg->date_to);
+    return g;
+}
+
+void datagen_destroy(DataGen *g)
+{
+    if (!g)
+        return;
+
+    free(g->author_cdf);
+    free(g->book_cdf);
+    free(g);
+}
+
+void datagen_book(const DataGen *g, unsigned id, Book *out)
+{
+    Rng r = record_rng(g, KIND_BOOK, id);
+
+    char title[sizeof out->title];
+    char author[sizeof out->author];
+    make_title(g, &r, title, sizeof title);
+    author_name(zipf_sample(g->author_cdf, g->cfg.authors, &r), author, sizeof author);
+
+    /* Mostly recent books, with a long tail of older ones. */
+    int age = (int)(-25.0 * log(1.0 - rng_unit(&r)));
+    int year = 2025 - (age > 400 ? 400 : age);
+
+    /* Most titles have 1-2 copies, a few have many. */
+    int copies = (int)rng_range(&r, 0, 2) + (rng_unit(&r) < 0.1 ? (int)rng_range(&r, 1, 10) : 0);
+
+    book_init(out, id, title, author, year, copies);
+}
+
+void datagen_user(const DataGen *g, unsigned id, User *out)
+{
+    Rng r = record_rng(g, KIND_USER, id);
+
+    const char *first = first_names[rng_range(&r, 0, COUNT_OF(first_names) - 1)];
+    const char *last = last_names[rng_range(&r, 0, COUNT_OF(last_names) - 1)];
+
+    char name[sizeof out->name];
+    char email[sizeof out->email];
+    snprintf(name, sizeof name, "%s %s", first, last);
+    snprintf(email, sizeof email, "%s.%s%u@example.com", first, last, id);
+    for (char *c = email; *c; ++c)
+        *c = (char)tolower((unsigned char)*c);
+
+    user_init(out, id, name, email);
+}
+
+void datagen_loan(const DataGen *g, unsigned id, Loan *out)
+{
+    Rng r = record_rng(g, KIND_LOAN, id);
+
+    unsigned book_id = 0;
+    if (g->cfg.books > 0)
+    {
+        unsigned rank = zipf_sample(g->book_cdf, g->cfg.books, &r);
+        book_id = (unsigned)(((uint64_t)rank * g->book_stride) % g->cfg.books) + 1;
+    }
+    unsigned user_id = g->cfg.users > 0 ? rng_range(&r, 1, g->cfg.users) : 0;
+
+    /*
+        Ids are handed out in borrow order, so the borrow date grows
+        with the id (plus a few days of jitter).
+    */
+    int span = g->day_to - g->day_from;
+    int day = g->day_from;
+    if (g->cfg.loans > 1)
+        day += (int)((int64_t)span * (id - 1) / (g->cfg.loans - 1));
+    day += (int)rng_range(&r, 0, 6) - 3;
+    if (day < g->day_from)
+        day = g->day_from;
+    if (day > g->day_to)
+        day = g->day_to;
+
+    unsigned date_return = 0;
+    if (rng_unit(&r) < g->cfg.returned_ratio)
+    {
+        int back = day + (int)rng_range(&r, 1, 45);
+        if (back <= g->day_to)
+            date_return = date_to_yyyymmdd((Date)back);
+    }
+
+    loan_init(out, id, user_id, book_id, date_to_yyyymmdd((Date)day), date_return);
+}
+
+void datagen_suggestion(const DataGen *g, unsigned id, Suggestion *out)
+{
+    Rng r = record_rng(g, KIND_SUGGESTION, id);
+
+    char title[sizeof out->title];
+    char author[sizeof out->author];
+    char isbn[sizeof out->isbn];
+
+    if (g->cfg.books > 0 && rng_unit(&r) < g->cfg.duplicate_ratio)
+    {
+        /* Near-duplicate: an existing book, typed slightly differently. */
+        Book b;
+        datagen_book(g, rng_range(&r, 1, g->cfg.books), &b);
+        snprintf(title, sizeof title, "%s", b.title);
+        snprintf(author, sizeof author, "%s", b.author);
+        mutate(&r, title, sizeof title);
+        if (rng_unit(&r) < 0.3)
+            mutate(&r, author, sizeof author);
+    }
+    else
+    {
+        make_title(g, &r, title, sizeof title);
+        author_name(zipf_sample(g->author_cdf, g->cfg.authors, &r), author, sizeof author);
+    }
+
+    make_isbn(&r, isbn, sizeof isbn);
+    suggestion_init(out, id, title, author, isbn);
+}
+
+/* ---------------------------------------------------------------
+   File output
+   --------------------------------------------------------------- */
+
+static FILE *open_output(const char *path, char **buffer)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return NULL;
+
+    *buffer = malloc(WRITE_BUFFER_SIZE);
+    if (*buffer)
+        setvbuf(f, *buffer, _IOFBF, WRITE_BUFFER_SIZE);
+    return f;
+}
+
+static int close_output(FILE *f, char *buffer)
+{
+    int failed = ferror(f) != 0;
+    if (fclose(f) != 0)
+        failed = 1;
+    free(buffer);
+    return failed ? -1 : 0;
+}
+
+/*
+    Records are written in ascending id order; the loaders insert by
+    priority, so the order in the file does not matter to them.
+*/
+int datagen_write_files(const DataGen *g,
+                        const char *books_path,
+                        const char *users_path,
+                        const char *loans_path,
+                        const char *suggestions_path)
+{
+    if (!g || !books_path || !users_path || !loans_path || !suggestions_path)
+        return -1;
+
+    char line[512];
+    char *buffer = NULL;
+    int rc = 0;
+    FILE *f;
+
+    if (!(f = open_output(books_path, &buffer)))
+        return -1;
+    fprintf(f, "id;title;author;year;available\n");
+    for (unsigned id = 1; id <= g->cfg.books; ++id)
+    {
+        Book b;
+        datagen_book(g, id, &b);
+        book_to_csv(&b, line, sizeof line);
+        fprintf(f, "%s\n", line);
+    }
+    rc |= close_output(f, buffer);
+
+    if (!(f = open_output(users_path, &buffer)))
+        return -1;
+    fprintf(f, "id;name;email\n");
+    for (unsigned id = 1; id <= g->cfg.users; ++id)
+    {
+        User u;
+        datagen_user(g, id, &u);
+        user_to_csv(&u, line, sizeof line);
+        fprintf(f, "%s\n", line);
+    }
+    rc |= close_output(f, buffer);
+
+    if (!(f = open_output(loans_path, &buffer)))
+        return -1;
+    fprintf(f, "id;user_id;book_id;date_borrow;date_return\n");
+    for (unsigned id = 1; id <= g->cfg.loans; ++id)
+    {
+        Loan l;
+        datagen_loan(g, id, &l);
+        loan_to_csv(&l, line, sizeof line);
+        fprintf(f, "%s\n", line);
+    }
+    rc |= close_output(f, buffer);
+
+    if (!(f = open_output(suggestions_path, &buffer)))
+        return -1;
+    fprintf(f, "id;title;author;isbn\n");
+    for (unsigned id = 1; id <= g->cfg.suggestions; ++id)
+    {
+        Suggestion s;
+        datagen_suggestion(g, id, &s);
+        suggestion_to_csv(&s, line, sizeof line);
+        fprintf(f, "%s\n", line);
+    }
+    rc |= close_output(f, buffer);
+
+    return rc == 0 ? 0 : -1;
+}
@@ -0,0 +1,346 @@
+/*
+    replay: re-executes a workload trace recorded with 'main --record'.
+
+    Uso:
+      replay <trace> [--data DIR]
+
+      --data DIR   diretorio com os ficheiros iniciais (default data)
+
+    A DB e carregada de DIR e cada operacao do trace e repetida pela
+    mesma ordem, o mais depressa possivel (sem respeitar os intervalos
+    gravados). No fim imprime o debito e a distribuicao de latencias por
+    operacao. Para uma repeticao fiel, DIR deve ter os dados que existiam
+    quando a gravacao comecou (a aplicacao grava por cima de data/ ao
+    sair, por isso copie-a antes de gravar).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "db/db.h"
+#include "db/db_record.h"
+#include "db/db_stats.h"
+#include "cutils.h"
+
+#define PATH_MAX_LEN 512
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Uso: %s <trace> [--data DIR]\n", prog);
+}
+
+static int count_book(const Book *b, void *ctx)       { (void)b; ++*(unsigned long *)ctx; return 0; }
+static int count_user(const User *u, void *ctx)       { (void)u; ++*(unsigned long *)ctx; return 0; }
+static int count_loan(const Loan *l, void *ctx)       { (void)l; ++*(unsigned long *)ctx; return 0; }
+static int count_suggestion(const Suggestion *s, void *ctx) { (void)s; ++*(unsigned long *)ctx; return 0; }
+static int count_reservation(const Reservation *r, void *ctx) { (void)r; ++*(unsigned long *)ctx; return 0; }
+
+/* Id buffer for select_loans, grown to the largest cap in the trace. */
+static unsigned *select_ids = NULL;
+static size_t select_cap = 0;
+
+static int select_loans(DB *db, const DBRecordEntry *e)
+{
+    if (e->cap > select_cap)
+    {
+        unsigned *ids = realloc(select_ids, e->cap * sizeof *ids);
+        if (!ids)
+            return -1;
+        select_ids = ids;
+        select_cap = e->cap;
+    }
+
+    size_t count;
+    return db_loans_select(db, &e->filter, select_ids, e->cap, &count);
+}
+
+/*
+    Runs one entry against db. Returns the result of the db_* call
+    (0 or a found record -> 0, otherwise -1), or -2 if the entry could
+    not be decoded (bad CSV).
+*/
+static int execute(DB *db, const DBRecordEntry *e)
+{
+    unsigned long visited = 0;
+    unsigned next;
+    Book b;
+    User u;
+    Loan l;
+    Suggestion s;
+
+    switch (e->op)
+    {
+    case DB_OP_FIND_BOOK:       return db_find_book_by_id(db, e->id) ? 0 : -1;
+    case DB_OP_FIND_USER:       return db_find_user_by_id(db, e->id) ? 0 : -1;
+    case DB_OP_FIND_LOAN:       return db_find_loan_by_id(db, e->id) ? 0 : -1;
+    case DB_OP_FIND_SUGGESTION: return db_find_suggestion_by_id(db, e->id) ? 0 : -1;
+
+    case DB_OP_COPY_BOOK:       return db_copy_book_by_id(db, e->id, &b);
+    case DB_OP_COPY_USER:       return db_copy_user_by_id(db, e->id, &u);
+    case DB_OP_COPY_LOAN:       return db_copy_loan_by_id(db, e->id, &l);
+    case DB_OP_COPY_SUGGESTION: return db_copy_suggestion_by_id(db, e->id, &s);
+
+    case DB_OP_FOREACH_BOOK:       return db_foreach_book(db, count_book, &visited);
+    case DB_OP_FOREACH_USER:       return db_foreach_user(db, count_user, &visited);
+    case DB_OP_FOREACH_LOAN:       return db_foreach_loan(db, count_loan, &visited);
+    case DB_OP_FOREACH_SUGGESTION: return db_foreach_suggestion(db, count_suggestion, &visited);
+
+    case DB_OP_SEARCH_BOOKS:
+        return db_search_books(db, e->field, e->text, count_book, &visited);
+
+    case DB_OP_BOOKS_BY_YEAR:
+        return db_books_by_year_range(db, (int)e->from, (int)e->to, count_book, &visited);
+    case DB_OP_LOANS_BY_BORROW:
+        return db_loans_by_borrow_date(db, e->from, e->to, count_loan, &visited);
+    case DB_OP_LOANS_BY_RETURN:
+        return db_loans_by_return_date(db, e->from, e->to, count_loan, &visited);
+
+    case DB_OP_PAGE_BOOKS:
+        return db_books_page(db, e->from, e->to, count_book, &visited, &next) < 0 ? -1 : 0;
+    case DB_OP_PAGE_USERS:
+        return db_users_page(db, e->from, e->to, count_user, &visited, &next) < 0 ? -1 : 0;
+    case DB_OP_PAGE_LOANS:
+        return db_loans_page(db, e->from, e->to, count_loan, &visited, &next) < 0 ? -1 : 0;
+    case DB_OP_PAGE_SUGGESTIONS:
+        return db_suggestions_page(db, e->from, e->to, count_suggestion, &visited, &next) < 0 ? -1 : 0;
+
+    case DB_OP_LOANS_DUE_ON:
+        return db_loans_due_on(db, e->from, count_loan, &visited);
+    case DB_OP_LOANS_OVERDUE:
+        return db_loans_overdue(db, e->from, count_loan, &visited);
+
+    case DB_OP_COUNT_LOANS:
+    {
+        size_t count;
+        return db_loans_count(db, &e->filter, &count);
+    }
+    case DB_OP_SELECT_LOANS:
+        return select_loans(db, e);
+    case DB_OP_LOANS_DAYS_OUT:
+    {
+        size_t returned;
+        uint64_t days;
+        return db_loans_days_out(db, &e->filter, &returned, &days);
+    }
+
+    case DB_OP_ADD_BOOK:
+        if (!book_from_csv(&b, e->text))
+            return -2;
+        return e->auto_id ? db_add_book_auto(db, &b) : db_add_book(db, &b);
+    case DB_OP_ADD_USER:
+        if (!user_from_csv(&u, e->text))
+            return -2;
+        return e->auto_id ? db_add_user_auto(db, &u) : db_add_user(db, &u);
+    case DB_OP_ADD_LOAN:
+        if (!loan_from_csv(&l, e->text))
+            return -2;
+        return e->auto_id ? db_add_loan_auto(db, &l) : db_add_loan(db, &l);
+    case DB_OP_ADD_SUGGESTION:
+        if (!suggestion_from_csv(&s, e->text))
+            return -2;
+        return e->auto_id ? db_add_suggestion_auto(db, &s) : db_add_suggestion(db, &s);
+
+    case DB_OP_UPDATE_BOOK:
+        return book_from_csv(&b, e->text) ? db_update_book(db, &b) : -2;
+    case DB_OP_UPDATE_USER:
+        return user_from_csv(&u, e->text) ? db_update_user(db, &u) : -2;
+    case DB_OP_UPDATE_LOAN:
+        return loan_from_csv(&l, e->text) ? db_update_loan(db, &l) : -2;
+    case DB_OP_UPDATE_SUGGESTION:
+        return suggestion_from_csv(&s, e->text) ? db_update_suggestion(db, &s) : -2;
+
+    case DB_OP_CHECKOUT:
+        return db_checkout(db, e->id, e->from, e->to, NULL) == DB_CIRC_OK ? 0 : -1;
+    case DB_OP_RETURN:
+        return db_return(db, e->id, e->to, NULL) == DB_CIRC_OK ? 0 : -1;
+    case DB_OP_ACTIVE_LOANS:
+        db_user_active_loans(db, e->id);
+        return 0;
+
+    case DB_OP_RESERVE:
+    {
+        Reservation r;
+        if (!reservation_from_csv(&r, e->text))
+            return -2;
+        return db_reserve(db, r.user_id, r.book_id, r.tier, r.date) == DB_CIRC_OK ? 0 : -1;
+    }
+    case DB_OP_CANCEL_RESERVATION:
+        return db_cancel_reservation(db, e->id, e->from) == DB_CIRC_OK ? 0 : -1;
+    case DB_OP_BOOK_RESERVATIONS:
+    {
+        unsigned long holds = 0;
+        return db_book_reservations(db, e->id, count_reservation, &holds);
+    }
+
+    case DB_OP_TOTALS:
+    {
+        DBTotals t;
+        return db_totals(db, &t);
+    }
+    case DB_OP_BOOK_LOANS:
+        db_book_loans(db, e->id);
+        return 0;
+    case DB_OP_CHECK_TOTALS:
+        return db_check_totals(db) == 0 ? 0 : -1;
+    case DB_OP_BUILD_RECOMMENDATIONS:
+        return db_build_recommendations(db, NULL, NULL);
+    case DB_OP_RECOMMEND:
+    {
+        IdCount similar[RECOMMEND_NEIGHBORS_MAX];
+        size_t got;
+        size_t n = e->from < RECOMMEND_NEIGHBORS_MAX ? e->from : RECOMMEND_NEIGHBORS_MAX;
+        return db_recommend_for_book(db, e->id, n, similar, &got);
+    }
+    case DB_OP_SIMILAR_BOOKS:
+    case DB_OP_SIMILAR_SUGGESTIONS:
+    {
+        TitleMatch *matches = malloc((e->cap ? e->cap : 1) * sizeof *matches);
+        size_t n;
+        int rc = !matches ? -1 :
+                 e->op == DB_OP_SIMILAR_BOOKS
+                     ? db_similar_books(db, e->text, e->id, matches, e->cap, &n)
+                     : db_similar_suggestions(db, e->text, e->id, matches, e->cap, &n);
+        free(matches);
+        return rc;
+    }
+    case DB_OP_AUTOCOMPLETE:
+    {
+        unsigned *ids = malloc((e->cap ? e->cap : 1) * sizeof *ids);
+        size_t n;
+        int rc = !ids ? -1 : db_autocomplete(db, (DBCompleteField)e->id, e->text, e->cap, ids, &n);
+        free(ids);
+        return rc;
+    }
+    case DB_OP_TOP_BOOKS:
+    case DB_OP_TOP_USERS:
+    {
+        IdCount *top = malloc((e->id ? e->id : 1) * sizeof *top);
+        size_t n;
+        int rc = !top ? -1 :
+                 e->op == DB_OP_TOP_BOOKS ? db_top_books(db, e->id, e->from, e->to, top, &n)
+                                          : db_top_users(db, e->id, e->from, e->to, top, &n);
+        free(top);
+        return rc;
+    }
+
+    case DB_OP_REMOVE_BOOK:       return db_remove_book(db, e->id);
+    case DB_OP_REMOVE_USER:       return db_remove_user(db, e->id);
+    case DB_OP_REMOVE_LOAN:       return db_remove_loan(db, e->id);
+    case DB_OP_REMOVE_SUGGESTION: return db_remove_suggestion(db, e->id);
+
+    default:
+        return -2;
+    }
+}
+
+static void data_path(char *out, size_t size, const char *dir, const char *file)
+{
+    snprintf(out, size, "%s/%s", dir, file);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    const char *dir = "data";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--data") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (!trace_path && argv[i][0] != '-')
+            trace_path = argv[i];
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!trace_path)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(trace_path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Nao foi possivel abrir %s.\n", trace_path);
+        return 1;
+    }
+    if (db_record_read_header(f) != 0)
+    {
+        fprintf(stderr, "%s nao e um trace de workload.\n", trace_path);
+        fclose(f);
+        return 1;
+    }
+
+    char books[PATH_MAX_LEN], users[PATH_MAX_LEN], loans[PATH_MAX_LEN], suggestions[PATH_MAX_LEN];
+    char reservations[PATH_MAX_LEN];
+    data_path(books, sizeof books, dir, "books.txt");
+    data_path(users, sizeof users, dir, "users.txt");
+    data_path(loans, sizeof loans, dir, "loans.txt");
+    data_path(suggestions, sizeof suggestions, dir, "suggestions.txt");
+    data_path(reservations, sizeof reservations, dir, "reservations.txt");
+
+    DB db;
+    if (db_init(&db, books, users, loans, suggestions) != 0)
+    {
+        fprintf(stderr, "Erro ao carregar os dados de %s.\n", dir);
+        fclose(f);
+        return 1;
+    }
+    if (db_load_reservations(&db, reservations) != 0)
+        fprintf(stderr, "Aviso: erro ao carregar %s.\n", reservations);
+
+    /* A DB_STATS=1 build already times every call inside db.c. */
+    bool time_here = !db_stats_enabled();
+    db_stats_reset();
+
+    static DBRecordEntry entry; /* ~1 KB of text, keep it off the stack */
+    uint64_t clock_us = 0;
+    unsigned long ops = 0, failed = 0, invalid = 0;
+    int rc = 0;
+    int status;
+
+    uint64_t start = cutils_now_ns();
+    while ((status = db_record_read(f, &clock_us, &entry)) == 1)
+    {
+        uint64_t t0 = time_here ? cutils_now_ns() : 0;
+        int result = execute(&db, &entry);
+        if (time_here)
+            db_stats_record(entry.op, cutils_now_ns() - t0);
+
+        ++ops;
+        if (result == -2)
+            ++invalid;
+        else if (result != 0)
+            ++failed;
+    }
+    uint64_t elapsed = cutils_now_ns() - start;
+
+    if (status < 0)
+    {
+        fprintf(stderr, "Trace truncado ou invalido apos %lu operacoes.\n", ops);
+        rc = 1;
+    }
+    fclose(f);
+
+    double seconds = (double)elapsed / 1e9;
+    double recorded = (double)clock_us / 1e6;
+
+    printf("Operacoes:        %lu (%lu sem efeito, %lu invalidas)\n", ops, failed, invalid);
+    printf("Tempo de replay:  %.3f s\n", seconds);
+    printf("Debito:           %.0f ops/s\n", seconds > 0 ? (double)ops / seconds : 0.0);
+    printf("Tempo gravado:    %.3f s", recorded);
+    if (seconds > 0 && recorded > 0)
+        printf(" (%.1fx mais rapido)", recorded / seconds);
+    printf("\n\n");
+
+    db_stats_dump(stdout);
+
+    free(select_ids);
+    db_destroy(&db);
+    return rc;
+}